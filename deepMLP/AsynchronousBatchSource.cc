@@ -17,9 +17,10 @@
 
 #include "AsynchronousBatchSource.h"
 
+template <class Real>
 void *
 MinibatchProducer(void *asynchBatchSource) {
-  AsynchronousBatchSource *bs = (AsynchronousBatchSource *) asynchBatchSource;
+  AsynchronousBatchSourceT<Real> *bs = (AsynchronousBatchSourceT<Real> *) asynchBatchSource;
   infoMsg(IM::ObsFile, IM::Mod, "launching producer thread\n");
   bs->fill();
 #if HAVE_PTHREAD
@@ -28,3 +29,6 @@ MinibatchProducer(void *asynchBatchSource) {
   return NULL;
 #endif
 }
+
+template void *MinibatchProducer<double>(void *);
+template void *MinibatchProducer<float>(void *);
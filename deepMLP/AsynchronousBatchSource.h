@@ -43,10 +43,18 @@
 #include "Matrix.h"
 
 
+// thread entry point, instantiated in AsynchronousBatchSource.cc
+// for double and float
+template <class Real>
 void *MinibatchProducer(void *asynchBatchSource);
 
 
-class AsynchronousBatchSource : public BatchSource {
+template <class Real>
+class AsynchronousBatchSourceT : public BatchSourceT<Real> {
+
+  typedef MatrixT<Real>           Matrix;
+  typedef AllocatingMatrixT<Real> AllocatingMatrix;
+  typedef BatchSourceT<Real>      BatchSource;
 
   BatchSource      *src;         // BatchSource run by the producer thread
   AllocatingMatrix *dataQueue;   // queue of training features
@@ -68,7 +76,7 @@ class AsynchronousBatchSource : public BatchSource {
 
  public:
 
-  AsynchronousBatchSource(BatchSource *src, unsigned queueSize) 
+  AsynchronousBatchSourceT(BatchSource *src, unsigned queueSize) 
     : src(src), queueSize(queueSize), queueCount(0), queueStart(0)
 #if HAVE_PTHREAD
       , queueNotFull(PTHREAD_COND_INITIALIZER),
@@ -84,13 +92,13 @@ class AsynchronousBatchSource : public BatchSource {
     }
 #if HAVE_PTHREAD
     pthread_mutex_init(&queueMutex, NULL);
-    if (pthread_create(&producerThread, NULL, MinibatchProducer, (void *)this)) {
+    if (pthread_create(&producerThread, NULL, MinibatchProducer<Real>, (void *)this)) {
       error("ERROR: unable to start asynchronous minibatch producer thread\n");
     }
 #endif
   }
 
-  ~AsynchronousBatchSource() {
+  ~AsynchronousBatchSourceT() {
 #if HAVE_PTHREAD
     assert(pthread_cancel(producerThread) == 0);
 #endif
@@ -194,3 +202,5 @@ class AsynchronousBatchSource : public BatchSource {
 
   unsigned numLabelRows() { return src->numLabelRows(); }
 };
+
+typedef AsynchronousBatchSourceT<double> AsynchronousBatchSource;
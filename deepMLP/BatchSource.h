@@ -41,11 +41,17 @@
 //   Matrix class (see Matrix.h). 
 // The ScheduleBatchSource produces the stream from observation files permuted 
 //   according to a TrainingSchedule (see featureFileIO/TrainingSchedule.h).
+// All of them are templates on the element type of the Matrix classes;
+// BatchSource, MatrixBatchSource and ScheduleBatchSource are the double
+// versions.
 
-class BatchSource {
+template <class Real>
+class BatchSourceT {
 
  public:
 
+  typedef MatrixT<Real> Matrix;
+
   // Get the next batchSize training instances' data. You won't be able to get
   // their labels -- use getBatch() if you need them. May return fewer instances
   // than you request. Instances are columns, Matrix in column-major order.
@@ -75,7 +81,11 @@ class BatchSource {
 
 
 // Stream batches from instances of Galen's Matrix class
-class MatrixBatchSource : public BatchSource {
+template <class Real>
+class MatrixBatchSourceT : public BatchSourceT<Real> {
+  typedef MatrixT<Real>           Matrix;
+  typedef AllocatingMatrixT<Real> AllocatingMatrix;
+
 
   Matrix const     &dataSource;   // training data
   Matrix const     &labelSource;  // labels thereof
@@ -118,7 +128,7 @@ class MatrixBatchSource : public BatchSource {
 
  public:
 
-  MatrixBatchSource(Matrix const &dataSource, Matrix const &labelSource) 
+  MatrixBatchSourceT(Matrix const &dataSource, Matrix const &labelSource) 
     : dataSource(dataSource), labelSource(labelSource), nextColumn(0)
   {
     assert(dataSource.NumC() == labelSource.NumC());
@@ -126,7 +136,7 @@ class MatrixBatchSource : public BatchSource {
 
 
   // Use the same matrix as training data & labels (e.g., for pre-training)
-  MatrixBatchSource(Matrix const &source) 
+  MatrixBatchSourceT(Matrix const &source) 
     : dataSource(source), labelSource(source), nextColumn(0)
   { }
 
@@ -172,7 +182,11 @@ class MatrixBatchSource : public BatchSource {
 
 
 // Stream batches from a TrainingSchedule
-class ScheduleBatchSource : public BatchSource {
+template <class Real>
+class ScheduleBatchSourceT : public BatchSourceT<Real> {
+  typedef MatrixT<Real>           Matrix;
+  typedef AllocatingMatrixT<Real> AllocatingMatrix;
+
   TrainingSchedule *schedule;
   float            *TSfeatures;   // current unit's instance data
   float            *TSlabels;     // current unit's label data
@@ -186,7 +200,7 @@ class ScheduleBatchSource : public BatchSource {
 
  public:
 
-  ScheduleBatchSource(TrainingSchedule *schedule) 
+  ScheduleBatchSourceT(TrainingSchedule *schedule) 
     : schedule(schedule), TSfeatures(NULL), TSlabels(NULL), unitSize(0), curInstance(0)
   {
     assert(schedule);
@@ -194,7 +208,7 @@ class ScheduleBatchSource : public BatchSource {
     schedule->describeFeatures(dataRows, dummy);
     schedule->describeLabels(labelRows, dummy, labelStride);
     infoMsg(IM::ObsFile, IM::Moderate, "Training schedule batch source: data %u x %u;  labels %u x %u + %u\n",
-	    dataRows, epochSize(), labelRows, epochSize(), labelStride);
+	    dataRows, this->epochSize(), labelRows, this->epochSize(), labelStride);
   }
 
 
@@ -216,8 +230,8 @@ class ScheduleBatchSource : public BatchSource {
     infoMsg(IM::ObsFile, IM::High, "ScheduleBatchSource::getBatch(%u)\n", batchSize);
     dataTemp.Resize(dataRows, batchSize);
     labelTemp.Resize(labelRows, batchSize);
-    double *dataP = dataTemp.Start();
-    double *labelsP = labelTemp.Start();
+    Real *dataP = dataTemp.Start();
+    Real *labelsP = labelTemp.Start();
     // copy columns from {data,label}Temp until they're all used, then load more according to the schedule
     for (unsigned i = 0; i < batchSize; i += 1, 
 	   curInstance += 1, dataP += dataRows, labelsP += labelRows, TSfeatures += dataRows, TSlabels += labelStride) 
@@ -232,9 +246,9 @@ class ScheduleBatchSource : public BatchSource {
 	curInstance = 0;
       }
       for (unsigned r=0; r < dataRows; r+=1)
-	dataP[r] = (double) (TSfeatures[r]);
+	dataP[r] = (Real) (TSfeatures[r]);
       for (unsigned r=0; r < labelRows; r+=1)
-	labelsP[r] = (double) (TSlabels[r]);
+	labelsP[r] = (Real) (TSlabels[r]);
     }
     data = dataTemp;
     labels = labelTemp;
@@ -256,3 +270,7 @@ class ScheduleBatchSource : public BatchSource {
     return labelRows;
   }
 };
+
+typedef BatchSourceT<double>         BatchSource;
+typedef MatrixBatchSourceT<double>   MatrixBatchSource;
+typedef ScheduleBatchSourceT<double> ScheduleBatchSource;
@@ -0,0 +1,134 @@
+#pragma once
+
+/*
+ * Blas.h - element type overloads of the BLAS routines used by the
+ * Matrix classes and the NN training code
+ *
+ * The Matrix, Layer and DBN templates call blas_axpy() etc. and the
+ * overload picks the double (cblas_d*) or float (cblas_s*) kernel
+ * of whichever BLAS was configured (MKL, a system CBLAS, or the
+ * miniblas replacements). Dot products, sums and norms are always
+ * returned as double; for float vectors the dot product accumulates
+ * in double precision (cblas_dsdot).
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+#if defined(HAVE_CONFIG_H)
+#  include <config.h>
+#endif
+
+#if defined(HAVE_MKL)
+#  include "mkl.h"
+#  include "mkl_lapacke.h"
+#  include "mkl_spblas.h"
+#  include "mkl_trans.h"
+#elif defined(HAVE_BLAS)
+extern "C" {            /* Assume C declarations for C++ */
+#  include <cblas.h>
+}
+#else
+#  include "miniblas.h"
+#endif
+
+#if defined(USE_PHIPAC)
+#  include "gemm.h"
+#endif
+
+inline void blas_copy(int n, const double *x, int incx, double *y, int incy) { cblas_dcopy(n, x, incx, y, incy); }
+inline void blas_copy(int n, const float *x, int incx, float *y, int incy) { cblas_scopy(n, x, incx, y, incy); }
+
+inline void blas_scal(int n, double alpha, double *x, int incx) { cblas_dscal(n, alpha, x, incx); }
+inline void blas_scal(int n, double alpha, float *x, int incx) { cblas_sscal(n, (float) alpha, x, incx); }
+
+inline void blas_axpy(int n, double alpha, const double *x, int incx, double *y, int incy) {
+  cblas_daxpy(n, alpha, x, incx, y, incy);
+}
+inline void blas_axpy(int n, double alpha, const float *x, int incx, float *y, int incy) {
+  cblas_saxpy(n, (float) alpha, x, incx, y, incy);
+}
+
+// y = alpha * x + beta * y
+inline void blas_axpby(int n, double alpha, const double *x, int incx, double beta, double *y, int incy) {
+#if HAVE_CBLAS_DAXPBY
+  cblas_daxpby(n, alpha, x, incx, beta, y, incy);
+#else
+  cblas_dscal(n, beta, y, incy);
+  cblas_daxpy(n, alpha, x, incx, y, incy);
+#endif
+}
+inline void blas_axpby(int n, double alpha, const float *x, int incx, double beta, float *y, int incy) {
+#if HAVE_CBLAS_DAXPBY
+  cblas_saxpby(n, (float) alpha, x, incx, (float) beta, y, incy);
+#else
+  cblas_sscal(n, (float) beta, y, incy);
+  cblas_saxpy(n, (float) alpha, x, incx, y, incy);
+#endif
+}
+
+inline double blas_dot(int n, const double *x, int incx, const double *y, int incy) {
+  return cblas_ddot(n, x, incx, y, incy);
+}
+inline double blas_dot(int n, const float *x, int incx, const float *y, int incy) {
+  return cblas_dsdot(n, x, incx, y, incy);
+}
+
+inline double blas_asum(int n, const double *x, int incx) { return cblas_dasum(n, x, incx); }
+inline double blas_asum(int n, const float *x, int incx) { return cblas_sasum(n, x, incx); }
+
+inline double blas_nrm2(int n, const double *x, int incx) { return cblas_dnrm2(n, x, incx); }
+inline double blas_nrm2(int n, const float *x, int incx) { return cblas_snrm2(n, x, incx); }
+
+// C = alpha * op(A) * op(B) + beta * C, all matrices column-major
+inline void blas_gemm(bool transA, bool transB, int M, int N, int K,
+		      double alpha, const double *A, int lda, const double *B, int ldb,
+		      double beta, double *C, int ldc)
+{
+#if USE_PHIPAC
+  // The internal dgemm (miscSupport/gemm.cc) takes the same column-major
+  // arguments as cblas_dgemm.
+  gmtk_dgemm(transA ? 'T' : 'N', transB ? 'T' : 'N', M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+#else
+  cblas_dgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans,
+	      M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+#endif
+}
+inline void blas_gemm(bool transA, bool transB, int M, int N, int K,
+		      double alpha, const float *A, int lda, const float *B, int ldb,
+		      double beta, float *C, int ldc)
+{
+#if USE_PHIPAC
+  gmtk_sgemm(transA ? 'T' : 'N', transB ? 'T' : 'N', M, N, K, (float) alpha, A, lda, B, ldb, (float) beta, C, ldc);
+#else
+  cblas_sgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans,
+	      M, N, K, (float) alpha, A, lda, B, ldb, (float) beta, C, ldc);
+#endif
+}
+
+#if defined(HAVE_MKL)
+// Intel VML functions for MutableVector::ApplyVML that select the
+// vd* or vs* version from the element type
+struct VmlExp {
+  void operator()(int n, const double *a, double *r) const { vdExp(n, a, r); }
+  void operator()(int n, const float *a, float *r) const { vsExp(n, a, r); }
+};
+struct VmlTanh {
+  void operator()(int n, const double *a, double *r) const { vdTanh(n, a, r); }
+  void operator()(int n, const float *a, float *r) const { vsTanh(n, a, r); }
+};
+struct VmlLog1p {
+  void operator()(int n, const double *a, double *r) const { vdLog1p(n, a, r); }
+  void operator()(int n, const float *a, float *r) const { vsLog1p(n, a, r); }
+};
+struct VmlAbs {
+  void operator()(int n, const double *a, double *r) const { vdAbs(n, a, r); }
+  void operator()(int n, const float *a, float *r) const { vsAbs(n, a, r); }
+};
+struct VmlAdd {
+  void operator()(int n, const double *a, const double *b, double *r) const { vdAdd(n, a, b, r); }
+  void operator()(int n, const float *a, const float *b, float *r) const { vsAdd(n, a, b, r); }
+};
+#endif
@@ -1,8 +1,12 @@
 
 #include "DBN.h"
 
-bool     DBN::resumeTraining  = false;
-bool     DBN::checkSignal     = false;
-bool     DBN::sparseInitLayer = false;
-unsigned DBN::nnChunkSize     = 4;
+bool     DBNBase::resumeTraining  = false;
+bool     DBNBase::checkSignal     = false;
+bool     DBNBase::sparseInitLayer = false;
+unsigned DBNBase::nnChunkSize     = 4;
+unsigned DBNBase::numTrainThreads = 1;
 
+
+template class DBNT<double>;
+template class DBNT<float>;
@@ -16,21 +16,17 @@
 #  include <config.h>
 #endif
 
-#if defined(HAVE_MKL)
-#  include "mkl.h"
-#  include "mkl_lapacke.h"
-#  include "mkl_spblas.h"
-#  include "mkl_trans.h"
-#elif defined(HAVE_BLAS)
-extern "C" {            /* Assume C declarations for C++ */
-#  include <cblas.h>
-}
-#endif
+#include "Blas.h"
 
 #include <vector>
 #include <algorithm>
 #include <fstream>
 #include <iomanip>      // std::setprecision
+#include <math.h>
+#include <stdlib.h>
+#if HAVE_PTHREAD
+#  include <pthread.h>
+#endif
 
 #include "rand.h"
 #include "fileParser.h"
@@ -50,15 +46,50 @@ using namespace std;
 /*
 The DBN class maintains all of the parameters of the DBN, and includes operations
 for training and testing.
+
+DBNT is a template on the element type of the parameters and activations:
+DBN (DBNT<double>) is the double precision network, DBNT<float> trains in
+single precision. The options, enums and hyperparameters they share are in
+DBNBase.
  */
 
-class DBN {
+class DBNBase {
 public:
 
   static bool     resumeTraining;  // should this invocation resume where the last left off?
   static bool     checkSignal;     // if true, print status as if end of check interval
   static bool     sparseInitLayer; // select layer initialization method
   static unsigned nnChunkSize;     // O(1) space to use for (non-minibatch) incremental processing
+  static unsigned numTrainThreads; // # of threads a minibatch is split over (data-parallel SGD)
+
+  // Each thread gets at least this many instances of a minibatch
+  static const int minShardSize = 8;
+
+  // Random numbers for one data-parallel shard of a minibatch. The
+  // global rnd (drand48() and the static state in its normal()) can't
+  // be shared between threads, so every shard but the first draws from
+  // its own erand48() state, seeded from rnd before each minibatch.
+  struct ShardRand {
+    bool shared;              // use the global rnd
+    unsigned short xsubi[3];
+
+    ShardRand() : shared(true) { }
+
+    void Seed() {
+      shared = false;
+      for (unsigned i=0; i < 3; i+=1) xsubi[i] = (unsigned short) (rnd.drand48() * 65536.0);
+    }
+
+    double drand48() { return shared ? rnd.drand48() : erand48(xsubi); }
+
+    // N(0,1) by Box-Muller
+    double normal() {
+      if (shared) return rnd.normal();
+      double u;
+      do { u = erand48(xsubi); } while (u == 0.0);
+      return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * erand48(xsubi));
+    }
+  };
 
   enum PretrainType {
     NONE, // no pretraining
@@ -117,6 +148,21 @@ public:
 	     numUpdates, numAnnealUpdates, miniBatchSize, checkInterval);
     }
   };
+};
+
+template <class Real>
+class DBNT : public DBNBase {
+  typedef VectorT<Real>            Vector;
+  typedef MatrixT<Real>            Matrix;
+  typedef MutableVectorT<Real>     MutableVector;
+  typedef MutableMatrixT<Real>     MutableMatrix;
+  typedef AllocatingVectorT<Real>  AllocatingVector;
+  typedef AllocatingMatrixT<Real>  AllocatingMatrix;
+  typedef StdioMatrixT<Real>       StdioMatrix;
+
+public:
+  typedef BatchSourceT<Real>       BatchSource;
+  typedef MatrixBatchSourceT<Real> MatrixBatchSource;
 
 private:
   // width of input, all hidden, and output layers
@@ -132,9 +178,6 @@ private:
   // number of layers (not including input)
   int _numLayers;
 
-	// layers
-  mutable vector<Layer> _layers;
-
   // all model parameters
   AllocatingVector _params, _deltaParams, _savedParams;
 
@@ -148,13 +191,32 @@ private:
 	// vectors pointing to all parameters _W and _B for each layer (and deltas and saved)
   vector<MutableVector> _layerParams, _layerDeltaParams, _layerSavedParams;
 
-  // space for temporary values during CD training
-  mutable AllocatingMatrix _tempTopSample, _tempBottomSample;
-
-  // temporary storage used in several places
-  mutable AllocatingMatrix _tempMat, _tempDropoutInput;
-  mutable AllocatingVector _tempVec;
-  mutable Layer _tempTopLayer, _tempBottomLayer;
+  // The state needed to evaluate (part of) a minibatch: the layer
+  // activations, temporaries, where the gradient goes, and random
+  // numbers. _shards[0] does all the single-threaded work and adds its
+  // gradient straight into _deltaParams. With numTrainThreads > 1 a
+  // minibatch is split by columns over the shards; each of the others
+  // accumulates into its own deltaParams, which are summed into
+  // _deltaParams when all the shards are done.
+  struct Shard {
+		// layers
+    vector<LayerT<Real> > layers;
+
+    // space for temporary values during CD training
+    AllocatingMatrix tempTopSample, tempBottomSample;
+
+    // temporary storage used in several places
+    AllocatingMatrix tempMat, tempDropoutInput;
+    LayerT<Real> tempTopLayer, tempBottomLayer;
+
+    // this shard's gradient (unused for _shards[0])
+    AllocatingVector deltaParams;
+    vector<MutableMatrix> deltaW;
+    vector<MutableVector> deltaB;
+
+    ShardRand rand;
+  };
+  mutable vector<Shard> _shards;
 
 	// apply weight decay and return weighted squared L2 norm
   static double Decay(MutableVector & v, double alpha, double step) {
@@ -191,7 +253,7 @@ private:
   class TrainingFunction {
   protected:
 		// DBN whose parameters we are training
-    DBN & _dbn;
+    DBNT<Real> & _dbn;
 
     BatchSource *batchSrc;
 
@@ -205,13 +267,87 @@ private:
     const HyperParams & _hyperParams;
 
 
-    TrainingFunction(DBN & dbn, BatchSource *batchSrc, const HyperParams & hyperParams, MutableVector & params, MutableVector & deltaParams, MutableVector & savedParams)
+    TrainingFunction(DBNT<Real> & dbn, BatchSource *batchSrc, const HyperParams & hyperParams, MutableVector & params, MutableVector & deltaParams, MutableVector & savedParams)
       :
     _dbn(dbn), batchSrc(batchSrc), _params(params), _deltaParams(deltaParams), _savedParams(savedParams), _hyperParams(hyperParams) 
     { }
 
 		// to be overridden in subclasses, implementing the specific training function update
-    virtual double PrivateEval(Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) = 0;
+		// using the given shard's storage
+    virtual double PrivateEval(Shard & shard, Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) = 0;
+
+#if HAVE_PTHREAD
+    struct ShardTask {
+      TrainingFunction *func;
+      Shard            *shard;
+      Matrix            input, output;
+      double            stepSize, loss;
+    };
+
+    static void *ShardThread(void *arg) {
+      ShardTask *task = (ShardTask *) arg;
+      task->loss = task->func->PrivateEval(*task->shard, task->input, task->output, task->stepSize);
+      return NULL;
+    }
+#endif
+
+		// Call PrivateEval on the minibatch. If there are several shards and
+		// enough instances, the minibatch's columns are split over that many
+		// threads; the loss is the sum of theirs, and their gradients are
+		// added into _deltaParams.
+    double ShardedEval(const Matrix & inputMiniBatch, const Matrix & outputMiniBatch, double stepSize) {
+      int numC = inputMiniBatch.NumC();
+      int numShards = (int) _dbn._shards.size();
+      if (numShards > numC / minShardSize) numShards = numC / minShardSize;
+#if HAVE_PTHREAD
+      if (numShards > 1) {
+	// offset of the parameters being trained in the whole parameter vector
+	int offset = _deltaParams.Start() - _dbn._deltaParams.Start();
+	int len = _deltaParams.Len();
+
+	vector<ShardTask> tasks(numShards);
+	vector<pthread_t> threads(numShards);
+	vector<bool> started(numShards, false);
+	for (int k = 0; k < numShards; ++k) {
+	  int start = (int) ((long) numC * k / numShards), end = (int) ((long) numC * (k+1) / numShards);
+	  Shard & shard = _dbn._shards[k];
+	  if (k > 0) {
+	    shard.rand.Seed();
+	    if (stepSize > 0) shard.deltaParams.SubVector(offset, offset + len) *= 0;
+	  }
+	  tasks[k].func = this;
+	  tasks[k].shard = &shard;
+	  tasks[k].input = inputMiniBatch.GetCols(start, end);
+	  tasks[k].output = outputMiniBatch.GetCols(start, end);
+	  tasks[k].stepSize = stepSize;
+	}
+#if defined(USE_PHIPAC)
+	// the shards' matrix multiplies share the threads one multiply
+	// may use, rather than each starting that many
+	unsigned gemmThreads = gmtk_gemm_threads();
+	gmtk_gemm_set_threads(gemmThreads / numShards > 0 ? gemmThreads / numShards : 1);
+#endif
+	// the calling thread does the first shard; if a thread can't be
+	// started, its shard is done here too
+	for (int k = 1; k < numShards; ++k) {
+	  started[k] = (pthread_create(&threads[k], NULL, ShardThread, &tasks[k]) == 0);
+	}
+	ShardThread(&tasks[0]);
+	double loss = tasks[0].loss;
+	for (int k = 1; k < numShards; ++k) {
+	  if (started[k]) pthread_join(threads[k], NULL);
+	  else ShardThread(&tasks[k]);
+	  loss += tasks[k].loss;
+	  if (stepSize > 0) _deltaParams += _dbn._shards[k].deltaParams.SubVector(offset, offset + len);
+	}
+#if defined(USE_PHIPAC)
+	gmtk_gemm_set_threads(gemmThreads);
+#endif
+	return loss;
+      }
+#endif
+      return PrivateEval(_dbn._shards[0], inputMiniBatch, outputMiniBatch, stepSize);
+    }
 
   public:
 
@@ -219,11 +355,11 @@ private:
     virtual double Eval(float epochFraction=1.0) {
       double sum = 0;
       unsigned numRows = batchSrc->numDataRows() + batchSrc->numLabelRows();
-      unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(double)) / numRows;
+      unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(Real)) / numRows;
       if (miniBatchSize < 1) {
 	miniBatchSize = 1;
 	warning("WARNING: -nnChunkSize %u MiB is too small. One training instances requires %u bytes\n",
-		nnChunkSize, numRows * sizeof(double));
+		nnChunkSize, numRows * sizeof(Real));
       }
       unsigned numBatches = (unsigned)(0.5 + batchSrc->batchesPerEpoch(miniBatchSize) * epochFraction);
       unsigned data_NumC = 0;
@@ -231,7 +367,7 @@ private:
 	Matrix  inputMiniBatch, outputMiniBatch;
 	batchSrc->getBatch(miniBatchSize, inputMiniBatch, outputMiniBatch);
 	data_NumC += outputMiniBatch.NumC();
-	sum += PrivateEval(inputMiniBatch, outputMiniBatch, 0);
+	sum += ShardedEval(inputMiniBatch, outputMiniBatch, 0);
       }
       return sum / data_NumC + Decay(_params, _hyperParams.l2, 0);
     }
@@ -239,7 +375,7 @@ private:
     double DoUpdate(Matrix &inputMiniBatch, Matrix &outputMiniBatch, double stepSize, double maxUpdate, double momentum) {
       int miniBatchSize = outputMiniBatch.NumC();
       _deltaParams *= momentum;
-      double val = PrivateEval(inputMiniBatch, outputMiniBatch, stepSize * (1 - momentum) / miniBatchSize);
+      double val = ShardedEval(inputMiniBatch, outputMiniBatch, stepSize * (1 - momentum) / miniBatchSize);
       if (!IsNaN(maxUpdate)) Trunc(_deltaParams, maxUpdate);
       _params -= _deltaParams;
 
@@ -275,12 +411,19 @@ private:
 	// base class for training functions that operate on a single layer's parameters
   class LayerTrainingFunction : public TrainingFunction {
   protected:
+    using TrainingFunction::_dbn;
+    using TrainingFunction::batchSrc;
+    using TrainingFunction::_params;
+    using TrainingFunction::_hyperParams;
+    using TrainingFunction::ShardedEval;
+    using TrainingFunction::DoUpdate;
+
     int _layer;
     AllocatingVector _inputBiases;
 
   public:
 
-    LayerTrainingFunction(DBN & dbn, int layer, BatchSource *batchSrc, const HyperParams & hyperParams, Layer::ActFunc actFunc, float epochFraction=1.0)
+    LayerTrainingFunction(DBNT<Real> & dbn, int layer, BatchSource *batchSrc, const HyperParams & hyperParams, Layer::ActFunc actFunc, float epochFraction=1.0)
       :
     TrainingFunction(dbn, batchSrc, hyperParams, dbn._layerParams[layer], dbn._layerDeltaParams[layer], dbn._layerSavedParams[layer]),
       _layer(layer)
@@ -288,7 +431,7 @@ private:
       if (resumeTraining) {
         _inputBiases.CopyFrom(dbn._B[layer]);
       } else {
-	DBN::InitializeInputBiases(batchSrc, _inputBiases, actFunc, 1e-3, epochFraction);
+	DBNT<Real>::InitializeInputBiases(batchSrc, _inputBiases, actFunc, 1e-3, epochFraction);
       }
     }
 
@@ -297,18 +440,18 @@ private:
     virtual double Eval(float epochFraction=1.0) {
       double sum = 0;
       unsigned numRows = batchSrc->numDataRows();
-      unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(double)) / numRows;
+      unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(Real)) / numRows;
       if (miniBatchSize < 1) {
 	miniBatchSize = 1;
 	warning("WARNING: -nnChunkSize %u MiB is too small. One training instances requires %u bytes\n",
-		nnChunkSize, numRows * sizeof(double));
+		nnChunkSize, numRows * sizeof(Real));
       }
       unsigned numBatches = (unsigned)(0.5 + batchSrc->batchesPerEpoch(miniBatchSize) * epochFraction);
       unsigned data_NumC = 0;
       for (unsigned i=0; i < numBatches; i+=1) {
 	Matrix  inputMiniBatch = batchSrc->getData(miniBatchSize);
 	data_NumC += inputMiniBatch.NumC();
-	sum += PrivateEval(inputMiniBatch, inputMiniBatch, 0);
+	sum += ShardedEval(inputMiniBatch, inputMiniBatch, 0);
       }
       return sum / data_NumC + Decay(_params, _hyperParams.l2, 0);
     }
@@ -327,31 +470,43 @@ private:
 	// training function to implement the contrastive divergence update
   class CDTrainingFunction : public LayerTrainingFunction {
   protected:
+    using LayerTrainingFunction::_dbn;
+    using LayerTrainingFunction::_layer;
+    using LayerTrainingFunction::_inputBiases;
+
     AllocatingMatrix _particles;
 		
-    virtual double PrivateEval(Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
-      return _dbn.UpdateCD(outputMiniBatch, _inputBiases, _layer, stepSize);
+    virtual double PrivateEval(Shard & shard, Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
+      return _dbn.UpdateCD(shard, outputMiniBatch, _inputBiases, _layer, stepSize);
     }
 
   public:
-  CDTrainingFunction(DBN & dbn, int layer, BatchSource *batchSrc, const HyperParams & hyperParams, Layer::ActFunc actFunc, float epochFraction=1.0)
+  CDTrainingFunction(DBNT<Real> & dbn, int layer, BatchSource *batchSrc, const HyperParams & hyperParams, Layer::ActFunc actFunc, float epochFraction=1.0)
     : LayerTrainingFunction(dbn, layer, batchSrc, hyperParams, actFunc, epochFraction)
     { }
   };
 
 	// training function to implement denoising autoencoder update
   class AETrainingFunction : public LayerTrainingFunction {
+    using LayerTrainingFunction::_dbn;
+    using LayerTrainingFunction::batchSrc;
+    using LayerTrainingFunction::_params;
+    using LayerTrainingFunction::_hyperParams;
+    using LayerTrainingFunction::_layer;
+    using LayerTrainingFunction::_inputBiases;
+    using LayerTrainingFunction::ShardedEval;
+    using LayerTrainingFunction::DoUpdate;
 
     Layer::ActFunc lowerActFunc;
       
   protected:
-    virtual double PrivateEval(Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
-      return _dbn.UpdateAE(inputMiniBatch, _inputBiases, outputMiniBatch, _layer, stepSize);
+    virtual double PrivateEval(Shard & shard, Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
+      return _dbn.UpdateAE(shard, inputMiniBatch, _inputBiases, outputMiniBatch, _layer, stepSize);
     }
 
   public:
 
-  AETrainingFunction(DBN & dbn, int layer, BatchSource *batchSrc, const HyperParams & hyperParams, Layer::ActFunc lowerActFunc, float epochFraction=1.0)
+  AETrainingFunction(DBNT<Real> & dbn, int layer, BatchSource *batchSrc, const HyperParams & hyperParams, Layer::ActFunc lowerActFunc, float epochFraction=1.0)
     : LayerTrainingFunction(dbn, layer, batchSrc, hyperParams, lowerActFunc, epochFraction), lowerActFunc(lowerActFunc)
     { }
 
@@ -359,11 +514,11 @@ private:
     virtual double Eval(float epochFraction=1.0) {
       double sum = 0;
       unsigned numRows = batchSrc->numDataRows();
-      unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(double)) / numRows;
+      unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(Real)) / numRows;
       if (miniBatchSize < 1) {
 	miniBatchSize = 1;
 	warning("WARNING: -nnChunkSize %u MiB is too small. One training instances requires %u bytes\n",
-		nnChunkSize, numRows * sizeof(double));
+		nnChunkSize, numRows * sizeof(Real));
       }
       unsigned numBatches = (unsigned)(0.5 + batchSrc->batchesPerEpoch(miniBatchSize) * epochFraction);
       unsigned data_NumC = 0;
@@ -373,7 +528,7 @@ private:
 	// distort the input, use undistorted input as the target output
 	lowerActFunc.Sample(inputMiniBatch.Vec(), temp.Vec());
 	data_NumC += inputMiniBatch.NumC();
-	sum += PrivateEval(temp, inputMiniBatch, 0);
+	sum += ShardedEval(temp, inputMiniBatch, 0);
       }
       return sum / data_NumC + Decay(_params, _hyperParams.l2, 0);
     }
@@ -390,38 +545,42 @@ private:
 
 	// training function for backpropagation training
   class BPTrainingFunction : public TrainingFunction {
+    using TrainingFunction::_dbn;
+    using TrainingFunction::_hyperParams;
 
    private:
 		// training objective (squared error or softmax)
     ObjectiveType _objectiveType;
 
    protected:
-    virtual double PrivateEval(Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
-      return _dbn.UpdateBackProp(inputMiniBatch, outputMiniBatch, _objectiveType, false, _hyperParams.iDropP, _hyperParams.hDropP, stepSize);
+    virtual double PrivateEval(Shard & shard, Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
+      return _dbn.UpdateBackProp(shard, inputMiniBatch, outputMiniBatch, _objectiveType, false, _hyperParams.iDropP, _hyperParams.hDropP, stepSize);
     }
 
    public:
 
-  BPTrainingFunction(BatchSource *batchSrc, DBN & dbn, HyperParams hyperParams, ObjectiveType objectiveType)
+  BPTrainingFunction(BatchSource *batchSrc, DBNT<Real> & dbn, const HyperParams & hyperParams, ObjectiveType objectiveType)
     : TrainingFunction(dbn, batchSrc, hyperParams, dbn._params, dbn._deltaParams, dbn._savedParams), _objectiveType(objectiveType)
     { }
   };
 	
 	// training function for output layer before full backpropagation
   class OutputLayerTrainingFunction : public TrainingFunction {
+    using TrainingFunction::_dbn;
+    using TrainingFunction::_hyperParams;
 
    private:
 		// training objective (squared error or softmax)
     ObjectiveType _objectiveType;
 
    protected:
-    virtual double PrivateEval(Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
-      return _dbn.UpdateBackProp(inputMiniBatch, outputMiniBatch, _objectiveType, true, _hyperParams.iDropP, _hyperParams.hDropP, stepSize);
+    virtual double PrivateEval(Shard & shard, Matrix inputMiniBatch, Matrix outputMiniBatch, double stepSize) {
+      return _dbn.UpdateBackProp(shard, inputMiniBatch, outputMiniBatch, _objectiveType, true, _hyperParams.iDropP, _hyperParams.hDropP, stepSize);
     }
 
    public:
 
-    OutputLayerTrainingFunction(BatchSource *batchSrc, DBN & dbn, HyperParams hyperParams, ObjectiveType objectiveType)
+    OutputLayerTrainingFunction(BatchSource *batchSrc, DBNT<Real> & dbn, const HyperParams & hyperParams, ObjectiveType objectiveType)
       :
     TrainingFunction(dbn, batchSrc, hyperParams, dbn._layerParams.back(), dbn._layerDeltaParams.back(), dbn._layerSavedParams.back()),  _objectiveType(objectiveType)
     { }
@@ -548,51 +707,51 @@ private:
 
 	// perform the backpropagation update to update the weights of all layers
 	// if lastLayerOnly, then backpropagation is terminated after updating the output layer
-  double UpdateBackProp(const Matrix &input, const Matrix& output, ObjectiveType _objType, bool lastLayerOnly, double iDropP, double hDropP, double stepSize) {
+  double UpdateBackProp(Shard & shard, const Matrix &input, const Matrix& output, ObjectiveType _objType, bool lastLayerOnly, double iDropP, double hDropP, double stepSize) {
     int startLayer = lastLayerOnly ? _numLayers - 1 : 0;
 
 		// the input matrix (which may be altered if dropout is used
     Matrix altInput;
     if (iDropP > 0) {
-      _tempDropoutInput.CopyFrom(input);
-      _tempDropoutInput.Vec().Apply([&] (double x) { return (rnd.drand48() > iDropP) ? x : 0; });
-      altInput = _tempDropoutInput;
+      shard.tempDropoutInput.CopyFrom(input);
+      shard.tempDropoutInput.Vec().Apply([&] (double x) { return (shard.rand.drand48() > iDropP) ? x : 0; });
+      altInput = shard.tempDropoutInput;
     } else {
       altInput = input;
     }
 
 		// map the data up to the output layer
-    Matrix mappedInput = MapUp(altInput, hDropP, startLayer);
+    Matrix mappedInput = MapUp(shard, altInput, hDropP, startLayer);
 
     double loss = 0;
 
 		// compute the loss, depending on objective type
-    // _tempMat is used to store the gradient w.r.t. the outputs at each layer
+    // shard.tempMat is used to store the gradient w.r.t. the outputs at each layer
     switch (_objType) {
     case SQ_ERR:
-      _tempMat.CopyFrom(mappedInput);
-      _tempMat -= output;
+      shard.tempMat.CopyFrom(mappedInput);
+      shard.tempMat -= output;
 
-      loss += _tempMat.Vec() * _tempMat.Vec();
+      loss += shard.tempMat.Vec() * shard.tempMat.Vec();
       loss /= 2;
       break;
 
     case SOFT_MAX:
-      _tempMat.CopyFrom(mappedInput);
+      shard.tempMat.CopyFrom(mappedInput);
       for (int i = 0; i < input.NumC(); ++i) {
-        MutableVector errCol = _tempMat.GetCol(i);
+        MutableVector errCol = shard.tempMat.GetCol(i);
         double max = Max(errCol);
         errCol.Apply([max] (double x) { return x - max; });
         loss += max;
       }
 #if HAVE_MKL
-      _tempMat.Vec().ApplyVML(vdExp);
+      shard.tempMat.Vec().ApplyVML(VmlExp());
 #else
-      _tempMat.Vec().Apply([](double x)->double {return exp(x);});
+      shard.tempMat.Vec().Apply([](double x)->double {return exp(x);});
 #endif
 
       for (int i = 0; i < input.NumC(); ++i) {
-        MutableVector errCol = _tempMat.GetCol(i);
+        MutableVector errCol = shard.tempMat.GetCol(i);
         Vector labelCol = output.GetCol(i);
         Vector predictionCol = mappedInput.GetCol(i);
         double sum = Sum(errCol);
@@ -605,21 +764,21 @@ private:
 
     if (stepSize > 0) {
 			// backpropagate errors
-      Matrix mappedError = _layers.back().ComputeErrors(_tempMat, Layer::ActFunc::LINEAR);
+      Matrix mappedError = shard.layers.back().ComputeErrors(shard.tempMat, Layer::ActFunc::LINEAR);
       for (int l = _numLayers - 1; ; --l) {
-        for (int i = 0; i < input.NumC(); ++i) _deltaB[l] += mappedError.GetCol(i) * stepSize;
+        for (int i = 0; i < input.NumC(); ++i) shard.deltaB[l] += mappedError.GetCol(i) * stepSize;
 
 				// inputs to this layer
-				const Matrix & lowerProbs = l > startLayer ? _layers[l - 1].Activations() : altInput;
+				const Matrix & lowerProbs = l > startLayer ? shard.layers[l - 1].Activations() : altInput;
 
 				// perform actual update
-        _deltaW[l] += stepSize * lowerProbs * mappedError.Trans();
+        shard.deltaW[l] += stepSize * lowerProbs * mappedError.Trans();
 
         if (lastLayerOnly || l == 0) break;
 
 				// backpropagate error
-        _tempMat = _W[l] * mappedError;
-        mappedError = _layers[l-1].ComputeErrors(_tempMat, _hActFunc[l-1]);
+        shard.tempMat = _W[l] * mappedError;
+        mappedError = shard.layers[l-1].ComputeErrors(shard.tempMat, _hActFunc[l-1]);
       }
     }
 
@@ -634,11 +793,11 @@ private:
     unsigned n = 0;
     unsigned numRows = batchSrc->numDataRows();
     inputBiases.Assign(numRows, 0);
-    unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(double)) / numRows;
+    unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(Real)) / numRows;
     if (miniBatchSize < 1) {
       miniBatchSize = 1;
       warning("WARNING: -nnChunkSize %u MiB is too small. One training instances requires %u bytes\n",
-	      nnChunkSize, numRows * sizeof(double));
+	      nnChunkSize, numRows * sizeof(Real));
     }
     unsigned numBatches = (unsigned)(0.5 + batchSrc->batchesPerEpoch(miniBatchSize) * epochFraction);
     for (unsigned t=0; t < numBatches; t+=1) {
@@ -646,7 +805,7 @@ private:
       unsigned numCols = miniBatch.NumC();
       n += numCols;
       int miniBatchLD = miniBatch.Ld();
-      double const *miniBatchP = miniBatch.Start();
+      Real const *miniBatchP = miniBatch.Start();
       for (unsigned c=0; c < numCols; c+=1, miniBatchP += miniBatchLD) {
 	for (unsigned r=0; r < numRows; r+=1) {
 	  inputBiases[r] += miniBatchP[r];
@@ -691,68 +850,68 @@ private:
 
 
 	// update the layer's parameters using contrastive divergence
-  double UpdateCD(const Matrix & input, const Vector & inputBiases, int layer, double stepSize) {
+  double UpdateCD(Shard & shard, const Matrix & input, const Vector & inputBiases, int layer, double stepSize) {
     Layer::ActFunc lowerActFunc = (layer == 0) ? _iActFunc : _hActFunc[layer-1];
 
     Matrix weights = _W[layer];
     Vector topBiases = _B[layer];
-    Layer & topLayer = _layers[layer];
+    LayerT<Real> & topLayer = shard.layers[layer];
 
-    _tempBottomSample.Resize(input);
+    shard.tempBottomSample.Resize(input);
 
     topLayer.ActivateUp(weights, topBiases, input, _hActFunc[layer]);
-    _tempTopSample.Resize(topLayer.Size(), input.NumC());
-    topLayer.Sample(_tempTopSample, _hActFunc[layer]);
+    shard.tempTopSample.Resize(topLayer.Size(), input.NumC());
+    topLayer.Sample(shard.tempTopSample, _hActFunc[layer], shard.rand);
 
-    _tempBottomLayer.ActivateDown(weights, inputBiases, _tempTopSample, lowerActFunc);
-    _tempBottomLayer.Sample(_tempBottomSample, lowerActFunc);
-    _tempTopLayer.ActivateUp(weights, topBiases, _tempBottomSample, _hActFunc[layer]);
+    shard.tempBottomLayer.ActivateDown(weights, inputBiases, shard.tempTopSample, lowerActFunc);
+    shard.tempBottomLayer.Sample(shard.tempBottomSample, lowerActFunc, shard.rand);
+    shard.tempTopLayer.ActivateUp(weights, topBiases, shard.tempBottomSample, _hActFunc[layer]);
 
     if (stepSize > 0) {
 			// actually perform update
-      Matrix topProbsP = topLayer.Activations(), topProbsN = _tempTopLayer.Activations();
+      Matrix topProbsP = topLayer.Activations(), topProbsN = shard.tempTopLayer.Activations();
 
-      _deltaW[layer] -= stepSize * input * topProbsP.Trans();
-      _deltaW[layer] += stepSize * _tempBottomSample * topProbsN.Trans();
+      shard.deltaW[layer] -= stepSize * input * topProbsP.Trans();
+      shard.deltaW[layer] += stepSize * shard.tempBottomSample * topProbsN.Trans();
 
       for (int i = 0; i < input.NumC(); ++i) {
-        _deltaB[layer] -= stepSize * topProbsP.GetCol(i);
-        _deltaB[layer] += stepSize * topProbsN.GetCol(i);
+        shard.deltaB[layer] -= stepSize * topProbsP.GetCol(i);
+        shard.deltaB[layer] += stepSize * topProbsN.GetCol(i);
       }
     }
 
     // often squared error is used for monitoring, like this
 
-    _tempBottomSample = input - _tempBottomLayer.Activations();
-    return _tempBottomSample.Vec() * _tempBottomSample.Vec();
+    shard.tempBottomSample = input - shard.tempBottomLayer.Activations();
+    return shard.tempBottomSample.Vec() * shard.tempBottomSample.Vec();
   }
 
 	// update layer's parameters using the autoencoder loss
-  double UpdateAE(const Matrix & input, const Vector & inputBiases, const Matrix & targetInput, int layer, double stepSize) {
+  double UpdateAE(Shard & shard, const Matrix & input, const Vector & inputBiases, const Matrix & targetInput, int layer, double stepSize) {
     Layer::ActFunc lowerActFunc = (layer == 0) ? _iActFunc : _hActFunc[layer-1];
 
     Matrix weights = _W[layer];
     Vector topBiases = _B[layer];
 
-    Layer & topLayer = _layers[layer];
+    LayerT<Real> & topLayer = shard.layers[layer];
     Matrix topProbs = topLayer.ActivateUp(weights, topBiases, input, _hActFunc[layer]);
 
-    double negll = _tempBottomLayer.ActivateDownAndGetNegLL(weights, inputBiases, topProbs, targetInput, lowerActFunc);
+    double negll = shard.tempBottomLayer.ActivateDownAndGetNegLL(weights, inputBiases, topProbs, targetInput, lowerActFunc);
     if (stepSize > 0) {
       // fill bottomProbs with errors = activations - input
 			// it is independent of activation type
-      MutableMatrix & bottomProbs = _tempBottomLayer.Activations();
+      MutableMatrix & bottomProbs = shard.tempBottomLayer.Activations();
       bottomProbs -= targetInput;
 
-      _deltaW[layer] += stepSize * bottomProbs * topProbs.Trans();
+      shard.deltaW[layer] += stepSize * bottomProbs * topProbs.Trans();
 
-      _tempMat = weights.Trans() * bottomProbs;
-      Matrix topError = topLayer.ComputeErrors(_tempMat, _hActFunc[layer]);
+      shard.tempMat = weights.Trans() * bottomProbs;
+      Matrix topError = topLayer.ComputeErrors(shard.tempMat, _hActFunc[layer]);
 
-      _deltaW[layer] += stepSize * input * topError.Trans();
+      shard.deltaW[layer] += stepSize * input * topError.Trans();
 
       for (int i = 0; i < input.NumC(); ++i) {
-        _deltaB[layer] += stepSize * topError.GetCol(i);
+        shard.deltaB[layer] += stepSize * topError.GetCol(i);
       }
     }
 
@@ -760,13 +919,13 @@ private:
   }
 
 public:
-  DBN(int numLayers, int iSize, vector<int> &hSize, int oSize, Layer::ActFunc iActFunc, vector<Layer::ActFunc> &hActFunc) 
+  DBNT(int numLayers, int iSize, vector<int> &hSize, int oSize, Layer::ActFunc iActFunc, vector<Layer::ActFunc> &hActFunc) 
   {
     Initialize(numLayers, iSize, hSize, oSize, iActFunc, hActFunc);
   }
 
   // resume training with previously learned W and B
-  DBN(int numLayers, int iSize, vector<int> &hSize, int oSize, Layer::ActFunc iActFunc, vector<Layer::ActFunc> &hActFunc, vector<AllocatingMatrix> &W, vector<AllocatingVector> &B)
+  DBNT(int numLayers, int iSize, vector<int> &hSize, int oSize, Layer::ActFunc iActFunc, vector<Layer::ActFunc> &hActFunc, vector<AllocatingMatrix> &W, vector<AllocatingVector> &B)
   {
     Initialize(numLayers, iSize, hSize, oSize, iActFunc, hActFunc);
     for (int i=0; i < numLayers; i+=1) {
@@ -787,7 +946,6 @@ public:
     _hActFunc = hActFunc;
     assert(_hActFunc[_numLayers-1].actType == Layer::ActFunc::LINEAR);
 
-    _layers.resize(numLayers);
     _layerParams.resize(numLayers);
     _layerDeltaParams.resize(numLayers);
     _layerSavedParams.resize(numLayers);
@@ -797,6 +955,15 @@ public:
     _deltaParams.Resize(numParams);
     _savedParams.Resize(numParams);
 
+    _shards.clear();
+    _shards.resize(numTrainThreads > 1 ? numTrainThreads : 1);
+    for (unsigned k = 0; k < _shards.size(); ++k) {
+      _shards[k].layers.resize(numLayers);
+      _shards[k].deltaW.resize(numLayers);
+      _shards[k].deltaB.resize(numLayers);
+      if (k > 0) _shards[k].deltaParams.Resize(numParams);
+    }
+
     _W.resize(numLayers);
     _B.resize(numLayers);
     _deltaW.resize(numLayers);
@@ -818,6 +985,14 @@ public:
       _deltaB[i] = _deltaParams.SubVector(endW, endB);
       _savedB[i] = _savedParams.SubVector(endW, endB);
 
+      // _shards[0] updates _deltaW and _deltaB directly
+      _shards[0].deltaW[i] = _deltaW[i];
+      _shards[0].deltaB[i] = _deltaB[i];
+      for (unsigned k = 1; k < _shards.size(); ++k) {
+	_shards[k].deltaW[i] = _shards[k].deltaParams.SubVector(start, endW).AsMatrix(bSize, tSize);
+	_shards[k].deltaB[i] = _shards[k].deltaParams.SubVector(endW, endB);
+      }
+
       _layerParams[i] = _params.SubVector(start, endB);
       _layerDeltaParams[i] = _deltaParams.SubVector(start, endB);
       _layerSavedParams[i] = _savedParams.SubVector(start, endB);
@@ -850,7 +1025,7 @@ public:
 
     Initialize(_numLayers, _iSize, _hSize, _oSize, _iActFunc, _hActFunc);
 
-    inStream.read((char *) _params.Start(), sizeof(double) * _params.Len());
+    inStream.read((char *) _params.Start(), sizeof(Real) * _params.Len());
   }
 
 	// write all parameters to disk
@@ -861,7 +1036,7 @@ public:
     outStream.write((const char *) &_oSize, sizeof(int));
     outStream.write((const char *) &_iActFunc, sizeof(Layer::ActFunc));
     outStream.write((const char *) &_hActFunc[0], sizeof(Layer::ActFunc) * _numLayers);
-    outStream.write((const char *) _params.Start(), sizeof(double) * _params.Len());
+    outStream.write((const char *) _params.Start(), sizeof(Real) * _params.Len());
   }
 
 	// randomize parameters
@@ -903,18 +1078,18 @@ public:
 	// given an input matrix to a given layer, compute the output matrix
 	// by multiplying by weights and adding biases
   StdioMatrix MapLayer(StdioMatrix &input, int layer) const {
-    int miniBatchSize = nnChunkSize * ((1<<20) / sizeof(double)) / input.Ld();
+    int miniBatchSize = nnChunkSize * ((1<<20) / sizeof(Real)) / input.Ld();
     if (miniBatchSize < 1) {
       miniBatchSize = 1;
       warning("WARNING: -nnChunkSize %u MiB is too small. One training instances requires %u bytes\n",
-	      nnChunkSize, input.Ld() * sizeof(double));
+	      nnChunkSize, input.Ld() * sizeof(Real));
     }
     StdioMatrix output(_B[layer].Len(), input.NumC(), _B[layer].Len());
     int start=0, end, lastCol = input.NumC();
     for ( ; start < lastCol ; start += miniBatchSize) {
       end = (start + miniBatchSize <= lastCol) ? start + miniBatchSize : lastCol;
       Matrix const &m = input.GetCols(start, end);
-      Matrix const &activated = _layers[layer].ActivateUp(_W[layer], _B[layer], m, _hActFunc[layer]);
+      Matrix const &activated = _shards[0].layers[layer].ActivateUp(_W[layer], _B[layer], m, _hActFunc[layer]);
       output.PutColsM(activated, (int)start);
     }
     return output;
@@ -924,11 +1099,11 @@ public:
 	// by multiplying by weights and adding biases
   StdioMatrix MapLayer(BatchSource *batchSrc, int layer, StdioMatrix &batchSrcLabels, unsigned numCols) const {
     unsigned numRows = batchSrc->numDataRows() + batchSrc->numLabelRows();
-    unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(double)) / numRows;
+    unsigned miniBatchSize = nnChunkSize * ((1<<20) / sizeof(Real)) / numRows;
     if (miniBatchSize < 1) {
       miniBatchSize = 1;
       warning("WARNING: -nnChunkSize %u MiB is too small. One training instances requires %u bytes\n",
-	      nnChunkSize, numRows * sizeof(double));
+	      nnChunkSize, numRows * sizeof(Real));
     }
     unsigned start, end, lastCol = min(numCols, batchSrc->epochSize());
     StdioMatrix output(_B[layer].Len(), lastCol, _B[layer].Len());
@@ -946,7 +1121,7 @@ public:
       Matrix d, l; // instance data, labels
       batchSrc->getBatch(batchSize, d, l);
 assert(d.NumC() == l.NumC());
-      output.PutColsM( _layers[layer].ActivateUp(_W[layer], _B[layer], d, _hActFunc[layer]) , start);
+      output.PutColsM( _shards[0].layers[layer].ActivateUp(_W[layer], _B[layer], d, _hActFunc[layer]) , start);
       batchSrcLabels.PutColsM(l, start);
     }
     return output;
@@ -956,22 +1131,32 @@ assert(d.NumC() == l.NumC());
 	// given an input matrix to a given layer, compute the output matrix
 	// by multiplying by weights and adding biases
   Matrix MapLayer(const Matrix & input, int layer) const {
-    return _layers[layer].ActivateUp(_W[layer], _B[layer], input, _hActFunc[layer]);
+    return MapLayer(_shards[0], input, layer);
+  }
+
+	// same, using the given shard's activations
+  Matrix MapLayer(Shard & shard, const Matrix & input, int layer) const {
+    return shard.layers[layer].ActivateUp(_W[layer], _B[layer], input, _hActFunc[layer]);
   }
 
 
 	// given an input matrix to a given layer, compute the output matrix of a higher layer
 	// by consecutively multiplying by weights and adding biases
   Matrix MapUp(const Matrix &input, double dropoutRate = 0, int startLayer = -1, int endLayer = -1) const {
+    return MapUp(_shards[0], input, dropoutRate, startLayer, endLayer);
+  }
+
+	// same, using the given shard's activations and random numbers
+  Matrix MapUp(Shard & shard, const Matrix &input, double dropoutRate = 0, int startLayer = -1, int endLayer = -1) const {
     if (startLayer == -1) startLayer = 0;
     if (endLayer == -1) endLayer = _numLayers;
 
     Matrix mappedInput = input;
 
     for (int layer = startLayer; layer < endLayer; ++layer) {
-      mappedInput = MapLayer(mappedInput, layer);
+      mappedInput = MapLayer(shard, mappedInput, layer);
       if (layer + 1 < _numLayers && dropoutRate > 0) {
-        mappedInput = _layers[layer].Dropout(dropoutRate);
+        mappedInput = shard.layers[layer].Dropout(dropoutRate, shard.rand);
       }
     }
     return mappedInput;
@@ -1016,7 +1201,7 @@ assert(d.NumC() == l.NumC());
 
       // pretrain hidden layers
       unsigned layer;
-      for (layer = 0; layer < _layers.size() - 1; ++layer) {
+      for (layer = 0; layer < (unsigned) _numLayers - 1; ++layer) {
 	const HyperParams & hyperParams = hyperParams_pt[layer];
 	InitLayer(layer);
 	
@@ -1065,10 +1250,12 @@ assert(d.NumC() == l.NumC());
 	}
 	input = output; // current layer's output becomes next layer's input
 	//	assert(input.NumC() == batchSrcLabels.NumC());  no longer valid with ptNumEpoch < 1
-	if (layer > 0) _layers[layer - 1].Clear(); // save some memory
+	if (layer > 0) { // save some memory
+	  for (unsigned k = 0; k < _shards.size(); ++k) _shards[k].layers[layer - 1].Clear();
+	}
       }
 
-      InitLayer(_layers.size() - 1);
+      InitLayer(_numLayers - 1);
       
       if (hyperParams_pt.back().pretrainType != NONE) {
 	// pretrain output layer
@@ -1127,3 +1314,5 @@ assert(d.NumC() == l.NumC());
     }
   }
 };
+
+typedef DBNT<double> DBN;
@@ -1,8 +1,8 @@
 
 #include "FileBackedMatrix.h"
 
-map<string,unsigned> FileBackedMatrix::ref_count;
+map<string,unsigned> FileBackedMatrixBase::ref_count;
 
-char const *FileBackedMatrix::dmlpTempDir = NULL;
-unsigned FileBackedMatrix::fileNumber = 0;
+char const *FileBackedMatrixBase::dmlpTempDir = NULL;
+unsigned FileBackedMatrixBase::fileNumber = 0;
 
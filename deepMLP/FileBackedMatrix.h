@@ -39,8 +39,14 @@
 // The MMapMatrix subclass memory maps the double array, and thus requires
 // 64-bit addresses to support large temporary files.
 
-class FileBackedMatrix : public Matrix {
-  friend class MutableVector;
+// All of them are templates on the element type like the Matrix
+// classes; FileBackedMatrix, StdioMatrix and MMapMatrix are the
+// double versions.
+
+// The state and helpers shared by the double and float versions of
+// the file-backed matrices (temporary file naming, the reference
+// counts of the backing files, and the -tempDir option).
+class FileBackedMatrixBase {
 
  protected:
 
@@ -80,24 +86,59 @@ class FileBackedMatrix : public Matrix {
     return strdup(tempname_buf);
   }
 
+  FileBackedMatrixBase(bool backed = false, char *fileName = NULL) 
+    : backed(backed), fileName(fileName) 
+  { }
+
  public:
 
   static char const *dmlpTempDir; // temp dir from command line
 
-  FileBackedMatrix() : Matrix(), backed(false), fileName(NULL) { }
+  // Delete all backing files - the subclass = operators create alias (shallow copies),
+  // and the instances might not have all be destroyed when we're finished using them...
+  static void GarbageCollect() {
+    for (auto it = ref_count.begin(); it != ref_count.end(); ++it) {
+      if (unlink(it->first.c_str())) {
+	perror(it->first.c_str());
+	error("ERROR: deleting temporary file '%s'\n", it->first.c_str());
+      }
+    }
+  }
+
+  char *GetFileName() {
+    return backed ? fileName : NULL;
+  }
+};
+
+
+template <class Real>
+class FileBackedMatrixT : public MatrixT<Real>, public FileBackedMatrixBase {
+  friend class MutableVectorT<Real>;
+
+ protected:
+
+  using MatrixT<Real>::_start;
+  using MatrixT<Real>::_numR;
+  using MatrixT<Real>::_numC;
+  using MatrixT<Real>::_ld;
+  using MatrixT<Real>::_trans;
+
+ public:
+
+  FileBackedMatrixT() : MatrixT<Real>(), FileBackedMatrixBase() { }
 
   // Just alias mat, not file-backed...
-  FileBackedMatrix(const Matrix & mat) : Matrix(mat), backed(false), fileName(NULL) { }
+  FileBackedMatrixT(const MatrixT<Real> & mat) : MatrixT<Real>(mat), FileBackedMatrixBase() { }
 
 
   // Just alias Matrix(start, numR, numC, ld, trans), not file-backed...
-  FileBackedMatrix(double *start, int numR, int numC, int ld, bool trans=false) 
-    : Matrix(start, numR, numC, ld, trans), backed(false) // subclass ctor will set to true
+  FileBackedMatrixT(Real *start, int numR, int numC, int ld, bool trans=false) 
+    : MatrixT<Real>(start, numR, numC, ld, trans), FileBackedMatrixBase() // subclass ctor will set to true
   { }
 
   // Create a new file-backed matrix. Put in values with PutCols
-  FileBackedMatrix(int numR, int numC, int ld, bool trans=false) 
-    : Matrix(NULL, numR, numC, ld, trans), backed(false) 
+  FileBackedMatrixT(int numR, int numC, int ld, bool trans=false) 
+    : MatrixT<Real>(NULL, numR, numC, ld, trans), FileBackedMatrixBase() 
   {
     assert(numC > 0 && ld > 0 && numR > 0);
     // create backing file
@@ -107,35 +148,21 @@ class FileBackedMatrix : public Matrix {
     }
   }
 
-  // Delete all backing files - the subclass = operators create alias (shallow copies),
-  // and the instances might not have all be destroyed when we're finished using them...
-  static void GarbageCollect() {
-    for (auto it = ref_count.begin(); it != ref_count.end(); ++it) {
-      if (unlink(it->first.c_str())) {
-	perror(it->first.c_str());
-	error("ERROR: deleting temporary file '%s'\n", it->first.c_str());
-      }
-    }
-  }
-
-  char *GetFileName() {
-    return backed ? fileName : NULL;
-  }
-
-
   // Copy Matrix m into this, starting at column destCol
-  virtual void PutColsM(Matrix const &m, int destCol) {
-    PutCols(const_cast<double *>(m.Start()), m.NumC(), m.NumR(), m.Ld(), destCol);
+  virtual void PutColsM(MatrixT<Real> const &m, int destCol) {
+    PutCols(const_cast<Real *>(m.Start()), m.NumC(), m.NumR(), m.Ld(), destCol);
   }
 
   // Copy Matrix(src, numRows, numCols, srcLd) into this, starting at column destCol
-  virtual void PutCols(double *src, int numCols, int numRows, int srcLd, int destCol) = 0;
+  virtual void PutCols(Real *src, int numCols, int numRows, int srcLd, int destCol) = 0;
   
   // non-constant space accessors not supported
-  virtual const double *Start() const { assert(0); return NULL; }
-  virtual const double *End() const { assert(0); return NULL; }
-  virtual Vector Vec() const { assert(0); return Vector(); }
-  virtual Vector GetRow(int r) const { assert(0); return Vector(); }
-  virtual Matrix GetRows(int beginRow, int endRow) const { assert(0); return Matrix(); }
+  virtual const Real *Start() const { assert(0); return NULL; }
+  virtual const Real *End() const { assert(0); return NULL; }
+  virtual VectorT<Real> Vec() const { assert(0); return VectorT<Real>(); }
+  virtual VectorT<Real> GetRow(int r) const { assert(0); return VectorT<Real>(); }
+  virtual MatrixT<Real> GetRows(int beginRow, int endRow) const { assert(0); return MatrixT<Real>(); }
 
 }; 
+
+typedef FileBackedMatrixT<double> FileBackedMatrix;
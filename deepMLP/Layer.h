@@ -4,13 +4,14 @@
 #include <vector>
 
 #include "Matrix.h"
+#include "Blas.h"
 #include "rand.h"
 
 using namespace std;
 
-// The Layer class holds the activations of a layer
-// and is responsible for computing them and backpropagating error
-class Layer {
+// The activation functions, shared by the double and float
+// versions of Layer (so Layer::ActFunc is the same type for both)
+class LayerBase {
 public:
 
 	// The ActFunc struct stores a type of activation function
@@ -54,7 +55,8 @@ public:
     }
 
 		// compute function value on all inputs
-    void Apply(const MutableVector & inputs) {
+    template <class Real>
+    void Apply(const MutableVectorT<Real> & inputs) {
       switch (actType) {
 
       case LOG_SIG:
@@ -70,7 +72,7 @@ public:
 
       case TANH:
 #if HAVE_MKL
-        inputs.ApplyVML(vdTanh);
+        inputs.ApplyVML(VmlTanh());
 #else
         inputs.Apply([](double x)->double {return tanh(x);});
 #endif
@@ -95,7 +97,8 @@ public:
 
 		// compute function on all inputs, and return negative log-likelihood
 		// of single-parameter distribution evaluated on label vector
-    double ApplyAndGetNegLL(const MutableVector & inputs, const Vector & labels) {
+    template <class Real>
+    double ApplyAndGetNegLL(const MutableVectorT<Real> & inputs, const VectorT<Real> & labels) {
       double negll = 0;
 
       switch (actType) {
@@ -183,7 +186,8 @@ public:
 
 		// Given incoming error vector (derivative of loss wrt output)
 		// multiply by derivative to produce derivative of loss wrt input
-    void ComputeErrors(const MutableVector & activations, const Vector & inError) {
+    template <class Real>
+    void ComputeErrors(const MutableVectorT<Real> & activations, const VectorT<Real> & inError) {
       switch (actType) {
 
       case LOG_SIG:
@@ -228,18 +232,20 @@ public:
       }
     }
 
-    void Sample(const Vector & activations, const MutableVector & sample) const {
+		// sample using random numbers from rng, which needs drand48() and normal()
+    template <class Real, class Rng>
+    void Sample(const VectorT<Real> & activations, const MutableVectorT<Real> & sample, Rng & rng) const {
       switch (actType) {
       case LOG_SIG:
         {
-          auto func = [&](double aVal) { return (rnd.drand48() < aVal) ? 1.0 : 0.0; };
+          auto func = [&](double aVal) { return (rng.drand48() < aVal) ? 1.0 : 0.0; };
           sample.Replace(func, activations);
         }
         break;
 
       case TANH:
         {
-          auto func = [&](double aVal) { return (2 * rnd.drand48() - 1) < aVal ? 1.0 : -1.0; };
+          auto func = [&](double aVal) { return (2 * rng.drand48() - 1) < aVal ? 1.0 : -1.0; };
           sample.Replace(func, activations);
         }
         break;
@@ -248,7 +254,7 @@ public:
       case LINEAR:
       case CUBIC:
         {
-          auto func = [&](double aVal) { return aVal + rnd.normal(); };
+          auto func = [&](double aVal) { return aVal + rng.normal(); };
           sample.Replace(func, activations);
         }
         break;
@@ -256,7 +262,23 @@ public:
       default: assert(false); // don't construct illegal NNs...
       }
     }
+
+    template <class Real>
+    void Sample(const VectorT<Real> & activations, const MutableVectorT<Real> & sample) const {
+      Sample(activations, sample, rnd);
+    }
   };
+};
+
+// The Layer class holds the activations of a layer
+// and is responsible for computing them and backpropagating error
+template <class Real>
+class LayerT : public LayerBase {
+  typedef VectorT<Real>           Vector;
+  typedef MatrixT<Real>           Matrix;
+  typedef MutableVectorT<Real>    MutableVector;
+  typedef MutableMatrixT<Real>    MutableMatrix;
+  typedef AllocatingMatrixT<Real> AllocatingMatrix;
 
 private:
   AllocatingMatrix _a;
@@ -271,7 +293,7 @@ private:
   }
 
 public:
-  Layer() { }
+  LayerT() { }
 
 	// compute inputs and apply activation function
   Matrix ActivateUp(const Matrix & weights, const Vector & biases, const Matrix & lowerValues, ActFunc actFunc) {
@@ -281,11 +303,14 @@ public:
   }
 
 	// dropout values
-  const Matrix & Dropout(double dropP) {
-    _a.Vec().Apply([&] (double a) { return rnd.drand48() > dropP ? a : 0; });
+  template <class Rng>
+  const Matrix & Dropout(double dropP, Rng & rng) {
+    _a.Vec().Apply([&] (double a) { return rng.drand48() > dropP ? a : 0; });
     return _a;
   }
 
+  const Matrix & Dropout(double dropP) { return Dropout(dropP, rnd); }
+
 	// compute activation downward, and return the negative log-likelihood, for autoencoder training
   double ActivateDownAndGetNegLL(const Matrix & weights, const Vector & biases, const Matrix & upperValues, const Matrix & lowerValues, ActFunc actFunc) {
     ComputeInputs(weights, biases, upperValues, false);
@@ -311,6 +336,11 @@ public:
 
   int Count() const { return _a.NumC(); }
 
+  template <class Rng>
+  void Sample(MutableMatrix & sample, ActFunc actFunc, Rng & rng) const {
+    actFunc.Sample(_a.Vec(), sample.Vec(), rng);
+  }
+
   void Sample(MutableMatrix & sample, ActFunc actFunc) const {
     actFunc.Sample(_a.Vec(), sample.Vec());
   }
@@ -319,3 +349,5 @@ public:
     _a.Resize(0, 0);
   }
 };
+
+typedef LayerT<double> Layer;
@@ -24,22 +24,35 @@
 #include "Matrix.h"
 #include "FileBackedMatrix.h"
 
-class MMapMatrix : public FileBackedMatrix {
-  friend class MutableVector;
+template <class Real>
+class MMapMatrixT : public FileBackedMatrixT<Real> {
+  friend class MutableVectorT<Real>;
+
+  using MatrixT<Real>::_start;
+  using MatrixT<Real>::_numR;
+  using MatrixT<Real>::_numC;
+  using MatrixT<Real>::_ld;
+  using MatrixT<Real>::_trans;
+  using FileBackedMatrixBase::backed;
+  using FileBackedMatrixBase::fileName;
+  using FileBackedMatrixBase::file_length;
+  using FileBackedMatrixBase::ref_count;
+  using FileBackedMatrixBase::tempname;
+  using FileBackedMatrixBase::dmlpTempDir;
 
   int     fd;            // backing file descriptor
   long    pagesize;      // VM system page size
 
 public:
 
-  MMapMatrix() : FileBackedMatrix() { }
+  MMapMatrixT() : FileBackedMatrixT<Real>() { }
 
   // Just alias mat, not file-backed...
-  MMapMatrix(const Matrix & mat) : FileBackedMatrix(mat) { }
+  MMapMatrixT(const MatrixT<Real> & mat) : FileBackedMatrixT<Real>(mat) { }
 
   // Create a new file-backed matrix. Put in values with PutCols
-  MMapMatrix(int numR, int numC, int ld, bool trans=false) 
-    : FileBackedMatrix(numR, numC, ld, trans)
+  MMapMatrixT(int numR, int numC, int ld, bool trans=false) 
+    : FileBackedMatrixT<Real>(numR, numC, ld, trans)
   {
     // O_EXCL so it fails if we didn't create the file
     fd = open(fileName, O_RDWR|O_CREAT|O_EXCL, S_IRWXU);
@@ -55,7 +68,7 @@ public:
 #else
     error("ERROR: unknown pagesize\n");
 #endif
-    file_length = ( ((off_t)numC * (off_t)ld * sizeof(double) - 1) / (off_t)pagesize + 1 ) * (off_t)pagesize;
+    file_length = ( ((off_t)numC * (off_t)ld * sizeof(Real) - 1) / (off_t)pagesize + 1 ) * (off_t)pagesize;
     // write to end of file to make it file_length bytes long so we can
     // memory map that many bytes
     if (lseek(fd, (off_t)file_length, SEEK_SET) == (off_t) -1) {
@@ -66,7 +79,7 @@ public:
       perror(fileName);
       error("ERROR: error writing to temporary file '%s'\n", fileName);
     }
-    _start = (const double *)mmap(NULL, file_length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    _start = (const Real *)mmap(NULL, file_length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
     if (!_start || _start == (void *) -1) {
       perror(fileName);
       error("ERROR: unable to allocate %ld bytes via mmap()\n", file_length);
@@ -77,8 +90,8 @@ public:
 
 
   // deep copy ctor - create a new backing file and copy that's contents into it 
-  MMapMatrix(MMapMatrix const &that) 
-    : FileBackedMatrix(NULL, that._numR, that._numC, that._ld, that._trans), pagesize(that.pagesize)
+  MMapMatrixT(MMapMatrixT<Real> const &that) 
+    : FileBackedMatrixT<Real>(NULL, that._numR, that._numC, that._ld, that._trans), pagesize(that.pagesize)
   { 
     file_length = that.file_length;
     if (that.backed) {
@@ -102,7 +115,7 @@ public:
 	}
 	bwritten += result;
       } while (bwritten < file_length);
-      _start = (const double *)mmap(NULL, file_length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+      _start = (const Real *)mmap(NULL, file_length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
       if (!_start || _start == (void *) -1) {
 	perror(fileName);
 	error("ERROR: unable to allocate %ld bytes via mmap()\n", file_length);
@@ -120,7 +133,7 @@ public:
 
 
   // shallow copy - just alias the backing file
-  MMapMatrix & operator= (const MMapMatrix &rhs) {
+  MMapMatrixT<Real> & operator= (const MMapMatrixT<Real> &rhs) {
     _numR  = rhs._numR;
     _numC  = rhs._numC;
     _ld    = rhs._ld;
@@ -171,7 +184,7 @@ public:
   }
 
 
-  ~MMapMatrix() {
+  ~MMapMatrixT() {
     if (backed && _start) {
       string fn(fileName);
       if (ref_count[fn] == 1) {
@@ -190,16 +203,18 @@ public:
 
 
   // Copy Matrix(src, numRows, numCols, srcLd) into this, starting at column destCol
-  void PutCols(double *src, int numCols, int numRows, int srcLd, int destCol) {
+  void PutCols(Real *src, int numCols, int numRows, int srcLd, int destCol) {
     assert(_start && _start != (void *)-1);
     assert(destCol + numCols <= _numC);
-    double *dest = const_cast<double *>(_start) + (ssize_t)destCol * (ssize_t)_ld;
-    double *end = src + numCols * srcLd;
+    Real *dest = const_cast<Real *>(_start) + (ssize_t)destCol * (ssize_t)_ld;
+    Real *end = src + numCols * srcLd;
     do {
-      memcpy((void *)dest, (void *)src, numRows * sizeof(double));
+      memcpy((void *)dest, (void *)src, numRows * sizeof(Real));
       dest += _ld;
       src += srcLd;
     } while (src != end);
   }
 
-}; 
+};
+
+typedef MMapMatrixT<double> MMapMatrix;
@@ -15,51 +15,61 @@
 
 #include <assert.h>
 
+#include "Blas.h"
+#include "Matrix.h"
+
 #if defined(HAVE_MKL)
-#  include "mkl.h"
-#  include "mkl_lapacke.h"
-#  include "mkl_spblas.h"
-#  include "mkl_trans.h"
-#elif defined(HAVE_BLAS)
-extern "C" {            /* Assume C declarations for C++ */
-#  include <cblas.h>
+static inline void
+my_omatcopy(char trans, int rows, int cols, 
+  const double alpha, double const *A, int lda, 
+  double * B, int ldb)
+{
+  mkl_domatcopy('c', trans, rows, cols, alpha, A, lda, B, ldb);
 }
-#else
-#  include "miniblas.h"
-#endif
 
-#if defined(USE_PHIPAC)
-extern "C" {            /* Assume C declarations for C++ */
-  void
-    phipac_dgemm(char* transA, char* transB,
-    int* M, int* N, int* K,
-    double* alpha,
-    double* A, int* Astride,
-    double* B, int* Bstride,
-    double* beta,
-    double* C, int* Cstride);
+static inline void
+my_omatcopy(char trans, int rows, int cols, 
+  const double alpha, float const *A, int lda, 
+  float * B, int ldb)
+{
+  mkl_somatcopy('c', trans, rows, cols, (float) alpha, A, lda, B, ldb);
 }
-#endif
 
-#include "Matrix.h"
+static inline void
+my_omatadd(char aTrans, char bTrans, int M, int N, 
+  const double alpha, double const *A, int lda,
+  const double beta,  double const *B, int ldb,
+  double *C, int ldc)
+{
+  MKL_Domatadd('c', aTrans, bTrans, M, N, alpha, A, lda, beta, B, ldb, C, ldc);
+}
 
-#if !defined(HAVE_MKL)
-void 
-  my_Domatcopy(char trans, int rows, int cols, 
-  const double alpha, double const *A, int lda, 
-  double * B, int ldb)
+static inline void
+my_omatadd(char aTrans, char bTrans, int M, int N, 
+  const double alpha, float const *A, int lda,
+  const double beta,  float const *B, int ldb,
+  float *C, int ldc)
+{
+  MKL_Somatadd('c', aTrans, bTrans, M, N, (float) alpha, A, lda, (float) beta, B, ldb, C, ldc);
+}
+#else
+template <class Real>
+static void 
+  my_omatcopy(char trans, int rows, int cols, 
+  const double alpha, Real const *A, int lda, 
+  Real * B, int ldb)
 {
   assert(trans == 'n' || trans == 't');
   unsigned Ainc1 = (trans == 'n' || trans == 'N') ? 1   : lda;
   unsigned Ainc2 = (trans == 'n' || trans == 'N') ? lda : 1;
 
-  double       *Bcol = B;
-  double       *pastB = B + cols * ldb;
-  double const *Apos = A;
+  Real       *Bcol = B;
+  Real       *pastB = B + cols * ldb;
+  Real const *Apos = A;
   do {
-    double       *Bp = Bcol;
-    double       *colEnd = Bp + rows;
-    double const *Ap = Apos;
+    Real       *Bp = Bcol;
+    Real       *colEnd = Bp + rows;
+    Real const *Ap = Apos;
     do {
       *(Bp++) = alpha * *Ap;
       Ap += Ainc1;
@@ -69,12 +79,13 @@ void
   } while (Bcol != pastB);
 }
 
-void
-  my_Domatadd(char aTrans, char bTrans,
+template <class Real>
+static void
+  my_omatadd(char aTrans, char bTrans,
   int M, int N, 
-  const double alpha, double const *A, int lda,
-  const double beta,  double const *B, int ldb,
-  double *C, int ldc)
+  const double alpha, Real const *A, int lda,
+  const double beta,  Real const *B, int ldb,
+  Real *C, int ldc)
 {
   assert(aTrans == 'n' || aTrans == 't');
   assert(bTrans == 'n' || bTrans == 't');
@@ -87,15 +98,15 @@ void
   unsigned Binc1 = (bTrans == 'n' || bTrans == 'N') ? 1   : ldb;
   unsigned Binc2 = (bTrans == 'n' || bTrans == 'N') ? ldb : 1;
 
-  double       *Ccol = C;
-  double       *pastC = C + N * ldc;
-  double const *Bpos = B;
-  double const *Apos = A;
+  Real       *Ccol = C;
+  Real       *pastC = C + N * ldc;
+  Real const *Bpos = B;
+  Real const *Apos = A;
   do {
-    double       *Cp = Ccol;
-    double       *colEnd = Cp + M;
-    double const *Bp = Bpos;
-    double const *Ap = Apos;
+    Real       *Cp = Ccol;
+    Real       *colEnd = Cp + M;
+    Real const *Bp = Bpos;
+    Real const *Ap = Apos;
     do {
       *(Cp++) = alpha * *Ap + beta * *Bp;
       Bp += Binc1;
@@ -108,47 +119,51 @@ void
 }
 #endif
 
-Matrix Vector::AsMatrix(int numR, int numC) const {
+template <class Real>
+MatrixT<Real> VectorT<Real>::AsMatrix(int numR, int numC) const {
   assert(numR * numC == _len && _inc == 1);
-  return Matrix(_start, numR, numC, numR, false);
+  return MatrixT<Real>(_start, numR, numC, numR, false);
 }
 
-void MutableVector::CopyFrom(const Vector & vec) const {
+template <class Real>
+void MutableVectorT<Real>::CopyFrom(const VectorT<Real> & vec) const {
   assert (_len == vec.Len());
-  cblas_dcopy(_len, vec.Start(), vec.Inc(), Start(), Inc());
+  blas_copy(_len, vec.Start(), vec.Inc(), Start(), Inc());
 }
 
-MutableMatrix MutableVector::AsMatrix(int numR, int numC) const {
-  return Vector::AsMatrix(numR, numC);
+template <class Real>
+MutableMatrixT<Real> MutableVectorT<Real>::AsMatrix(int numR, int numC) const {
+  return VectorT<Real>::AsMatrix(numR, numC);
 }
 
-MutableMatrix MutableVector::AsMatrix(int numR) const {
+template <class Real>
+MutableMatrixT<Real> MutableVectorT<Real>::AsMatrix(int numR) const {
   return AsMatrix(numR, Len() / numR);
 }
 
-Matrix Vector::AsMatrix(int numR) const {
+template <class Real>
+MatrixT<Real> VectorT<Real>::AsMatrix(int numR) const {
   return AsMatrix(numR, Len() / numR);
 }
 
-void MutableVector::Axpby(const VecScal & expr, double a, double b) const {
+template <class Real>
+void MutableVectorT<Real>::Axpby(const VecScalT<Real> & expr, double a, double b) const {
   assert (_len == expr.Len());
-#if HAVE_CBLAS_DAXPBY
-  cblas_daxpby(_len, a * expr.a, expr.v.Start(), expr.v.Inc(), b, Start(), Inc());
-#else
-  cblas_dscal(_len, b, Start(), Inc());
-  cblas_daxpy(_len, a * expr.a, expr.v.Start(), expr.v.Inc(), Start(), Inc());
-#endif
+  blas_axpby(_len, a * expr.a, expr.v.Start(), expr.v.Inc(), b, Start(), Inc());
 }
 
-const MutableMatrix & MutableMatrix::operator=(const MatMatMult & expr) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator=(const MatMatMultT<Real> & expr) const {
   return Dgemm(expr.a, expr.A, expr.B, 0.0);
 }
 
-const MutableMatrix & MutableMatrix::operator+=(const MatMatMult & expr) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator+=(const MatMatMultT<Real> & expr) const {
   return Dgemm(expr.a, expr.A, expr.B, 1.0);
 }
 
-const MutableMatrix & MutableMatrix::Dgemm(double a, const Matrix & A, const Matrix & B, double b) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::Dgemm(double a, const MatrixT<Real> & A, const MatrixT<Real> & B, double b) const {
   if (_trans) {
     Trans().Dgemm(a, B.Trans(), A.Trans(), b);
     return *this;
@@ -156,193 +171,107 @@ const MutableMatrix & MutableMatrix::Dgemm(double a, const Matrix & A, const Mat
 
   assert(_numR == A.NumR() && _numC == B.NumC() && A.NumC() == B.NumR());
 
-#if USE_PHIPAC
-  // The low-level PHiPAC routines assume the matrices are in row-major order,
-  // but the phipac_dgemm BLAS interface assumes they're in column-major order
-  // and does the necessary transposes implicitly.
-  int numR   = _numR;
-  int numC   = _numC;
-  int ANumC  = A.NumC();
-  int ALd    = A.Ld();
-  int BLd    = B.Ld();
-  int thisLd = Ld();
-  char Aop   = A.IsTrans() ? 'T' : 'N';
-  char Bop   = B.IsTrans() ? 'T' : 'N';
-  phipac_dgemm(&Aop, &Bop, 
-    &numR, &numC, &ANumC, 
-    &a, 
-    const_cast<double *>(A.Start()), &ALd, 
-    const_cast<double *>(B.Start()), &BLd, 
-    &b, 
-    Start(), &thisLd);
-#else
-  cblas_dgemm(CblasColMajor, A.IsTrans() ? CblasTrans : CblasNoTrans, B.IsTrans() ? CblasTrans : CblasNoTrans,
+  blas_gemm(A.IsTrans(), B.IsTrans(),
     _numR, _numC, A.NumC(), a, A.Start(), A.Ld(), B.Start(), B.Ld(), b, Start(), Ld());
-#endif
   return *this;
 }
 
-const MutableMatrix & MutableMatrix::operator=(const MatScaledSum & expr) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator=(const MatScaledSumT<Real> & expr) const {
   assert (NumR() == expr.NumR());
   assert (NumC() == expr.NumC());
 
   bool aTrans = expr.A.IsTrans() ^ IsTrans(), bTrans = expr.B.IsTrans() ^ IsTrans();
-#if HAVE_MKL
-  MKL_Domatadd ('c', aTrans ? 't' : 'n', bTrans ? 't' : 'n',
+  my_omatadd (aTrans ? 't' : 'n', bTrans ? 't' : 'n',
     _numR, _numC, expr.a, expr.A.Start(), expr.A.Ld(),
     expr.b, expr.B.Start(), expr.B.Ld(), Start(), _ld);
-#else
-  my_Domatadd (aTrans ? 't' : 'n', bTrans ? 't' : 'n',
-    _numR, _numC, expr.a, expr.A.Start(), expr.A.Ld(),
-    expr.b, expr.B.Start(), expr.B.Ld(), Start(), _ld);  
-#endif
   return *this;
 }
 
-const MutableMatrix & MutableMatrix::operator+=(const MatScal & expr) const {
-  return operator=(MatScaledSum(*this, expr));
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator+=(const MatScalT<Real> & expr) const {
+  return operator=(MatScaledSumT<Real>(*this, expr));
 }
 
-const MutableMatrix & MutableMatrix::operator=(const MatScal & expr) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator=(const MatScalT<Real> & expr) const {
   assert (NumR() == expr.NumR());
   assert (NumC() == expr.NumC());
 
   bool trans = expr.A.IsTrans() ^ _trans;
-#if HAVE_MKL
-  MKL_Domatcopy('c', trans ? 't' : 'n', expr.A.DeepNumR(), expr.A.DeepNumC(), expr.a, expr.A.Start(), expr.A.Ld(), Start(), Ld());
-#else
-  my_Domatcopy(trans ? 't' : 'n', expr.A.DeepNumR(), expr.A.DeepNumC(), expr.a, expr.A.Start(), expr.A.Ld(), Start(), Ld());
-#endif
+  my_omatcopy(trans ? 't' : 'n', expr.A.DeepNumR(), expr.A.DeepNumC(), expr.a, expr.A.Start(), expr.A.Ld(), Start(), Ld());
   return *this;
 }
 
-const MutableVector & MutableVector::operator*=(double a) const {
+template <class Real>
+const MutableVectorT<Real> & MutableVectorT<Real>::operator*=(double a) const {
   return operator=(*this * a);
 }
 
-const MutableMatrix & MutableMatrix::operator*=(double a) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator*=(double a) const {
   return operator=(*this * a);
 }
 
-const MutableMatrix & MutableMatrix::operator-=(const MatScal & expr) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator-=(const MatScalT<Real> & expr) const {
   return operator+= (-1 * expr);
 }
 
-const MutableMatrix & MutableMatrix::operator-=(const MatMatMult & expr) const {
+template <class Real>
+const MutableMatrixT<Real> & MutableMatrixT<Real>::operator-=(const MatMatMultT<Real> & expr) const {
   return operator+= (-1 * expr);
 }
 
-const MutableVector & MutableVector::operator-=(const VecScal & expr) const {
+template <class Real>
+const MutableVectorT<Real> & MutableVectorT<Real>::operator-=(const VecScalT<Real> & expr) const {
   return operator+= (-1.0 * expr);
 }
 
-const MutableVector & MutableVector::operator=(const VecScaledSum & expr) const {
+template <class Real>
+const MutableVectorT<Real> & MutableVectorT<Real>::operator=(const VecScaledSumT<Real> & expr) const {
   assert (Len() == expr.Len());
-#if HAVE_MKL
-  MKL_Domatadd('c', 'n', 'n', 1, Len(), expr.a, expr.x.Start(), expr.x.Inc(), expr.b, expr.y.Start(), expr.y.Inc(), Start(), Inc());
-#else
-  my_Domatadd('n', 'n', 1, Len(), expr.a, expr.x.Start(), expr.x.Inc(), expr.b, expr.y.Start(), expr.y.Inc(), Start(), Inc());
-#endif
+  my_omatadd('n', 'n', 1, Len(), expr.a, expr.x.Start(), expr.x.Inc(), expr.b, expr.y.Start(), expr.y.Inc(), Start(), Inc());
   return *this;
 }
 
-const MutableVector & MutableVector::operator=(const VecScal & expr) const {
+template <class Real>
+const MutableVectorT<Real> & MutableVectorT<Real>::operator=(const VecScalT<Real> & expr) const {
   assert (Len() == expr.Len());
-#if HAVE_MKL
-  MKL_Domatcopy('c', 'n', 1, Len(), expr.a, expr.v.Start(), expr.v.Inc(), Start(), Inc());
-#else
-  my_Domatcopy('n', 1, Len(), expr.a, expr.v.Start(), expr.v.Inc(), Start(), Inc());
-#endif
+  my_omatcopy('n', 1, Len(), expr.a, expr.v.Start(), expr.v.Inc(), Start(), Inc());
   return *this;
 }
 
-const MutableVector & MutableVector::operator+=(const VecScal & expr) const {
+template <class Real>
+const MutableVectorT<Real> & MutableVectorT<Real>::operator+=(const VecScalT<Real> & expr) const {
   assert (Len() == expr.Len());
-  cblas_daxpy(Len(), expr.a, expr.v.Start(), expr.v.Inc(), Start(), Inc());
+  blas_axpy(Len(), expr.a, expr.v.Start(), expr.v.Inc(), Start(), Inc());
   return *this;
 }
 
-VecScal Vector::operator-() const {
-  return *this * -1;
-}
-
-MatScal Matrix::operator-() const {
-  return *this * -1;
-}
-
-MatScal operator*(double b, const MatScal & ms) {
-  return MatScal(ms.A, ms.a * b);
-}
-
-MatScal operator*(const MatScal & ms, double b) {
-  return b * ms;
-}
-
-MatMatMult operator*(const MatScal & A, const MatScal & B) {
-  return MatMatMult(A.A, B.A, A.a * B.a);
-}
-
-MatScaledSum operator*(double c, const MatScaledSum & mss) {
-  return mss.A * mss.a * c + mss.B * mss.b * c;
-}
-
-MatScaledSum operator*(const MatScaledSum & mss, double c) {
-  return c * mss;
-}
-
-MatMatMult operator*(double b, const MatMatMult & mmm) {
-  return MatMatMult(mmm.A, mmm.B, mmm.a * b);
-}
-
-MatMatMult operator*(const MatMatMult & mmm, double b) {
-  return b * mmm;
-}
-
-MatScaledSum operator+(const MatScal & ax, const MatScal & by) {
-  return MatScaledSum(ax, by);
-}
-
-MatScaledSum operator-(const MatScal & ax, const MatScal & by) {
-  return MatScaledSum(ax, -by);
-}
-
-VecScal operator*(double b, const VecScal & vs) {
-  return VecScal(vs.v, b * vs.a);
-}
-
-VecScal operator*(const VecScal & vs, double b) {
-  return b * vs;
-}
-
-double operator*(const VecScal & ax, const VecScal & by) {
+template <class Real>
+double operator*(const VecScalT<Real> & ax, const VecScalT<Real> & by) {
   assert(ax.v.Len() == by.v.Len());
 
-  return ax.a * by.a * cblas_ddot(ax.v.Len(), ax.v.Start(), ax.v.Inc(), by.v.Start(), by.v.Inc());
-}
-
-VecScaledSum operator+(const VecScal & ax, const VecScal & by) {
-  return VecScaledSum(ax, by);
-}
-
-VecScaledSum operator-(const VecScal & ax, const VecScal & by) {
-  return VecScaledSum(ax, -by);
-}
-
-VecScaledSum operator*(double c, const VecScaledSum & vss) {
-  return vss.x * vss.a * c + vss.y * vss.b * c;
-}
-
-VecScaledSum operator*(const VecScaledSum & vss, double c) {
-  return c * vss;
+  return (double) ax.a * by.a * blas_dot(ax.v.Len(), ax.v.Start(), ax.v.Inc(), by.v.Start(), by.v.Inc());
 }
 
-void MutableMatrix::CopyFrom(const Matrix & mat, double scale) const {
+template <class Real>
+void MutableMatrixT<Real>::CopyFrom(const MatrixT<Real> & mat, double scale) const {
   assert (NumR() == mat.NumR() && NumC() == mat.NumC());
 
   char trans = (IsTrans() ^ mat.IsTrans()) ? 't' : 'n';
-#if HAVE_MKL
-  mkl_domatcopy('c', trans, mat.DeepNumR(), mat.DeepNumC(), scale, mat.Start(), mat.Ld(), Start(), _ld);
-#else
-  my_Domatcopy(trans, mat.DeepNumR(), mat.DeepNumC(), scale, mat.Start(), mat.Ld(), Start(), _ld);
-#endif
+  my_omatcopy(trans, mat.DeepNumR(), mat.DeepNumC(), scale, mat.Start(), mat.Ld(), Start(), _ld);
 }
+
+template class VectorT<double>;
+template class MatrixT<double>;
+template class MutableVectorT<double>;
+template class MutableMatrixT<double>;
+template double operator*(const VecScalT<double> &, const VecScalT<double> &);
+
+template class VectorT<float>;
+template class MatrixT<float>;
+template class MutableVectorT<float>;
+template class MutableMatrixT<float>;
+template double operator*(const VecScalT<float> &, const VecScalT<float> &);
@@ -35,13 +35,14 @@
 
 #include "Globals.h"
 
-class Matrix;
-class MutableMatrix;
-struct MatScal;
-struct MatScaledSum;
-struct MatMatMult;
-struct VecScal;
-struct VecScaledSum;
+template <class Real> class MatrixT;
+template <class Real> class MutableVectorT;
+template <class Real> class MutableMatrixT;
+template <class Real> struct MatScalT;
+template <class Real> struct MatScaledSumT;
+template <class Real> struct MatMatMultT;
+template <class Real> struct VecScalT;
+template <class Real> struct VecScaledSumT;
 
 /**********************
 The Matrix and Vector classes were created to allow matrix/vector
@@ -68,6 +69,12 @@ matrix-vector product, matrix-matrix product, addition, etc.) are
 implemented using a handful of utility classes and operator
 overloading.
 
+All of the classes are templates on the element type Real, which
+may be double or float. Vector, Matrix, etc. (typedefs at the end
+of this file) are the double versions; the float versions halve
+the memory traffic and double the SIMD width of the BLAS calls
+for training where single precision is accurate enough.
+
 NOTE ABOUT INDEXING.
 Several operators like Vector::operator[](int i) and Matrix::
 At(r,c) index into the structures. If any of the arguments i are
@@ -87,33 +94,34 @@ Vector, use Vector::SubVector(~2, ~0).
 // Base class for Vectors. Contains read-only pointer to data.
 // Maintains increment between vector elements and increment
 // between adjacent vectors in a larger matrix, if applicable
-class Vector {
+template <class Real>
+class VectorT {
 protected:
-  const double *_start;
+  const Real *_start;
   int _len, _inc, _ld;
 
 public:
 	// construct a null vector
-  Vector() : _start(NULL), _len(0), _inc(1), _ld(0) { }
+  VectorT() : _start(NULL), _len(0), _inc(1), _ld(0) { }
 
 	// construct a vector with the given data, size, and increment
 	// ld is optional, but if provided allows the vector to skip
 	// through rows or columns of a matrix it is part of
-  Vector(const double * start, int len, int inc = 1, int ld = 0)
+  VectorT(const Real * start, int len, int inc = 1, int ld = 0)
     :
   _start(start), _len(len), _inc(inc), _ld(ld) { }
 
 	// copy constructor
-  Vector(const std::vector<double> & vec) : _start(&vec[0]), _len(vec.size()), _inc(1), _ld(0) { }
+  VectorT(const std::vector<Real> & vec) : _start(&vec[0]), _len(vec.size()), _inc(1), _ld(0) { }
 
 	// get start pointer
-  const double *Start() const { return _start; }
+  const Real *Start() const { return _start; }
 
 	// get vector length
   int Len() const { return _len; }
 
 	// get end pointer (one past last entry of vector)
-  const double *End() const { return _start + _inc * _len; }
+  const Real *End() const { return _start + _inc * _len; }
 
 	// get distance between elements
   int Inc() const { return _inc; }
@@ -133,10 +141,10 @@ public:
 	// negate vector. This is an implicit operation, no data
 	// is copied until the resulting VecScal is assigned to
 	// another vector
-  VecScal operator-() const;
+  VecScalT<Real> operator-() const;
 
 	// get the ith element. See NOTE ABOUT INDEXING above
-  const double & operator[](int i) const {
+  const Real & operator[](int i) const {
     if (i < 0) i += _len;
     assert (0 <= i && i < _len);
     return *(_start + i * _inc);
@@ -145,28 +153,28 @@ public:
 	// Returns a new vector view that begins with the given
 	// element position and is of length (end-begin)
 	// See NOTE ABOUT INDEXING above
-  Vector SubVector(int begin, int end) const {		
+  VectorT<Real> SubVector(int begin, int end) const {		
     if (begin < 0) begin = _len - ~begin;
     if (end < 0) end = _len - ~end;
     assert (0 <= begin && begin <= end && end <= _len);
-    return Vector(_start + begin, (end - begin), _inc, _ld);
+    return VectorT<Real>(_start + begin, (end - begin), _inc, _ld);
   }
 
 	// Interpret the vector data as a matrix with the given
 	// number of rows and columns. It is required that
 	// numR * numC == _len
-  Matrix AsMatrix(int numR, int numC) const;
+  MatrixT<Real> AsMatrix(int numR, int numC) const;
 
 	// Interpret the vector data as a matrix with the given
 	// number of rows. It is required that _len % numR == 0
-  Matrix AsMatrix(int numR) const;
+  MatrixT<Real> AsMatrix(int numR) const;
 
 	// Apply a visitor object to each element
 	// A Visitor is assumed to implement operator()(double x)
 	// Very handy with lambda expressions!
   template <class Visitor>
   void Visit(Visitor visitor) const {
-    const double *p = _start;
+    const Real *p = _start;
     while (p != End()) {
       visitor(*p);
       p += _inc;
@@ -181,10 +189,10 @@ public:
 	// and the second is an element of the argument vector.
 	// Very handy with lambda expressions!
   template <class Visitor>
-  void Visit(Visitor visitor, const Vector & arg) const {
+  void Visit(Visitor visitor, const VectorT<Real> & arg) const {
     assert (arg.Len() == Len());
-    const double *p = _start;
-    const double *pA = arg.Start();
+    const Real *p = _start;
+    const Real *pA = arg.Start();
     while (p != End()) {
       visitor(*p, *pA);
       p += _inc;
@@ -211,29 +219,30 @@ public:
 // Matrices are stored in column order. Maintains whether the
 // matrix is transposed, and the distance between first elements
 // of each column
-class Matrix {
+template <class Real>
+class MatrixT {
 protected:
-  const double *_start;
+  const Real *_start;
   int _numR, _numC, _ld;
   bool _trans;
 
 public:
 	// create an empty matrix
-  Matrix() : _start(NULL), _numR(0), _numC(0), _ld(0), _trans(false) { }
+  MatrixT() : _start(NULL), _numR(0), _numC(0), _ld(0), _trans(false) { }
 
 	// creates a matrix with the given pointer to data (start),
 	// number of rows and columns, distance between starts of adjacent
 	// columns ld, and possibly transposed
-  Matrix(const double *start, int numR, int numC, int ld, bool trans)
+  MatrixT(const Real *start, int numR, int numC, int ld, bool trans)
     :
   _start(start), _numR(numR), _numC(numC), _ld(ld), _trans(trans) { }
 
 	// pointer to start of matrix
-  const double *Start() const { return _start; }
+  const Real *Start() const { return _start; }
 
 	// pointer to end of matrix (location which would be start of
 	// next column after last)
-  const double *End() const { return Start() + (_numC * _ld); }
+  const Real *End() const { return Start() + (_numC * _ld); }
 
 	// Number of underlying rows, not considering that matrix may
 	// be carrying a transpose tag
@@ -263,17 +272,17 @@ public:
 
 	// Returns vector representation of matrix IF IsVec() is true
 	// otherwise causes program abort
-  Vector Vec() const { return Vector(_start, VecLen(), 1, 0); }
+  VectorT<Real> Vec() const { return VectorT<Real>(_start, VecLen(), 1, 0); }
 
 	// returns true iff the matrix is transposed
   bool IsTrans() const { return _trans; }
 
 	// returns a matrix pointing to the same data, but transposed
-  Matrix Trans() const { return Matrix(_start, _numR, _numC, _ld, !_trans); }
+  MatrixT<Real> Trans() const { return MatrixT<Real>(_start, _numR, _numC, _ld, !_trans); }
 
 	// Return the element at the given row and column
 	// See NOTE ABOUT INDEXING above
-  virtual const double & At(int r, int c) const {
+  virtual const Real & At(int r, int c) const {
     if (_trans) std::swap(r, c);
     if (r < 0) r += _numR;
     if (c < 0) c += _numC;
@@ -292,7 +301,7 @@ public:
     s[4] = '0' + prec;
     for (int r = 0; r < NumR(); ++r) {
       for (int c = 0; c < NumC(); ++c) {
-        double d = At(r,c);
+        Real d = At(r,c);
         printf(s.c_str(),d);
       }
       printf("\n");
@@ -301,31 +310,31 @@ public:
 
 	// Return a Vector representation of the given column
 	// See NOTE ABOUT INDEXING above
-  Vector GetCol(int c) const {
+  VectorT<Real> GetCol(int c) const {
     if (_trans) return Trans().GetRow(c);
 
     if (c < 0) c += _numC;
     assert (0 <= c && c < _numC);
 
-    return Vector(Start() + c * _ld, _numR, 1, _ld);
+    return VectorT<Real>(Start() + c * _ld, _numR, 1, _ld);
   }
 
 	// Return a Vector representation of the given row
 	// See NOTE ABOUT INDEXING above
-  Vector GetRow(int r) const {
+  VectorT<Real> GetRow(int r) const {
     if (_trans) return Trans().GetCol(r);
 
     if (r < 0) r += _numR;
     assert (0 <= r && r < _numR);
 
-    return Vector(Start() + r, _numC, _ld, 1);
+    return VectorT<Real>(Start() + r, _numC, _ld, 1);
   }
 
 	// Return a Matrix consisting of the columns from beginCol
 	// to endCol (not inclusive: the result will have
 	// endCol-beginCol total columns)
 	// See NOTE ABOUT INDEXING above
-  Matrix GetCols(int beginCol, int endCol) const {
+  MatrixT<Real> GetCols(int beginCol, int endCol) const {
     return SubMatrix(0, -1, beginCol, endCol);
   }
 
@@ -333,21 +342,21 @@ public:
 	// to endRow (not inclusive: the result will have
 	// endRow-beginRow total rows)
 	// See NOTE ABOUT INDEXING above
-  Matrix GetRows(int beginRow, int endRow) const {
+  MatrixT<Real> GetRows(int beginRow, int endRow) const {
     return SubMatrix(beginRow, endRow, 0, -1);
   }
 
 	// negate the matrix. This is an implicit operation, no data
 	// is copied until the resulting MatScal is assigned to
 	// another matrix
-  MatScal operator-() const;
+  MatScalT<Real> operator-() const;
 
 	// Return a Matrix consisting of the rows from beginRow
 	// to endRow, and the columns from beginCol to endCol
 	// (not inclusive: the result will have (endRow-beginRow)
 	// total rows and (endCol-beginCol) total columns)
 	// See NOTE ABOUT INDEXING above
-  virtual Matrix SubMatrix(int beginRow, int endRow, int beginCol, int endCol) const {
+  virtual MatrixT<Real> SubMatrix(int beginRow, int endRow, int beginCol, int endCol) const {
     if (_trans) {
       std::swap(beginRow, beginCol);
       std::swap(endRow, endCol);
@@ -361,89 +370,99 @@ public:
     if (endCol < 0) endCol = _numC - ~endCol;
     assert (0 <= beginCol && beginCol <= endCol && endCol <= _numC);
 
-    return Matrix(_start + (int64_t)beginCol * _ld + beginRow, endRow - beginRow, endCol - beginCol, _ld, _trans);
+    return MatrixT<Real>(_start + (int64_t)beginCol * _ld + beginRow, endRow - beginRow, endCol - beginCol, _ld, _trans);
   }
 };
 
 // Subclass of Vector that adds methods that can alter the
 // the underlying data
-class MutableVector : public Vector {
-  friend class MutableMatrix;
-  MutableVector(const Vector & vec) : Vector(vec) { }
+template <class Real>
+class MutableVectorT : public VectorT<Real> {
+  friend class MutableMatrixT<Real>;
+  MutableVectorT(const VectorT<Real> & vec) : VectorT<Real>(vec) { }
+
+protected:
+  using VectorT<Real>::_start;
+  using VectorT<Real>::_len;
+  using VectorT<Real>::_inc;
 
 public:
+  using VectorT<Real>::End;
+  using VectorT<Real>::Len;
+  using VectorT<Real>::Inc;
+
 	// Make an empty vector
-  MutableVector() : Vector() { }
+  MutableVectorT() : VectorT<Real>() { }
 
 	// construct a vector with the given data, size, and increment
 	// ld is optional, but if provided allows the vector to skip
 	// through rows or columns of a matrix it is part of
-  MutableVector(double * start, int len, int inc = 1, int ld = 0) : Vector(start, len, inc, ld) { }
+  MutableVectorT(Real * start, int len, int inc = 1, int ld = 0) : VectorT<Real>(start, len, inc, ld) { }
 
 	// create a vector pointing to the data in this std::vector
-  MutableVector(std::vector<double> & vec) : Vector(vec) { }
+  MutableVectorT(std::vector<Real> & vec) : VectorT<Real>(vec) { }
 
 	// This appears to have no implementation and is not being used
 	//  MutableVector(const MutableMatrix & m);
 
 	// Get the pointer to the beginning of the data
-  double *Start() const { return const_cast<double*>(Vector::Start()); }
+  Real *Start() const { return const_cast<Real*>(VectorT<Real>::Start()); }
 
 	// get the ith element. See NOTE ABOUT INDEXING above
-  double & operator[](int i) const {
-    return const_cast<double &>(Vector::operator[](i));
+  Real & operator[](int i) const {
+    return const_cast<Real &>(VectorT<Real>::operator[](i));
   }
 
 	// Returns a new vector view that begins with the given
 	// element position and is of length (end-begin)
 	// See NOTE ABOUT INDEXING above
-  MutableVector SubVector(int begin, int end) const {
-    return Vector::SubVector(begin, end);
+  MutableVectorT<Real> SubVector(int begin, int end) const {
+    return VectorT<Real>::SubVector(begin, end);
   }
 
 	// Interpret the vector data as a matrix with the given
 	// number of rows and columns. It is required that
 	// numR * numC == _len
-  MutableMatrix AsMatrix(int numR, int numC) const;
+  MutableMatrixT<Real> AsMatrix(int numR, int numC) const;
 
 	// Interpret the vector data as a matrix with the given
 	// number of rows. It is required that _len % numR == 0
-  MutableMatrix AsMatrix(int numR) const;
+  MutableMatrixT<Real> AsMatrix(int numR) const;
 
 	// Overwrite this vector's data with the results of evaluating
 	// the linear combination of two other vectors
-  const MutableVector & operator=(const VecScaledSum & expr) const;
+  const MutableVectorT<Real> & operator=(const VecScaledSumT<Real> & expr) const;
 
 	// Overwrite this vector's data with the results of multiplying
 	// another vector with a scalar
-  const MutableVector & operator=(const VecScal & expr) const;
+  const MutableVectorT<Real> & operator=(const VecScalT<Real> & expr) const;
 
 	// Overwrite this vector's data by adding the results of
 	// multiplying another vector with a scalar
-  const MutableVector & operator+=(const VecScal & expr) const;
+  const MutableVectorT<Real> & operator+=(const VecScalT<Real> & expr) const;
 
 	// Overwrite this vector's data by subtracting the results of
 	// multiplying another vector with a scalar
-  const MutableVector & operator-=(const VecScal & expr) const;
+  const MutableVectorT<Real> & operator-=(const VecScalT<Real> & expr) const;
 
 	// Overwrite this vector's data by with the results of
 	// multiplying it with a scalar
-  const MutableVector & operator*=(double a) const;
+  const MutableVectorT<Real> & operator*=(double a) const;
 
 	// Overwrite this vector's data by with the results of
 	// dividing it by a scalar
-  const MutableVector & operator/=(double a) const { return operator*=(1.0 / a); }
+  const MutableVectorT<Real> & operator/=(double a) const { return operator*=(1.0 / a); }
 
 	// Overwrite this vector's data with a copy of vec's data
 	// It is a precondition that the vector lengths are the same
-  void CopyFrom(const Vector & vec) const;
+  void CopyFrom(const VectorT<Real> & vec) const;
 
 	// Overwrite this vector's data by applying a mutator object to each element
 	// A Mutator is assumed to implement operator()(double x)->double
 	// Very handy with lambda expressions!
   template <class Mutator>
   void Apply(Mutator mut) const {
-    double *p = Start();
+    Real *p = Start();
     while (p != End()) {
       *p = mut(*p);
       p += _inc;
@@ -460,10 +479,10 @@ public:
 	// and the second is an element of the argument vector.
 	// Very handy with lambda expressions!
   template <class Mutator>
-  void Apply(Mutator mut, const Vector & arg) const {
+  void Apply(Mutator mut, const VectorT<Real> & arg) const {
     assert (arg.Len() == Len());
-    double *p = Start();
-    const double *pA = arg.Start();
+    Real *p = Start();
+    const Real *pA = arg.Start();
     while (p != End()) {
       *p = mut(*p, *pA);
       p += _inc;
@@ -477,7 +496,7 @@ public:
 	// Very handy with lambda expressions!
   template <class Func>
   void Replace(Func trans) const {
-    double *p = Start();
+    Real *p = Start();
     while (p != End()) {
       *p = trans();
       p += _inc;
@@ -490,10 +509,10 @@ public:
 	// Note the difference with Apply is that the current data is not used
 	// Very handy with lambda expressions!
   template <class Func>
-  void Replace(Func trans, const Vector & arg) const {
+  void Replace(Func trans, const VectorT<Real> & arg) const {
     assert (arg.Len() == Len());
-    double *p = Start();
-    const double *pA = arg.Start();
+    Real *p = Start();
+    const Real *pA = arg.Start();
     while (p != End()) {
       *p = trans(*pA);
       p += _inc;
@@ -508,10 +527,10 @@ public:
 	// Note the difference with Apply is that the current data is not used
 	// Very handy with lambda expressions!
   template <class Func>
-  void Replace(Func trans, const Vector & arg, const Vector & arg2) const {
+  void Replace(Func trans, const VectorT<Real> & arg, const VectorT<Real> & arg2) const {
     assert (arg.Len() == Len());
-    double *p = Start();
-    const double *pA = arg.Start(), *pA2 = arg2.Start();
+    Real *p = Start();
+    const Real *pA = arg.Start(), *pA2 = arg2.Start();
     while (p != End()) {
       *p = trans(*pA, *pA2);
       p += _inc;
@@ -521,7 +540,7 @@ public:
   }
 
 	// Overwrite every element of this vector's data with the given value
-  void Assign(double val) const {
+  void Assign(Real val) const {
     Replace([val] () { return val; });
   }
 
@@ -529,7 +548,7 @@ public:
 	// an Intel Vector Matrix Library function taking a single vector
 	// argument (such as vdexp) to the argument vector
   template <class VMLFunc>
-  void ApplyVML(VMLFunc Func, const Vector & arg) const {
+  void ApplyVML(VMLFunc Func, const VectorT<Real> & arg) const {
     assert (_inc == 1 && arg.Inc() == 1);
     Func(_len, arg.Start(), Start());
   }
@@ -538,7 +557,7 @@ public:
 	// an Intel Vector Matrix Library function taking two vector
 	// arguments (such as vdadd) to the argument vectors
   template <class VMLFunc>
-  void ApplyVML(VMLFunc Func, const Vector & arg1, const Vector & arg2) const {
+  void ApplyVML(VMLFunc Func, const VectorT<Real> & arg1, const VectorT<Real> & arg2) const {
     assert (_inc == 1 && arg1.Inc() == 1 && arg2.Inc() == 1);
     Func(_len, arg1.Start(), arg2.Start(), Start());
   }
@@ -555,66 +574,81 @@ public:
 	// Overwrite this vector's data as a linear combination of
 	// itself with another vector
 	// this = a * expr + b * this
-  void Axpby(const VecScal & expr, double a, double b) const;
+  void Axpby(const VecScalT<Real> & expr, double a, double b) const;
 };
 
 // Subclass of Matrix that adds methods that can alter the
 // the underlying data
-class MutableMatrix : public Matrix {
-  friend class MutableVector;
-  MutableMatrix(const Matrix & mat) : Matrix(mat) { }
+template <class Real>
+class MutableMatrixT : public MatrixT<Real> {
+  friend class MutableVectorT<Real>;
+  MutableMatrixT(const MatrixT<Real> & mat) : MatrixT<Real>(mat) { }
+
+protected:
+  using MatrixT<Real>::_start;
+  using MatrixT<Real>::_numR;
+  using MatrixT<Real>::_numC;
+  using MatrixT<Real>::_ld;
+  using MatrixT<Real>::_trans;
 
 public:
+  using MatrixT<Real>::NumR;
+  using MatrixT<Real>::NumC;
+  using MatrixT<Real>::Ld;
+  using MatrixT<Real>::IsVec;
+  using MatrixT<Real>::VecLen;
+  using MatrixT<Real>::IsTrans;
+
 	// create an empty matrix
-  MutableMatrix() : Matrix() { }
+  MutableMatrixT() : MatrixT<Real>() { }
 
 	// creates a matrix with the given pointer to data (start),
 	// number of rows and columns, distance between starts of adjacent
 	// columns ld, and possibly transposed
-  MutableMatrix(double *start, int numR, int numC, int ld, bool trans) : Matrix(start, numR, numC, ld, trans) { }
+  MutableMatrixT(Real *start, int numR, int numC, int ld, bool trans) : MatrixT<Real>(start, numR, numC, ld, trans) { }
 
 	// returns a matrix pointing to the same data, but transposed
-  MutableMatrix Trans() const { return MutableMatrix(Start(), _numR, _numC, _ld, !_trans); }
+  MutableMatrixT<Real> Trans() const { return MutableMatrixT<Real>(Start(), _numR, _numC, _ld, !_trans); }
 
 	// pointer to start of matrix
-  double *Start() const { return const_cast<double*>(_start); }
+  Real *Start() const { return const_cast<Real*>(_start); }
 
 	// pointer to end of matrix (location which would be start of
 	// next column after last)
-  double *End() const { return Start() + (_numC * _ld); }
+  Real *End() const { return Start() + (_numC * _ld); }
 
 	// Return the element at the given row and column
 	// See NOTE ABOUT INDEXING above
-  double & AtMutable(int r, int c) const {
-    return const_cast<double &>(Matrix::At(r,c));
+  Real & AtMutable(int r, int c) const {
+    return const_cast<Real &>(MatrixT<Real>::At(r,c));
   }
 
 	// Returns vector representation of matrix IF IsVec() is true
 	// otherwise causes program abort
-  MutableVector Vec() const {
-    return MutableVector(Start(), VecLen(), 1, 0);
+  MutableVectorT<Real> Vec() const {
+    return MutableVectorT<Real>(Start(), VecLen(), 1, 0);
   }
 
 	// Overwrite this matrix's data with a copy of mat's data (possibly scaled)
-  void CopyFrom(const Matrix & mat, double scale = 1.0) const;
+  void CopyFrom(const MatrixT<Real> & mat, double scale = 1.0) const;
 
 	// Return a MutableVector representation of the given row
 	// See NOTE ABOUT INDEXING above
-  MutableVector GetRow(int r) const {
-    return Matrix::GetRow(r);
+  MutableVectorT<Real> GetRow(int r) const {
+    return MatrixT<Real>::GetRow(r);
   }
 
 	// Return a MutableVector representation of the given column
 	// See NOTE ABOUT INDEXING above
-  MutableVector GetCol(int c) const {
-    return Matrix::GetCol(c);
+  MutableVectorT<Real> GetCol(int c) const {
+    return MatrixT<Real>::GetCol(c);
   }
 
 	// Return a Matrix consisting of the columns from beginCol
 	// to endCol (not inclusive: the result will have
 	// endCol-beginCol total columns)
 	// See NOTE ABOUT INDEXING above
-  MutableMatrix GetCols(int beginCol, int endCol) const {
+  MutableMatrixT<Real> GetCols(int beginCol, int endCol) const {
     return SubMatrix(0, -1, beginCol, endCol);
   }
 
@@ -622,7 +656,7 @@ public:
 	// to endRow (not inclusive: the result will have
 	// endRow-beginRow total rows)
 	// See NOTE ABOUT INDEXING above
-  MutableMatrix GetRows(int beginRow, int endRow) const {
+  MutableMatrixT<Real> GetRows(int beginRow, int endRow) const {
     return SubMatrix(beginRow, endRow, 0, -1);
   }
 
@@ -631,54 +665,54 @@ public:
 	// (not inclusive: the result will have (endRow-beginRow)
 	// total rows and (endCol-beginCol) total columns)
 	// See NOTE ABOUT INDEXING above
-  Matrix SubMatrix(int beginRow, int endRow, int beginCol, int endCol) const {
-    return Matrix::SubMatrix(beginRow, endRow, beginCol, endCol);
+  MatrixT<Real> SubMatrix(int beginRow, int endRow, int beginCol, int endCol) const {
+    return MatrixT<Real>::SubMatrix(beginRow, endRow, beginCol, endCol);
   }
 
 	// Overwrite this matrix's data with the result of the
 	// matrix/matrix multiplication op specified in expr
-  const MutableMatrix & operator=(const MatMatMult & expr) const;
+  const MutableMatrixT<Real> & operator=(const MatMatMultT<Real> & expr) const;
 
 	// Overwrite this matrix's data with the results of evaluating
 	// the linear combination of two other matrices
-  const MutableMatrix & operator=(const MatScaledSum & expr) const;
+  const MutableMatrixT<Real> & operator=(const MatScaledSumT<Real> & expr) const;
 
 	// Overwrite this matrix's data with the result of the given
 	// scaling operation on another matrix
-  const MutableMatrix & operator=(const MatScal & expr) const;
+  const MutableMatrixT<Real> & operator=(const MatScalT<Real> & expr) const;
 
 	// Overwrite this matrix's data by adding a multiple of another
 	// matrix (supplied in expr) to the current data
-  const MutableMatrix & operator+=(const MatScal & expr) const;
+  const MutableMatrixT<Real> & operator+=(const MatScalT<Real> & expr) const;
 
 	// Overwrite this matrix's data by adding a product of two other
 	// matrices (supplied in expr) to the current data
-  const MutableMatrix & operator+=(const MatMatMult & expr) const;
+  const MutableMatrixT<Real> & operator+=(const MatMatMultT<Real> & expr) const;
 
 	// Overwrite this matrix's data by subtracting a multiple of another
 	// matrix (supplied in expr) to the current data
-  const MutableMatrix & operator-=(const MatScal & expr) const;
+  const MutableMatrixT<Real> & operator-=(const MatScalT<Real> & expr) const;
 
 	// Overwrite this matrix's data by subtracting a product of two other
 	// matrices (supplied in expr) to the current data
-  const MutableMatrix & operator-=(const MatMatMult & expr) const;
+  const MutableMatrixT<Real> & operator-=(const MatMatMultT<Real> & expr) const;
 
 	// Overwrite this matrix's data with the results of
 	// multiplying it by a scalar
-  const MutableMatrix & operator*=(double a) const;
+  const MutableMatrixT<Real> & operator*=(double a) const;
 
 	// Overwrite this matrix's data with the results of
 	// dividing it by a scalar
-  const MutableMatrix & operator/=(double a) const { return operator*=(1.0 / a); }
+  const MutableMatrixT<Real> & operator/=(double a) const { return operator*=(1.0 / a); }
 
 	// The complete Dgemm specification
 	// If this matrix represents the matrix X, overwrite this matrix's
 	// data with the result of evaluating aAB+bX
 	// Note transpose is handled by calling Trans() on A or B
-  const MutableMatrix & Dgemm(double a, const Matrix & A, const Matrix & B, double b) const;
+  const MutableMatrixT<Real> & Dgemm(double a, const MatrixT<Real> & A, const MatrixT<Real> & B, double b) const;
 
 	// Overwrite every element of the matrix with the given value
-  void Assign(double val) const {
+  void Assign(Real val) const {
     if (IsVec()) Vec().Assign(val);
     else if (_trans) Trans().Assign(val);
     else for (int c = 0; c < _numC; ++c) {
@@ -689,36 +723,40 @@ public:
 
 // Subclass of MutableVector that allocates the underlying array at
 // construction and destroyes it at destruction
-class AllocatingVector : public MutableVector {
-  std::vector<double> _arr;
+template <class Real>
+class AllocatingVectorT : public MutableVectorT<Real> {
+  using MutableVectorT<Real>::_start;
+  using MutableVectorT<Real>::_len;
+
+  std::vector<Real> _arr;
   void ResetStart() {
     _start = (_arr.size() > 0) ? &_arr[0] : NULL;
   }
 
 public:
 	// Make an empty (size-0) vector
-  AllocatingVector() : MutableVector() { }
+  AllocatingVectorT() : MutableVectorT<Real>() { }
 
 	// construct a vector of length len
 	// all values are initialized to val
-  AllocatingVector(int len, double val = 0) : MutableVector(NULL, len), _arr(len, val) {
+  AllocatingVectorT(int len, Real val = 0) : MutableVectorT<Real>(NULL, len), _arr(len, val) {
     ResetStart();
   }
 
 	// construct a new vector with length and initial values taken from vec
-  AllocatingVector(const Vector & vec) : MutableVector(NULL, vec.Len()), _arr(vec.Len()) {
+  AllocatingVectorT(const VectorT<Real> & vec) : MutableVectorT<Real>(NULL, vec.Len()), _arr(vec.Len()) {
     ResetStart();
-    MutableVector::CopyFrom(vec);
+    MutableVectorT<Real>::CopyFrom(vec);
   }
 
 	// construct a new vector with length and initial values taken from vec
-  AllocatingVector(const MutableVector & vec) : MutableVector(NULL, vec.Len()), _arr(vec.Len()) {
+  AllocatingVectorT(const MutableVectorT<Real> & vec) : MutableVectorT<Real>(NULL, vec.Len()), _arr(vec.Len()) {
     ResetStart();
-    MutableVector::CopyFrom(vec);
+    MutableVectorT<Real>::CopyFrom(vec);
   }
 
 	// construct a new vector with length and initial values taken from vec
-  AllocatingVector(const AllocatingVector & vec) : MutableVector(vec), _arr(vec._arr) {
+  AllocatingVectorT(const AllocatingVectorT<Real> & vec) : MutableVectorT<Real>(vec), _arr(vec._arr) {
     ResetStart();
   }
 
@@ -733,44 +771,44 @@ public:
   }
 
 	// Change the size if necessary and copy the data from vec
-  void CopyFrom(const Vector & vec) {
+  void CopyFrom(const VectorT<Real> & vec) {
     Resize(vec.Len());
-    MutableVector::CopyFrom(vec);
+    MutableVectorT<Real>::CopyFrom(vec);
   }
 
 	// Resize to length len and assign all elements the value val
-  void Assign(int len, double val) {
+  void Assign(int len, Real val) {
     Resize(len);
-    MutableVector::Assign(val);
+    MutableVectorT<Real>::Assign(val);
   }
 
 	// assign all elements the value val
-  void Assign(double val) {
-    MutableVector::Assign(val);
+  void Assign(Real val) {
+    MutableVectorT<Real>::Assign(val);
   }
 
 	// Exchange underlying data with another AllocatingVector
 	// without any allocation or copying
-  void Swap(AllocatingVector & other) {		
+  void Swap(AllocatingVectorT<Real> & other) {		
     std::swap(_len, other._len);
     std::swap(_start, other._start);
     _arr.swap(other._arr);
   }
 
 	// Change the size if necessary and copy the data from vec
-  const Vector & operator=(const Vector & other) {
+  const VectorT<Real> & operator=(const VectorT<Real> & other) {
     CopyFrom(other);
     return *this;
   }
 
 	// Change the size if necessary and copy the data from vec
-  const Vector & operator=(const MutableVector & other) {
+  const VectorT<Real> & operator=(const MutableVectorT<Real> & other) {
     CopyFrom(other);
     return *this;
   }
 
 	// Change the size if necessary and copy the data from vec
-  const Vector & operator=(const AllocatingVector & other) {
+  const VectorT<Real> & operator=(const AllocatingVectorT<Real> & other) {
     CopyFrom(other);
     return *this;
   }
@@ -779,47 +817,54 @@ public:
 	// result of evaluating the expression expr, then overwrite
 	// the vector's data with the results of the evaluation
   template <class Expr>
-  const Vector & operator=(const Expr & expr) {
+  const VectorT<Real> & operator=(const Expr & expr) {
     Resize(expr.Len());
-    return MutableVector::operator=(expr);
+    return MutableVectorT<Real>::operator=(expr);
   }
 };
 
 // Subclass of MutableMatrix that allocates the underlying array at
 // construction and destroyes it at destruction
-class AllocatingMatrix : public MutableMatrix {
-  std::vector<double> _arr;
+template <class Real>
+class AllocatingMatrixT : public MutableMatrixT<Real> {
+  using MutableMatrixT<Real>::_start;
+  using MutableMatrixT<Real>::_numR;
+  using MutableMatrixT<Real>::_numC;
+  using MutableMatrixT<Real>::_ld;
+  using MutableMatrixT<Real>::_trans;
+
+  std::vector<Real> _arr;
   void ResetStart() {
     _start = (_arr.size() > 0) ? &_arr[0] : NULL;
   }
 
 public:
 	// creates an empty (0x0) matrix
-  AllocatingMatrix() : MutableMatrix() { }
+  AllocatingMatrixT() : MutableMatrixT<Real>() { }
 
 	// creates a matrix with the supplied number of rows and columns
 	// and initializes the value of each element to val
-  AllocatingMatrix(int numR, int numC, double val = 0) : MutableMatrix(NULL, numR, numC, numR, false), _arr(_numR * _numC, val) {
+  AllocatingMatrixT(int numR, int numC, Real val = 0) : MutableMatrixT<Real>(NULL, numR, numC, numR, false), _arr(_numR * _numC, val) {
     ResetStart();
   }
 
 	// creates a matrix whose dimensions are the same as mat
 	// and initializes the data by copying the values of mat
-  AllocatingMatrix(const Matrix & mat) : MutableMatrix(NULL, mat.NumR(), mat.NumC(), mat.NumR(), false), _arr(_numR * _numC) {
+  AllocatingMatrixT(const MatrixT<Real> & mat) : MutableMatrixT<Real>(NULL, mat.NumR(), mat.NumC(), mat.NumR(), false), _arr(_numR * _numC) {
     ResetStart();
-    MutableMatrix::CopyFrom(mat);
+    MutableMatrixT<Real>::CopyFrom(mat);
   }
 
 	// creates a matrix whose dimensions are the same as mat
 	// and initializes the data by copying the values of mat
-  AllocatingMatrix(const MutableMatrix & mat) : MutableMatrix(NULL, mat.NumR(), mat.NumC(), mat.NumR(), false), _arr(_numR * _numC) {
+  AllocatingMatrixT(const MutableMatrixT<Real> & mat) : MutableMatrixT<Real>(NULL, mat.NumR(), mat.NumC(), mat.NumR(), false), _arr(_numR * _numC) {
     ResetStart();
-    MutableMatrix::CopyFrom(mat);
+    MutableMatrixT<Real>::CopyFrom(mat);
   }
 
 	// creates a matrix whose dimensions are the same as mat
 	// and initializes the data by copying the values of mat
-  AllocatingMatrix(const AllocatingMatrix & mat) : MutableMatrix(mat), _arr(mat._arr) {
+  AllocatingMatrixT(const AllocatingMatrixT<Real> & mat) : MutableMatrixT<Real>(mat), _arr(mat._arr) {
     ResetStart();
   }
 
@@ -836,30 +881,30 @@ public:
   }
 
 	// Change the dimensions of the matrix to match the dimensions of A
-  void Resize(const Matrix & A) { Resize(A.NumR(), A.NumC()); }
+  void Resize(const MatrixT<Real> & A) { Resize(A.NumR(), A.NumC()); }
 
 	// Overwrite all entries of the matrix with val
-  void Assign(double val) {
-    MutableMatrix::Assign(val);
+  void Assign(Real val) {
+    MutableMatrixT<Real>::Assign(val);
   }
 
 	// Change the dimensions of the matrix and set all values to val
-  void Assign(int numR, int numC, double val) {
+  void Assign(int numR, int numC, Real val) {
     Resize(numR, numC);
-    MutableMatrix::Assign(val);
+    MutableMatrixT<Real>::Assign(val);
   }
 
 	// Change the dimensions of the matrix (if necessary) to match
 	// those of mat, then copy the data from mat, including an optional
 	// scaling factor
-  void CopyFrom(const Matrix & mat, double scale = 1.0) {
+  void CopyFrom(const MatrixT<Real> & mat, double scale = 1.0) {
     Resize(mat);
-    MutableMatrix::CopyFrom(mat, scale);
+    MutableMatrixT<Real>::CopyFrom(mat, scale);
   }
 
 	// Exchange underlying data with another AllocatingMatrix
 	// without any allocation or copying
-  void Swap(AllocatingMatrix & other) {		
+  void Swap(AllocatingMatrixT<Real> & other) {		
     std::swap(_numR, other._numR);
     std::swap(_numC, other._numC);
     std::swap(_start, other._start);
@@ -870,21 +915,21 @@ public:
 
 	// Change the dimensions of the matrix (if necessary) to match
 	// those of mat, then copy the data from mat
-  const Matrix & operator=(const Matrix & other) {
+  const MatrixT<Real> & operator=(const MatrixT<Real> & other) {
     CopyFrom(other);
     return *this;
   }
 
 	// Change the dimensions of the matrix (if necessary) to match
 	// those of mat, then copy the data from mat
-  const Matrix & operator=(const MutableMatrix & other) {
+  const MatrixT<Real> & operator=(const MutableMatrixT<Real> & other) {
     CopyFrom(other);
     return *this;
   }
 
 	// Change the dimensions of the matrix (if necessary) to match
 	// those of mat, then copy the data from mat
-  const Matrix & operator=(const AllocatingMatrix & other) {
+  const MatrixT<Real> & operator=(const AllocatingMatrixT<Real> & other) {
     CopyFrom(other);
     return *this;
   }
@@ -893,9 +938,9 @@ public:
 	// the dimensions of the result of evaluating expr, then overwrite
 	// the data of the matrix with the results of the evaluation
   template <class Expr>
-  const Matrix & operator=(const Expr & expr) {
+  const MatrixT<Real> & operator=(const Expr & expr) {
     Resize(expr.NumR(), expr.NumC());
-    return MutableMatrix::operator=(expr);
+    return MutableMatrixT<Real>::operator=(expr);
   }
 };
 
@@ -903,12 +948,13 @@ public:
 // where A is a matrix and a is a scalar
 // The expression is evaluated if the resulting MatScal is
 // assigned to a matrix object
-struct MatScal {
-  const Matrix A;
-  const double a;
+template <class Real>
+struct MatScalT {
+  const MatrixT<Real> A;
+  const Real a;
 
-  MatScal(const Matrix & A, const double a = 1.0) : A(A), a(a) { }
-  MatScal operator-() const { return MatScal(A, -a); }
+  MatScalT(const MatrixT<Real> & A, const Real a = 1.0) : A(A), a(a) { }
+  MatScalT<Real> operator-() const { return MatScalT<Real>(A, -a); }
 
 	// number of rows in the result
   int NumR() const { return A.NumR(); }
@@ -917,19 +963,30 @@ struct MatScal {
   int NumC() const { return A.NumC(); }
 };
 
-MatScal operator*(double b, const MatScal & ms);
-MatScal operator*(const MatScal & ms, double b);
+// Template argument deduction does not consider the implicit
+// conversions from Matrix to MatScal and Vector to VecScal, so
+// the operators below are also declared for plain matrix and
+// vector operands. Scalars are always passed as double.
+template <class Real>
+inline MatScalT<Real> operator*(double b, const MatScalT<Real> & ms) { return MatScalT<Real>(ms.A, ms.a * b); }
+template <class Real>
+inline MatScalT<Real> operator*(const MatScalT<Real> & ms, double b) { return b * ms; }
+template <class Real>
+inline MatScalT<Real> operator*(double b, const MatrixT<Real> & A) { return MatScalT<Real>(A, b); }
+template <class Real>
+inline MatScalT<Real> operator*(const MatrixT<Real> & A, double b) { return MatScalT<Real>(A, b); }
 
 
 // structure to store the parts of the expression a * A + b * B
 // where A and B are matrices and a and b are scalars
 // The expression is evaluated if the resulting MatScaledSum is
 // assigned to a matrix object
-struct MatScaledSum {
-  const Matrix A, B;
-  const double a, b;
+template <class Real>
+struct MatScaledSumT {
+  const MatrixT<Real> A, B;
+  const Real a, b;
 
-  MatScaledSum(const MatScal & ax, const MatScal & by) : A(ax.A), B(by.A), a(ax.a), b(by.a) {
+  MatScaledSumT(const MatScalT<Real> & ax, const MatScalT<Real> & by) : A(ax.A), B(by.A), a(ax.a), b(by.a) {
     assert (A.NumC() == B.NumC() && A.NumR() == B.NumR());
   }
 
@@ -940,22 +997,39 @@ struct MatScaledSum {
   int NumC() const { return A.NumC(); }
 };
 
-MatScaledSum operator+(const MatScal & ax, const MatScal & by);
-MatScaledSum operator-(const MatScal & ax, const MatScal & by);
-MatScaledSum operator*(double c, const MatScaledSum & mss);
-MatScaledSum operator*(const MatScaledSum & mss, double c);
+template <class Real>
+inline MatScaledSumT<Real> operator+(const MatScalT<Real> & ax, const MatScalT<Real> & by) { return MatScaledSumT<Real>(ax, by); }
+template <class Real>
+inline MatScaledSumT<Real> operator+(const MatrixT<Real> & A, const MatScalT<Real> & by) { return MatScaledSumT<Real>(A, by); }
+template <class Real>
+inline MatScaledSumT<Real> operator+(const MatScalT<Real> & ax, const MatrixT<Real> & B) { return MatScaledSumT<Real>(ax, B); }
+template <class Real>
+inline MatScaledSumT<Real> operator+(const MatrixT<Real> & A, const MatrixT<Real> & B) { return MatScaledSumT<Real>(A, B); }
+template <class Real>
+inline MatScaledSumT<Real> operator-(const MatScalT<Real> & ax, const MatScalT<Real> & by) { return MatScaledSumT<Real>(ax, -by); }
+template <class Real>
+inline MatScaledSumT<Real> operator-(const MatrixT<Real> & A, const MatScalT<Real> & by) { return MatScaledSumT<Real>(A, -by); }
+template <class Real>
+inline MatScaledSumT<Real> operator-(const MatScalT<Real> & ax, const MatrixT<Real> & B) { return MatScaledSumT<Real>(ax, -MatScalT<Real>(B)); }
+template <class Real>
+inline MatScaledSumT<Real> operator-(const MatrixT<Real> & A, const MatrixT<Real> & B) { return MatScaledSumT<Real>(A, -MatScalT<Real>(B)); }
+template <class Real>
+inline MatScaledSumT<Real> operator*(double c, const MatScaledSumT<Real> & mss) { return mss.A * mss.a * c + mss.B * mss.b * c; }
+template <class Real>
+inline MatScaledSumT<Real> operator*(const MatScaledSumT<Real> & mss, double c) { return c * mss; }
 
 
 // structure to store the parts of the expression a * A * B
 // where A and B are matrices and a is a scalar scalars
 // The expression is evaluated if the resulting MatMatMult
 // assigned to a matrix object
-struct MatMatMult {
-  const Matrix A;
-  const Matrix B;
-  const double a;
+template <class Real>
+struct MatMatMultT {
+  const MatrixT<Real> A;
+  const MatrixT<Real> B;
+  const Real a;
 
-  MatMatMult(const Matrix & A, const Matrix & B, double a) : A(A), B(B), a(a) { 
+  MatMatMultT(const MatrixT<Real> & A, const MatrixT<Real> & B, Real a) : A(A), B(B), a(a) { 
     assert (A.NumC() == B.NumR());
   }
 
@@ -966,40 +1040,66 @@ struct MatMatMult {
   int NumC() const { return B.NumC(); }
 };
 
-MatMatMult operator*(const MatScal & A, const MatScal & B);
-MatMatMult operator*(double b, const MatMatMult & mmm);
-MatMatMult operator*(const MatMatMult & mmm, double b);
+template <class Real>
+inline MatMatMultT<Real> operator*(const MatScalT<Real> & A, const MatScalT<Real> & B) { return MatMatMultT<Real>(A.A, B.A, A.a * B.a); }
+template <class Real>
+inline MatMatMultT<Real> operator*(const MatrixT<Real> & A, const MatScalT<Real> & B) { return MatMatMultT<Real>(A, B.A, B.a); }
+template <class Real>
+inline MatMatMultT<Real> operator*(const MatScalT<Real> & A, const MatrixT<Real> & B) { return MatMatMultT<Real>(A.A, B, A.a); }
+template <class Real>
+inline MatMatMultT<Real> operator*(const MatrixT<Real> & A, const MatrixT<Real> & B) { return MatMatMultT<Real>(A, B, 1.0); }
+template <class Real>
+inline MatMatMultT<Real> operator*(double b, const MatMatMultT<Real> & mmm) { return MatMatMultT<Real>(mmm.A, mmm.B, mmm.a * b); }
+template <class Real>
+inline MatMatMultT<Real> operator*(const MatMatMultT<Real> & mmm, double b) { return b * mmm; }
 
 
 // structure to store the parts of the expression a * v
 // where v is a vector and a is a scalar
 // The expression is evaluated if the resulting VecScal is
 // assigned to a vector object
-struct VecScal {
-  const Vector v;
-  const double a;
+template <class Real>
+struct VecScalT {
+  const VectorT<Real> v;
+  const Real a;
 
-  VecScal(const Vector & v, const double a = 1.0) : v(v), a(a) { }
-  VecScal operator-() const { return VecScal(v, -a); }
+  VecScalT(const VectorT<Real> & v, const Real a = 1.0) : v(v), a(a) { }
+  VecScalT<Real> operator-() const { return VecScalT<Real>(v, -a); }
 
 	// the length of the result 
   int Len() const { return v.Len(); }
 };
 
-VecScal operator*(double b, const VecScal & ms);
-VecScal operator*(const VecScal & ms, double b);
-double operator*(const VecScal & ax, const VecScal & by);
+template <class Real>
+inline VecScalT<Real> operator*(double b, const VecScalT<Real> & vs) { return VecScalT<Real>(vs.v, b * vs.a); }
+template <class Real>
+inline VecScalT<Real> operator*(const VecScalT<Real> & vs, double b) { return b * vs; }
+template <class Real>
+inline VecScalT<Real> operator*(double b, const VectorT<Real> & v) { return VecScalT<Real>(v, b); }
+template <class Real>
+inline VecScalT<Real> operator*(const VectorT<Real> & v, double b) { return VecScalT<Real>(v, b); }
+
+// dot product (accumulated in double precision for both element types)
+template <class Real>
+double operator*(const VecScalT<Real> & ax, const VecScalT<Real> & by);
+template <class Real>
+inline double operator*(const VectorT<Real> & x, const VecScalT<Real> & by) { return VecScalT<Real>(x) * by; }
+template <class Real>
+inline double operator*(const VecScalT<Real> & ax, const VectorT<Real> & y) { return ax * VecScalT<Real>(y); }
+template <class Real>
+inline double operator*(const VectorT<Real> & x, const VectorT<Real> & y) { return VecScalT<Real>(x) * VecScalT<Real>(y); }
 
 
 // structure to store the parts of the expression a * x + b * y
 // where x and y are vectors and a and b are scalars
 // The expression is evaluated if the resulting VecScal is
 // assigned to a vector object
-struct VecScaledSum {
-  const Vector x, y;
-  const double a, b;
+template <class Real>
+struct VecScaledSumT {
+  const VectorT<Real> x, y;
+  const Real a, b;
 
-  VecScaledSum(const VecScal & ax, const VecScal & by) : x(ax.v), y(by.v), a(ax.a), b(by.a) {
+  VecScaledSumT(const VecScalT<Real> & ax, const VecScalT<Real> & by) : x(ax.v), y(by.v), a(ax.a), b(by.a) {
     assert(x.Len() == y.Len());
   }
 
@@ -1007,8 +1107,47 @@ struct VecScaledSum {
   int Len() const { return x.Len(); }
 };
 
-VecScaledSum operator+(const VecScal & ax, const VecScal & by);
-VecScaledSum operator-(const VecScal & ax, const VecScal & by);
-VecScaledSum operator*(double c, const VecScaledSum & mss);
-VecScaledSum operator*(const VecScaledSum & mss, double c);
+template <class Real>
+inline VecScaledSumT<Real> operator+(const VecScalT<Real> & ax, const VecScalT<Real> & by) { return VecScaledSumT<Real>(ax, by); }
+template <class Real>
+inline VecScaledSumT<Real> operator+(const VectorT<Real> & x, const VecScalT<Real> & by) { return VecScaledSumT<Real>(x, by); }
+template <class Real>
+inline VecScaledSumT<Real> operator+(const VecScalT<Real> & ax, const VectorT<Real> & y) { return VecScaledSumT<Real>(ax, y); }
+template <class Real>
+inline VecScaledSumT<Real> operator+(const VectorT<Real> & x, const VectorT<Real> & y) { return VecScaledSumT<Real>(x, y); }
+template <class Real>
+inline VecScaledSumT<Real> operator-(const VecScalT<Real> & ax, const VecScalT<Real> & by) { return VecScaledSumT<Real>(ax, -by); }
+template <class Real>
+inline VecScaledSumT<Real> operator-(const VectorT<Real> & x, const VecScalT<Real> & by) { return VecScaledSumT<Real>(x, -by); }
+template <class Real>
+inline VecScaledSumT<Real> operator-(const VecScalT<Real> & ax, const VectorT<Real> & y) { return VecScaledSumT<Real>(ax, -VecScalT<Real>(y)); }
+template <class Real>
+inline VecScaledSumT<Real> operator-(const VectorT<Real> & x, const VectorT<Real> & y) { return VecScaledSumT<Real>(x, -VecScalT<Real>(y)); }
+template <class Real>
+inline VecScaledSumT<Real> operator*(double c, const VecScaledSumT<Real> & vss) { return vss.x * vss.a * c + vss.y * vss.b * c; }
+template <class Real>
+inline VecScaledSumT<Real> operator*(const VecScaledSumT<Real> & vss, double c) { return c * vss; }
+
+template <class Real>
+inline VecScalT<Real> VectorT<Real>::operator-() const { return *this * -1; }
+
+template <class Real>
+inline MatScalT<Real> MatrixT<Real>::operator-() const { return *this * -1; }
+
+
+// The Matrix and Vector names used by most of the code are the double
+// precision classes. Single precision ones are available as, e.g.,
+// MatrixT<float>; the library parts (Matrix.cc, MatrixFunc.cc) are
+// instantiated for both.
+typedef VectorT<double>           Vector;
+typedef MatrixT<double>           Matrix;
+typedef MutableVectorT<double>    MutableVector;
+typedef MutableMatrixT<double>    MutableMatrix;
+typedef AllocatingVectorT<double> AllocatingVector;
+typedef AllocatingMatrixT<double> AllocatingMatrix;
+typedef MatScalT<double>          MatScal;
+typedef MatScaledSumT<double>     MatScaledSum;
+typedef MatMatMultT<double>       MatMatMult;
+typedef VecScalT<double>          VecScal;
+typedef VecScaledSumT<double>     VecScaledSum;
 
@@ -15,44 +15,37 @@
 #  include <config.h>
 #endif
 
-#if defined(HAVE_MKL)
-#  include "mkl.h"
-#  include "mkl_lapacke.h"
-#  include "mkl_spblas.h"
-#  include "mkl_trans.h"
-#elif defined(HAVE_BLAS)
-extern "C" {            /* Assume C declarations for C++ */
-#  include <cblas.h>
-}
-#else
-#  include "miniblas.h"
-#endif
+#include "Blas.h"
 
 #include "MatrixFunc.h"
 
-double Max(const Vector & vec) {
+template <class Real>
+double Max(const VectorT<Real> & vec) {
   double max = -INFTY;
   vec.Visit([&](double x) { if (x > max) max = x; });
   return max;
 }
 
-double Sum(const Vector & vec) {
+template <class Real>
+double Sum(const VectorT<Real> & vec) {
   double sum = 0;
   vec.Visit([&](double x) { sum += x; });
   return sum;
 }
 
-double NormL1(const Vector & vec) {
-  return cblas_dasum(vec.Len(), vec.Start(), vec.Inc());
+template <class Real>
+double NormL1(const VectorT<Real> & vec) {
+  return blas_asum(vec.Len(), vec.Start(), vec.Inc());
 }
 
-double LogSumFastDestroy(MutableVector & vec) {
+template <class Real>
+double LogSumFastDestroy(MutableVectorT<Real> & vec) {
   assert (vec.Inc() == 1);
 
   double max = Max(vec);
 
-  double *s = vec.Start();
-  double *tP = vec.Start();
+  Real *s = vec.Start();
+  Real *tP = vec.Start();
   vec.Visit([&](double x) {
     double val = x - max;
     if (val > -30) *tP++ = val;
@@ -60,55 +53,55 @@ double LogSumFastDestroy(MutableVector & vec) {
 
   int nT = (int)(tP - vec.Start());
 #if HAVE_MKL
-  vdExp(nT, s, s);
+  VmlExp()(nT, s, s);
 #else
-  MutableVector temp(s, nT);
+  MutableVectorT<Real> temp(s, nT);
   temp.Apply([](double x)->double {return exp(x);});
 #endif
-  double sumExp = cblas_dasum(nT, s, 1);
+  double sumExp = blas_asum(nT, s, 1);
 
   return max + log(sumExp);
 }
 
-void LogSumWithNeg(MutableVector & vec, MutableVector & temp) {
+template <class Real>
+void LogSumWithNeg(MutableVectorT<Real> & vec, MutableVectorT<Real> & temp) {
   int len = vec.Len();
   assert (temp.Len() == len);
   assert (vec.Inc() == 1 && temp.Inc() == 1);
 #if HAVE_MKL	
-  vdAbs(len, vec.Start(), vec.Start());
+  VmlAbs()(len, vec.Start(), vec.Start());
 #else
   vec.Apply([](double x)->double {return fabs(x);});
 #endif
-#if HAVE_CBLAS_DAXPBY
-  cblas_daxpby(len, -2.0, vec.Start(), 1, 0, temp.Start(), 1);
-#else
-  cblas_dscal(len, 0, temp.Start(), 1);
-  cblas_daxpy(len, -2.0, vec.Start(), 1, temp.Start(), 1);
-#endif
+  blas_axpby(len, -2.0, vec.Start(), 1, 0, temp.Start(), 1);
 #if HAVE_MKL
-  temp.ApplyVML(vdExp, temp);
-  temp.ApplyVML(vdLog1p, temp); // note: might be faster to increment and log!
-  vdAdd(len, temp.Start(), vec.Start(), vec.Start());
+  temp.ApplyVML(VmlExp(), temp);
+  temp.ApplyVML(VmlLog1p(), temp); // note: might be faster to increment and log!
+  VmlAdd()(len, temp.Start(), vec.Start(), vec.Start());
 #else
   temp.Apply([](double x)->double {return exp(x);});
   temp.Apply([](double x)->double {return log1p(x);});
-  cblas_daxpy(len, 1.0, temp.Start(), 1, vec.Start(), 1);
+  blas_axpy(len, 1.0, temp.Start(), 1, vec.Start(), 1);
 #endif
 }
 
-void Trunc(MutableVector & vec, double maxVal) {
+template <class Real>
+void Trunc(MutableVectorT<Real> & vec, double maxVal) {
   vec.Apply([maxVal] (double x) { return (x < -maxVal) ? -maxVal : (x > maxVal) ? maxVal : x; });
 }
 
-void Shrink(MutableVector & vec, double d) {
+template <class Real>
+void Shrink(MutableVectorT<Real> & vec, double d) {
   vec.Apply([d](double x) { return (x>d) ? x-d : (x<-d) ? x+d : 0; });
 }
 
-double Norm(const Vector & vec) {
-  return cblas_dnrm2(vec.Len(), vec.Start(), vec.Inc());
+template <class Real>
+double Norm(const VectorT<Real> & vec) {
+  return blas_nrm2(vec.Len(), vec.Start(), vec.Inc());
 }
 
-double Decay(MutableVector vec, double stepSize, double decayRate, int decayType) {
+template <class Real>
+double Decay(MutableVectorT<Real> vec, double stepSize, double decayRate, int decayType) {
   if (decayType == 2) {
     double val = 0.5 * decayRate * vec * vec;
     vec *= (1.0 - stepSize * decayRate);
@@ -120,11 +113,13 @@ double Decay(MutableVector vec, double stepSize, double decayRate, int decayType
   }
 }
 
-void Print(const Vector & vec) {
+template <class Real>
+void Print(const VectorT<Real> & vec) {
   vec.Visit([] (double x) { cout << x << endl; });
 }
 
-int ArgMax(const Vector & vec) {
+template <class Real>
+int ArgMax(const VectorT<Real> & vec) {
   double max = -INFTY;
   int argMax = -1;
   int i = 0;
@@ -132,4 +127,18 @@ int ArgMax(const Vector & vec) {
   return argMax;
 }
 
-
+#define INSTANTIATE_MATRIX_FUNC(Real)                                    \
+  template double Max(const VectorT<Real> &);                            \
+  template double Sum(const VectorT<Real> &);                            \
+  template double NormL1(const VectorT<Real> &);                         \
+  template double LogSumFastDestroy(MutableVectorT<Real> &);             \
+  template void LogSumWithNeg(MutableVectorT<Real> &, MutableVectorT<Real> &); \
+  template void Trunc(MutableVectorT<Real> &, double);                   \
+  template void Shrink(MutableVectorT<Real> &, double);                  \
+  template double Norm(const VectorT<Real> &);                           \
+  template double Decay(MutableVectorT<Real>, double, double, int);      \
+  template void Print(const VectorT<Real> &);                            \
+  template int ArgMax(const VectorT<Real> &);
+
+INSTANTIATE_MATRIX_FUNC(double)
+INSTANTIATE_MATRIX_FUNC(float)
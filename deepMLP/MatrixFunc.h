@@ -15,47 +15,61 @@
 #include "Globals.h"
 #include "Matrix.h"
 
+// The functions are templates on the element type of the vectors
+// (instantiated in MatrixFunc.cc for double and float). Scalar
+// arguments and results are double in either case.
+
 // returns the maximally valued element
-double Max(const Vector & vec);
+template <class Real>
+double Max(const VectorT<Real> & vec);
 
 // Computes the log sum of the entries of vec
 // log sum_i exp(x_i)
 // in a particularly fast and stable way that
 // does not require temporary storage, but
 // overwrites (destroys) the original data in vec
-double LogSumFastDestroy(MutableVector & vec);
+template <class Real>
+double LogSumFastDestroy(MutableVectorT<Real> & vec);
 
 // Replaces each element x_i of the vector with
 // log(exp(x_i) + exp(-x_i))
 // in a particularly fast and stable way requiring
 // temporary storage in the vector temp
-void LogSumWithNeg(MutableVector & vec, MutableVector & temp);
+template <class Real>
+void LogSumWithNeg(MutableVectorT<Real> & vec, MutableVectorT<Real> & temp);
 
 // Projection onto L-infinity ball of radius maxVal.
 // Replaces any element of vec that exceeds maxVal in absolute value
 // with the signed value maxVal
 // maxVal is assumed to be positive
-void Trunc(MutableVector & vec, double maxVal);
+template <class Real>
+void Trunc(MutableVectorT<Real> & vec, double maxVal);
 
 // For each element x, if x is larger than d in magnitude, reduces
 // the value by d. If x is smaller than d, it is set to zero.
 // d is assumed to be positive.
-void Shrink(MutableVector & vec, double d);
+template <class Real>
+void Shrink(MutableVectorT<Real> & vec, double d);
 
 // Returns the L2 norm of the vector
-double Norm(const Vector & vec);
+template <class Real>
+double Norm(const VectorT<Real> & vec);
 
 // Print the values of vector to the console
-void Print(const Vector & vec);
+template <class Real>
+void Print(const VectorT<Real> & vec);
 
 // Return the index of the maximal element
-int ArgMax(const Vector & vec);
+template <class Real>
+int ArgMax(const VectorT<Real> & vec);
 
 // Returns the L1 norm of the vector
-double NormL1(const Vector & vec);
+template <class Real>
+double NormL1(const VectorT<Real> & vec);
 
 // Returns the sum of the vector elements
-double Sum(const Vector & vec);
+template <class Real>
+double Sum(const VectorT<Real> & vec);
 
 // L1 or L2 weight decay
 // takes a step in the direction of the negative (sub-)gradient
@@ -64,4 +78,5 @@ double Sum(const Vector & vec);
 // and returns the value of that function
 // For L2, this is functionally equivalent to multiplication by
 // (1 - stepSize * decayRate)
-double Decay(MutableVector vec, double stepSize, double decayRate, int decayType = 2);
+template <class Real>
+double Decay(MutableVectorT<Real> vec, double stepSize, double decayRate, int decayType = 2);
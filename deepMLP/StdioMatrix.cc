@@ -1,4 +1,5 @@
 
 #include "StdioMatrix.h"
 
-double StdioMatrix::dAt;
+template class StdioMatrixT<double>;
+template class StdioMatrixT<float>;
@@ -36,27 +36,41 @@
 // The copy ctor copys the copyee's backing file in chunks of this size (# of floats / chunk)
 #define FILE_COPY_BUFFER_SIZE ((1<<20)/sizeof(float))
 
-class StdioMatrix : public FileBackedMatrix {
-  friend class MutableVector;
+template <class Real>
+class StdioMatrixT : public FileBackedMatrixT<Real> {
+  friend class MutableVectorT<Real>;
+
+  using MatrixT<Real>::_start;
+  using MatrixT<Real>::_numR;
+  using MatrixT<Real>::_numC;
+  using MatrixT<Real>::_ld;
+  using MatrixT<Real>::_trans;
+  using FileBackedMatrixBase::backed;
+  using FileBackedMatrixBase::fileName;
+  using FileBackedMatrixBase::file_length;
+  using FileBackedMatrixBase::ref_count;
+  using FileBackedMatrixBase::tempname;
+  using FileBackedMatrixBase::dmlpTempDir;
 
   FILE   *f;                               // backing file descriptor
 
   static float buf[FILE_COPY_BUFFER_SIZE]; // for copying files in copy ctor
-  static double at;                        // To hold ::At() result
 
-  mutable vector<double> doubleBuf; // The backing file stores floats, so we need
-  mutable vector<float>  floatBuf;  // space to convert them to doubles. And vice versa.
+  mutable vector<Real>   realBuf;   // The backing file stores floats, so we need
+  mutable vector<float>  floatBuf;  // space to convert them to Real. And vice versa.
 
 public:
 
-  StdioMatrix() : FileBackedMatrix(), doubleBuf(0), floatBuf(0) { }
+  using MatrixT<Real>::Trans;
+
+  StdioMatrixT() : FileBackedMatrixT<Real>(), realBuf(0), floatBuf(0) { }
 
   // Just alias mat, not file-backed...
-  StdioMatrix(const Matrix & mat) : FileBackedMatrix(mat), doubleBuf(0), floatBuf(0) { }
+  StdioMatrixT(const MatrixT<Real> & mat) : FileBackedMatrixT<Real>(mat), realBuf(0), floatBuf(0) { }
 
   // Create a new file-backed matrix. Put in values with PutCols
-  StdioMatrix(int numR, int numC, int ld, bool trans=false) 
-    : FileBackedMatrix(numR, numC, ld, trans), doubleBuf(0), floatBuf(0)
+  StdioMatrixT(int numR, int numC, int ld, bool trans=false) 
+    : FileBackedMatrixT<Real>(numR, numC, ld, trans), realBuf(0), floatBuf(0)
   {
     // O_EXCL so it fails if we didn't create the file
     int fd = open(fileName, O_RDWR|O_CREAT|O_EXCL, S_IRWXU);
@@ -89,9 +103,9 @@ public:
 
 
   // deep copy ctor - create a new backing file and copy that's contents into it
-  StdioMatrix(StdioMatrix const &that) 
-    : FileBackedMatrix(NULL, that._numR, that._numC, that._ld, that._trans), 
-      doubleBuf(0), floatBuf(0)
+  StdioMatrixT(StdioMatrixT<Real> const &that) 
+    : FileBackedMatrixT<Real>(NULL, that._numR, that._numC, that._ld, that._trans), 
+      realBuf(0), floatBuf(0)
   { 
     file_length = that.file_length;
     if (that.backed) {
@@ -155,7 +169,7 @@ public:
 
 
   // shallow copy - just alias the backing file
-  StdioMatrix & operator= (const StdioMatrix &rhs) {
+  StdioMatrixT<Real> & operator= (const StdioMatrixT<Real> &rhs) {
     _numR  = rhs._numR;
     _numC  = rhs._numC;
     _ld    = rhs._ld;
@@ -203,7 +217,7 @@ public:
   }
 
 
-  ~StdioMatrix() {
+  ~StdioMatrixT() {
     if (backed) {
       string fn(fileName);
       if (ref_count[fn] == 1) {
@@ -231,12 +245,12 @@ public:
 
   // Copy Matrix m into this, starting at column destCol
   void PutCols(Matrix const &m, int destCol) {
-    PutCols(const_cast<double *>(m.Start()), m.NumC(), m.NumR(), m.Ld(), destCol);
+    PutCols(const_cast<Real *>(m.Start()), m.NumC(), m.NumR(), m.Ld(), destCol);
   }
 #endif
 
   // Copy Matrix(src, numRows, numCols, srcLd) into this, starting at column destCol
-  void PutCols(double *src, int numCols, int numRows, int srcLd, int destCol) {
+  void PutCols(Real *src, int numCols, int numRows, int srcLd, int destCol) {
     assert(backed);
     assert(destCol + numCols <= _numC);
     assert(numRows == _ld);
@@ -250,7 +264,7 @@ public:
       error("ERROR: failed to seek in temporary file '%s'\n", fileName);
     }
     // write input matrix column by column (converting to float)
-    double *end = src + numCols * srcLd;
+    Real *end = src + numCols * srcLd;
     do {
       for (int i=0; i < numRows; i+=1)
 	floatBuf[i] = (float)src[i];
@@ -263,9 +277,9 @@ public:
     fflush(f);
   }
   
-  static double dAt; // gotta convert float to double
-  virtual const double & At(int r, int c) const {
-    if (!backed) return Matrix::At(r,c);
+  static Real dAt; // gotta convert float to Real
+  virtual const Real & At(int r, int c) const {
+    if (!backed) return MatrixT<Real>::At(r,c);
     if (_trans) std::swap(r, c);
     if (r < 0) r += _numR;
     if (c < 0) c += _numC;
@@ -282,13 +296,13 @@ public:
       perror(fileName);
       error("ERROR: failed to read element from temporary file '%s'\n", fileName);
     }
-    dAt = (double) element;
+    dAt = (Real) element;
     return dAt;
   }
 
-  // seek to requested column, convert it to double
-  Vector GetCol(int c) {
-    if (!backed) return Matrix::GetCol(c);
+  // seek to requested column, convert it to Real
+  VectorT<Real> GetCol(int c) {
+    if (!backed) return MatrixT<Real>::GetCol(c);
     if (_trans) return Trans().GetRow(c);  // fails if file backed since not O(1) space
 
     if (c < 0) c += _numC;
@@ -305,14 +319,14 @@ public:
       perror(fileName);
       error("ERROR: StdioMatrix::GetCol() failed to read from temporary file '%s'\n", fileName);
     }
-    if (doubleBuf.size() < (size_t)_numR) doubleBuf.resize(_numR);
-    for (int i=0; i < _numR; i+=1) doubleBuf[i] = (double)floatBuf[i];
-    return Vector(&doubleBuf[0], _numR);
+    if (realBuf.size() < (size_t)_numR) realBuf.resize(_numR);
+    for (int i=0; i < _numR; i+=1) realBuf[i] = (Real)floatBuf[i];
+    return VectorT<Real>(&realBuf[0], _numR);
   }
 
-  // seek to requested submatrix, convert to double
-  virtual Matrix SubMatrix(int beginRow, int endRow, int beginCol, int endCol) const {
-    if (!backed) return Matrix::SubMatrix(beginRow, endRow, beginCol, endCol);
+  // seek to requested submatrix, convert to Real
+  virtual MatrixT<Real> SubMatrix(int beginRow, int endRow, int beginCol, int endCol) const {
+    if (!backed) return MatrixT<Real>::SubMatrix(beginRow, endRow, beginCol, endCol);
 
     if (_trans) {
       std::swap(beginRow, beginCol);
@@ -332,7 +346,7 @@ public:
     size_t numInputs = numCols * (size_t)_ld;
     size_t numOutputs= numCols * numRows;
     if (floatBuf.size()  < numInputs) floatBuf.resize(numInputs);
-    if (doubleBuf.size() < numOutputs) doubleBuf.resize(numOutputs);
+    if (realBuf.size() < numOutputs) realBuf.resize(numOutputs);
 
     off_t dest = ((off_t)beginCol * (off_t)_ld + (off_t)beginRow) * sizeof(float);
     if (FM_SEEK(f, dest, SEEK_SET)) {
@@ -348,13 +362,18 @@ public:
     unsigned i = 0;
     for (size_t c=0; c < numCols; c+=1) {
       for (size_t r=0; r < numRows; r+=1) {
-	doubleBuf[i] = (double) (fp[r]);
+	realBuf[i] = (Real) (fp[r]);
 	i += 1;
       }
       fp += _ld;
     }
-    return Matrix(&doubleBuf[0], numRows, numCols, numRows, _trans);
+    return MatrixT<Real>(&realBuf[0], numRows, numCols, numRows, _trans);
   }
 
-}; 
+};
+
+template <class Real> float StdioMatrixT<Real>::buf[FILE_COPY_BUFFER_SIZE];
+template <class Real> Real StdioMatrixT<Real>::dAt;
+
+typedef StdioMatrixT<double> StdioMatrix; 
   
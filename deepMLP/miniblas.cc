@@ -78,4 +78,70 @@ cblas_dnrm2(int n, double const *x, int incx) {
   } while (x != end);
   return nrm;
 }
+
+void
+cblas_scopy(int n, float const* x, int incx, float *y, int incy) {
+  float const *end = x + n * incx;
+  do {
+    *y = *x;
+    x+=incx; y+=incy;
+  } while (x != end);
+}
+
+void
+cblas_sscal(int n, float alpha, float *x, int incx) {
+  float *end = x + n * incx;
+  do {
+    *x = alpha * *x;
+    x+=incx;
+  } while ( x != end);
+}
+
+void
+cblas_saxpy(int n, float alpha, float const *x, int incx, float *y, int incy) {
+  float const *end = x + n * incx;
+  do {
+    *y = alpha * *x + *y;
+    x+=incx; y+=incy;
+  } while (x != end);
+}
+
+float
+cblas_sdot(int n, float const *x, int incx, float const *y, int incy) {
+  return (float) cblas_dsdot(n, x, incx, y, incy);
+}
+
+// dot product of float vectors accumulated in double precision
+double
+cblas_dsdot(int n, float const *x, int incx, float const *y, int incy) {
+  double ddot = 0.0;
+  float const *end = x + n * incx; 
+  do {
+    ddot += (double) *x * *y;
+    x+=incx; y+=incy;
+  } while (x != end);
+  return ddot;
+}
+
+float
+cblas_sasum(int n, float const *x, int incx) {
+  float const *end = x + n * incx;
+  double sum = 0.0;
+  do {
+    sum += fabs(*x);
+    x += incx;
+  } while (x != end);
+  return (float) sum;
+}
+
+float
+cblas_snrm2(int n, float const *x, int incx) {
+  float const *end = x + n * incx;
+  double nrm = 0.0;
+  do {
+    nrm += (double) *x * *x;
+    x += incx;
+  } while (x != end);
+  return (float) nrm;
+}
 #endif
@@ -32,4 +32,21 @@ double cblas_dasum(int n, double const *x, int incx);
 
 double cblas_dnrm2(int n, double const *x, int incx);
 
+// single precision versions for the float instantiations of the
+// Matrix classes
+
+void cblas_scopy(int n, float const* x, int incx, float *y, int incy);
+
+void cblas_sscal(int n, float alpha, float *x, int incx);
+
+void cblas_saxpy(int n, float alpha, float const *x, int incx, float *y, int incy);
+
+float cblas_sdot(int n, float const *x, int incx, float const *y, int incy);
+
+double cblas_dsdot(int n, float const *x, int incx, float const *y, int incy);
+
+float cblas_sasum(int n, float const *x, int incx);
+
+float cblas_snrm2(int n, float const *x, int incx);
+
 #endif
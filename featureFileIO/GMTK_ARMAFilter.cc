@@ -183,15 +183,24 @@ ARMAFilter::localTransform(Data32 const *inputSubMatrix,
 
   for ( ; cnt < inputDescription.requestedCount; cnt += 1) {
     if (numFrames == 0 || inputDescription.firstFrame + cnt < numFrames - order) {
+      // The recursion is serial in time, but each step is a handful
+      // of contiguous vector operations over the features. The sums
+      // are accumulated in the same order as the scalar recursion.
+      float *x = floatOut + stride * cnt;
+      float *remembered = output + numFloats * outputIndex;
       for (unsigned i = 0; i < numContinuous; i+=1) {
-	float x = outputSum[i] + floatIn[stride * cnt + i];
-	for (unsigned tau=1; tau <= order; tau+=1) {
-	  x += floatIn[stride * (cnt + tau) + i];
+	x[i] = outputSum[i] + floatIn[stride * cnt + i];
+      }
+      for (unsigned tau=1; tau <= order; tau+=1) {
+	float const *future = floatIn + stride * (cnt + tau);
+	for (unsigned i = 0; i < numContinuous; i+=1) {
+	  x[i] += future[i];
 	}
-	x /= (2*order + 1);
-	floatOut[stride * cnt + i] = x;
-	outputSum[i] = outputSum[i] - output[numFloats * outputIndex + i] + x;
-	output[numFloats * outputIndex + i] = x;
+      }
+      for (unsigned i = 0; i < numContinuous; i+=1) {
+	x[i] /= (2*order + 1);
+	outputSum[i] = outputSum[i] - remembered[i] + x[i];
+	remembered[i] = x[i];
       }
       firstRememberedFrame += 1;
       outputIndex = (outputIndex + 1) % order;
@@ -65,6 +65,7 @@ class ARMAFilter: public Filter {
       error("ERROR: In applying tranforms: ARMA filter order (%d) has to be less than "
 	    "half the number of frames (%d).", order, numFrames);
 
+    firstRememberedFrame = 0;
     outputIndex = 0;
     numRemembered = 0;
     initialized = false;
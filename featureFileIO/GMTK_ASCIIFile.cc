@@ -24,6 +24,8 @@
 
 #include "file_utils.h"
 #include "GMTK_ASCIIFile.h"
+#include "GMTK_CookedCacheFile.h"
+#include "GMTK_ASCIIScanner.h"
 
 using namespace std;
 
@@ -86,16 +88,19 @@ ASCIIFile::ASCIIFile(const char *name, unsigned nfloats, unsigned nints,
 }
 
 
+string
+ASCIIFile::dataIdentity() {
+  return CookedCacheFile::listIdentity(numFileNames, dataNames);
+}
+
+
 // Begin sourcing data from the requested segment.
 // Must be called before any other operations are performed on a segment.
 // Loads the segment's data into the buffer and set the # of frames.
 bool
 ASCIIFile::openSegment(unsigned seg) {
   assert(seg < numFileNames);
-  bool found_new_line=true;
   char *fname = dataNames[seg];
-  unsigned n_samples = 0;
-  char ch;
   FILE *curDataFile = NULL;
 
   if (fname == NULL) {
@@ -110,65 +115,39 @@ ASCIIFile::openSegment(unsigned seg) {
     return false;
   }
   
-  // Read through the segment once to determine its length, then again 
-  // to actually load the data.
-
-  // For ASCII, newline is record delimiter - additional or missing nl's
-  // will cause error messages.
-  int tmp;
-  while ((tmp = fgetc(curDataFile)) != EOF) {
-    ch=tmp;
-    if(ch=='\n') { found_new_line=true; continue;}
-    if(ch==CPP_DIRECTIVE_CHAR) { found_new_line=false; continue; }
-    if(found_new_line) {
-      found_new_line=false;
-      n_samples++;
+  // Read the frames in one pass, growing the buffer as needed. A frame
+  // starts on a new line, but (as with fscanf) its values may span lines.
+  ASCIIScanner in(curDataFile);
+  unsigned s = 0;
+  while (!in.atEOF()) {
+    // consume CPP special directives if any
+    if (in.peek() == CPP_DIRECTIVE_CHAR) {
+      in.skipLine();
+      continue;
     }
-  }
-  closeCPPableFile(curDataFile, cppIfAscii);
-  curDataFile = openCPPableFile(fname, cppIfAscii, cppCommandOptions);
-  if (curDataFile == NULL) {
-    warning("ASCIIFile::openSegment: Can't open '%s' for input\n",fname);
-    return false;
-  }
-
-  nFrames = n_samples;
-  if (n_samples > bufferSize) {
-    buffer = (Data32 *) realloc(buffer, n_samples * _numFeatures * sizeof(Data32));
-    bufferSize = n_samples;
-  }
-  Data32 *dest = buffer;
-
-  int lineNum=0;
-
-  // consume CPP special directives if any
-#ifdef PIPE_ASCII_FILES_THROUGH_CPP
-  if(cppIfAscii) {
-    while((tmp=fgetc(curDataFile))==CPP_DIRECTIVE_CHAR) {
-      while((tmp=fgetc(curDataFile))!='\n');
-      lineNum++;
+    if (s >= bufferSize) {
+      unsigned newSize = bufferSize ? 2 * bufferSize : 1024;
+      buffer = (Data32 *) realloc(buffer, newSize * _numFeatures * sizeof(Data32));
+      if (!buffer)
+	error("ERROR: ASCIIFile::openSegment: unable to allocate memory for %u frames\n", newSize);
+      bufferSize = newSize;
     }
-    ungetc(tmp,curDataFile);
-  }
-#endif
-
-  // could be made a bit more efficient since we check whether
-  // num_floats and num_ints > 0 for each frame.
-  for(unsigned s=0; s < n_samples; ++s) {
-    lineNum++;
+    Data32 *dest = buffer + s * _numFeatures;
     for (unsigned n = 0; n < _numContinuousFeatures; n+=1, dest+=1) {
-      if (fscanf(curDataFile,"%e", (float *)(dest)) != 1) {
+      if (!in.readFloat(*(float *)dest)) {
 	error("ERROR: ASCIIFile::openSegment: observation file %u '%s' segment %u: couldn't read %u'th item in frame %u\n",
 	      observationFileNum, observationFileName, seg, n, s);
       }
     }
     for (unsigned n = 0; n < _numDiscreteFeatures; n+=1, dest+=1) {
-      if (fscanf(curDataFile,"%d", (Int32 *)(dest)) != 1) {
+      if (!in.readInt(*(Int32 *)dest)) {
 	error("ERROR: ASCIIFile::openSegment: observation file %u '%s' segment %u: couldn't read %u'th item in frame %u\n",
 	      observationFileNum, observationFileName, seg, _numContinuousFeatures+n, s);
       }
     }
+    s += 1;
   }
+  nFrames = s;
   closeCPPableFile(curDataFile, cppIfAscii);
   return true;
 }
@@ -43,7 +43,7 @@ class ASCIIFile: public ObservationFile {
   char     **dataNames;  // pointers to individual filenames
 
   Data32    *buffer;     // data for current segment
-  unsigned   bufferSize; // in Data32s
+  unsigned   bufferSize; // in frames
 
 
   // for writable files
@@ -149,6 +149,9 @@ class ASCIIFile: public ObservationFile {
   // The number of available segments.
   unsigned numSegments() {return numFileNames;}
 
+  // The identities of the listed data files.
+  string dataIdentity();
+
   // Begin sourcing data from the requested segment.
   // Must be called before any other operations are performed on a segment.
   bool openSegment(unsigned seg);
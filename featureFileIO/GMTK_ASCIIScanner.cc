@@ -0,0 +1,270 @@
+/*
+ * GMTK_ASCIIScanner.cc
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+
+#include "error.h"
+#include "general.h"
+
+#include "GMTK_ASCIIScanner.h"
+
+// No number we care about is longer than this, so the scanner makes
+// sure at least this many characters are buffered before parsing.
+#define MAX_NUMBER_LENGTH 128
+
+// largest number of significant digits held exactly in a double
+#define MAX_FAST_DIGITS 15
+
+static double const exactPowersOf10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define MAX_EXACT_POWER 22
+
+
+static inline bool
+isDigit(char c) {
+  return '0' <= c && c <= '9';
+}
+
+
+char const *
+parseFloat(char const *s, float &x) {
+  char const *p = s;
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = *p == '-';
+    p += 1;
+  }
+
+  // Collect up to MAX_FAST_DIGITS significant digits into an exactly
+  // represented double. Anything unusual goes to strtof().
+  double mantissa = 0.0;
+  int    digits = 0;       // significant digits in mantissa
+  int    exponent = 0;     // decimal exponent to apply to mantissa
+  bool   any = false;      // saw at least one digit
+  bool   slow = false;     // need strtof()
+  for ( ; isDigit(*p); p+=1) {
+    any = true;
+    if (digits == 0 && *p == '0') continue;  // leading zero
+    if (digits < MAX_FAST_DIGITS) {
+      mantissa = mantissa * 10.0 + (*p - '0');
+      digits += 1;
+    } else {
+      slow = true;
+    }
+  }
+  if (*p == '.') {
+    p += 1;
+    for ( ; isDigit(*p); p+=1) {
+      any = true;
+      if (digits == 0 && *p == '0') {
+	exponent -= 1;
+	continue;
+      }
+      if (digits < MAX_FAST_DIGITS) {
+	mantissa = mantissa * 10.0 + (*p - '0');
+	digits += 1;
+	exponent -= 1;
+      } else {
+	slow = true;
+      }
+    }
+  }
+  if (!any) {
+    // inf, nan, hex floats, or not a number at all
+    char *end;
+    float y = strtof(s, &end);
+    if (end != s) x = y;
+    return end;
+  }
+  if (*p == 'e' || *p == 'E') {
+    char const *q = p + 1;
+    bool negExp = false;
+    if (*q == '-' || *q == '+') {
+      negExp = *q == '-';
+      q += 1;
+    }
+    if (isDigit(*q)) {
+      int e = 0;
+      for ( ; isDigit(*q); q+=1) {
+	if (e < 10000) e = e * 10 + (*q - '0');
+      }
+      exponent += negExp ? -e : e;
+      p = q;
+    } // else the 'e' isn't part of the number
+  }
+
+  if (!slow) {
+    if (mantissa == 0.0) {
+      x = negative ? -0.0f : 0.0f;
+      return p;
+    }
+    if (-MAX_EXACT_POWER <= exponent && exponent <= MAX_EXACT_POWER) {
+      // both operands are exact, so d is the correctly rounded double
+      double d = exponent < 0 ? mantissa / exactPowersOf10[-exponent]
+	                      : mantissa * exactPowersOf10[exponent];
+      if (FLT_MIN <= d && d <= FLT_MAX) {
+	// Rounding d to float gives the correctly rounded float unless d
+	// landed exactly halfway between two floats (double rounding).
+	float f = (float) d;
+	int e;
+	frexp(d, &e);
+	if (fabs(d - (double) f) != ldexp(1.0, e - 25)) {
+	  x = negative ? -f : f;
+	  return p;
+	}
+      }
+    }
+  }
+  char *end;
+  x = strtof(s, &end);
+  return end;
+}
+
+
+char const *
+parseInt(char const *s, Int32 &x) {
+  char const *p = s;
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = *p == '-';
+    p += 1;
+  }
+  if (!isDigit(*p)) return s;
+  Uint32 v = 0;
+  for ( ; isDigit(*p); p+=1)
+    v = v * 10 + (Uint32)(*p - '0');
+  x = (Int32)(negative ? 0U - v : v);
+  return p;
+}
+
+
+ASCIIScanner::ASCIIScanner(FILE *f, unsigned bufSize)
+  : f(f), bufSize(bufSize), pos(0), len(0), eof(false)
+{
+  assert(f);
+  if (this->bufSize < 2 * MAX_NUMBER_LENGTH) this->bufSize = 2 * MAX_NUMBER_LENGTH;
+  buf = new char[this->bufSize + 1];
+  buf[0] = 0;
+  base = gmtk_ftell(f);
+  if (base < 0) base = 0;  // a pipe
+}
+
+
+ASCIIScanner::~ASCIIScanner() {
+  delete [] buf;
+}
+
+
+void
+ASCIIScanner::fill(unsigned n) {
+  if (len - pos >= n || eof) return;
+  memmove(buf, buf + pos, len - pos);
+  base += pos;
+  len -= pos;
+  pos = 0;
+  while (len < n && !eof) {
+    size_t nread = fread(buf + len, 1, bufSize - len, f);
+    if (nread == 0) eof = true;
+    len += nread;
+  }
+  buf[len] = 0;
+}
+
+
+void
+ASCIIScanner::skipSpace(bool newlines) {
+  for (;;) {
+    if (pos == len) {
+      fill(1);
+      if (pos == len) return;
+    }
+    char c = buf[pos];
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v' || (newlines && c == '\n'))
+      pos += 1;
+    else
+      return;
+  }
+}
+
+
+bool
+ASCIIScanner::readFloat(float &x) {
+  skipSpace(true);
+  fill(MAX_NUMBER_LENGTH);
+  char const *start = buf + pos;
+  char const *end = parseFloat(start, x);
+  if (end == start) return false;
+  pos += end - start;
+  return true;
+}
+
+
+bool
+ASCIIScanner::readInt(Int32 &x) {
+  skipSpace(true);
+  fill(MAX_NUMBER_LENGTH);
+  char const *start = buf + pos;
+  char const *end = parseInt(start, x);
+  if (end == start) return false;
+  pos += end - start;
+  return true;
+}
+
+
+void
+ASCIIScanner::skipLine() {
+  for (;;) {
+    char *nl = (char *) memchr(buf + pos, '\n', len - pos);
+    if (nl) {
+      pos = (nl - buf) + 1;
+      return;
+    }
+    pos = len;
+    fill(1);
+    if (pos == len) return;
+  }
+}
+
+
+bool
+ASCIIScanner::atEOF() {
+  skipSpace(true);
+  return pos == len;
+}
+
+
+int
+ASCIIScanner::peek() {
+  fill(1);
+  return pos < len ? (unsigned char) buf[pos] : EOF;
+}
+
+
+bool
+ASCIIScanner::seek(gmtk_off_t off) {
+  if (gmtk_fseek(f, off, SEEK_SET) != 0) return false;
+  base = off;
+  pos = len = 0;
+  eof = false;
+  buf[0] = 0;
+  return true;
+}
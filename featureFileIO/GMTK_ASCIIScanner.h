@@ -0,0 +1,86 @@
+/*
+ * GMTK_ASCIIScanner.h
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#ifndef GMTK_ASCIISCANNER_H
+#define GMTK_ASCIISCANNER_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include "machine-dependent.h"
+#include "file_utils.h"
+
+
+// Parse a float from the NUL or non-numeric terminated string at s,
+// like strtof(). Returns a pointer to the first unused character, or
+// s if no number could be parsed. Plain decimal numbers with up to 15
+// significant digits (which covers everything written with %e or %f)
+// are converted without going through the C library; the result is
+// correctly rounded, so it is identical to what fscanf("%e") gives.
+char const *parseFloat(char const *s, float &x);
+
+// Parse a decimal int like strtol(), with the same return convention
+char const *parseInt(char const *s, Int32 &x);
+
+
+// A replacement for fscanf() for reading whitespace separated numbers
+// from ASCII observation files. The input is read in large blocks and
+// the numbers are parsed in place, which avoids the per-call format
+// parsing and stream locking overhead of the stdio scanning functions.
+// It works on pipes (e.g., ASCII files run through cpp) as well as on
+// regular files.
+
+class ASCIIScanner {
+
+  FILE      *f;
+  char      *buf;
+  unsigned   bufSize;   // capacity of buf, not counting the sentinel
+  unsigned   pos;       // next unread character
+  unsigned   len;       // # of valid characters in buf
+  bool       eof;       // nothing more to read from f
+  gmtk_off_t base;      // offset in f of buf[0]
+
+  // make sure at least n characters are available after pos (unless
+  // the end of the file is reached first)
+  void fill(unsigned n);
+
+  // skip spaces and tabs (and newlines if newlines is true)
+  void skipSpace(bool newlines);
+
+ public:
+
+  ASCIIScanner(FILE *f, unsigned bufSize = 1024 * 1024);
+  ~ASCIIScanner();
+
+  // Read the next number, skipping leading whitespace (including
+  // newlines). Returns false if no number could be read.
+  bool readFloat(float &x);
+  bool readInt(Int32 &x);
+
+  // Skip the rest of the current line, including the newline
+  void skipLine();
+
+  // Skip whitespace and return true iff the end of the file is reached
+  bool atEOF();
+
+  // Return the next character without consuming it (EOF at the end)
+  int peek();
+
+  // Offset in the file of the next unread character
+  gmtk_off_t offset() { return base + pos; }
+
+  // Continue reading at offset off (f must be seekable)
+  bool seek(gmtk_off_t off);
+};
+
+#endif
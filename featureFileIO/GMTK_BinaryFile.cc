@@ -25,6 +25,7 @@
 
 #include "file_utils.h"
 #include "GMTK_BinaryFile.h"
+#include "GMTK_CookedCacheFile.h"
 
 using namespace std;
 
@@ -225,6 +226,12 @@ BinaryFile::endOfSegment() {
 }
 
 
+string
+BinaryFile::dataIdentity() {
+  return CookedCacheFile::listIdentity(numFileNames, dataNames);
+}
+
+
 // Begin sourcing data from the requested segment.
 // Must be called before any other operations are performed on a segment.
 bool
@@ -146,6 +146,9 @@ class BinaryFile: public ObservationFile {
   // The number of available segments.
   unsigned numSegments() {return numFileNames;}
 
+  // The identities of the listed data files.
+  string dataIdentity();
+
   // Begin sourcing data from the requested segment.
   // Must be called before any other operations are performed on a segment.
   bool openSegment(unsigned seg);
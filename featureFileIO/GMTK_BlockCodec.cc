@@ -0,0 +1,396 @@
+/*
+ * GMTK_BlockCodec.cc
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#if defined(__F16C__)
+#  include <immintrin.h>
+#endif
+
+#include <vector>
+using namespace std;
+
+#include "GMTK_BlockCodec.h"
+
+#define MIN_MATCH   4
+#define MAX_OFFSET  65535
+#define HASH_LOG    14
+#define HASH_SIZE   (1 << HASH_LOG)
+#define NO_POS      0xffffffffU
+
+static inline Uint32
+read32(unsigned char const *p) {
+  Uint32 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline unsigned
+hash32(Uint32 v) {
+  return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+// write the extension bytes of a literal or match length >= 15
+static inline unsigned char *
+putLength(unsigned char *op, size_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (unsigned char) len;
+  return op;
+}
+
+static unsigned char *
+putSequence(unsigned char *op, unsigned char const *lit, size_t litLen,
+	    size_t offset, size_t matchLen)
+{
+  unsigned char *token = op++;
+  unsigned char t = (unsigned char)((litLen < 15 ? litLen : 15) << 4);
+  if (litLen >= 15) op = putLength(op, litLen - 15);
+  memcpy(op, lit, litLen);
+  op += litLen;
+  if (matchLen) {
+    size_t m = matchLen - MIN_MATCH;
+    t |= (unsigned char)(m < 15 ? m : 15);
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    if (m >= 15) op = putLength(op, m - 15);
+  }
+  *token = t;
+  return op;
+}
+
+
+size_t
+blockCompressBound(size_t n) {
+  return n + n / 255 + 16;
+}
+
+
+size_t
+blockCompress(unsigned char const *src, size_t n, unsigned char *dst) {
+  Uint32 table[HASH_SIZE];
+  assert(n < NO_POS);
+  for (unsigned i=0; i < HASH_SIZE; i+=1) table[i] = NO_POS;
+
+  unsigned char *op = dst;
+  size_t ip = 0, anchor = 0;
+  while (ip + MIN_MATCH <= n) {
+    Uint32 seq = read32(src + ip);
+    unsigned h = hash32(seq);
+    Uint32 ref = table[h];
+    table[h] = (Uint32) ip;
+    if (ref != NO_POS && ip - ref <= MAX_OFFSET && read32(src + ref) == seq) {
+      size_t len = MIN_MATCH;
+      while (ip + len < n && src[ref + len] == src[ip + len]) len += 1;
+      op = putSequence(op, src + anchor, ip - anchor, ip - ref, len);
+      ip += len;
+      anchor = ip;
+    } else {
+      ip += 1;
+    }
+  }
+  // trailing literals (always emitted, so the stream ends with literals)
+  op = putSequence(op, src + anchor, n - anchor, 0, 0);
+  assert((size_t)(op - dst) <= blockCompressBound(n));
+  return op - dst;
+}
+
+
+bool
+blockDecompress(unsigned char const *src, size_t csize, unsigned char *dst, size_t n) {
+  unsigned char const *ip = src, *iend = src + csize;
+  unsigned char *op = dst, *oend = dst + n;
+
+  while (ip < iend) {
+    unsigned token = *ip++;
+    size_t litLen = token >> 4;
+    if (litLen == 15) {
+      unsigned b;
+      do {
+	if (ip >= iend) return false;
+	b = *ip++;
+	litLen += b;
+      } while (b == 255);
+    }
+    if ((size_t)(iend - ip) < litLen || (size_t)(oend - op) < litLen) return false;
+    memcpy(op, ip, litLen);
+    op += litLen;
+    ip += litLen;
+    if (ip == iend) break;   // last sequence has no match
+
+    if (iend - ip < 2) return false;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    size_t matchLen = token & 0xf;
+    if (matchLen == 15) {
+      unsigned b;
+      do {
+	if (ip >= iend) return false;
+	b = *ip++;
+	matchLen += b;
+      } while (b == 255);
+    }
+    matchLen += MIN_MATCH;
+    if (offset == 0 || offset > (size_t)(op - dst) || (size_t)(oend - op) < matchLen)
+      return false;
+    // byte-wise copy, since the match may overlap its own output
+    unsigned char const *match = op - offset;
+    for (size_t i=0; i < matchLen; i+=1) op[i] = match[i];
+    op += matchLen;
+  }
+  return op == oend;
+}
+
+
+// Compute where byte j of a frame goes when the block is shuffled:
+// byte j of frame f is stored at base[j] + f * stride[j]. Plane k
+// holds byte k of every feature that is wider than k bytes.
+static void
+shuffleMap(unsigned nFrames, unsigned nCont, unsigned contBytes, unsigned nDisc,
+	   vector<size_t> &base, vector<size_t> &stride)
+{
+  unsigned frameBytes = nCont * contBytes + nDisc * sizeof(Data32);
+  base.resize(frameBytes);
+  stride.resize(frameBytes);
+  size_t planeStart = 0;
+  for (unsigned k=0; k < sizeof(Data32); k+=1) {
+    unsigned nWide = (contBytes > k ? nCont : 0);
+    unsigned perFrame = nWide + nDisc;
+    for (unsigned i=0; i < nWide; i+=1) {
+      base[i * contBytes + k]   = planeStart + i;
+      stride[i * contBytes + k] = perFrame;
+    }
+    for (unsigned d=0; d < nDisc; d+=1) {
+      unsigned j = nCont * contBytes + d * sizeof(Data32) + k;
+      base[j]   = planeStart + nWide + d;
+      stride[j] = perFrame;
+    }
+    planeStart += (size_t) nFrames * perFrame;
+  }
+}
+
+
+void
+blockEncodeTransform(unsigned flags, unsigned char const *src, unsigned nFrames,
+		     unsigned nCont, unsigned contBytes, unsigned nDisc,
+		     unsigned char *dst)
+{
+  size_t frameBytes = nCont * contBytes + nDisc * sizeof(Data32);
+  size_t nBytes = nFrames * frameBytes;
+
+  if (!(flags & BLOCK_SHUFFLE)) {
+    if (flags & BLOCK_XOR_DELTA) {
+      memcpy(dst, src, frameBytes < nBytes ? frameBytes : nBytes);
+      for (size_t i=frameBytes; i < nBytes; i+=1)
+	dst[i] = src[i] ^ src[i - frameBytes];
+    } else {
+      memcpy(dst, src, nBytes);
+    }
+    return;
+  }
+
+  vector<size_t> base, stride;
+  shuffleMap(nFrames, nCont, contBytes, nDisc, base, stride);
+  for (unsigned f=0; f < nFrames; f+=1) {
+    unsigned char const *frame = src + f * frameBytes;
+    for (size_t j=0; j < frameBytes; j+=1) {
+      unsigned char b = frame[j];
+      if ((flags & BLOCK_XOR_DELTA) && f > 0) b ^= frame[j - frameBytes];
+      dst[base[j] + f * stride[j]] = b;
+    }
+  }
+}
+
+
+void
+blockDecodeTransform(unsigned flags, unsigned char const *src, unsigned nFrames,
+		     unsigned nCont, unsigned contBytes, unsigned nDisc,
+		     unsigned char *dst)
+{
+  size_t frameBytes = nCont * contBytes + nDisc * sizeof(Data32);
+  size_t nBytes = nFrames * frameBytes;
+
+  if (flags & BLOCK_SHUFFLE) {
+    vector<size_t> base, stride;
+    shuffleMap(nFrames, nCont, contBytes, nDisc, base, stride);
+    for (unsigned f=0; f < nFrames; f+=1) {
+      unsigned char *frame = dst + f * frameBytes;
+      for (size_t j=0; j < frameBytes; j+=1)
+	frame[j] = src[base[j] + f * stride[j]];
+    }
+  } else {
+    memcpy(dst, src, nBytes);
+  }
+  if (flags & BLOCK_XOR_DELTA) {
+    for (size_t i=frameBytes; i < nBytes; i+=1)
+      dst[i] ^= dst[i - frameBytes];
+  }
+}
+
+
+int
+blockTransformStrToFlags(char const *str) {
+  if (strcmp(str, "none") == 0)
+    return 0;
+  else if (strcmp(str, "xor") == 0)
+    return BLOCK_XOR_DELTA;
+  else if (strcmp(str, "shuffle") == 0)
+    return BLOCK_SHUFFLE;
+  else if (strcmp(str, "xorshuffle") == 0)
+    return BLOCK_XOR_DELTA | BLOCK_SHUFFLE;
+  return -1;
+}
+
+
+Uint16
+floatToHalf(float f) {
+  Uint32 u;
+  memcpy(&u, &f, sizeof(u));
+  Uint16 sign = (Uint16)((u >> 16) & 0x8000);
+  int    exp  = (u >> 23) & 0xff;
+  Uint32 mant = u & 0x7fffff;
+
+  if (exp == 0xff)                           // inf or NaN (keep NaNs quiet)
+    return sign | 0x7c00 | (mant ? 0x200 | (mant >> 13) : 0);
+  int e = exp - 127 + 15;
+  if (e >= 0x1f)                             // overflow
+    return sign | 0x7c00;
+  if (e <= 0) {                              // subnormal half (or zero)
+    if (e < -10) return sign;
+    mant |= 0x800000;
+    unsigned shift = 14 - e;
+    Uint32 h = mant >> shift;
+    Uint32 rem = mant & ((1U << shift) - 1);
+    Uint32 halfway = 1U << (shift - 1);
+    if (rem > halfway || (rem == halfway && (h & 1))) h += 1;
+    return sign | (Uint16) h;
+  }
+  Uint32 h = ((Uint32) e << 10) | (mant >> 13);
+  Uint32 rem = mant & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h += 1;  // may carry into inf
+  return sign | (Uint16) h;
+}
+
+
+float
+halfToFloat(Uint16 h) {
+  Uint32 sign = (Uint32)(h & 0x8000) << 16;
+  Uint32 exp  = (h >> 10) & 0x1f;
+  Uint32 mant = h & 0x3ff;
+  Uint32 u;
+
+  if (exp == 0) {
+    if (mant == 0) {
+      u = sign;
+    } else {                                 // renormalize the subnormal
+      exp = 127 - 15 + 1;
+      while (!(mant & 0x400)) {
+	mant <<= 1;
+	exp -= 1;
+      }
+      u = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+  } else if (exp == 0x1f) {
+    u = sign | 0x7f800000 | (mant << 13);
+  } else {
+    u = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+  }
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+
+void
+quantizeHalf(float const *src, unsigned nFrames, unsigned nCont, unsigned stride,
+	     Uint16 *dst)
+{
+  for (unsigned f=0; f < nFrames; f+=1, src += stride, dst += nCont)
+    for (unsigned i=0; i < nCont; i+=1)
+      dst[i] = floatToHalf(src[i]);
+}
+
+
+void
+dequantizeHalf(Uint16 const *src, unsigned nFrames, unsigned nCont, bool swap,
+	       float *dst, unsigned stride)
+{
+  for (unsigned f=0; f < nFrames; f+=1, src += nCont, dst += stride) {
+    unsigned i=0;
+    if (swap) {
+      for (; i < nCont; i+=1)
+	dst[i] = halfToFloat((Uint16)((src[i] >> 8) | (src[i] << 8)));
+      continue;
+    }
+#if defined(__F16C__)
+    for (; i + 8 <= nCont; i+=8)
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((__m128i const *)(src + i))));
+#endif
+    for (; i < nCont; i+=1)
+      dst[i] = halfToFloat(src[i]);
+  }
+}
+
+
+void
+affine8Range(float const *src, unsigned nFrames, unsigned nCont, unsigned stride,
+	     float *scale, float *offset)
+{
+  for (unsigned i=0; i < nCont; i+=1) {
+    float lo = 0.0f, hi = 0.0f;
+    bool first = true;
+    for (unsigned f=0; f < nFrames; f+=1) {
+      float x = src[f * stride + i];
+      if (isnan(x)) continue;
+      if (first) {
+	lo = hi = x;
+	first = false;
+      } else if (x < lo) {
+	lo = x;
+      } else if (x > hi) {
+	hi = x;
+      }
+    }
+    offset[i] = lo;
+    scale[i]  = (hi - lo) / 255.0f;
+  }
+}
+
+
+void
+quantizeAffine8(float const *src, unsigned nFrames, unsigned nCont, unsigned stride,
+		float const *scale, float const *offset, unsigned char *dst)
+{
+  for (unsigned f=0; f < nFrames; f+=1, src += stride, dst += nCont) {
+    for (unsigned i=0; i < nCont; i+=1) {
+      float q = scale[i] > 0.0f && !isnan(src[i]) ? floorf((src[i] - offset[i]) / scale[i] + 0.5f) : 0.0f;
+      dst[i] = (unsigned char)(q < 0.0f ? 0 : (q > 255.0f ? 255 : q));
+    }
+  }
+}
+
+
+void
+dequantizeAffine8(unsigned char const *src, unsigned nFrames, unsigned nCont,
+		  float const *scale, float const *offset, float *dst, unsigned stride)
+{
+  // simple enough for the compiler to vectorize the inner loop
+  for (unsigned f=0; f < nFrames; f+=1, src += nCont, dst += stride)
+    for (unsigned i=0; i < nCont; i+=1)
+      dst[i] = offset[i] + scale[i] * (float) src[i];
+}
@@ -0,0 +1,106 @@
+/*
+ * GMTK_BlockCodec.h
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#ifndef GMTK_BLOCKCODEC_H
+#define GMTK_BLOCKCODEC_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include "machine-dependent.h"
+
+// A small, fast, dependency-free block codec for observation data.
+//
+// A block is a row-major matrix of frames. Each frame holds nCont
+// continuous features of contBytes bytes each (4 for float, or 2 or 1
+// when stored at reduced precision, see below) followed by nDisc
+// 4-byte discrete features. Blocks are first passed through optional
+// lossless transforms that make the features more compressible, and
+// then through a byte-oriented LZ77 coder (in the spirit of LZ4:
+// 4-byte minimum matches found through a hash table, 64K window,
+// literal/match lengths packed into a single token byte).
+//
+// The transforms are:
+//
+//   BLOCK_XOR_DELTA - replace each byte of frame f > 0 with its XOR
+//                     against the same byte in frame f-1. Slowly
+//                     varying features then have mostly-zero sign,
+//                     exponent and high mantissa bits.
+//   BLOCK_SHUFFLE   - regroup the bytes so that byte k of every feature
+//                     is stored contiguously (byte planes), which gives
+//                     the LZ coder long runs to work with.
+//
+// Both transforms operate on bits only, so they commute with byte
+// swapping and decoded blocks can be swapped after the fact.
+
+#define BLOCK_XOR_DELTA 0x1
+#define BLOCK_SHUFFLE   0x2
+
+// Maximum compressed size of n input bytes
+size_t blockCompressBound(size_t n);
+
+// Compress n bytes from src into dst (which must hold at least
+// blockCompressBound(n) bytes). Returns the compressed size.
+size_t blockCompress(unsigned char const *src, size_t n, unsigned char *dst);
+
+// Decompress csize bytes from src into exactly n bytes at dst.
+// Returns false if the compressed data is corrupt.
+bool blockDecompress(unsigned char const *src, size_t csize, unsigned char *dst, size_t n);
+
+// Apply the transforms in flags to the nFrames frame block at src,
+// writing the result to dst. src and dst may not overlap.
+void blockEncodeTransform(unsigned flags, unsigned char const *src, unsigned nFrames,
+			  unsigned nCont, unsigned contBytes, unsigned nDisc,
+			  unsigned char *dst);
+
+// Invert blockEncodeTransform()
+void blockDecodeTransform(unsigned flags, unsigned char const *src, unsigned nFrames,
+			  unsigned nCont, unsigned contBytes, unsigned nDisc,
+			  unsigned char *dst);
+
+// Converts a transform name (none, xor, shuffle, xorshuffle) to flags,
+// returns -1 if the name is not recognized
+int blockTransformStrToFlags(char const *str);
+
+
+// Reduced-precision storage of continuous features. Either IEEE
+// half precision floats, or per-dimension affine 8-bit codes
+//
+//   x = offset[i] + scale[i] * q,   q in [0,255]
+//
+// Both convert n values with stride srcStride/dstStride (in elements)
+// so they can be applied to one feature column of a frame block.
+
+// IEEE single <-> half precision (round to nearest even)
+Uint16 floatToHalf(float f);
+float  halfToFloat(Uint16 h);
+
+// Convert nFrames x nCont floats (frame stride stride) to halves and back.
+// dequantizeHalf byte swaps the halves first if swap is true.
+void quantizeHalf(float const *src, unsigned nFrames, unsigned nCont, unsigned stride,
+		  Uint16 *dst);
+void dequantizeHalf(Uint16 const *src, unsigned nFrames, unsigned nCont, bool swap,
+		    float *dst, unsigned stride);
+
+// Choose the affine scale and offset for each of nCont features over
+// nFrames frames (frame stride stride) so that they cover [min,max]
+void affine8Range(float const *src, unsigned nFrames, unsigned nCont, unsigned stride,
+		  float *scale, float *offset);
+
+// Convert nFrames x nCont floats to 8-bit codes and back
+void quantizeAffine8(float const *src, unsigned nFrames, unsigned nCont, unsigned stride,
+		     float const *scale, float const *offset, unsigned char *dst);
+void dequantizeAffine8(unsigned char const *src, unsigned nFrames, unsigned nCont,
+		       float const *scale, float const *offset, float *dst, unsigned stride);
+
+#endif
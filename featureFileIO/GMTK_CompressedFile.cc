@@ -0,0 +1,473 @@
+/*
+ * GMTK_CompressedFile.cc
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "error.h"
+#include "general.h"
+#include "debug.h"
+#include "vbyteswapping.h"
+
+#include "GMTK_BlockCodec.h"
+#include "GMTK_CompressedFile.h"
+
+using namespace std;
+
+#define CMP_MAGIC        "GMTKCMP1"
+#define CMP_INDEX_MAGIC  "GMTKIDX1"
+#define CMP_MAGIC_LEN    8
+#define CMP_BYTE_ORDER   0x01020304
+#define CMP_VERSION      2
+#define CMP_TRAILER_SIZE (4 * sizeof(Uint32) + CMP_MAGIC_LEN)
+
+unsigned CompressedFile::writeFramesPerBlock = 256;
+unsigned CompressedFile::writeTransform      = BLOCK_XOR_DELTA | BLOCK_SHUFFLE;
+unsigned CompressedFile::writePrecision      = 32;
+
+
+Uint32
+CompressedFile::readWord() {
+  Uint32 w;
+  if (fread(&w, sizeof(w), 1, dataFile) != 1)
+    error("ERROR: CompressedFile: failed to read '%s': %s\n", fileName,
+	  feof(dataFile) ? "unexpected end of file" : strerror(errno));
+  return swap ? (Uint32) swapb_i32_i32((Int32) w) : w;
+}
+
+
+void
+CompressedFile::writeWord(Uint32 w) {
+  if (fwrite(&w, sizeof(w), 1, writeFile) != 1)
+    error("ERROR: CompressedFile: failed to write '%s': %s\n", fileName, strerror(errno));
+}
+
+
+CompressedFile::CompressedFile(const char *name, unsigned nfloats, unsigned nints, unsigned num,
+			       char const *contFeatureRangeStr_,
+			       char const *discFeatureRangeStr_,
+			       char const *preFrameRangeStr_,
+			       char const *segRangeStr_,
+			       unsigned leftPad, unsigned rightPad)
+  : ObservationFile(name, num,
+		    contFeatureRangeStr_,
+		    discFeatureRangeStr_,
+		    preFrameRangeStr_,
+		    segRangeStr_,
+		    leftPad, rightPad),
+    dataFile(NULL), swap(false), currSegment(-1),
+    blockBuf(NULL), cachedBlock(-1), buffer(NULL), bufferSize(0),
+    writeFile(NULL)
+{
+  if (name == NULL)
+    error("CompressedFile: File name is NULL for observation file %u\n", num);
+  fileName = name;
+  if ((dataFile = fopen(name, "rb")) == NULL)
+    error("CompressedFile: Can't open observation file '%s' for input: %s\n", name, strerror(errno));
+
+  char magic[CMP_MAGIC_LEN];
+  if (fread(magic, 1, CMP_MAGIC_LEN, dataFile) != CMP_MAGIC_LEN || memcmp(magic, CMP_MAGIC, CMP_MAGIC_LEN))
+    error("ERROR: CompressedFile: '%s' is not a compressed observation file\n", name);
+  Uint32 byteOrder = readWord();
+  if (byteOrder == CMP_BYTE_ORDER) {
+    swap = false;
+  } else if ((Uint32) swapb_i32_i32((Int32) byteOrder) == CMP_BYTE_ORDER) {
+    swap = true;
+  } else {
+    error("ERROR: CompressedFile: '%s' has an invalid byte order marker\n", name);
+  }
+  unsigned version = readWord();
+  if (version < 1 || version > CMP_VERSION)
+    error("ERROR: CompressedFile: '%s' is version %u, but only versions up to %u are supported\n",
+	  name, version, CMP_VERSION);
+  _numContinuousFeatures = readWord();
+  _numDiscreteFeatures   = readWord();
+  _numFeatures           = _numContinuousFeatures + _numDiscreteFeatures;
+  framesPerBlock         = readWord();
+  transform              = readWord();
+  precision              = version > 1 ? readWord() : 32;
+
+  if (_numContinuousFeatures != nfloats)
+    error("CompressedFile: Observation file %s has %u floats, expected %u\n",
+	  name, _numContinuousFeatures, nfloats);
+  if (_numDiscreteFeatures != nints)
+    error("CompressedFile: Observation file %s has %u ints, expected %u\n",
+	  name, _numDiscreteFeatures, nints);
+  if (framesPerBlock == 0 || (transform & ~(BLOCK_XOR_DELTA | BLOCK_SHUFFLE)) ||
+      (precision != 32 && precision != 16 && precision != 8))
+    error("ERROR: CompressedFile: '%s' has a corrupt header\n", name);
+
+  // the trailer tells us where the index is
+  if (gmtk_fseek(dataFile, -(gmtk_off_t)CMP_TRAILER_SIZE, SEEK_END) == -1)
+    error("ERROR: CompressedFile: can't seek to the index trailer in '%s'\n", name);
+  unsigned nSegments = readWord();
+  unsigned nBlocks   = readWord();
+  Uint32 offLo = readWord();
+  Uint32 offHi = readWord();
+  if (fread(magic, 1, CMP_MAGIC_LEN, dataFile) != CMP_MAGIC_LEN || memcmp(magic, CMP_INDEX_MAGIC, CMP_MAGIC_LEN))
+    error("ERROR: CompressedFile: '%s' has no segment index (incompletely written?)\n", name);
+  if (offHi && sizeof(gmtk_off_t) <= sizeof(Uint32))
+    error("ERROR: CompressedFile: '%s' is too large for this platform\n", name);
+  gmtk_off_t indexOffset = (gmtk_off_t) offLo + (((gmtk_off_t) offHi << 16) << 16);
+  if (gmtk_fseek(dataFile, indexOffset, SEEK_SET) == -1)
+    error("ERROR: CompressedFile: can't seek to the segment index in '%s'\n", name);
+
+  segInfo.resize(nSegments);
+  if (precision == 8) affine.resize(2 * nSegments * _numContinuousFeatures);
+  for (unsigned s=0; s < nSegments; s+=1) {
+    segInfo[s].nFrames    = readWord();
+    segInfo[s].firstBlock = readWord();
+    if (precision == 8) {
+      for (unsigned i=0; i < 2 * _numContinuousFeatures; i+=1) {
+	Uint32 w = readWord();
+	memcpy(&affine[2 * s * _numContinuousFeatures + i], &w, sizeof(w));
+      }
+    }
+  }
+  blockInfo.resize(nBlocks);
+  for (unsigned b=0; b < nBlocks; b+=1) {
+    offLo = readWord();
+    offHi = readWord();
+    blockInfo[b].offset = (gmtk_off_t) offLo + (((gmtk_off_t) offHi << 16) << 16);
+    blockInfo[b].size   = readWord();
+  }
+  infoMsg(IM::ObsFile, IM::Low, "CompressedFile '%s': %u segments in %u blocks of %u frames, %u-bit floats\n",
+	  name, nSegments, nBlocks, framesPerBlock, precision);
+
+  blockBuf = (Data32 *) malloc(framesPerBlock * _numFeatures * sizeof(Data32));
+  if (!blockBuf)
+    error("ERROR: CompressedFile: unable to allocate block buffer for '%s'\n", name);
+
+  if (contFeatureRangeStr) {
+    contFeatureRange = new Range(contFeatureRangeStr, 0, _numContinuousFeatures);
+    assert(contFeatureRange);
+    _numLogicalContinuousFeatures = contFeatureRange->length();
+  } else
+    _numLogicalContinuousFeatures = _numContinuousFeatures;
+  if (discFeatureRangeStr) {
+    discFeatureRange = new Range(discFeatureRangeStr, 0, _numDiscreteFeatures);
+    assert(discFeatureRange);
+    _numLogicalDiscreteFeatures = discFeatureRange->length();
+  } else
+    _numLogicalDiscreteFeatures = _numDiscreteFeatures;
+  _numLogicalFeatures = _numLogicalContinuousFeatures + _numLogicalDiscreteFeatures;
+  if (segRangeStr) {
+    segRange = new Range(segRangeStr, 0, nSegments);
+    assert(segRange);
+  }
+}
+
+
+CompressedFile::CompressedFile(const char *name, unsigned nfloats, unsigned nints)
+  : dataFile(NULL), swap(false),
+    framesPerBlock(writeFramesPerBlock), transform(writeTransform), precision(writePrecision),
+    currSegment(-1), blockBuf(NULL), cachedBlock(-1), buffer(NULL), bufferSize(0),
+    segFrames(0), currFrame(0), currFeature(0)
+{
+  if (name == NULL)
+    error("CompressedFile: output file name is NULL\n");
+  fileName = name;
+  if ((writeFile = fopen(name, "wb")) == NULL)
+    error("CompressedFile: Can't open '%s' for output: %s\n", name, strerror(errno));
+  assert(framesPerBlock > 0);
+  assert(precision == 32 || precision == 16 || precision == 8);
+  _numContinuousFeatures = nfloats;
+  _numDiscreteFeatures   = nints;
+  _numFeatures           = nfloats + nints;
+
+  if (fwrite(CMP_MAGIC, 1, CMP_MAGIC_LEN, writeFile) != CMP_MAGIC_LEN)
+    error("ERROR: CompressedFile: failed to write '%s': %s\n", name, strerror(errno));
+  writeWord(CMP_BYTE_ORDER);
+  writeWord(CMP_VERSION);
+  writeWord(_numContinuousFeatures);
+  writeWord(_numDiscreteFeatures);
+  writeWord(framesPerBlock);
+  writeWord(transform);
+  writeWord(precision);
+}
+
+
+CompressedFile::~CompressedFile() {
+  if (writeFile) {
+    if (segFrames > 0)
+      endOfSegment();
+    writeIndex();
+    if (fclose(writeFile))
+      error("Error closing output file '%s'\n", fileName);
+  }
+  if (dataFile) fclose(dataFile);
+  if (blockBuf) free(blockBuf);
+  if (buffer)   free(buffer);
+}
+
+
+void
+CompressedFile::setFrame(unsigned frame) {
+  assert(currFeature == 0);
+  currFrame = frame;
+}
+
+
+void
+CompressedFile::writeFrame(Data32 const *frame) {
+  assert(currFeature == 0);
+  size_t end = (size_t)(currFrame + 1) * _numFeatures;
+  if (segBuffer.size() < end) segBuffer.resize(end, 0);
+  memcpy(&segBuffer[end - _numFeatures], frame, _numFeatures * sizeof(Data32));
+  currFrame += 1;
+  if (currFrame > segFrames) segFrames = currFrame;
+}
+
+
+void
+CompressedFile::writeFeature(Data32 x) {
+  size_t idx = (size_t) currFrame * _numFeatures + currFeature;
+  if (segBuffer.size() <= idx) segBuffer.resize((size_t)(currFrame + 1) * _numFeatures, 0);
+  segBuffer[idx] = x;
+  currFeature += 1;
+  if (currFeature == _numFeatures) {
+    currFrame += 1;
+    currFeature = 0;
+    if (currFrame > segFrames) segFrames = currFrame;
+  }
+}
+
+
+void
+CompressedFile::endOfSegment() {
+  assert(currFeature == 0);
+  flushSegment();
+  segBuffer.clear();
+  segFrames = 0;
+  currFrame = 0;
+}
+
+
+void
+CompressedFile::flushSegment() {
+  assert(writeFile);
+  SegmentInfo si;
+  si.nFrames    = segFrames;
+  si.firstBlock = blockInfo.size();
+  segInfo.push_back(si);
+
+  unsigned nCont = _numContinuousFeatures;
+  float const *scale = NULL, *offset = NULL;
+  if (precision == 8) {
+    size_t base = affine.size();
+    affine.resize(base + 2 * nCont);
+    scale  = &affine[base];
+    offset = &affine[base + nCont];
+    affine8Range((float const *) &segBuffer[0], segFrames, nCont, _numFeatures,
+		 &affine[base], &affine[base + nCont]);
+  }
+
+  for (unsigned first=0; first < segFrames; first += framesPerBlock) {
+    unsigned count = segFrames - first < framesPerBlock ? segFrames - first : framesPerBlock;
+    size_t rawBytes = count * packedFrameBytes();
+    if (xformBuf.size() < rawBytes) xformBuf.resize(rawBytes);
+    if (codeBuf.size() < blockCompressBound(rawBytes)) codeBuf.resize(blockCompressBound(rawBytes));
+
+    unsigned char const *packed = (unsigned char const *) &segBuffer[(size_t) first * _numFeatures];
+    if (precision != 32) {
+      if (packBuf.size() < rawBytes) packBuf.resize(rawBytes);
+      pack(&segBuffer[(size_t) first * _numFeatures], count, scale, offset, &packBuf[0]);
+      packed = &packBuf[0];
+    }
+    blockEncodeTransform(transform, packed, count, nCont, precision / 8,
+			 _numDiscreteFeatures, &xformBuf[0]);
+    size_t csize = blockCompress(&xformBuf[0], rawBytes, &codeBuf[0]);
+    unsigned char const *data = &codeBuf[0];
+    if (csize >= rawBytes) {  // incompressible: store transformed bytes as is
+      csize = rawBytes;
+      data = &xformBuf[0];
+    }
+    BlockInfo bi;
+    bi.offset = gmtk_ftell(writeFile);
+    bi.size   = csize;
+    blockInfo.push_back(bi);
+    if (fwrite(data, 1, csize, writeFile) != csize)
+      error("ERROR: CompressedFile: failed to write '%s': %s\n", fileName, strerror(errno));
+  }
+}
+
+
+void
+CompressedFile::writeIndex() {
+  gmtk_off_t indexOffset = gmtk_ftell(writeFile);
+  for (unsigned s=0; s < segInfo.size(); s+=1) {
+    writeWord(segInfo[s].nFrames);
+    writeWord(segInfo[s].firstBlock);
+    if (precision == 8) {
+      for (unsigned i=0; i < 2 * _numContinuousFeatures; i+=1) {
+	Uint32 w;
+	memcpy(&w, &affine[2 * s * _numContinuousFeatures + i], sizeof(w));
+	writeWord(w);
+      }
+    }
+  }
+  for (unsigned b=0; b < blockInfo.size(); b+=1) {
+    writeWord((Uint32) blockInfo[b].offset);
+    writeWord((Uint32) ((blockInfo[b].offset >> 16) >> 16));
+    writeWord(blockInfo[b].size);
+  }
+  writeWord(segInfo.size());
+  writeWord(blockInfo.size());
+  writeWord((Uint32) indexOffset);
+  writeWord((Uint32) ((indexOffset >> 16) >> 16));
+  if (fwrite(CMP_INDEX_MAGIC, 1, CMP_MAGIC_LEN, writeFile) != CMP_MAGIC_LEN)
+    error("ERROR: CompressedFile: failed to write '%s': %s\n", fileName, strerror(errno));
+}
+
+
+bool
+CompressedFile::openSegment(unsigned seg) {
+  assert(seg < segInfo.size());
+  currSegment = seg;
+  if (preFrameRange)
+    delete preFrameRange;
+  if (preFrameRangeStr) {
+    preFrameRange = new Range(preFrameRangeStr, 0, segInfo[seg].nFrames);
+    assert(preFrameRange);
+  }
+  return true;
+}
+
+
+void
+CompressedFile::loadBlock(unsigned b) {
+  assert(currSegment >= 0);
+  if ((int) b == cachedBlock) return;
+
+  SegmentInfo const &si = segInfo[currSegment];
+  unsigned first = (b - si.firstBlock) * framesPerBlock;
+  assert(first < si.nFrames);
+  unsigned count = si.nFrames - first < framesPerBlock ? si.nFrames - first : framesPerBlock;
+  size_t rawBytes = count * packedFrameBytes();
+  size_t csize = blockInfo[b].size;
+
+  if (codeBuf.size() < csize) codeBuf.resize(csize);
+  if (gmtk_fseek(dataFile, blockInfo[b].offset, SEEK_SET) == -1)
+    error("ERROR: CompressedFile: can't seek to block %u in '%s'\n", b, fileName);
+  if (fread(&codeBuf[0], 1, csize, dataFile) != csize)
+    error("ERROR: CompressedFile: failed to read block %u in '%s'\n", b, fileName);
+
+  unsigned char const *xformed = &codeBuf[0];
+  if (csize != rawBytes) {
+    if (xformBuf.size() < rawBytes) xformBuf.resize(rawBytes);
+    if (!blockDecompress(&codeBuf[0], csize, &xformBuf[0], rawBytes))
+      error("ERROR: CompressedFile: block %u in '%s' is corrupt\n", b, fileName);
+    xformed = &xformBuf[0];
+  }
+  if (precision == 32) {
+    blockDecodeTransform(transform, xformed, count, _numContinuousFeatures, sizeof(Data32),
+			 _numDiscreteFeatures, (unsigned char *) blockBuf);
+    if (swap)
+      swapb_vi32_vi32(count * _numFeatures, (intv_int32_t *) blockBuf, (intv_int32_t *) blockBuf);
+  } else {
+    if (packBuf.size() < rawBytes) packBuf.resize(rawBytes);
+    blockDecodeTransform(transform, xformed, count, _numContinuousFeatures, precision / 8,
+			 _numDiscreteFeatures, &packBuf[0]);
+    float const *scale = NULL, *offset = NULL;
+    if (precision == 8) {
+      scale  = &affine[2 * currSegment * _numContinuousFeatures];
+      offset = scale + _numContinuousFeatures;
+    }
+    unpack(&packBuf[0], count, scale, offset, blockBuf);
+  }
+  cachedBlock = b;
+}
+
+
+void
+CompressedFile::pack(Data32 const *src, unsigned count, float const *scale, float const *offset,
+		     unsigned char *dst)
+{
+  unsigned nCont = _numContinuousFeatures;
+  unsigned nDisc = _numDiscreteFeatures;
+  size_t frameBytes = packedFrameBytes();
+  size_t contFrameBytes = nCont * (precision / 8);
+  for (unsigned f=0; f < count; f+=1) {
+    Data32 const *in = src + (size_t) f * _numFeatures;
+    unsigned char *frame = dst + f * frameBytes;
+    if (precision == 16)
+      quantizeHalf((float const *) in, 1, nCont, _numFeatures, (Uint16 *) frame);
+    else
+      quantizeAffine8((float const *) in, 1, nCont, _numFeatures, scale, offset, frame);
+    memcpy(frame + contFrameBytes, in + nCont, nDisc * sizeof(Data32));
+  }
+}
+
+
+void
+CompressedFile::unpack(unsigned char const *src, unsigned count, float const *scale, float const *offset,
+		       Data32 *dst)
+{
+  unsigned nCont = _numContinuousFeatures;
+  unsigned nDisc = _numDiscreteFeatures;
+  size_t frameBytes = packedFrameBytes();
+  size_t contFrameBytes = nCont * (precision / 8);
+  for (unsigned f=0; f < count; f+=1) {
+    unsigned char const *frame = src + f * frameBytes;
+    Data32 *out = dst + (size_t) f * _numFeatures;
+    if (precision == 16)
+      dequantizeHalf((Uint16 const *) frame, 1, nCont, swap, (float *) out, _numFeatures);
+    else
+      dequantizeAffine8(frame, 1, nCont, scale, offset, (float *) out, _numFeatures);
+    memcpy(out + nCont, frame + contFrameBytes, nDisc * sizeof(Data32));
+    if (swap)
+      swapb_vi32_vi32(nDisc, (intv_int32_t *) out + nCont, (intv_int32_t *) out + nCont);
+  }
+}
+
+
+Data32 const *
+CompressedFile::getFrames(unsigned first, unsigned count) {
+  assert(currSegment >= 0);
+  SegmentInfo const &si = segInfo[currSegment];
+  assert(first < si.nFrames && first + count <= si.nFrames);
+  assert(count > 0);
+
+  unsigned firstBlock = first / framesPerBlock;
+  unsigned lastBlock  = (first + count - 1) / framesPerBlock;
+
+  // the common case: everything is in one block, so hand out the
+  // block buffer directly
+  if (firstBlock == lastBlock) {
+    loadBlock(si.firstBlock + firstBlock);
+    return blockBuf + (size_t)(first - firstBlock * framesPerBlock) * _numFeatures;
+  }
+
+  unsigned needed = count * _numFeatures;
+  if (needed > bufferSize) {
+    buffer = (Data32 *) realloc(buffer, needed * sizeof(Data32));
+    assert(buffer);
+    bufferSize = needed;
+  }
+  Data32 *dest = buffer;
+  unsigned frame = first, end = first + count;
+  for (unsigned b = firstBlock; b <= lastBlock; b+=1) {
+    loadBlock(si.firstBlock + b);
+    unsigned blockStart = b * framesPerBlock;
+    unsigned blockEnd   = blockStart + framesPerBlock < end ? blockStart + framesPerBlock : end;
+    unsigned n = blockEnd - frame;
+    memcpy(dest, blockBuf + (size_t)(frame - blockStart) * _numFeatures, n * _numFeatures * sizeof(Data32));
+    dest  += n * _numFeatures;
+    frame += n;
+  }
+  assert(frame == end);
+  return buffer;
+}
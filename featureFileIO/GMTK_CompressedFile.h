@@ -0,0 +1,181 @@
+/*
+ * GMTK_CompressedFile.h
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#ifndef GMTK_COMPRESSEDFILE_H
+#define GMTK_COMPRESSEDFILE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <vector>
+using namespace std;
+
+#include "machine-dependent.h"
+#include "error.h"
+#include "general.h"
+#include "file_utils.h"
+
+#include "GMTK_ObservationFile.h"
+
+// A single seekable archive holding all the segments of an
+// observation file. Each segment is cut into blocks of
+// framesPerBlock frames, and each block is transformed and
+// compressed independently (see GMTK_BlockCodec.h), so
+// getFrames() only needs to read and decompress the blocks
+// that overlap the requested frames. The layout is
+//
+//   header:   "GMTKCMP1" byteOrder version nFloats nInts framesPerBlock transform
+//             precision
+//   blocks:   compressed block data, in segment order
+//   index:    for each segment:  nFrames firstBlock [nFloats scales, nFloats offsets]
+//             for each block:    offsetLo offsetHi compressedSize
+//   trailer:  nSegments nBlocks indexOffsetLo indexOffsetHi "GMTKIDX1"
+//
+// All integers are Uint32 in the byte order of the writer; the
+// byteOrder word lets readers on the other endianness swap. A block
+// whose compressed size equals its raw size is stored uncompressed.
+// The index lives at the end of the file so that it can be written
+// in a single pass.
+//
+// The continuous features may be stored at reduced precision (16-bit
+// IEEE half or 8-bit per-dimension affine codes) and are dequantized
+// as blocks are decompressed. Since the file is written in one pass,
+// the affine scale/offset table is computed for each segment and
+// kept in that segment's index entry (only present for precision 8).
+// Version 1 files have no precision word and are always 32-bit.
+
+class CompressedFile: public ObservationFile {
+
+  struct SegmentInfo {
+    unsigned nFrames;
+    unsigned firstBlock;
+  };
+  struct BlockInfo {
+    gmtk_off_t offset;
+    unsigned   size;        // compressed size in bytes
+  };
+
+  FILE     *dataFile;
+  bool      swap;           // file byte order differs from ours
+  unsigned  framesPerBlock;
+  unsigned  transform;      // BLOCK_XOR_DELTA | BLOCK_SHUFFLE
+  unsigned  precision;      // bits per continuous feature (32, 16, or 8)
+
+  vector<SegmentInfo> segInfo;
+  vector<BlockInfo>   blockInfo;
+  vector<float>       affine;   // per segment: nFloats scales then nFloats offsets
+
+  int       currSegment;
+
+  // decompressed block cache (holds block cachedBlock)
+  Data32   *blockBuf;
+  int       cachedBlock;
+
+  // scratch space for compressed and transformed bytes
+  vector<unsigned char> codeBuf;
+  vector<unsigned char> xformBuf;
+  vector<unsigned char> packBuf;  // reduced-precision block
+
+  Data32   *buffer;         // frames spanning several blocks
+  unsigned  bufferSize;     // in Data32's
+
+  // for writable files
+  FILE            *writeFile;
+  vector<Data32>   segBuffer;   // current segment being written
+  unsigned         segFrames;   // # frames written to current segment
+  unsigned         currFrame;
+  unsigned         currFeature;
+
+  // read and decompress block b into blockBuf
+  void loadBlock(unsigned b);
+
+  // bytes per frame as stored in a block
+  size_t packedFrameBytes() {
+    return _numContinuousFeatures * (precision / 8) + _numDiscreteFeatures * sizeof(Data32);
+  }
+
+  // convert count frames between Data32 and reduced precision storage
+  void pack(Data32 const *src, unsigned count, float const *scale, float const *offset,
+	    unsigned char *dst);
+  void unpack(unsigned char const *src, unsigned count, float const *scale, float const *offset,
+	      Data32 *dst);
+
+  // compress the current write segment and append it to the file
+  void flushSegment();
+
+  // write the index and trailer
+  void writeIndex();
+
+  Uint32 readWord();
+  void   writeWord(Uint32 w);
+
+ public:
+
+  // Block size, transform, and precision used by the write constructor
+  static unsigned writeFramesPerBlock;
+  static unsigned writeTransform;
+  static unsigned writePrecision;
+
+  CompressedFile(const char *name, unsigned nfloats, unsigned nints, unsigned num,
+		 char const *contFeatureRangeStr_=NULL,
+		 char const *discFeatureRangeStr_=NULL,
+		 char const *preFrameRangeStr_=NULL,
+		 char const *segRangeStr_=NULL,
+		 unsigned leftPad=0, unsigned rightPad=0);
+
+  // write constructor
+  CompressedFile(const char *name, unsigned nfloats, unsigned nints);
+
+  ~CompressedFile();
+
+  // returns true iff file supports random access writes via setFrame()
+  // (the current segment is held in memory until endOfSegment)
+  bool seekable() { return true; }
+
+  // Set frame # to write within current segemnt
+  void setFrame(unsigned frame);
+
+  // Write frame to the file (call endOfSegment after last frame of a segment)
+  void writeFrame(Data32 const *frame);
+
+  // Write the next feature in the current frame
+  void writeFeature(Data32 x);
+
+  // Call after last writeFrame of a segment
+  void endOfSegment();
+
+
+  // The number of available segments.
+  unsigned numSegments() { return segInfo.size(); }
+
+  // Begin sourcing data from the requested segment.
+  // Must be called before any other operations are performed on a segment.
+  bool openSegment(unsigned seg);
+
+  // The number of frames in the currently open segment.
+  unsigned numFrames() {
+    assert(currSegment >= 0);
+    return segInfo[currSegment].nFrames;
+  }
+
+  // Load count frames of observed data, starting from first (physical),
+  // in the current segment.
+  Data32 const *getFrames(unsigned first, unsigned count);
+
+  // Number of continuous/discrete/total features in the file
+  // after applying -frX and -irX
+  unsigned numLogicalContinuous() { return _numLogicalContinuousFeatures; }
+  unsigned numLogicalDiscrete()   { return _numLogicalDiscreteFeatures; }
+  unsigned numLogicalFeatures()   { return _numLogicalFeatures; }
+};
+
+#endif
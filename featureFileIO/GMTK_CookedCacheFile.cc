@@ -0,0 +1,270 @@
+/*
+ * GMTK_CookedCacheFile.cc
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include "error.h"
+#include "general.h"
+#include "debug.h"
+
+#include "file_utils.h"
+
+#include "GMTK_CookedCacheFile.h"
+
+#define COOK_MAGIC      "GMTKCOOK"
+#define COOK_MAGIC_LEN  8
+#define COOK_BYTE_ORDER 0x01020304
+#define COOK_VERSION    1
+#define COOK_HEADER_WORDS 6   // byteOrder version nFloats nInts nFrames keyLength
+
+// frames are copied from the underlying file this many bytes at a time
+#define COOK_GULP_BYTES (16 * 1024 * 1024)
+
+char const *CookedCacheFile::cacheDirectory = NULL;
+
+
+// 32-bit FNV-1a
+static Uint32
+fnv1a(char const *s, size_t n, Uint32 h) {
+  for (size_t i=0; i < n; i+=1) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+
+CookedCacheFile::CookedCacheFile(ObservationFile *file, char const *key)
+  : ObservationFile(NULL, 0),
+    file(file), key(key), _numFrames(0), frames(NULL), mapBase(NULL), mapSize(0),
+    writeFailed(false)
+{
+  assert(file);
+  assert(cacheDirectory);
+  observationFileName = file->obsFileName();
+  observationFileNum  = file->obsFileNum();
+  _numContinuousFeatures = _numLogicalContinuousFeatures = file->numLogicalContinuous();
+  _numDiscreteFeatures   = _numLogicalDiscreteFeatures   = file->numLogicalDiscrete();
+  _numFeatures           = _numLogicalFeatures           = _numContinuousFeatures + _numDiscreteFeatures;
+
+  // two differently seeded hashes make accidental collisions very
+  // unlikely; the stored key catches the rest
+  char hex[17];
+  sprintf(hex, "%08x%08x", fnv1a(key, strlen(key), 2166136261U), fnv1a(key, strlen(key), 0x9e3779b9U));
+  keyHash = hex;
+
+  struct stat st;
+  if (stat(cacheDirectory, &st) != 0 && mkdir(cacheDirectory, 0777) != 0 && errno != EEXIST)
+    error("ERROR: can't create observation cache directory '%s': %s\n", cacheDirectory, strerror(errno));
+  infoMsg(IM::ObsFile, IM::Low, "cooked observation cache %s/%s_*\n", cacheDirectory, keyHash.c_str());
+}
+
+
+CookedCacheFile::~CookedCacheFile() {
+  releaseSegment();
+  if (file) delete file;
+}
+
+
+string
+CookedCacheFile::fileIdentity(char const *name) {
+  char buf[128];
+  struct stat st;
+  string id(name ? name : "");
+  if (name && stat(name, &st) == 0) {
+    sprintf(buf, ":%lu:%lu", (unsigned long) st.st_size, (unsigned long) st.st_mtime);
+    id += buf;
+  }
+  return id;
+}
+
+
+string
+CookedCacheFile::listIdentity(unsigned n, char **names) {
+  Uint32 h1 = 2166136261U, h2 = 0x9e3779b9U;
+  for (unsigned i=0; i < n; i+=1) {
+    if (!names[i]) continue;
+    int startFrame, endFrame;
+    string fname;
+    parseSentenceSpec(names[i], startFrame, endFrame, fname);
+    string id = fileIdentity(fname.c_str()) + "\n";
+    h1 = fnv1a(id.data(), id.size(), h1);
+    h2 = fnv1a(id.data(), id.size(), h2);
+  }
+  char buf[48];
+  sprintf(buf, "[%u files %08x%08x]", n, h1, h2);
+  return string(buf);
+}
+
+
+string
+CookedCacheFile::segmentPath(unsigned seg) {
+  char buf[32];
+  sprintf(buf, "_%u.cooked", seg);
+  return string(cacheDirectory) + "/" + keyHash + buf;
+}
+
+
+void
+CookedCacheFile::releaseSegment() {
+  if (mapBase) {
+#ifdef HAVE_MMAP
+    if (mapSize)
+      munmap(mapBase, mapSize);
+    else
+#endif
+      free(mapBase);
+  }
+  mapBase = NULL;
+  mapSize = 0;
+  frames = NULL;
+}
+
+
+bool
+CookedCacheFile::mapSegment(char const *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  char magic[COOK_MAGIC_LEN];
+  Uint32 header[COOK_HEADER_WORDS];
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      read(fd, magic, COOK_MAGIC_LEN) != COOK_MAGIC_LEN ||
+      memcmp(magic, COOK_MAGIC, COOK_MAGIC_LEN) ||
+      read(fd, header, sizeof(header)) != (ssize_t) sizeof(header) ||
+      header[0] != COOK_BYTE_ORDER || header[1] != COOK_VERSION ||
+      header[2] != _numContinuousFeatures || header[3] != _numDiscreteFeatures ||
+      header[5] != key.size())
+  {
+    close(fd);
+    return false;
+  }
+  unsigned nFrames = header[4];
+  size_t keyBytes   = (key.size() + 3) & ~(size_t)3;
+  size_t dataOffset = COOK_MAGIC_LEN + sizeof(header) + keyBytes;
+  size_t fileSize   = dataOffset + (size_t) nFrames * _numFeatures * sizeof(Data32);
+  if ((size_t) st.st_size != fileSize) {
+    close(fd);
+    return false;
+  }
+
+  void *base = NULL;
+  size_t size = 0;
+#ifdef HAVE_MMAP
+  base = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    base = NULL;
+  } else {
+    size = fileSize;
+  }
+#endif
+  if (!base) {
+    base = malloc(fileSize);
+    if (!base || pread(fd, base, fileSize, 0) != (ssize_t) fileSize) {
+      if (base) free(base);
+      close(fd);
+      return false;
+    }
+  }
+  close(fd);
+
+  if (memcmp((char *)base + COOK_MAGIC_LEN + sizeof(header), key.data(), key.size())) {
+    // a different key that hashes to the same name
+#ifdef HAVE_MMAP
+    if (size) munmap(base, size); else
+#endif
+    free(base);
+    return false;
+  }
+  mapBase   = base;
+  mapSize   = size;
+  frames    = (Data32 const *)((char *)base + dataOffset);
+  _numFrames = nFrames;
+  return true;
+}
+
+
+bool
+CookedCacheFile::saveSegment(unsigned seg, char const *path) {
+  char tmp[32];
+  sprintf(tmp, ".%lu.tmp", (unsigned long) getpid());
+  string tmpPath = string(path) + tmp;
+
+  unsigned nFrames = file->numLogicalFrames();
+  FILE *f = fopen(tmpPath.c_str(), "wb");
+  if (!f) {
+    if (!writeFailed)
+      warning("WARNING: can't write observation cache file '%s': %s\n", tmpPath.c_str(), strerror(errno));
+    writeFailed = true;
+    return false;
+  }
+  Uint32 header[COOK_HEADER_WORDS] =
+    { COOK_BYTE_ORDER, COOK_VERSION, _numContinuousFeatures, _numDiscreteFeatures, nFrames, (Uint32) key.size() };
+  char pad[4] = {0, 0, 0, 0};
+  bool ok = fwrite(COOK_MAGIC, 1, COOK_MAGIC_LEN, f) == COOK_MAGIC_LEN &&
+            fwrite(header, sizeof(header), 1, f) == 1 &&
+            fwrite(key.data(), 1, key.size(), f) == key.size() &&
+            fwrite(pad, 1, ((key.size() + 3) & ~(size_t)3) - key.size(), f) == ((key.size() + 3) & ~(size_t)3) - key.size();
+
+  unsigned framesPerGulp = COOK_GULP_BYTES / (_numFeatures * sizeof(Data32));
+  if (framesPerGulp == 0) framesPerGulp = 1;
+  for (unsigned first=0; ok && first < nFrames; first += framesPerGulp) {
+    unsigned count = nFrames - first < framesPerGulp ? nFrames - first : framesPerGulp;
+    Data32 const *buf = file->getLogicalFrames(first, count);
+    ok = fwrite(buf, sizeof(Data32) * _numFeatures, count, f) == count;
+  }
+  if (fclose(f) != 0) ok = false;
+  if (ok && rename(tmpPath.c_str(), path) != 0) ok = false;
+  if (!ok) {
+    if (!writeFailed)
+      warning("WARNING: failed to write observation cache file '%s': %s\n", path, strerror(errno));
+    writeFailed = true;
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  infoMsg(IM::ObsFile, IM::Med, "cached %u cooked frames of segment %u in %s\n", nFrames, seg, path);
+  return true;
+}
+
+
+bool
+CookedCacheFile::openSegment(unsigned seg) {
+  releaseSegment();
+  string path = segmentPath(seg);
+  if (mapSegment(path.c_str())) {
+    infoMsg(IM::ObsFile, IM::Med, "segment %u read from observation cache %s\n", seg, path.c_str());
+    return true;
+  }
+  // cache miss - cook the segment the slow way
+  if (!file->openLogicalSegment(seg)) return false;
+  _numFrames = file->numLogicalFrames();
+  if (saveSegment(seg, path.c_str())) {
+    // use the file we just wrote so the frames don't have to be cooked twice
+    if (mapSegment(path.c_str())) return true;
+  }
+  // couldn't use the cache, so read through to the underlying file
+  return true;
+}
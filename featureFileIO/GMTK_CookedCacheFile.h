@@ -0,0 +1,147 @@
+/*
+ * GMTK_CookedCacheFile.h
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#ifndef GMTK_COOKEDCACHEFILE_H
+#define GMTK_COOKEDCACHEFILE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string>
+using namespace std;
+
+#include "machine-dependent.h"
+#include "GMTK_ObservationFile.h"
+
+
+// This is an adaptor class that sits on top of the FilterFile /
+// MergeFile hierarchy built by instantiateFileSource() (see
+// GMTK_FileSource.h) and saves the "cooked" frames it produces
+// (after -transX, -fdiffactX, -preprX, -frX, -posttrans, -gpr,
+// etc.) in a cache directory, one file per segment. The next
+// time the segment is opened - by a later EM iteration or by a
+// different GMTK program with the same observation arguments -
+// the frames are mapped directly from the cache file and the
+// underlying files and filters are not touched at all.
+//
+// Cache files are named by a hash of a key string describing the
+// input files (name, size and modification time of each -ofX, of
+// the files named in a list file, and of the parameter files of
+// the transforms) and the full transformation specification. The
+// key itself is stored in each cache file, so hash collisions and
+// stale files are detected and simply rewritten. Note that a list
+// of N files takes N stat() calls each time the cache is set up.
+//
+// A cache file is written in native byte order with the layout
+//
+//   "GMTKCOOK" byteOrder version nFloats nInts nFrames keyLength
+//   key (padded to a multiple of 4 bytes)
+//   nFrames x (nFloats + nInts) Data32's
+//
+// so the frames can be used in place from a read-only mapping.
+// Files are written to a temporary name and renamed into place,
+// so concurrent jobs sharing a cache directory never see partial
+// files.
+
+class CookedCacheFile: public ObservationFile {
+
+  ObservationFile *file;     // the uncached transformation hierarchy
+  string           key;      // describes the input files and transforms
+  string           keyHash;  // hex hash of key, used to name the cache files
+
+  unsigned  _numFrames;      // in the current segment
+
+  // cached frames for the current segment, or NULL if they
+  // are being read directly from file
+  Data32 const *frames;
+  void         *mapBase;     // mapping (or buffer) holding frames
+  size_t        mapSize;     // in bytes; 0 if mapBase is malloc()ed
+
+  bool writeFailed;          // only warn about an unwritable cache once
+
+  // the cache file name for logical segment seg
+  string segmentPath(unsigned seg);
+
+  // try to use the cache file at path for the current segment
+  bool mapSegment(char const *path);
+
+  // write the frames of the (open) underlying segment seg to path
+  bool saveSegment(unsigned seg, char const *path);
+
+  void releaseSegment();
+
+ public:
+
+  // Directory to hold cooked observation files, or NULL to disable
+  // the cache (set by -obsCacheDir)
+  static char const *cacheDirectory;
+
+  // Takes ownership of file. key should identify everything that
+  // affects the frames file produces.
+  CookedCacheFile(ObservationFile *file, char const *key);
+
+  ~CookedCacheFile();
+
+  // Returns a string suitable for a cache key describing the identity
+  // (name, size, modification time) of the observation file name
+  static string fileIdentity(char const *name);
+
+  // Returns a short string suitable for a cache key, hashed from the
+  // identities of the n files named in names (which may have
+  // [startFrame:endFrame] sentence specifications)
+  static string listIdentity(unsigned n, char **names);
+
+  // Write segment to the file (no need to call endOfSegment)
+  void writeSegment(Data32 const *segment, unsigned nFrames) {
+    assert(0); // can't write to the cache
+  }
+
+  void setFrame(unsigned frame) {
+    assert(0); // can't write to the cache
+  }
+
+  void writeFrame(Data32 const *frame) {
+    assert(0); // can't write to the cache
+  }
+
+  void writeFeature(Data32 x) {
+    assert(0); // can't write to the cache
+  }
+
+  void endOfSegment() {
+    assert(0); // can't write to the cache
+  }
+
+  unsigned numSegments() {
+    return file->numLogicalSegments();
+  }
+
+  unsigned numFiles() {
+    return file->numFiles();
+  }
+
+  bool openSegment(unsigned seg);
+
+  unsigned numFrames() { return _numFrames; }
+
+  Data32 const *getFrames(unsigned first, unsigned count) {
+    assert(first + count <= _numFrames);
+    if (frames)
+      return frames + (size_t) first * _numFeatures;
+    return file->getLogicalFrames(first, count);
+  }
+
+  unsigned numLogicalContinuous() { return _numLogicalContinuousFeatures; }
+  unsigned numLogicalDiscrete()   { return _numLogicalDiscreteFeatures; }
+  unsigned numLogicalFeatures()   { return _numLogicalFeatures; }
+};
+
+#endif
@@ -30,6 +30,7 @@
 #include "GMTK_FileSourceNoCache.h"
 #include "GMTK_Filter.h"
 #include "GMTK_MergeFile.h"
+#include "GMTK_CookedCacheFile.h"
 #include "GMTK_ObservationArguments.h"
 
 
@@ -79,6 +80,51 @@ extern bool constantSpace;
     ( strncasecmp(var, "full", 5) == 0 ) || \
     ( strlen(var) == 0 ) )
 
+// The identities of the parameter files named in a transform
+// specification (the 'F@file' and 'A@file' transforms, see
+// parseTransform()).
+static string
+transformFilesIdentity(char const *spec) {
+  string id;
+  if (!spec) return id;
+  for (char const *p = strchr(spec, '@'); p; p = strchr(p, '@')) {
+    p += 1;
+    size_t len = strcspn(p, "_");
+    id += "|" + CookedCacheFile::fileIdentity(string(p, len).c_str());
+    p += len;
+  }
+  return id;
+}
+
+
+// Describe everything that determines the cooked frames, so that
+// the CookedCacheFile only reuses frames produced the same way.
+// dataIds[i] is obsFile[i]->dataIdentity().
+static string
+cookedCacheKey(unsigned nFiles, string const *dataIds) {
+  string key;
+  char buf[256];
+#define KEYSTR(s) ((s) ? (s) : "-")
+  for (unsigned i=0; i < nFiles; i+=1) {
+    key += CookedCacheFile::fileIdentity(ofs[i]) + dataIds[i];
+    key += transformFilesIdentity(Per_Stream_Transforms[i]);
+    sprintf(buf, "|%s %u %u %d %u %u|", fmts[i], nfs[i], nis[i], iswp[i], leftPad[i], rightPad[i]);
+    key += buf;
+    key += string(KEYSTR(prefrs[i])) + "|" + KEYSTR(preirs[i]) + "|" + KEYSTR(prepr[i]) + "|" +
+      KEYSTR(sr[i]) + "|" + KEYSTR(Per_Stream_Transforms[i]) + "|" + KEYSTR(frs[i]) + "|" +
+      KEYSTR(irs[i]) + "|" + KEYSTR(postpr[i]) + "\n";
+    sprintf(buf, "%u %u\n", Action_If_Diff_Num_Frames[i], Action_If_Diff_Num_Sents[i]);
+    key += buf;
+  }
+  sprintf(buf, "%u %u %d\n", nFiles, Ftr_Combo, Cpp_If_Ascii);
+  key += buf;
+  key += string(KEYSTR(cppCommandOptions)) + "|" + KEYSTR(Post_Transforms) + "|" + KEYSTR(gpr_str);
+  key += transformFilesIdentity(Post_Transforms);
+#undef KEYSTR
+  return key;
+}
+
+
 FileSource *
 instantiateFileSource() {
 
@@ -105,6 +151,7 @@ instantiateFileSource() {
   if (gpr_str && ALLOREMPTY(gpr_str)) gpr_str = NULL;
 
   ObservationFile *obsFile[MAX_NUM_OBS_FILES];
+  string dataIds[MAX_NUM_OBS_FILES];
   int lastFileIdx = -1;
   unsigned nFiles = 0;
   for (unsigned i=0; i < MAX_NUM_OBS_FILES; i+=1) {
@@ -113,6 +160,8 @@ instantiateFileSource() {
 				   Cpp_If_Ascii, cppCommandOptions, prefrs[i], preirs[i],
 				   prepr[i], sr[i], fmts[i], leftPad[i], rightPad[i]);
       assert(obsFile[i]);
+      if (CookedCacheFile::cacheDirectory)
+	dataIds[i] = obsFile[i]->dataIdentity();
       if ((unsigned)(lastFileIdx + 1) != i) {
 	error("Error: -of%d through -of%d are missing\n", lastFileIdx+2, i); // +1 for 0 offset, +1 to get next index
       }
@@ -147,6 +196,9 @@ instantiateFileSource() {
   } else {
     ff = mf;
   }
+  if (CookedCacheFile::cacheDirectory) {
+    ff = new CookedCacheFile(ff, cookedCacheKey(nFiles, dataIds).c_str());
+  }
   unsigned windowBytes = fileWindowSize * MEBIBYTE;
   infoMsg(IM::ObsFile, IM::Low, "windowBytes = %u MiB = %u B\n", fileWindowSize, windowBytes);
   infoMsg(IM::ObsFile, IM::Low, "fileBufferSize = %u\n", fileBufferSize);
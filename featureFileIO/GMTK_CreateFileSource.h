@@ -18,6 +18,7 @@
 #endif
 
 #include "GMTK_FileSource.h"
+#include "GMTK_CookedCacheFile.h"
 
 FileSource *instantiateFileSource();
 
@@ -170,22 +170,32 @@ FIRFilter::localTransform(Data32 const *inputSubMatrix,
   }
 
   if (B==NULL) {
-    B = new float[myOutput.numContinuous];
+    B = new float[(order+1) * myOutput.numContinuous];
     assert(B);
-    for (unsigned i=0; i < myOutput.numContinuous; i+=1)
+    for (unsigned i=0; i < (order+1) * myOutput.numContinuous; i+=1)
       B[i] = 1.0f;
   }
-  unsigned availableHistory = inputDescription.historyFrames;
-  for (unsigned outr=0; outr < myOutput.numFrames; outr+=1) {
-    float *outputRow = (float *)(buffer + outr * stride);
-    for (unsigned h=0; h <= availableHistory; h+=1) {
-      float *inputRow  = (float *)(inputSubMatrix + (outr + inputDescription.historyFrames - h) * stride);
-      for (unsigned j=0; j < myOutput.numContinuous; j+=1) {
-	outputRow[j] += inputRow[j] * (B + h * myOutput.numContinuous)[j];
+
+  // Convolve along time one lag at a time over the whole block, so
+  // the inner loop is a contiguous multiply-add over the features
+  // that the compiler can vectorize. Output row r is input row
+  // r + history, so it can see min(order, r + history) frames of
+  // history - rows near the start of a segment see fewer lags.
+  // The lags are accumulated in increasing order for every output,
+  // just as when the frames are filtered one at a time.
+  unsigned history = inputDescription.historyFrames;
+  unsigned nCont = myOutput.numContinuous;
+  for (unsigned h=0; h <= order; h+=1) {
+    float const *coef = B + h * nCont;
+    unsigned firstRow = h > history ? h - history : 0;
+    for (unsigned outr=firstRow; outr < myOutput.numFrames; outr+=1) {
+      float *outputRow = (float *)(buffer + outr * stride);
+      float const *inputRow = (float const *)(inputSubMatrix + (outr + history - h) * stride);
+      for (unsigned j=0; j < nCont; j+=1) {
+	outputRow[j] += inputRow[j] * coef[j];
       }
     }
   }
-  availableHistory = (availableHistory < order) ? availableHistory + 1  :  order;
 
   if (outputDescription) *outputDescription = myOutput;
   return buffer;
@@ -46,6 +46,14 @@
 // You should also update parseTransform() and instantiateFilters()
 // to facilitate command line argument parsing.
 
+// FileSource fills its cooked buffer in large blocks of frames (a
+// whole segment, or a -fileWindowSize window in constant space mode),
+// and FilterFile hands each block to localTransform() at once. So
+// localTransform() should loop over frames outside and features
+// inside (or hand the block to a matrix multiply, as AffineFilter
+// does), and must give the same output for a frame no matter how
+// the requested frames are split into blocks.
+
 class StreamSource;
 
 class Filter {
@@ -18,9 +18,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "error.h"
 #include "general.h"
+#include "debug.h"
 
 #include "file_utils.h"
 #include "GMTK_FlatASCIIFile.h"
@@ -45,6 +50,11 @@ FlatASCIIFile::FlatASCIIFile(const char *name, unsigned nfloats, unsigned nints,
     close(true)
 {
   buffer = NULL;
+  bufferFrames = 0;
+  segment = NULL;
+  dataFile = NULL;
+  scanner = NULL;
+  indexFromFile = false;
   fileName = name;
   writeFile = NULL;
   if (name == NULL) 	
@@ -56,144 +66,281 @@ FlatASCIIFile::FlatASCIIFile(const char *name, unsigned nfloats, unsigned nints,
   _numContinuousFeatures = nfloats; 
   _numDiscreteFeatures   = nints;
   _numFeatures           = nfloats + nints;
+  currSegment = -1;
+
+  if (!cppIfAscii) {
+    // Keep the file open and load each segment as it's opened.
+    dataFile = fopen(name, "r");
+    if (!dataFile)
+      error("FlatASCIIFile: couldn't open '%s' for reading\n", name);
+    scanner = new ASCIIScanner(dataFile);
+    if (readIndex()) {
+      indexFromFile = true;
+    } else {
+      scanSegments(*scanner);
+      writeIndex();
+    }
+  } else {
+    // A pipe from cpp can't seek, so count the frames and then read
+    // the whole file into memory.
+    FILE *f = openCPPableFile(name, cppIfAscii, cppCommandOptions);
+    if (!f)
+      error("FlatASCIIFile: couldn't open '%s' for reading\n", name);
+    {
+      ASCIIScanner in(f);
+      scanSegments(in);
+    }
+    closeCPPableFile(f, cppIfAscii);
+
+    unsigned totalFrames = 0;
+    for (unsigned seg=0; seg < nSegments; seg+=1)
+      totalFrames += nFrames[seg];
+    buffer = new Data32[totalFrames * _numFeatures];
+    if (!buffer) 
+      error("ERROR: FlatASCIIFile: unable to allocate memory for %u frames\n", totalFrames);
+    bufferFrames = totalFrames;
+    segment = new Data32 *[nSegments];
+    assert(segment);
+
+    // read file again, loading data into memory
+    f = openCPPableFile(name, cppIfAscii, cppCommandOptions);
+    if (!f)
+      error("FlatASCIIFile: couldn't open '%s' for reading\n", name);
+    ASCIIScanner in(f);
+    Data32 *dest = buffer;
+    for (unsigned seg=0; seg < nSegments; seg+=1) {
+      segment[seg] = dest;
+      for (unsigned frame=0; frame < nFrames[seg]; frame+=1, dest += _numFeatures) {
+	readFrame(in, seg, frame, dest);
+      }
+    }
+    closeCPPableFile(f, cppIfAscii);
+  }
 
-  FILE *f = openCPPableFile(name, cppIfAscii, cppCommandOptions);
-  if (!f)
-    error("FlatASCIIFile: couldn't open '%s' for reading\n", name);
+  if (contFeatureRangeStr) {
+    contFeatureRange = new Range(contFeatureRangeStr_,0,_numContinuousFeatures);
+    assert(contFeatureRange);
+    _numLogicalContinuousFeatures = contFeatureRange->length();
+  } else
+    _numLogicalContinuousFeatures = nfloats;
 
+  if (discFeatureRangeStr) {
+    discFeatureRange = new Range(discFeatureRangeStr_,0,_numDiscreteFeatures);
+    assert(discFeatureRange);
+    _numLogicalDiscreteFeatures = discFeatureRange->length();
+  } else
+    _numLogicalDiscreteFeatures = nints;
+  
+  _numLogicalFeatures = _numLogicalContinuousFeatures + _numLogicalDiscreteFeatures;
+
+  if (segRangeStr_)
+    segRange = new Range(segRangeStr_,0,nSegments);
+}
+
+
+void
+FlatASCIIFile::scanSegments(ASCIIScanner &in) {
   unsigned lineNum = 1;
-  unsigned totalFrames = 0;
   int prevSegment = -1, currSegment;
   int prevFrame=-1, currFrame;
-  int tmp;
-  nSegments = 0;
 
-  // consume CPP special directives if any
-#ifdef PIPE_ASCII_FILES_THROUGH_CPP
-  if(cppIfAscii) {
-    while((tmp=fgetc(f))==CPP_DIRECTIVE_CHAR) {
-      while((tmp=fgetc(f))!='\n');
-      lineNum++;
+  nFrames.clear();
+  segOffset.clear();
+  while (!in.atEOF()) {
+    // consume CPP special directives if any
+    if (cppIfAscii && in.peek() == CPP_DIRECTIVE_CHAR) {
+      in.skipLine();
+      lineNum += 1;
+      continue;
     }
-    ungetc(tmp,f);
-  }
-#endif
-
-  // read entire file once to count segments, frames per segment
-  while (!feof(f)) {
-    // read a frame
-    int nread = fscanf(f, "%d %d", &currSegment, &currFrame);
-    if (nread == EOF) break;
-    if (nread != 2) {
-      error("ERROR: FlatASCIIFile: error reading '%s'\n", name);
+    gmtk_off_t lineStart = in.offset();
+    if (!in.readInt(currSegment) || !in.readInt(currFrame)) {
+      error("ERROR: FlatASCIIFile: error reading '%s'\n", fileName);
     }
     if (currSegment != prevSegment) {
       if (currSegment != prevSegment+1)
 	error("ERROR: FlatASCIIFile: expected segment %d, but got %d at line %u in '%s'\n",
-	      prevSegment+1, currSegment, lineNum, name);
+	      prevSegment+1, currSegment, lineNum, fileName);
       if (currFrame != 0) 
 	error("ERROR: FlatASCIIFile: expected frame 0, but got %d at line %u in '%s'\n",
-	      currFrame, lineNum, name);
+	      currFrame, lineNum, fileName);
       if (prevSegment > -1) {
 	nFrames.push_back(prevFrame+1); // count of frames in previous segment
-	nSegments += 1;
       }
+      segOffset.push_back(lineStart);
       prevSegment = currSegment;
     } else {
       if (currFrame != prevFrame+1) 
 	error("ERROR: FlatASCIIFile: expected frame %d, but got %d at line %u in '%s'\n",
-	      prevFrame+1, currFrame, lineNum, name);
+	      prevFrame+1, currFrame, lineNum, fileName);
     }
     prevFrame = currFrame;
-    // skip rest of line
-    while((tmp=fgetc(f)) != '\n')
-      ;
+    in.skipLine();
     lineNum += 1;
-    totalFrames += 1;
   }
-  nSegments += 1;
   nFrames.push_back(prevFrame+1);
-  closeCPPableFile(f, cppIfAscii);
+  if (segOffset.size() == 0) segOffset.push_back(0); // empty file
+  nSegments = nFrames.size();
+}
 
-  buffer = new Data32[totalFrames * _numFeatures];
-  if (!buffer) 
-    error("ERROR: FlatASCIIFile: unable to allocate memory for %u frames\n", totalFrames);
-  segment = new Data32 *[nSegments];
-  assert(segment);
 
-  // read file again, loading data into memory
+#define FLAT_INDEX_MAGIC   "GMTK_FLATASCII_INDEX"
+#define FLAT_INDEX_VERSION 1
 
-  f = openCPPableFile(name, cppIfAscii, cppCommandOptions);
-  if (!f)
-    error("FlatASCIIFile: couldn't open '%s' for reading\n", name);
-  
-  lineNum = 1;
-  // consume CPP special directives if any
-#ifdef PIPE_ASCII_FILES_THROUGH_CPP
-  if(cppIfAscii) {
-    while((tmp=fgetc(f))==CPP_DIRECTIVE_CHAR) {
-      while((tmp=fgetc(f))!='\n');
-      lineNum++;
+string
+FlatASCIIFile::indexFileName() {
+  return string(fileName) + ".gmtkidx";
+}
+
+
+bool
+FlatASCIIFile::readIndex() {
+  struct stat st;
+  if (stat(fileName, &st) != 0) return false;
+  string idxName = indexFileName();
+  FILE *f = fopen(idxName.c_str(), "r");
+  if (!f) return false;
+
+  char magic[32];
+  unsigned version, n;
+  unsigned long size, mtime;
+  if (fscanf(f, "%31s %u %lu %lu %u", magic, &version, &size, &mtime, &n) != 5 ||
+      strcmp(magic, FLAT_INDEX_MAGIC) || version != FLAT_INDEX_VERSION ||
+      size != (unsigned long) st.st_size || mtime != (unsigned long) st.st_mtime || n == 0)
+  {
+    fclose(f);
+    return false;
+  }
+  nFrames.resize(n);
+  segOffset.resize(n);
+  for (unsigned i=0; i < n; i+=1) {
+    double offset;
+    if (fscanf(f, "%u %lf", &nFrames[i], &offset) != 2 || offset < 0 || offset > (double) st.st_size) {
+      fclose(f);
+      nFrames.clear();
+      segOffset.clear();
+      return false;
     }
-    ungetc(tmp,f);
+    segOffset[i] = (gmtk_off_t) offset;
   }
-#endif
+  fclose(f);
+  nSegments = n;
+  infoMsg(IM::ObsFile, IM::Low, "FlatASCIIFile: read %u segment offsets from '%s'\n", n, idxName.c_str());
+  return true;
+}
 
-  float *fDest;
-  Int32 *iDest = (Int32 *)buffer;
-  for (unsigned seg=0; seg < nSegments; seg+=1) {
-    fDest = (float *) iDest;
-    segment[seg] = (Data32 *) fDest;
-    //printf("seg %u  has %u frames\n",seg,nFrames[seg]);
-    for (unsigned frame=0; frame < nFrames[seg]; frame+=1) {
-      if (fscanf(f, "%d %d", &currSegment, &currFrame) != 2) {
-	error("ERROR: FlatASCIIFile: error reading '%s'\n", name);
-      }
-      if (currSegment != (int)seg) {
-	error("ERROR: FlatASCIIFile: expected segment %u but got segment %u in observation file '%s'\n",
-	      seg, currSegment, name);
-      }
-      if (currFrame != (int)frame) {
-	error("ERROR: FlatASCIIFile: expected frame %u but got frame %u in observation file '%s'\n",
-	      frame, currFrame, name);
-      }	
-      fDest = (float *) iDest;
-      for (unsigned n = 0; n < _numContinuousFeatures; n+=1) {
-	if (fscanf(f,"%e", fDest++) != 1) {
-	  error("ERROR: FlatASCIIFile: couldn't read %u'th float in segment %u, frame %u in observation file '%s'\n",
-		n, seg, frame, name);
-	}
-      }
-      iDest = (Int32 *)fDest;
-      for (unsigned n = 0; n < _numDiscreteFeatures; n+=1) {
-	if (fscanf(f,"%d", iDest++) != 1) {
-	error("ERROR: FlatASCIIFile: couldn't read %u'th int in segment %u, frame %u in observation file '%s'\n",
-	      n, seg, frame, name);
-	}
-      }
-      lineNum += 1;
+
+void
+FlatASCIIFile::writeIndex() {
+  struct stat st;
+  if (stat(fileName, &st) != 0) return;
+  string idxName = indexFileName();
+  char tmp[32];
+  sprintf(tmp, ".%lu.tmp", (unsigned long) getpid());
+  string tmpName = idxName + tmp;
+
+  // The index is only an optimization, so it's not an error if it
+  // can't be written (e.g., the data is on a read-only file system).
+  FILE *f = fopen(tmpName.c_str(), "w");
+  if (!f) {
+    infoMsg(IM::ObsFile, IM::Low, "FlatASCIIFile: can't write index '%s': %s\n", tmpName.c_str(), strerror(errno));
+    return;
+  }
+  bool ok = fprintf(f, "%s %u %lu %lu %u\n", FLAT_INDEX_MAGIC, FLAT_INDEX_VERSION,
+		    (unsigned long) st.st_size, (unsigned long) st.st_mtime, nSegments) > 0;
+  for (unsigned i=0; ok && i < nSegments; i+=1)
+    ok = fprintf(f, "%u %.0f\n", nFrames[i], (double) segOffset[i]) > 0;
+  if (fclose(f) != 0) ok = false;
+  if (ok && rename(tmpName.c_str(), idxName.c_str()) != 0) ok = false;
+  if (!ok) {
+    infoMsg(IM::ObsFile, IM::Low, "FlatASCIIFile: failed to write index '%s': %s\n", idxName.c_str(), strerror(errno));
+    unlink(tmpName.c_str());
+  }
+}
+
+
+bool
+FlatASCIIFile::readFrame(ASCIIScanner &in, unsigned seg, unsigned frame, Data32 *dest, bool strict) {
+  int currSegment, currFrame;
+
+  // consume CPP special directives if any
+  while (cppIfAscii && !in.atEOF() && in.peek() == CPP_DIRECTIVE_CHAR)
+    in.skipLine();
+  if (!in.readInt(currSegment) || !in.readInt(currFrame)) {
+    if (!strict) return false;
+    error("ERROR: FlatASCIIFile: error reading '%s'\n", fileName);
+  }
+  if (currSegment != (int)seg) {
+    if (!strict) return false;
+    error("ERROR: FlatASCIIFile: expected segment %u but got segment %u in observation file '%s'\n",
+	  seg, currSegment, fileName);
+  }
+  if (currFrame != (int)frame) {
+    if (!strict) return false;
+    error("ERROR: FlatASCIIFile: expected frame %u but got frame %u in observation file '%s'\n",
+	  frame, currFrame, fileName);
+  }	
+  float *fDest = (float *) dest;
+  for (unsigned n = 0; n < _numContinuousFeatures; n+=1) {
+    if (!in.readFloat(*fDest++)) {
+      error("ERROR: FlatASCIIFile: couldn't read %u'th float in segment %u, frame %u in observation file '%s'\n",
+	    n, seg, frame, fileName);
+    }
+  }
+  Int32 *iDest = (Int32 *) fDest;
+  for (unsigned n = 0; n < _numDiscreteFeatures; n+=1) {
+    if (!in.readInt(*iDest++)) {
+      error("ERROR: FlatASCIIFile: couldn't read %u'th int in segment %u, frame %u in observation file '%s'\n",
+	    n, seg, frame, fileName);
     }
   }
-  closeCPPableFile(f, cppIfAscii);
+  return true;
+}
 
-  if (contFeatureRangeStr) {
-    contFeatureRange = new Range(contFeatureRangeStr_,0,_numContinuousFeatures);
-    assert(contFeatureRange);
-    _numLogicalContinuousFeatures = contFeatureRange->length();
-  } else
-    _numLogicalContinuousFeatures = nfloats;
 
-  if (discFeatureRangeStr) {
-    discFeatureRange = new Range(discFeatureRangeStr_,0,_numDiscreteFeatures);
-    assert(discFeatureRange);
-    _numLogicalDiscreteFeatures = discFeatureRange->length();
-  } else
-    _numLogicalDiscreteFeatures = nints;
-  
-  _numLogicalFeatures = _numLogicalContinuousFeatures + _numLogicalDiscreteFeatures;
+bool
+FlatASCIIFile::loadSegment(unsigned seg) {
+  if (nFrames[seg] > bufferFrames) {
+    if (buffer) delete [] buffer;
+    buffer = new Data32[nFrames[seg] * _numFeatures];
+    if (!buffer) 
+      error("ERROR: FlatASCIIFile: unable to allocate memory for %u frames\n", nFrames[seg]);
+    bufferFrames = nFrames[seg];
+  }
+  if (!scanner->seek(segOffset[seg]))
+    error("ERROR: FlatASCIIFile: couldn't seek to segment %u in '%s'\n", seg, fileName);
+  Data32 *dest = buffer;
+  for (unsigned frame=0; frame < nFrames[seg]; frame+=1, dest += _numFeatures) {
+    if (!readFrame(*scanner, seg, frame, dest, !indexFromFile))
+      return false;
+  }
+  return true;
+}
 
-  if (segRangeStr_)
-    segRange = new Range(segRangeStr_,0,nSegments);
+
+bool
+FlatASCIIFile::openSegment(unsigned seg) {
+  assert(seg < nSegments);
+  if (!segment && !loadSegment(seg)) {
+    // The index file doesn't match the data (it was probably modified
+    // within the mtime resolution), so rebuild it.
+    warning("WARNING: FlatASCIIFile: index '%s' is out of date, rebuilding it\n", indexFileName().c_str());
+    indexFromFile = false;
+    scanner->seek(0);
+    scanSegments(*scanner);
+    writeIndex();
+    if (seg >= nSegments)
+      error("ERROR: FlatASCIIFile: segment %u not found in '%s'\n", seg, fileName);
+    loadSegment(seg);
+  }
+  currSegment = seg;
+  if (preFrameRange)
+    delete preFrameRange;
+  if (preFrameRangeStr) {
+    preFrameRange = new Range(preFrameRangeStr,0,nFrames[seg]);
+    assert(preFrameRange);
+  }
+  return true;
 }
 
 
@@ -208,7 +355,11 @@ FlatASCIIFile::FlatASCIIFile(const char *name, unsigned nfloats, unsigned nints)
   logicalObservationBuffer = NULL;
   logicalObsBufSize = 0;
   buffer = NULL;
+  bufferFrames = 0;
   segment = NULL;
+  dataFile = NULL;
+  scanner = NULL;
+  indexFromFile = false;
 
   nSegments = 0;
   currSegment = 0;
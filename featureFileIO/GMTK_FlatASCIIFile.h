@@ -31,7 +31,9 @@ using namespace std;
 #include "error.h"
 #include "general.h"
 
+#include "file_utils.h"
 #include "GMTK_ObservationFile.h"
+#include "GMTK_ASCIIScanner.h"
 
 
 // Reads in flat ASCII files, which consist of a single file
@@ -41,8 +43,16 @@ using namespace std;
 //
 // where S is the segment number, F is the frame number,
 // f_i are the continuous features and i_j are the 
-// discrete features. The entire file is read into
-// memory.
+// discrete features.
+//
+// The file is scanned once to find where each segment starts, and
+// openSegment() then seeks directly to the segment and parses only
+// its frames. The segment offsets are saved in a sidecar index file
+// (the file name with ".gmtkidx" appended) so later runs don't need
+// the scan at all; the index records the size and modification time
+// of the data file and is ignored (and rewritten) if they change.
+// Files run through cpp can't be seeked, so they are read entirely
+// into memory instead.
 
 class FlatASCIIFile: public ObservationFile {
 
@@ -55,12 +65,35 @@ class FlatASCIIFile: public ObservationFile {
   bool        cppIfAscii;
   char const *cppCommandOptions;
 
-  Data32     *buffer;              // data for current segment
-  Data32    **segment;             // the frames for the ith segment start at segment[i]
+  Data32     *buffer;              // data for current segment (or all segments if cpp'ed)
+  unsigned    bufferFrames;        // capacity of buffer in frames
+  Data32    **segment;             // the frames for the ith segment start at segment[i] (if cpp'ed)
+
+  vector<gmtk_off_t> segOffset;    // segOffset[i] is where the ith segment starts in the file
+  FILE         *dataFile;          // kept open to load segments on demand
+  ASCIIScanner *scanner;           // reads dataFile
+  bool          indexFromFile;     // segOffset came from the sidecar index file
 
   FILE       *writeFile;           // for writable files
   bool        close;
 
+  // scan the whole file to find the number of frames in and the
+  // starting offset of each segment
+  void scanSegments(ASCIIScanner &in);
+
+  // read/write the sidecar index file holding nFrames and segOffset
+  string indexFileName();
+  bool readIndex();
+  void writeIndex();
+
+  // Parse frame # frame of segment seg into dest. If strict is false,
+  // returns false (rather than failing) if the line has the wrong
+  // segment or frame number.
+  bool readFrame(ASCIIScanner &in, unsigned seg, unsigned frame, Data32 *dest, bool strict=true);
+
+  // load the current segment from dataFile into buffer
+  bool loadSegment(unsigned seg);
+
  public:
 
   FlatASCIIFile(const char *name, unsigned nfloats, unsigned nints, unsigned num, 
@@ -78,6 +111,8 @@ class FlatASCIIFile: public ObservationFile {
   ~FlatASCIIFile() {
     if (buffer) delete [] buffer;
     if (segment) delete [] segment;
+    if (scanner) delete scanner;
+    if (dataFile) fclose(dataFile);
     if (writeFile && close) {
       if (fclose(writeFile)) {
 	error("ERROR: '%s' %s\n", fileName, strerror(errno));
@@ -116,18 +151,8 @@ class FlatASCIIFile: public ObservationFile {
   // Call after last writeFrame of a segment
   void endOfSegment();
 
-  // Set the frame range for the segment
-  bool openSegment(unsigned seg) {
-    assert(seg < nSegments);
-    currSegment = seg;
-    if (preFrameRange)
-      delete preFrameRange;
-    if (preFrameRangeStr) {
-      preFrameRange = new Range(preFrameRangeStr,0,nFrames[seg]);
-      assert(preFrameRange);
-    }
-    return true;
-  }
+  // Load the segment (if necessary) and set its frame range
+  bool openSegment(unsigned seg);
 
   // The number of frames in the currently open segment.
   unsigned numFrames()  {
@@ -142,7 +167,9 @@ class FlatASCIIFile: public ObservationFile {
     assert(currSegment > -1); 
     assert(first < nFrames[currSegment]);
     assert(first + count <= nFrames[currSegment]);
-    return segment[currSegment] + first * _numFeatures;
+    if (segment) 
+      return segment[currSegment] + first * _numFeatures;
+    return buffer + first * _numFeatures;
   }
 
   // Number of continuous/discrete/total features in the file
@@ -34,6 +34,7 @@
 
 #include "file_utils.h"
 #include "GMTK_HTKFile.h"
+#include "GMTK_CookedCacheFile.h"
 
 using namespace std;
 
@@ -341,6 +342,13 @@ openHTKFile(StreamInfo *f, size_t sentno) {
 }
 
 
+string
+HTKFile::dataIdentity() {
+  assert(info);
+  return CookedCacheFile::listIdentity((unsigned) info->getFullFofSize(), info->dataNames);
+}
+
+
 bool 
 HTKFile::openSegment(unsigned seg) {
   assert(info);
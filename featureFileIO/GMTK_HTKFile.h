@@ -177,6 +177,9 @@ class HTKFile: public ObservationFile {
     return (unsigned) info->getFullFofSize();
   }
 
+  // The identities of the listed data files.
+  string dataIdentity();
+
   // The number of available logical segments.
   unsigned numLogicalSegments() {
     assert(info);
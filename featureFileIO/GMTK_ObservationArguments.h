@@ -45,6 +45,60 @@
 #endif // defined(GMTK_ARG_STREAMING_OUTPUT)
 
 
+#if defined(GMTK_ARG_FILE_OUTPUT)
+#if defined(GMTK_ARGUMENTS_DEFINITION)
+
+   char    *outputFileName      = NULL;
+   char    *outputListName      = NULL;
+   char    *outputFileFmt       = (char *)"compressed";
+   char    *outputNameSeparator = (char *)"_";
+   bool     outputSwap          = false;
+   unsigned compressBlockFrames = 256;
+   char    *compressTransform   = (char *)"xorshuffle";
+   unsigned compressPrecision   = 32;
+
+#elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
+
+  Arg("\n*** Output observation file ***\n"),
+  Arg("outputFile", Arg::Opt, outputFileName, "Write the observations to this file (name prefix for htk, binary, ascii) rather than as a stream to stdout"),
+  Arg("outputList", Arg::Opt, outputListName, "Output list file name (htk, binary, ascii)"),
+  Arg("outputFormat", Arg::Opt, outputFileFmt, "Output file format (htk,binary,ascii,flatascii,pfile,compressed)"),
+  Arg("outputSeparator", Arg::Opt, outputNameSeparator, "String to use as separator when writing htk, binary, or ascii segment files"),
+  Arg("outputSwap", Arg::Opt, outputSwap, "Do byte swapping when writing pfile, htk, or binary output"),
+  Arg("compressBlockFrames", Arg::Opt, compressBlockFrames, "Number of frames per independently compressed block (compressed output)"),
+  Arg("compressTransform", Arg::Opt, compressTransform, "Lossless transform applied before compression (none,xor,shuffle,xorshuffle)"),
+  Arg("compressPrecision", Arg::Opt, compressPrecision, "Bits per stored continuous feature: 32 (float), 16 (half), 8 (per-segment affine) (compressed output)"),
+
+#elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
+
+  if (outputFileName) {
+    int ofmt = formatStrToNumber(outputFileFmt);
+    if (ofmt < 0 || ofmt == HDF5) {
+      error("%s: unsupported output file format '%s'", argerr, outputFileFmt);
+    }
+    if ((ofmt == HTK || ofmt == RAWBIN || ofmt == RAWASC) && !outputListName) {
+      error("%s: -outputList is required for %s output files", argerr, outputFileFmt);
+    }
+  }
+  if (compressBlockFrames == 0) {
+    error("%s: -compressBlockFrames must be positive", argerr);
+  }
+  int compressFlags = blockTransformStrToFlags(compressTransform);
+  if (compressFlags < 0) {
+    error("%s: unknown -compressTransform '%s'", argerr, compressTransform);
+  }
+  CompressedFile::writeFramesPerBlock = compressBlockFrames;
+  if (compressPrecision != 32 && compressPrecision != 16 && compressPrecision != 8) {
+    error("%s: -compressPrecision must be 32, 16, or 8", argerr);
+  }
+  CompressedFile::writeTransform      = compressFlags;
+  CompressedFile::writePrecision      = compressPrecision;
+
+#else
+#endif
+#endif // defined(GMTK_ARG_FILE_OUTPUT)
+
+
 /*-----------------------------------------------------------------------------------------------------------*/
 /*************************************************************************************************************/
 /*************************************************************************************************************/
@@ -110,7 +164,7 @@ extern bool ObservationsAllowNan;
   Arg("inputNetByteOrder", Arg::Opt, inputNetByteOrder, "For binary input observation stream X, data is big-endian",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
   Arg("nf",  Arg::Opt,nfs,"Number of floats in observation stream X",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
   Arg("ni",  Arg::Opt,nis,"Number of ints in observation stream X",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
-  Arg("fmt", Arg::Opt,fmts,"Format (for files: htk,binary,ascii,flatascii,hdf5,pfile; for streams: binary,ascii) for observation stream X",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
+  Arg("fmt", Arg::Opt,fmts,"Format (for files: htk,binary,ascii,flatascii,hdf5,pfile,compressed; for streams: binary,ascii) for observation stream X",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
   Arg("startSkip",Arg::Opt,streamStartSkip,"Frames to skip at beginning (i.e., first frame is buff[startSkip])"),
   Arg("obsNAN",   Arg::Opt, ObservationsAllowNan," True if observation files allow FP NAN values"),
 
@@ -247,7 +301,7 @@ extern bool ObservationsAllowNan;
   Arg("os",  Arg::Opt,oss,"Input observation stream file name (- is stdin). Replace X with the stream number",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
   Arg("inputNetByteOrder", Arg::Opt, inputNetByteOrder, "For binary input observation stream X, data is big-endian",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
   Arg("of",  Arg::Opt,ofs,"Read observation stream X from non-stream file.",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
-  Arg("fmt", Arg::Opt,fmts,"Format (for files: htk,binary,ascii,flatascii,hdf5,pfile; for streams: binary,ascii) for observation stream X",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
+  Arg("fmt", Arg::Opt,fmts,"Format (for files: htk,binary,ascii,flatascii,hdf5,pfile,compressed; for streams: binary,ascii) for observation stream X",Arg::ARRAY,MAX_NUM_OBS_STREAMS),
   Arg("fileBufferSize", Arg::Opt,fileBufferSize,"Size in MB of the file observation frame buffer"),
   Arg("constantSpace", Arg::Opt,constantSpace,"Use only fileBufferSize memory to hold the observation data"),
   Arg("fileWindowSize", Arg::Opt,fileWindowSize, "Size in MB to load at once if constantSpace is active"),
@@ -390,7 +444,7 @@ extern bool ObservationsAllowNan;
 /*************************************************************************************************************/
 
 
-#if defined(GMTK_ARG_OBS_FILES)
+#if defined(GMTK_ARG_OBS_FILES) || defined(GMTK_ARG_OBS_FILES_OPT_ARG)
 #if defined(GMTK_ARGUMENTS_DEFINITION)
 
 #define DEFAULT_FILE_BUFFER_SIZE   (16)
@@ -457,6 +511,7 @@ extern bool ObservationsAllowNan;
    unsigned fileWindowSize = DEFAULT_FILE_WINDOW_SIZE;
    unsigned fileWindowDelta = DEFAULT_FILE_WINDOW_DELTA;
    bool constantSpace = false;
+   char *obsCacheDir = NULL;
 
 #ifdef INTV_WORDS_BIGENDIAN
    bool iswp[MAX_NUM_OBS_FILES] = {true,true,true,true,true};
@@ -471,14 +526,19 @@ extern bool ObservationsAllowNan;
 
   // observation input file handling
   Arg("\n*** Observation input file handling ***\n"),
+#ifdef GMTK_ARG_OBS_FILES_OPT_ARG
+  Arg("of",  Arg::Opt,ofs,"Observation File.  Replace X with the file number",Arg::ARRAY,MAX_NUM_OBS_FILES),
+#else
   Arg("of",  Arg::Req,ofs,"Observation File.  Replace X with the file number",Arg::ARRAY,MAX_NUM_OBS_FILES),
+#endif
   Arg("nf",  Arg::Opt,nfs,"Number of floats in observation file X",Arg::ARRAY,MAX_NUM_OBS_FILES),
   Arg("ni",  Arg::Opt,nis,"Number of ints in observation file X",Arg::ARRAY,MAX_NUM_OBS_FILES),
-  Arg("fmt", Arg::Opt,fmts,"Format (htk,binary,ascii,flatascii,hdf5,pfile) for observation file X",Arg::ARRAY,MAX_NUM_OBS_FILES),
+  Arg("fmt", Arg::Opt,fmts,"Format (htk,binary,ascii,flatascii,hdf5,pfile,compressed) for observation file X",Arg::ARRAY,MAX_NUM_OBS_FILES),
   Arg("fileBufferSize", Arg::Opt,fileBufferSize,"Size in MB of the file observation frame buffer"),
   Arg("constantSpace", Arg::Opt,constantSpace,"Use only fileBufferSize memory to hold the observation data"),
   Arg("fileWindowSize", Arg::Opt,fileWindowSize, "Size in MB to load at once if constantSpace is active"),
   Arg("fileWindowDelta", Arg::Opt,fileWindowDelta, "How close (in frames) from the edge of the current window triggers loading more frames"),    
+  Arg("obsCacheDir", Arg::Opt,obsCacheDir, "Directory in which to cache transformed observations for reuse by later passes and programs"),
   Arg("iswp",Arg::Opt,iswp,"Endian swap condition for observation file X",Arg::ARRAY,MAX_NUM_OBS_FILES),
   Arg("prefr",  Arg::Opt,prefrs,"Float range for observation file X (before transforms)",Arg::ARRAY,MAX_NUM_OBS_FILES),
   Arg("preir",  Arg::Opt,preirs,"Int range for observation file X",Arg::ARRAY,MAX_NUM_OBS_FILES),
@@ -517,6 +577,8 @@ extern bool ObservationsAllowNan;
       ifmts[i] = HDF5;
     else if (strcmp(fmts[i],"pfile") == 0)
       ifmts[i] = PFILE;
+    else if (strcmp(fmts[i],"compressed") == 0)
+      ifmts[i] = CMPBIN;
     else
       error("%s: Unknown observation file format type: '%s'\n",argerr,fmts[i]);
 
@@ -574,9 +636,13 @@ extern bool ObservationsAllowNan;
     error("%s: must specify 'left', 'center', or 'right' for -justification",argerr);
   }
 
+  if (obsCacheDir && strlen(obsCacheDir) > 0) {
+    CookedCacheFile::cacheDirectory = obsCacheDir;
+  }
+
 #else
 #endif
-#endif // defined(GMTK_ARG_OBS_FILES)
+#endif // defined(GMTK_ARG_OBS_FILES) || defined(GMTK_ARG_OBS_FILES_OPT_ARG)
 
 
 
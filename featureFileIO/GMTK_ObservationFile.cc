@@ -27,6 +27,7 @@
 #include "GMTK_HTKFile.h"
 #include "GMTK_HDF5File.h"
 #include "GMTK_BinaryFile.h"
+#include "GMTK_CompressedFile.h"
 
 unsigned 
 ObservationFile::numLogicalSegments() {
@@ -189,6 +190,9 @@ instantiateFile(unsigned ifmt, char *ofs, unsigned nfs, unsigned nis,
     obsFile = new BinaryFile(ofs, nfs, nis, number, iswp, Cpp_If_Ascii, cppCommandOptions,
 			     frs, irs, prepr, sr, leftPad, rightPad);
     break;
+  case CMPBIN:
+    obsFile = new CompressedFile(ofs, nfs, nis, number, frs, irs, prepr, sr, leftPad, rightPad);
+    break;
   default:
     error("ERROR: Unknown observation file format type: '%s'\n", ifmtStr);
   }
@@ -215,6 +219,8 @@ instantiateWriteFile(char *listFileName, char *outputFileName, char *outputNameS
     return new FlatASCIIFile(outputFileName, nfs, nis);
   case RAWBIN:
     return new BinaryFile(listFileName, outputFileName, outputNameSeparator, swap, nfs, nis);
+  case CMPBIN:
+    return new CompressedFile(outputFileName, nfs, nis);
   default:
     error("ERROR: Unknown output file format type: '%s'\n", fmt);
   }
@@ -235,6 +241,8 @@ formatStrToNumber(char const *fmt) {
     return HDF5;
   else if (strcmp(fmt,"pfile") == 0)
     return PFILE;
+  else if (strcmp(fmt,"compressed") == 0)
+    return CMPBIN;
   return -1;
 }
 
@@ -19,6 +19,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string>
 
 #include "error.h"
 #include "machine-dependent.h"
@@ -69,6 +70,7 @@
 //   HDF5File     
 //   HTKFile      
 //   BinaryFile   
+//   CompressedFile -  block-compressed segments with a seek index
 //   FilterFile    -   ObservationFile wrapper for IIR, FIR, etc transforms
 //   MergeFile     -   Combines multiple ObservationFiles into a single 
 //                     logical file
@@ -156,6 +158,12 @@ class ObservationFile {
   virtual char const *obsFileName() {return observationFileName;}
   virtual unsigned    obsFileNum()  {return observationFileNum; }
 
+  // Describes the files the frames are read from, other than the
+  // observation file itself (e.g., the files named in a list file),
+  // so that a cache of the frames can tell when they change. See
+  // CookedCacheFile.
+  virtual std::string dataIdentity() { return std::string(); }
+
   // Set frame # to write within current segemnt
   // note this only works for file formats that support random access
   virtual void setFrame(unsigned frame) = 0;
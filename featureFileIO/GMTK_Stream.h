@@ -45,7 +45,8 @@ enum {
   PFILE,
   HTK,
   FLATBIN,
-  HDF5
+  HDF5,
+  CMPBIN
 };
 
 
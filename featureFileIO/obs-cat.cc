@@ -48,6 +48,8 @@ static const char * gmtk_version_id = "GMTK Version 0.2b Tue Jan 20 22:59:41 200
 #include "GMTK_HTKFile.h"
 #include "GMTK_HDF5File.h"
 #include "GMTK_BinaryFile.h"
+#include "GMTK_CompressedFile.h"
+#include "GMTK_BlockCodec.h"
 #include "GMTK_Filter.h"
 #include "GMTK_FilterFile.h"
 #include "GMTK_FIRFilter.h"
@@ -64,6 +66,7 @@ RAND rnd(false);
 #define GMTK_ARG_VERSION
 #define GMTK_ARG_STREAM_AND_FILE_INPUT
 #define GMTK_ARG_STREAMING_OUTPUT
+#define GMTK_ARG_FILE_OUTPUT
 #define GMTK_ARGUMENTS_DEFINITION
 #include "ObsArguments.h"
 #undef GMTK_ARGUMENTS_DEFINITION
@@ -227,10 +230,12 @@ main(int argc, char *argv[]) {
   bool machineBigEndian = getWordOrganization() == BYTE_BIG_ENDIAN;
   bool needOutputSwap   = machineBigEndian != outputNetByteOrder;
 
-  if (binaryOutputStream) {
-    printf("%s%s", GMTK_BIN_PROTOCOL_COOKIE, GMTK_BIN_PROTOCOL_VERSION);
-  } else {
-    printf("%s%s", GMTK_ASC_PROTOCOL_COOKIE, GMTK_ASC_PROTOCOL_VERSION);
+  if (!outputFileName) {
+    if (binaryOutputStream) {
+      printf("%s%s", GMTK_BIN_PROTOCOL_COOKIE, GMTK_BIN_PROTOCOL_VERSION);
+    } else {
+      printf("%s%s", GMTK_ASC_PROTOCOL_COOKIE, GMTK_ASC_PROTOCOL_VERSION);
+    }
   }
   
   ObservationStream *obsStream[MAX_NUM_OBS_STREAMS] = {NULL,NULL,NULL,NULL,NULL};
@@ -268,7 +273,17 @@ main(int argc, char *argv[]) {
   }
 
   StreamSource *source = new StreamSource(nStreams, obsStream, streamBufferSize, Post_Transforms, startSkip);
-  sendFeatureCounts(source, binaryOutputStream, needOutputSwap);
+  // With -outputFile we convert to an ObservationFile (e.g., the
+  // compressed format) instead of writing the stream protocol.
+  ObservationFile *outFile = NULL;
+  if (outputFileName) {
+    outFile = instantiateWriteFile(outputListName, outputFileName, outputNameSeparator,
+				   outputFileFmt, source->numContinuous(), source->numDiscrete(),
+				   outputSwap);
+    assert(outFile);
+  } else {
+    sendFeatureCounts(source, binaryOutputStream, needOutputSwap);
+  }
 
   unsigned segNum = 0;
   unsigned frmNum = 0;
@@ -285,12 +300,21 @@ main(int argc, char *argv[]) {
 	assert(frame == NULL);
 	continue;
       }
-      sendFrame(frame, segNum, frmNum, source->numContinuous(), source->numDiscrete(),
-		binaryOutputStream, needOutputSwap);
+      if (outFile) {
+	outFile->writeFrame(frame);
+      } else {
+	sendFrame(frame, segNum, frmNum, source->numContinuous(), source->numDiscrete(),
+		  binaryOutputStream, needOutputSwap);
+      }
       source->enqueueFrames(1);
     }
-    printf("%s", binaryOutputStream ? "E" : "E\n");
+    if (outFile) {
+      outFile->endOfSegment();
+    } else {
+      printf("%s", binaryOutputStream ? "E" : "E\n");
+    }
   }
+  if (outFile) delete outFile;
 
   exit(0);
 }
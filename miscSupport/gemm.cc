@@ -0,0 +1,672 @@
+/*
+ * gemm.cc - GMTK's internal cache-blocked, multi-threaded matrix
+ *           multiply. See gemm.h.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ * The multiply follows the usual Goto/BLIS layout: for each KC x NC
+ * panel of op(B) and each MC x KC block of op(A), both are copied
+ * ("packed") into contiguous buffers, op(A) in slivers of MR rows and
+ * op(B) in slivers of NR columns, so that a micro-kernel can compute
+ * an MR x NR tile of C in registers while streaming through the two
+ * slivers. The tile sizes depend on the vector width, so there is one
+ * kernel per instruction set; the one to use is chosen at run time
+ * from what the CPU supports. The code is written with GCC vector
+ * extensions, and only the generic kernel is built by other compilers.
+ *
+ * Products big enough to be worth it are split into column (or row)
+ * ranges of C, each done by its own thread with its own buffers.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#if defined(_POSIX_THREADS) && _POSIX_THREADS > 0
+#  define GEMM_THREADS 1
+#  include <pthread.h>
+#endif
+
+#include "gemm.h"
+#include "error.h"
+
+#if defined(__GNUC__)
+#  define GEMM_VECTORS 1
+#  define GEMM_INLINE inline __attribute__((always_inline))
+#else
+#  define GEMM_INLINE inline
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define GEMM_X86_DISPATCH 1
+#  define GEMM_TARGET(t) __attribute__((target(t)))
+#endif
+
+// Block sizes, in elements. GEMM_MC must be a multiple of every
+// kernel's MR; the packed op(A) block (MC x KC) is meant to stay in
+// the L2 cache and a packed KC x NR sliver of op(B) in L1.
+#define GEMM_MC 192
+#define GEMM_KC 256
+#define GEMM_NC 3072
+
+// Products of fewer multiply-adds than this per thread are not
+// worth starting a thread for.
+#define GEMM_MIN_THREAD_WORK (1 << 20)
+
+static unsigned gemmMaxThreads = 0;
+
+static inline int
+imin(int a, int b) {
+  return a < b ? a : b;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//                    Packing
+//////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct GemmOperands {
+  bool transA, transB;
+  int M, N, K;
+  T alpha;
+  const T *A;
+  int lda;
+  const T *B;
+  int ldb;
+  T beta;
+  T *C;
+  int ldc;
+};
+
+
+// Copy rows [i0,i0+mc) and columns [k0,k0+kc) of op(A) into pa, as
+// slivers of MR rows stored k by k. Short slivers are zero padded.
+template <typename T>
+static void
+packA(const GemmOperands<T> &op, int MR, int i0, int mc, int k0, int kc, T *pa)
+{
+  for (int ir = 0; ir < mc; ir += MR) {
+    int mr = imin(MR, mc - ir);
+    if (mr < MR)
+      memset(pa, 0, (size_t)MR * kc * sizeof(T));
+    if (op.transA) {
+      for (int i = 0; i < mr; i++) {
+	const T *a = op.A + k0 + (size_t)(i0 + ir + i) * op.lda;
+	for (int k = 0; k < kc; k++)
+	  pa[k * MR + i] = a[k];
+      }
+    } else {
+      for (int k = 0; k < kc; k++) {
+	const T *a = op.A + i0 + ir + (size_t)(k0 + k) * op.lda;
+	memcpy(pa + k * MR, a, mr * sizeof(T));
+      }
+    }
+    pa += (size_t)MR * kc;
+  }
+}
+
+
+// Copy rows [k0,k0+kc) and columns [j0,j0+nc) of op(B) into pb, as
+// slivers of NR columns stored k by k. Short slivers are zero padded.
+template <typename T>
+static void
+packB(const GemmOperands<T> &op, int NR, int k0, int kc, int j0, int nc, T *pb)
+{
+  for (int jr = 0; jr < nc; jr += NR) {
+    int nr = imin(NR, nc - jr);
+    if (nr < NR)
+      memset(pb, 0, (size_t)NR * kc * sizeof(T));
+    if (op.transB) {
+      for (int k = 0; k < kc; k++) {
+	const T *b = op.B + j0 + jr + (size_t)(k0 + k) * op.ldb;
+	memcpy(pb + k * NR, b, nr * sizeof(T));
+      }
+    } else {
+      for (int j = 0; j < nr; j++) {
+	const T *b = op.B + k0 + (size_t)(j0 + jr + j) * op.ldb;
+	for (int k = 0; k < kc; k++)
+	  pb[k * NR + j] = b[k];
+      }
+    }
+    pb += (size_t)NR * kc;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//                    Kernels
+//////////////////////////////////////////////////////////////////////
+
+#if defined(GEMM_VECTORS)
+
+// Compute the MR x NR (MR = W*MV) tile ab = pa * pb from a packed
+// sliver of op(A) and one of op(B), holding the tile in NR*MV vector
+// registers of W elements each.
+template <typename T, int W, int MV, int NR>
+static GEMM_INLINE void
+microKernel(int kc, const T *pa, const T *pb, T *ab)
+{
+  typedef T V __attribute__((vector_size(W * sizeof(T))));
+  // for loads from addresses only aligned to T
+  typedef T U __attribute__((vector_size(W * sizeof(T)), aligned(sizeof(T))));
+  V zero;
+  memset(&zero, 0, sizeof(zero));
+  V c[NR][MV];
+  for (int j = 0; j < NR; j++)
+    for (int v = 0; v < MV; v++)
+      c[j][v] = zero;
+  for (int k = 0; k < kc; k++) {
+    V a[MV];
+    for (int v = 0; v < MV; v++)
+      a[v] = *(const U *)(pa + v * W);
+    for (int j = 0; j < NR; j++) {
+      // (x - 0 is x, so this is just a broadcast)
+      V b = pb[j] - zero;
+      for (int v = 0; v < MV; v++)
+	c[j][v] += a[v] * b;
+    }
+    pa += W * MV;
+    pb += NR;
+  }
+  memcpy(ab, c, sizeof(c));
+}
+
+
+// sum of a[k]*x[k] over k < n
+template <typename T, int W>
+static GEMM_INLINE T
+dot(int n, const T *a, const T *x)
+{
+  typedef T V __attribute__((vector_size(W * sizeof(T))));
+  typedef T U __attribute__((vector_size(W * sizeof(T)), aligned(sizeof(T))));
+  V s[4];
+  memset(s, 0, sizeof(s));
+  int k = 0;
+  for (; k + 4 * W <= n; k += 4 * W) {
+    for (int u = 0; u < 4; u++)
+      s[u] += *(const U *)(a + k + u * W) * *(const U *)(x + k + u * W);
+  }
+  V t = (s[0] + s[1]) + (s[2] + s[3]);
+  T sum = 0;
+  for (int l = 0; l < W; l++)
+    sum += t[l];
+  for (; k < n; k++)
+    sum += a[k] * x[k];
+  return sum;
+}
+
+#else
+
+template <typename T, int W, int MV, int NR>
+static GEMM_INLINE void
+microKernel(int kc, const T *pa, const T *pb, T *ab)
+{
+  const int MR = W * MV;
+  T c[NR * MR];
+  for (int i = 0; i < NR * MR; i++)
+    c[i] = 0;
+  for (int k = 0; k < kc; k++) {
+    for (int j = 0; j < NR; j++)
+      for (int i = 0; i < MR; i++)
+	c[j * MR + i] += pa[i] * pb[j];
+    pa += MR;
+    pb += NR;
+  }
+  memcpy(ab, c, sizeof(c));
+}
+
+template <typename T, int W>
+static GEMM_INLINE T
+dot(int n, const T *a, const T *x)
+{
+  T sum = 0;
+  for (int k = 0; k < n; k++)
+    sum += a[k] * x[k];
+  return sum;
+}
+
+#endif
+
+
+// C[i0.., j0..] += alpha * op(A) op(B) over the given ranges of C,
+// using pa (GEMM_MC x GEMM_KC) and pb (GEMM_KC x GEMM_NC, rounded up to
+// NR columns) as the packing buffers.
+template <typename T, int W, int MV, int NR>
+static GEMM_INLINE void
+blockedGemm(const GemmOperands<T> &op, int i0, int i1, int j0, int j1, T *pa, T *pb)
+{
+  const int MR = W * MV;
+  T ab[MR * NR];
+  for (int jc = j0; jc < j1; jc += GEMM_NC) {
+    int nc = imin(GEMM_NC, j1 - jc);
+    for (int pc = 0; pc < op.K; pc += GEMM_KC) {
+      int kc = imin(GEMM_KC, op.K - pc);
+      packB(op, NR, pc, kc, jc, nc, pb);
+      for (int ic = i0; ic < i1; ic += GEMM_MC) {
+	int mc = imin(GEMM_MC, i1 - ic);
+	packA(op, MR, ic, mc, pc, kc, pa);
+	for (int jr = 0; jr < nc; jr += NR) {
+	  int nr = imin(NR, nc - jr);
+	  const T *bs = pb + (size_t)jr * kc;
+	  for (int ir = 0; ir < mc; ir += MR) {
+	    int mr = imin(MR, mc - ir);
+	    microKernel<T, W, MV, NR>(kc, pa + (size_t)ir * kc, bs, ab);
+	    T *c = op.C + ic + ir + (size_t)(jc + jr) * op.ldc;
+	    for (int j = 0; j < nr; j++, c += op.ldc)
+	      for (int i = 0; i < mr; i++)
+		c[i] += op.alpha * ab[j * MR + i];
+	  }
+	}
+      }
+    }
+  }
+}
+
+
+// y = alpha * op(A) x + beta * y, for N == 1 (x is contiguous)
+template <typename T, int W>
+static GEMM_INLINE void
+gemv(const GemmOperands<T> &op, const T *x)
+{
+  T *y = op.C;
+  if (op.transA) {
+    for (int i = 0; i < op.M; i++) {
+      T s = op.alpha * dot<T, W>(op.K, op.A + (size_t)i * op.lda, x);
+      y[i] = (op.beta == 0) ? s : s + op.beta * y[i];
+    }
+  } else {
+    if (op.beta == 0)
+      memset(y, 0, op.M * sizeof(T));
+    else if (op.beta != 1)
+      for (int i = 0; i < op.M; i++)
+	y[i] *= op.beta;
+    for (int k = 0; k < op.K; k++) {
+      T s = op.alpha * x[k];
+      const T *a = op.A + (size_t)k * op.lda;
+      for (int i = 0; i < op.M; i++)
+	y[i] += s * a[i];
+    }
+  }
+}
+
+
+template <typename T>
+struct GemmKernel {
+  const char *name;
+  int MR, NR;
+  void (*gemm)(const GemmOperands<T> &, int, int, int, int, T *, T *);
+  void (*gemv)(const GemmOperands<T> &, const T *);
+};
+
+// Define the gemm and gemv functions of one kernel, compiled for
+// the given target.
+#define GEMM_DEFINE_KERNEL(NAME, TARGET, T, W, MV, NR)				\
+  static TARGET void								\
+  NAME##_gemm(const GemmOperands<T> &op, int i0, int i1, int j0, int j1, T *pa, T *pb) \
+  {										\
+    blockedGemm<T, W, MV, NR>(op, i0, i1, j0, j1, pa, pb);			\
+  }										\
+  static TARGET void								\
+  NAME##_gemv(const GemmOperands<T> &op, const T *x)				\
+  {										\
+    gemv<T, W>(op, x);								\
+  }
+
+#define GEMM_NO_TARGET
+
+// 16 byte vectors are available everywhere GCC vectors are (SSE2 on
+// x86-64, NEON, ...) and are otherwise split into scalars.
+GEMM_DEFINE_KERNEL(generic_d, GEMM_NO_TARGET, double, 2, 2, 4)
+GEMM_DEFINE_KERNEL(generic_s, GEMM_NO_TARGET, float,  4, 2, 4)
+#if defined(GEMM_X86_DISPATCH)
+GEMM_DEFINE_KERNEL(avx2_d, GEMM_TARGET("avx2,fma"), double, 4, 2, 6)
+GEMM_DEFINE_KERNEL(avx2_s, GEMM_TARGET("avx2,fma"), float,  8, 2, 6)
+GEMM_DEFINE_KERNEL(avx512_d, GEMM_TARGET("avx512f"), double, 8, 2, 12)
+GEMM_DEFINE_KERNEL(avx512_s, GEMM_TARGET("avx512f"), float, 16, 2, 12)
+#endif
+
+static const GemmKernel<double> doubleKernels[] = {
+  { "generic", 4, 4, generic_d_gemm, generic_d_gemv },
+#if defined(GEMM_X86_DISPATCH)
+  { "avx2", 8, 6, avx2_d_gemm, avx2_d_gemv },
+  { "avx512", 16, 12, avx512_d_gemm, avx512_d_gemv },
+#endif
+};
+
+static const GemmKernel<float> floatKernels[] = {
+  { "generic", 8, 4, generic_s_gemm, generic_s_gemv },
+#if defined(GEMM_X86_DISPATCH)
+  { "avx2", 16, 6, avx2_s_gemm, avx2_s_gemv },
+  { "avx512", 32, 12, avx512_s_gemm, avx512_s_gemv },
+#endif
+};
+
+
+// The best kernel this CPU can run: an index into the kernel tables.
+static unsigned
+cpuKernel()
+{
+  static int level = -1;
+  if (level < 0) {
+    int l = 0;
+#if defined(GEMM_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      l = 2;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      l = 1;
+#endif
+    level = l;
+  }
+  return (unsigned) level;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//                    Driver
+//////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct GemmTask {
+  const GemmKernel<T> *kernel;
+  const GemmOperands<T> *op;
+  int i0, i1, j0, j1;
+};
+
+
+// Do one range of C: scale it by beta, then add alpha op(A) op(B).
+template <typename T>
+static void
+runTask(const GemmTask<T> &t)
+{
+  const GemmOperands<T> &op = *t.op;
+  for (int j = t.j0; j < t.j1; j++) {
+    T *c = op.C + (size_t)j * op.ldc;
+    if (op.beta == 0) {
+      memset(c + t.i0, 0, (t.i1 - t.i0) * sizeof(T));
+    } else if (op.beta != 1) {
+      for (int i = t.i0; i < t.i1; i++)
+	c[i] *= op.beta;
+    }
+  }
+  if (op.K == 0 || op.alpha == 0)
+    return;
+
+  int NR = t.kernel->NR;
+  int nc = imin(GEMM_NC, t.j1 - t.j0);
+  size_t paSize = (size_t)GEMM_MC * GEMM_KC;
+  size_t pbSize = (size_t)GEMM_KC * ((nc + NR - 1) / NR) * NR;
+  T *pa = (T *) malloc((paSize + pbSize) * sizeof(T));
+  if (pa == NULL)
+    error("ERROR: out of memory in matrix multiply of %d x %d by %d x %d", op.M, op.K, op.K, op.N);
+  t.kernel->gemm(op, t.i0, t.i1, t.j0, t.j1, pa, pa + paSize);
+  free(pa);
+}
+
+
+#if defined(GEMM_THREADS)
+template <typename T>
+static void *
+taskThread(void *arg)
+{
+  runTask(*(GemmTask<T> *)arg);
+  return NULL;
+}
+#endif
+
+
+template <typename T>
+static void
+gemm(const GemmKernel<T> &kernel, char transA, char transB, int M, int N, int K,
+     T alpha, const T *A, int lda, const T *B, int ldb, T beta, T *C, int ldc)
+{
+  if (M <= 0 || N <= 0)
+    return;
+
+  GemmOperands<T> op;
+  op.transA = (transA == 't' || transA == 'T');
+  op.transB = (transB == 't' || transB == 'T');
+  op.M = M; op.N = N; op.K = K;
+  op.alpha = alpha;
+  op.A = A; op.lda = lda;
+  op.B = B; op.ldb = ldb;
+  op.beta = beta;
+  op.C = C; op.ldc = ldc;
+
+  if (N == 1 && K > 0) {
+    if (!op.transB) {
+      kernel.gemv(op, B);
+    } else {
+      T *x = (T *) malloc(K * sizeof(T));
+      if (x == NULL)
+	error("ERROR: out of memory in matrix multiply of %d x %d by %d x 1", M, K, K);
+      for (int k = 0; k < K; k++)
+	x[k] = B[(size_t)k * ldb];
+      kernel.gemv(op, x);
+      free(x);
+    }
+    return;
+  }
+
+  // Split the larger of the dimensions of C over the threads, in
+  // multiples of the kernel's tile size.
+  unsigned numThreads = 1;
+#if defined(GEMM_THREADS)
+  double work = (double)M * N * K;
+  numThreads = gmtk_gemm_threads();
+  if (work / numThreads < GEMM_MIN_THREAD_WORK)
+    numThreads = (unsigned)(work / GEMM_MIN_THREAD_WORK);
+  bool splitN = (N / kernel.NR >= M / kernel.MR);
+  int tile = splitN ? kernel.NR : kernel.MR;
+  int numTiles = ((splitN ? N : M) + tile - 1) / tile;
+  if ((int)numThreads > numTiles)
+    numThreads = numTiles;
+#endif
+  if (numThreads <= 1) {
+    GemmTask<T> t = { &kernel, &op, 0, M, 0, N };
+    runTask(t);
+    return;
+  }
+
+#if defined(GEMM_THREADS)
+  GemmTask<T> *tasks = new GemmTask<T>[numThreads];
+  pthread_t *threads = new pthread_t[numThreads];
+  bool *started = new bool[numThreads];
+  for (unsigned t = 0; t < numThreads; t++) {
+    int first = (int)((long)numTiles * t / numThreads) * tile;
+    int last = (int)((long)numTiles * (t + 1) / numThreads) * tile;
+    tasks[t].kernel = &kernel;
+    tasks[t].op = &op;
+    tasks[t].i0 = splitN ? 0 : first;
+    tasks[t].i1 = splitN ? M : imin(last, M);
+    tasks[t].j0 = splitN ? first : 0;
+    tasks[t].j1 = splitN ? imin(last, N) : N;
+  }
+  // the calling thread does the first range itself; if a thread
+  // can't be started, its range is done here too
+  for (unsigned t = 1; t < numThreads; t++)
+    started[t] = (pthread_create(&threads[t], NULL, taskThread<T>, &tasks[t]) == 0);
+  runTask(tasks[0]);
+  for (unsigned t = 1; t < numThreads; t++) {
+    if (started[t])
+      pthread_join(threads[t], NULL);
+    else
+      runTask(tasks[t]);
+  }
+  delete [] started;
+  delete [] threads;
+  delete [] tasks;
+#endif
+}
+
+
+void
+gmtk_dgemm(char transA, char transB, int M, int N, int K,
+	   double alpha, const double *A, int lda,
+	   const double *B, int ldb,
+	   double beta, double *C, int ldc)
+{
+  gemm(doubleKernels[cpuKernel()], transA, transB, M, N, K,
+       alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+
+void
+gmtk_sgemm(char transA, char transB, int M, int N, int K,
+	   float alpha, const float *A, int lda,
+	   const float *B, int ldb,
+	   float beta, float *C, int ldc)
+{
+  gemm(floatKernels[cpuKernel()], transA, transB, M, N, K,
+       alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+
+void
+gmtk_gemm_set_threads(unsigned numThreads)
+{
+  gemmMaxThreads = numThreads;
+}
+
+
+unsigned
+gmtk_gemm_threads()
+{
+  if (gemmMaxThreads > 0)
+    return gemmMaxThreads;
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (unsigned)n : 1;
+}
+
+
+const char *
+gmtk_gemm_kernel()
+{
+  return doubleKernels[cpuKernel()].name;
+}
+
+
+#ifdef MAIN
+
+#include <sys/time.h>
+
+// Check every kernel this CPU can run against a plain triple loop,
+// for all the transpose cases, odd sizes (partial tiles and blocks),
+// leading dimensions larger than the matrices, and a few values of
+// alpha and beta, with one and several threads. With a size
+// argument, also time an n x n x n multiply with each kernel.
+
+template <typename T>
+static void
+reference(bool tA, bool tB, int M, int N, int K, T alpha, const T *A, int lda,
+	  const T *B, int ldb, T beta, T *C, int ldc)
+{
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < M; i++) {
+      double s = 0;
+      for (int k = 0; k < K; k++)
+	s += (double)(tA ? A[k + i * lda] : A[i + k * lda]) * (tB ? B[j + k * ldb] : B[k + j * ldb]);
+      C[i + j * ldc] = (T)(alpha * s + (beta == 0 ? 0 : beta * C[i + j * ldc]));
+    }
+}
+
+
+template <typename T>
+static bool
+check(const GemmKernel<T> &kernel, bool tA, bool tB, int M, int N, int K, T alpha, T beta, double tol)
+{
+  int lda = (tA ? K : M) + 3, ldb = (tB ? N : K) + 1, ldc = M + 2;
+  size_t aSize = (size_t)lda * (tA ? M : K), bSize = (size_t)ldb * (tB ? K : N), cSize = (size_t)ldc * N;
+  T *A = new T[aSize], *B = new T[bSize], *C = new T[cSize], *R = new T[cSize];
+  for (size_t i = 0; i < aSize; i++) A[i] = (T)(rand() % 2001 - 1000) / 1000;
+  for (size_t i = 0; i < bSize; i++) B[i] = (T)(rand() % 2001 - 1000) / 1000;
+  for (size_t i = 0; i < cSize; i++) C[i] = R[i] = (T)(rand() % 2001 - 1000) / 1000;
+  reference(tA, tB, M, N, K, alpha, A, lda, B, ldb, beta, R, ldc);
+  gemm(kernel, tA ? 'T' : 'N', tB ? 'T' : 'N', M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+  bool ok = true;
+  for (int j = 0; j < N && ok; j++)
+    for (int i = 0; i < ldc && ok; i++) {
+      double err = fabs((double)C[i + j * ldc] - R[i + j * ldc]);
+      if (err > tol * (1 + K)) {
+	printf("%s %s: %c%c M=%d N=%d K=%d alpha=%g beta=%g: C[%d,%d] = %g, should be %g\n",
+	       kernel.name, sizeof(T) == sizeof(double) ? "dgemm" : "sgemm",
+	       tA ? 'T' : 'N', tB ? 'T' : 'N', M, N, K, (double)alpha, (double)beta,
+	       i, j, (double)C[i + j * ldc], (double)R[i + j * ldc]);
+	ok = false;
+      }
+    }
+  delete [] A; delete [] B; delete [] C; delete [] R;
+  return ok;
+}
+
+
+template <typename T>
+static bool
+checkKernel(const GemmKernel<T> &kernel, double tol)
+{
+  static const int sizes[][3] = {
+    { 1, 1, 1 }, { 7, 5, 3 }, { 17, 13, 1 }, { 33, 1, 70 }, { 1, 29, 31 },
+    { 200, 9, 300 }, { 65, 130, 257 }, { 400, 301, 520 }, { 5, 3100, 20 },
+  };
+  static const double ab[][2] = { { 1, 0 }, { 1, 1 }, { -0.5, 2 } };
+  bool ok = true;
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    for (int t = 0; t < 4; t++)
+      for (unsigned a = 0; a < sizeof(ab) / sizeof(ab[0]); a++)
+	ok = check(kernel, (t & 1) != 0, (t & 2) != 0, sizes[s][0], sizes[s][1], sizes[s][2],
+		   (T)ab[a][0], (T)ab[a][1], tol) && ok;
+  return ok;
+}
+
+
+template <typename T>
+static double
+gflops(const GemmKernel<T> &kernel, int n)
+{
+  T *A = new T[(size_t)n * n], *B = new T[(size_t)n * n], *C = new T[(size_t)n * n];
+  for (size_t i = 0; i < (size_t)n * n; i++)
+    A[i] = B[i] = C[i] = 1;
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  gemm(kernel, 'N', 'N', n, n, n, (T)1, A, n, B, n, (T)0, C, n);
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * 1e-6;
+  delete [] A; delete [] B; delete [] C;
+  return 2.0 * n * n * n / secs * 1e-9;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  bool ok = true;
+  unsigned threads[] = { 1, 3 };
+  for (unsigned t = 0; t < 2; t++) {
+    gmtk_gemm_set_threads(threads[t]);
+    for (unsigned k = 0; k <= cpuKernel(); k++) {
+      ok = checkKernel(doubleKernels[k], 1e-12) && ok;
+      ok = checkKernel(floatKernels[k], 1e-5) && ok;
+    }
+  }
+  if (argc > 1) {
+    int n = atoi(argv[1]);
+    gmtk_gemm_set_threads(0);
+    for (unsigned k = 0; k <= cpuKernel(); k++)
+      printf("%s: dgemm %.2f GFLOPS, sgemm %.2f GFLOPS (%u threads)\n", doubleKernels[k].name,
+	     gflops(doubleKernels[k], n), gflops(floatKernels[k], n), gmtk_gemm_threads());
+  }
+  printf("gemm %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+#endif
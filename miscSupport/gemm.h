@@ -0,0 +1,49 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+/*
+ * gemm.h  header for GMTK's internal general matrix multiply
+ *
+ * gmtk_dgemm() and gmtk_sgemm() compute
+ *
+ *    C = alpha * op(A) * op(B) + beta * C
+ *
+ * with the same arguments as the column-major BLAS xGEMM routines:
+ * op(A) is M x K, op(B) is K x N, C is M x N, transA and transB are
+ * 'N' or 'T', and lda, ldb and ldc are the leading dimensions (the
+ * distance between columns) of A, B and C. Row-major callers can
+ * compute C^T = op(B)^T op(A)^T instead.
+ *
+ * The multiply is cache-blocked (panels of op(B) and blocks of op(A)
+ * are packed into contiguous buffers), uses AVX2/FMA or AVX-512 code
+ * when the CPU it runs on supports it, and splits large products
+ * over several threads. No external BLAS is needed.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+void
+gmtk_dgemm(char transA, char transB, int M, int N, int K,
+	   double alpha, const double *A, int lda,
+	   const double *B, int ldb,
+	   double beta, double *C, int ldc);
+
+void
+gmtk_sgemm(char transA, char transB, int M, int N, int K,
+	   float alpha, const float *A, int lda,
+	   const float *B, int ldb,
+	   float beta, float *C, int ldc);
+
+// Set the maximum number of threads a single multiply may use. 0
+// (the default) means one per online CPU, 1 never starts a thread.
+void gmtk_gemm_set_threads(unsigned numThreads);
+unsigned gmtk_gemm_threads();
+
+// The name of the kernel chosen for this CPU ("avx512", "avx2" or
+// "generic").
+const char *gmtk_gemm_kernel();
+
+#endif
@@ -51,7 +51,19 @@ class RAND {
       seed48(seedv); 
     }
 
-  // seed with a double 
+  // Switch to the stream'th of several independent random number
+  // streams derived from the current seed (e.g., one per parallel
+  // worker process). The result depends only on seedv and stream,
+  // so runs are repeatable.
+  void seedStream(unsigned stream) {
+    unsigned short tmp[3];
+    tmp[0] = seedv[0] ^ (unsigned short)(0x9e37 * (stream + 1));
+    tmp[1] = seedv[1] ^ (unsigned short)(stream >> 16);
+    tmp[2] = seedv[2] ^ (unsigned short) stream;
+    seed48(tmp);
+  }
+
+  // seed with a double
   void seed(double* d) {
     unsigned short* tmp = (unsigned short*)d;
     seed48(tmp);
@@ -923,9 +923,10 @@ Range::iterator::iterator (const Range& rng)
     reset(rng);
 }
 
-Range::iterator::iterator (const iterator& it) {
+Range::iterator::iterator (const iterator& it)
+  : filename(0), file_handle(0), p(NULL)
+{
   if (it.p) {
-    delete p;
     p = new permuter(*(it.p));
     return;
   }
@@ -269,7 +269,7 @@ public:
   inline bool find(_Key* key) {
     const unsigned a = entryOf(key,ksize,table);
     // printf("find: entry %d\n",a);
-    return !empty(table.ptr[a]);
+    return !table.ptr[a].empty();
   }
 
   ////////////////////////////////////////////////////////
@@ -278,7 +278,7 @@ public:
   // the set, false otherwise.
   inline bool find(_Key* key,_Key**& key_pp) {
     const unsigned a = entryOf(key,ksize,table);
-    if (empty(table.ptr[a])) {
+    if (table.ptr[a].empty()) {
       key_pp = NULL;
       return false;
     } else {
@@ -38,6 +38,7 @@
 
 #include "rand.h"
 #include "MixBiNormal.h"
+#include "vector-math.h"
 #include "error.h"
 
 
@@ -74,12 +75,6 @@ RAND rnd(true); // true to seed the rand num generator; false, otherwise.
 // ======================================================================
 
 extern "C" {
-#ifdef HAVE_MVEC
-void vexp_(int *n, double *x, int *stridex, double  *y,  int
-     *stridey);
-void vlog_(int *n, double *x, int *stridex, double  *y,  int
-     *stridey);
-#endif
 void pg_c1(double *x0,double *x1,
 		int l,
 		int n,
@@ -134,20 +129,6 @@ pg_c3(double x0,
 
 }
 
-inline void
-vexp(int n,double *x, double *y)
-{
-#ifdef HAVE_MVEC
-  static int one = 1;
-  vexp_(&n,x,&one,y,&one);
-#else
-  double *x_endp = x+n;
-  while (x != x_endp) {
-    *y++ = exp(*x++);
-  }
-#endif
-}
-
 // What we call log(~0). If log-likelihoods get 
 // smaller than this (which is very unlikely), an error could occur.
 #define LOG_ZERO (-1e250)
@@ -160,20 +141,6 @@ vexp(int n,double *x, double *y)
 // this, we don't bother using it for the accumulation.
 #define POST_THRESHOLD 1e-100
 
-inline void
-vlog(int n,double *x, double *y)
-{
-#ifdef HAVE_MVEC
-  static int one = 1;
-  vlog_(&n,x,&one,y,&one);
-#else
-  double *x_endp = x+n;
-  while (x != x_endp) {
-    *y++ = log(*x++);
-  }
-#endif
-}
-
 
 
 // ======================================================================
@@ -1198,7 +1165,9 @@ MixBiNormal::addtoEpoch(double x0,double x1)
 
 
 void
-MixBiNormal::addtoEpoch(double *x0,double *x1,const int n)
+MixBiNormal::addtoEpoch(double *x0,double *x1,const int n,
+			double *scratch1,double *scratch2,
+			double *scratch3,double *scratch4)
 {
   int l;
   if (NumMixComps == 1) {
@@ -243,7 +243,15 @@ public:
   // Interface to the EM algorithm.
   void startEpoch();
   void addtoEpoch(double x0,double x1);
-  void addtoEpoch(double *x0,double *x1,const int n);
+  void addtoEpoch(double *x0,double *x1,const int n)
+  { addtoEpoch(x0,x1,n,scratch1,scratch2,scratch3,scratch4); }
+  // Same, but using the given scratch arrays (each of length at
+  // least n times the number of components) rather than the shared
+  // static ones, so that different objects can be trained by
+  // different threads at the same time.
+  void addtoEpoch(double *x0,double *x1,const int n,
+		  double *scratch1,double *scratch2,
+		  double *scratch3,double *scratch4);
   bool endEpoch();
 
   // Print the current parameters.
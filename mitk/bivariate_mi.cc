@@ -97,6 +97,7 @@ extern "C" void nonstandard_arithmetic();
 #include "range.h"
 #include "bp_range.h"
 #include "MixBiNormal.h"
+#include "work-queue.h"
 #include "rand.h"
 //#include "spi.h"
 #include "GMTK_ObservationMatrix.h"
@@ -190,6 +191,7 @@ usage(const char* message = 0)
 	    "     [-sac n]     Stop when numactive=n (don't compute MI if n>0)\n"
 	    "     [-nocmi]     Only finish computing mixtures, don't compute MI\n"
 	    "     [-maxi n]    Stop after 'n' EM iterations, don't computeMI\n"
+	    "     [-threads n] Spread the EM of the feature pairs over 'n' threads\n"
 	    "     [-varfl f]   Variance floor, if var < f, re-randomize\n"
 	    "     [-detfl f]   Determinant floor, if det <= f >= 0, re-randomize\n"
 	    "     [-mcvr  f]   Mixture Coefficient Vanishing Ratio\n"
@@ -775,11 +777,38 @@ class MBN_Col {
   MixBiNormal *const ftr_mi;
   MixBiNormal *const ftr_mi_endp;
 
+  // The accumulations of the current call to addtoEpoch(), at most
+  // one per object, which are done together (possibly in parallel)
+  // once they have all been found.
+  struct Job {
+    MixBiNormal *mbn;
+    double *x0;
+    double *x1;
+    int n;
+  };
+  Job *const jobs;
+  int n_jobs;
+  void addJob(MixBiNormal *mbn,double *x0,double *x1,const int n) {
+    assert ( n_jobs < n_mis );
+    Job &j = jobs[n_jobs++];
+    j.mbn = mbn; j.x0 = x0; j.x1 = x1; j.n = n;
+  }
+  void runJobs(const size_t max_samps);
+  static void runJob(void *arg,unsigned item,unsigned thread);
+
+  // Scratch space of each thread, 4 arrays of scratch_len*numComps.
+  sArray<double> thread_scratch;
+  size_t scratch_len;
+
 public:
   MBN_Col(const int n_mis_a)
     : n_mis(n_mis_a), ftr_mi(new MixBiNormal[n_mis]),
-      ftr_mi_endp(ftr_mi+n_mis) {}
-  ~MBN_Col() { delete [] ftr_mi; }
+      ftr_mi_endp(ftr_mi+n_mis), jobs(new Job[n_mis]),
+      n_jobs(0), scratch_len(0) {}
+  ~MBN_Col() { delete [] ftr_mi; delete [] jobs; }
+
+  // number of threads the feature pairs are spread over in addtoEpoch()
+  static unsigned numThreads;
 
   static void setNumComps(int n_comps)
   { MixBiNormal::GlobalNumComps = n_comps; }
@@ -1022,6 +1051,7 @@ MBN_Col::addtoEpoch(double *const dftr_buf,
 {
   bool data_used = false;
   MixBiNormal *ftr_mi_p = ftr_mi;
+  n_jobs = 0;
 
   size_t *counts_p = counts;
   for (Range::iterator cnit=cfr_rng.begin();
@@ -1074,9 +1104,9 @@ MBN_Col::addtoEpoch(double *const dftr_buf,
 	  double *dftr_buf_cur_pp = dftr_buf_cur_p + (j+1)*col_stride;
 	  for (k=(j+1);k<n_ftrs;k++) {
 	    if (ftr_mi_p->active())
-	      ftr_mi_p->addtoEpoch(dftr_buf_lag_p,
-				   dftr_buf_cur_pp,
-				   num_samps);
+	      addJob(ftr_mi_p,dftr_buf_lag_p,
+		     dftr_buf_cur_pp,
+		     num_samps);
 	    dftr_buf_cur_pp += col_stride;
 	    ftr_mi_p++;		  
 	  }
@@ -1089,9 +1119,9 @@ MBN_Col::addtoEpoch(double *const dftr_buf,
 	  double *dftr_buf_cur_pp = dftr_buf_cur_p;
 	  for (k=0;k<n_ftrs;k++) {
 	    if (ftr_mi_p->active())
-	      ftr_mi_p->addtoEpoch(dftr_buf_lag_p,
-				   dftr_buf_cur_pp,
-				   num_samps);
+	      addJob(ftr_mi_p,dftr_buf_lag_p,
+		     dftr_buf_cur_pp,
+		     num_samps);
 	    dftr_buf_cur_pp += col_stride;
 	    ftr_mi_p++;		  
 	  }
@@ -1117,9 +1147,9 @@ MBN_Col::addtoEpoch(double *const dftr_buf,
 	      const int k = (*bfit);
 	      double *dftr_buf_cur_pp = 
 		dftr_buf_cur_p + k*col_stride;
-	      ftr_mi_p->addtoEpoch(dftr_buf_lag_pp,
-				   dftr_buf_cur_pp,
-				   num_samps);
+	      addJob(ftr_mi_p,dftr_buf_lag_pp,
+		     dftr_buf_cur_pp,
+		     num_samps);
 	    }
 	    ftr_mi_p++;		  
 	  }
@@ -1136,9 +1166,9 @@ MBN_Col::addtoEpoch(double *const dftr_buf,
 	      const int k = (*bfit);
 	      double *dftr_buf_cur_pp = 
 		dftr_buf_cur_p + k*col_stride;
-	      ftr_mi_p->addtoEpoch(dftr_buf_lag_pp,
-				   dftr_buf_cur_pp,
-				   num_samps);
+	      addJob(ftr_mi_p,dftr_buf_lag_pp,
+		     dftr_buf_cur_pp,
+		     num_samps);
 	    }
 	    ftr_mi_p++;		  
 	  }
@@ -1146,10 +1176,45 @@ MBN_Col::addtoEpoch(double *const dftr_buf,
       }
     }
   }
+  runJobs(n_samps);
   return data_used;
 }
 
 
+unsigned MBN_Col::numThreads = 1;
+
+// Run one job with the scratch space of the given thread.
+void
+MBN_Col::runJob(void *arg,unsigned item,unsigned thread)
+{
+  MBN_Col *const col = (MBN_Col*) arg;
+  const Job &j = col->jobs[item];
+  const size_t len = col->scratch_len*MixBiNormal::GlobalNumComps;
+  double *const scratch = col->thread_scratch.ptr + thread*4*len;
+  j.mbn->addtoEpoch(j.x0,j.x1,j.n,
+		    scratch,scratch+len,scratch+2*len,scratch+3*len);
+}
+
+// Do the accumulations found by addtoEpoch(). Each object is only
+// touched by one job, and the data is only read, so the jobs are
+// independent and can be spread over numThreads threads.
+void
+MBN_Col::runJobs(const size_t max_samps)
+{
+  if (n_jobs == 0)
+    return;
+  const unsigned n_threads = (numThreads < (unsigned)n_jobs ? numThreads : n_jobs);
+  if (max_samps > scratch_len || 
+      (size_t)thread_scratch.len() < n_threads*4*scratch_len*MixBiNormal::GlobalNumComps) {
+    if (max_samps > scratch_len)
+      scratch_len = max_samps;
+    thread_scratch.resize(n_threads*4*scratch_len*MixBiNormal::GlobalNumComps);
+  }
+  runWorkQueue(n_jobs,n_threads,runJob,this);
+  n_jobs = 0;
+}
+
+
 void
 MBN_Col::endEpoch()
 {
@@ -2010,6 +2075,7 @@ int main(int argc, const char *argv[])
 
     bool compute_mi = true;
     int max_em_iterations = INT_MAX;
+    int n_threads = 1;
 
     double varianceFloor = 0.0;
     int re_rands = 5;
@@ -2327,6 +2393,14 @@ int main(int argc, const char *argv[])
 	  } else
 	    usage("No -maxi *n* value given.");
         }
+        else if (strcmp(argp, "-threads")==0)
+        {
+	  if (argc>0) {
+	    n_threads = (int) parse_long(*argv++);
+	    argc--;
+	  } else
+	    usage("No -threads *n* value given.");
+        }
         else if (strcmp(argp, "-varfl")==0)
         {
 	  if (argc>0) {
@@ -2540,6 +2614,10 @@ int main(int argc, const char *argv[])
     if (nacps < 1) {
       error("nacps (number of active->inactive changes per save must be >= 1");
     }
+    if (n_threads < 1) {
+      error("Number of threads must be >= 1");
+    }
+    MBN_Col::numThreads = n_threads;
 
 
     //////////////////////////////////////////////////////////////////////
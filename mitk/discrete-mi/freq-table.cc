@@ -0,0 +1,262 @@
+/**
+ *: freq-table.cc
+*/
+/*
+ *
+ * Copyright (C) 2004 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "freq-table.h"
+
+using std::vector;
+
+/**
+ * methods for class FreqTable
+ */
+
+
+//////////////////// FreqTable ////////////////////
+
+FreqTable::FreqTable() :
+  _width(0), _dense(true), _bound(1), _numCells(0),
+  _capacity(0), _numUsed(0), _keys(NULL), _counts(NULL)
+{
+} // end FreqTable
+
+
+FreqTable::~FreqTable() {
+  clear();
+} // end ~FreqTable
+
+
+void FreqTable::clear() {
+  delete [] _keys;
+  delete [] _counts;
+  _keys = NULL;
+  _counts = NULL;
+  _numCells = _capacity = _numUsed = 0;
+} // end clear
+
+
+//////////////////// init ////////////////////
+
+/**
+ * start an empty table, picking the largest per-position bound for
+ * which every vector of width values below it has a dense cell
+ *
+ * @param width the number of values in each counted vector
+ */
+void FreqTable::init(unsigned width) {
+  clear();
+  _width = width;
+
+  // largest b with b^width <= MAX_DENSE_CELLS
+  unsigned b = width == 0 ? 1 :
+    (unsigned) floor(pow((double) MAX_DENSE_CELLS, 1.0 / width));
+  while (width > 0) {
+    double cells = pow((double) b, (double) width);
+    if (cells > MAX_DENSE_CELLS) b--;
+    else if (pow((double) (b+1), (double) width) <= MAX_DENSE_CELLS) b++;
+    else break;
+  }
+
+  if (width > 0 && b < 2) {
+    // not even binary vectors fit, hash from the start
+    _dense = false;
+    _bound = 0;
+    _capacity = 16;
+    _keys = new unsigned[_capacity * _width];
+    _counts = new unsigned[_capacity];
+    memset(_counts, 0, _capacity * sizeof(unsigned));
+    return;
+  }
+
+  _dense = true;
+  _bound = b;
+  _numCells = (unsigned) pow((double) b, (double) width);
+  _counts = new unsigned[_numCells];
+  memset(_counts, 0, _numCells * sizeof(unsigned));
+} // end init
+
+
+//////////////////// hash ////////////////////
+
+/**
+ * FNV-1a over the values of key, followed by a final avalanche so
+ * that the low bits used for the slot depend on all of the key.
+ */
+unsigned FreqTable::hash(const unsigned *key) const {
+  unsigned h = 2166136261u;
+  for (unsigned j = 0; j < _width; ++j) {
+    h ^= key[j];
+    h *= 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+} // end hash
+
+
+//////////////////// find ////////////////////
+
+/**
+ * linear probing in hash mode
+ *
+ * @return the slot holding key, or the empty slot where it goes
+ */
+unsigned FreqTable::find(const unsigned *key) const {
+  const unsigned mask = _capacity - 1;
+  unsigned s = hash(key) & mask;
+  while (_counts[s] != 0 &&
+	 memcmp(_keys + s * _width, key, _width * sizeof(unsigned)) != 0)
+    s = (s + 1) & mask;
+  return s;
+} // end find
+
+
+//////////////////// growHash ////////////////////
+
+/**
+ * double the number of hash slots, keeping the load below one half
+ */
+void FreqTable::growHash() {
+  unsigned *oldKeys = _keys;
+  unsigned *oldCounts = _counts;
+  unsigned oldCapacity = _capacity;
+
+  _capacity *= 2;
+  _keys = new unsigned[_capacity * _width];
+  _counts = new unsigned[_capacity];
+  memset(_counts, 0, _capacity * sizeof(unsigned));
+
+  for (unsigned s = 0; s < oldCapacity; ++s) {
+    if (oldCounts[s] == 0) continue;
+    const unsigned *key = oldKeys + s * _width;
+    unsigned t = find(key);
+    memcpy(_keys + t * _width, key, _width * sizeof(unsigned));
+    _counts[t] = oldCounts[s];
+  }
+  delete [] oldKeys;
+  delete [] oldCounts;
+} // end growHash
+
+
+//////////////////// toHash ////////////////////
+
+/**
+ * move the counts of a dense table into a hash table
+ */
+void FreqTable::toHash() {
+  unsigned *cellCounts = _counts;
+  unsigned numCells = _numCells;
+
+  unsigned numUsed = 0;
+  for (unsigned c = 0; c < numCells; ++c)
+    if (cellCounts[c] != 0) numUsed++;
+
+  _dense = false;
+  _capacity = 16;
+  while (_capacity < 4 * numUsed) _capacity *= 2;
+  _keys = new unsigned[_capacity * _width];
+  _counts = new unsigned[_capacity];
+  memset(_counts, 0, _capacity * sizeof(unsigned));
+  _numUsed = numUsed;
+
+  vector<unsigned> key(_width);
+  for (unsigned c = 0; c < numCells; ++c) {
+    if (cellCounts[c] == 0) continue;
+    unsigned rest = c;
+    for (unsigned j = 0; j < _width; ++j) {
+      key[j] = rest % _bound;
+      rest /= _bound;
+    }
+    unsigned s = find(&key[0]);
+    memcpy(_keys + s * _width, &key[0], _width * sizeof(unsigned));
+    _counts[s] = cellCounts[c];
+  }
+  delete [] cellCounts;
+  _numCells = 0;
+} // end toHash
+
+
+//////////////////// add ////////////////////
+
+/**
+ * @param key the width values of the vector that occurred
+ */
+void FreqTable::add(const unsigned *key) {
+  if (_dense) {
+    unsigned c = 0;
+    unsigned j = _width;
+    while (j-- > 0) {
+      if (key[j] >= _bound) break;
+      c = c * _bound + key[j];
+    }
+    if (j == (unsigned) -1) {
+      _counts[c]++;
+      return;
+    }
+    toHash();
+  }
+
+  if (2 * (_numUsed + 1) > _capacity)
+    growHash();
+  unsigned s = find(key);
+  if (_counts[s] == 0) {
+    memcpy(_keys + s * _width, key, _width * sizeof(unsigned));
+    _numUsed++;
+  }
+  _counts[s]++;
+} // end add
+
+
+//////////////////// count ////////////////////
+
+/**
+ * @param key the width values of the vector to look up
+ * @return the number of times key was added
+ */
+unsigned FreqTable::count(const unsigned *key) const {
+  if (_dense) {
+    unsigned c = 0;
+    for (unsigned j = _width; j-- > 0; ) {
+      if (key[j] >= _bound) return 0;
+      c = c * _bound + key[j];
+    }
+    return _counts[c];
+  }
+  return _counts[find(key)];
+} // end count
+
+
+//////////////////// slot ////////////////////
+
+/**
+ * @param s the slot, < numSlots()
+ * @param key where the width values of the slot's vector are put
+ * @param cnt where the slot's count is put
+ * @return false if the slot is empty
+ */
+bool FreqTable::slot(unsigned s, unsigned *key, unsigned &cnt) const {
+  cnt = _counts[s];
+  if (cnt == 0) return false;
+  if (_dense) {
+    for (unsigned j = 0; j < _width; ++j) {
+      key[j] = s % _bound;
+      s /= _bound;
+    }
+  } else {
+    memcpy(key, _keys + s * _width, _width * sizeof(unsigned));
+  }
+  return true;
+} // end slot
@@ -0,0 +1,81 @@
+/**
+ *: freq-table.h
+*/
+
+/*
+ *
+ * Copyright (C) 2004 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+#ifndef FREQ_TABLE_H
+#define FREQ_TABLE_H
+
+// Largest number of cells a table counts directly into before it
+// has to fall back on hashing.
+#define MAX_DENSE_CELLS (1u << 16)
+
+
+//////////////////// class FreqTable ////////////////////
+
+/**
+ * counts how often each fixed-width vector of unsigned values occurs.
+ *
+ * As long as every value is below the per-position bound picked by
+ * init(), so that all possible vectors fit in MAX_DENSE_CELLS cells,
+ * the counts are kept in a dense array indexed by the vector itself.
+ * The first vector with a larger value moves the table over to an
+ * open-addressing hash keyed on the vector.
+ */
+class FreqTable {
+
+public:
+  FreqTable();
+  ~FreqTable();
+
+  // (re)start an empty table for vectors of width values
+  void init(unsigned width);
+
+  // count one more occurrence of key[0..width-1]
+  void add(const unsigned *key);
+
+  // number of occurrences of key[0..width-1] so far
+  unsigned count(const unsigned *key) const;
+
+  // The occupied entries are found by going over slot 0..numSlots()-1:
+  // slot() returns false for an empty slot, otherwise fills in the
+  // key and its count.
+  unsigned numSlots() const { return _dense ? _numCells : _capacity; }
+  bool slot(unsigned s, unsigned *key, unsigned &cnt) const;
+
+private:
+  // not copyable
+  FreqTable(const FreqTable &);
+  FreqTable &operator=(const FreqTable &);
+
+  void clear();
+  void toHash();
+  void growHash();
+  unsigned hash(const unsigned *key) const;
+  unsigned find(const unsigned *key) const;
+
+  unsigned _width;
+
+  /** dense mode: _counts[sum_j key[j]*_bound^j], _numCells = _bound^_width */
+  bool _dense;
+  unsigned _bound;
+  unsigned _numCells;
+
+  /** hash mode: _capacity slots (a power of 2), _keys is _capacity x _width */
+  unsigned _capacity;
+  unsigned _numUsed;
+  unsigned *_keys;
+
+  /** counts for either mode, 0 for an empty slot */
+  unsigned *_counts;
+}; // end class FreqTable
+
+
+#endif
@@ -61,23 +61,16 @@ void MixNormal::startEpoch(unsigned numVars, unsigned dimX) {
  */
 bool MixNormal::addToEpoch(PtrArray<unsigned> *ptrArray, unsigned numData) {
 
-  vector<double> X(_dX), Y(_numVariables - _dX), XY(_numVariables); 
+  unsigned XY[MAX_DIMENSIONALITY];
   //unsigned* data;
   for(unsigned i = 0; i < numData; i++) {  //go through all frames
     //data = ptrArray->toVec(i);
-    for(unsigned j = 0; j < _dX; ++j) X[j] = XY[j] = ptrArray->getVal(i,j);
-    for(unsigned j = _dX; j < _numVariables; ++j) 
-      Y[j - _dX] = XY[j] = ptrArray->getVal(i,j);
-    
-    map<vector<double>,int>::iterator xfound  = xFreqTable.find(X);
-    if(xfound != xFreqTable.end()) (*xfound).second++; 
-    else xFreqTable[X] = 1;
-    map<vector<double>,int>::iterator yfound  = yFreqTable.find(Y);
-    if(yfound != yFreqTable.end()) (*yfound).second++; 
-    else yFreqTable[Y] = 1;
-    map<vector<double>,int>::iterator xyfound  = xyFreqTable.find(XY);
-    if(xyfound != xyFreqTable.end()) (*xyfound).second++; 
-    else xyFreqTable[XY] = 1;
+    for(unsigned j = 0; j < _numVariables; ++j) XY[j] = ptrArray->getVal(i,j);
+
+    // X is the first _dX values of XY, Y the rest
+    xFreqTable.add(XY);
+    yFreqTable.add(XY + _dX);
+    xyFreqTable.add(XY);
   }
 
   return true;
@@ -95,26 +88,15 @@ bool MixNormal::addToEpoch(PtrArray<unsigned> *ptrArray, unsigned numData) {
  * @return the learning status
  */
 double MixNormal::endEpoch(int numSamples) {
-  vector<double> X(_dX), Y(_numVariables - _dX), XY(_numVariables);
+  unsigned XY[MAX_DIMENSIONALITY], xyCount;
   double accumMI = 0.0, tmp;
   double invLog2 = 1.0 / log(2.0);
-  for(map<vector<double>,int>::iterator it = xyFreqTable.begin();
-      it != xyFreqTable.end();
-      it++) 
+  for(unsigned s = 0; s < xyFreqTable.numSlots(); s++) 
     {
-      //cout<<"(*it).second = "<<(*it).second<<endl;
-      //cout<<"numSamples = "<<numSamples<<endl;
-      _pXY = (double) (*it).second / numSamples;
-      //cout<<"_pXY = "<<_pXY<<endl;
-      XY = (*it).first;
-      //cout<<"xyFreqTable = "<<xyFreqTable[XY]<<endl;
-      for(unsigned j = 0; j < _dX; ++j) X[j] = XY[j];
-      for(unsigned j = _dX; j < _numVariables; ++j) Y[j - _dX] = XY[j];
-      _pX = (double) xFreqTable[X] / numSamples;
-      //cout<<"xFreqTable = "<<xFreqTable[X]<<endl;
-      //cout<<"_pX = "<<_pX<<endl;
-      _pY = (double) yFreqTable[Y] / numSamples;
-      //cout<<"_pY = "<<_pY<<endl;    
+      if(!xyFreqTable.slot(s, XY, xyCount)) continue;
+      _pXY = (double) xyCount / numSamples;
+      _pX = (double) xFreqTable.count(XY) / numSamples;
+      _pY = (double) yFreqTable.count(XY + _dX) / numSamples;
       tmp = log(_pXY) - log(_pX * _pY);
       tmp *= invLog2 * _pXY;
       accumMI += tmp;
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "data_processing.h"
+#include "freq-table.h"
 #include "config.h"
 #include "error.h"
 
@@ -56,13 +57,15 @@ public:
   // constructors and destructor
   MixNormal() { }
   MixNormal(unsigned numVars, unsigned dimX) { 
-    _numVariables = numVars;
-    _dX = dimX;
+    setInit(numVars, dimX);
   }
   
   void setInit(unsigned numVars, unsigned dimX) { 
     _numVariables = numVars;
     _dX = dimX;
+    xFreqTable.init(_dX);
+    yFreqTable.init(_numVariables - _dX);
+    xyFreqTable.init(_numVariables);
   }
 
   virtual ~MixNormal();
@@ -74,9 +77,9 @@ public:
 
 private:
   
-  map<vector<double>, int> xFreqTable;
-  map<vector<double>, int> yFreqTable;
-  map<vector<double>, int> xyFreqTable;
+  FreqTable xFreqTable;
+  FreqTable yFreqTable;
+  FreqTable xyFreqTable;
   /** the number of variables we are talking about */
   unsigned _numVariables;
 
@@ -0,0 +1,104 @@
+/**
+ *: test-freq-table.cc
+ *
+ * Checks FreqTable against a std::map of the same keys, for tables
+ * that stay dense, that move from dense to hashing part way, and
+ * that hash from the start. Prints "freq-table ok" if they agree.
+ */
+
+/*
+ *
+ * Copyright (C) 2004 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "freq-table.h"
+
+using std::map;
+using std::vector;
+
+// a fixed linear congruential generator, so every run sees the same keys
+static unsigned long lcgState = 12345;
+static unsigned lcg() {
+  lcgState = (lcgState * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  return (unsigned) (lcgState >> 8);
+}
+
+
+/**
+ * count numKeys keys of the given width into a FreqTable and a map
+ * and compare them. Values are below smallBound, except that from
+ * key number switchAt on they are below largeBound.
+ *
+ * @return true if the table and the map agree
+ */
+static bool check(unsigned width, unsigned numKeys,
+		  unsigned smallBound, unsigned largeBound, unsigned switchAt) {
+  FreqTable table;
+  map< vector<unsigned>, unsigned > reference;
+  vector<unsigned> key(width + 1);
+
+  table.init(width);
+  for (unsigned n = 0; n < numKeys; n++) {
+    const unsigned bound = n < switchAt ? smallBound : largeBound;
+    for (unsigned j = 0; j < width; j++)
+      key[j] = lcg() % bound;
+    table.add(&key[0]);
+    reference[vector<unsigned>(key.begin(), key.begin() + width)]++;
+  }
+
+  bool ok = true;
+  for (map< vector<unsigned>, unsigned >::const_iterator it = reference.begin();
+       it != reference.end(); ++it) {
+    const unsigned cnt = table.count(width > 0 ? &it->first[0] : &key[0]);
+    if (cnt != it->second) {
+      printf("width %u: count %u, should be %u\n", width, cnt, it->second);
+      ok = false;
+      break;
+    }
+  }
+
+  // every occupied slot is a key of the map with the same count
+  unsigned numEntries = 0, cnt;
+  for (unsigned s = 0; s < table.numSlots(); s++) {
+    if (!table.slot(s, &key[0], cnt))
+      continue;
+    numEntries++;
+    map< vector<unsigned>, unsigned >::const_iterator it =
+      reference.find(vector<unsigned>(key.begin(), key.begin() + width));
+    if (it == reference.end() || it->second != cnt) {
+      printf("width %u: slot %u has a key with count %u that the map %s\n",
+	     width, s, cnt, it == reference.end() ? "lacks" : "counts differently");
+      ok = false;
+      break;
+    }
+  }
+  if (ok && numEntries != reference.size()) {
+    printf("width %u: %u entries, should be %u\n",
+	   width, numEntries, (unsigned) reference.size());
+    ok = false;
+  }
+  return ok;
+}
+
+
+int main(void) {
+  bool ok = true;
+  for (unsigned width = 0; width <= 20; width++) {
+    // values 0 and 1 only, dense up to width 16
+    ok = check(width, 20000, 2, 2, 20000) && ok;
+    // dense at first, then values too large for it
+    ok = check(width, 20000, 2, 1000, 10000) && ok;
+    // large values from the start
+    ok = check(width, 20000, 1000, 1000, 0) && ok;
+  }
+  if (ok)
+    printf("freq-table ok\n");
+  return ok ? 0 : 1;
+}
@@ -23,6 +23,7 @@
 #define PARAM_DATA_TYPE double
 #define MAX_POINTER_SET_DIM 20  // == MAX NUM OF VARIABLES
 #define MAX_NUM_MIXTURES 20
+#define EM_BLOCK_SIZE 128  // samples per block in MixNormal::addToEpoch{,Diag}()
 
 
 //////////// Verbosity //////////////////
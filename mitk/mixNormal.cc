@@ -25,6 +25,7 @@
 #include "rand.h"
 #include "mixNormal.h"
 #include "matrix-ops.h"
+#include "vector-math.h"
 
 #if defined(WIN32)
 #pragma warning( disable : 4800 )	      // Disable warning messages 4800
@@ -301,6 +302,24 @@ void MixNormal::startEpoch() {
 } // end startEpoch
 
 
+//////////////////// gatherBlock ////////////////////
+
+/**
+ * copies samples first .. first+n-1 of the dim variables in pointerSet
+ * into x, variable-major: x[j*EM_BLOCK_SIZE + i] is variable j of
+ * sample first+i.
+ */
+static void gatherBlock(const PointerSetToDataPoints &pointerSet,
+			unsigned dim, unsigned first, unsigned n,
+			BUFFER_DATA_TYPE *x) {
+  for(unsigned j = 0; j < dim; ++j) {
+    const BUFFER_DATA_TYPE *src = pointerSet.start[j] + first*pointerSet.skip;
+    BUFFER_DATA_TYPE *dst = x + j*EM_BLOCK_SIZE;
+    for(unsigned i = 0; i < n; i++, src += pointerSet.skip) dst[i] = *src;
+  }
+} // end gatherBlock
+
+
 //////////////////// addToEpoch ////////////////////
 
 /**
@@ -318,28 +337,45 @@ bool MixNormal::addToEpoch(const PointerSetToDataPoints &pointerSet) {
   // lambda_l = \frac{\sum_i{p(l|x_i,theta)}}{\sum_i{p(l|x_i,theta)(x_i-mue_i)^2}}
   // B_{ij} = (\sum_i{(x_i-(1-B)u)x_i' p(l|x,theta)})(\sum_i{x_i x_i' p(l|x_i,theta)})^(-1)
 
-  PARAM_DATA_TYPE *pOut;
-  PARAM_DATA_TYPE Px, prob_l;				// p(l|x,theta)
-  PARAM_DATA_TYPE postProb[MAX_NUM_MIXTURES];              // vector of  p(l|x,theta)
+  BUFFER_DATA_TYPE x[MAX_POINTER_SET_DIM*EM_BLOCK_SIZE];
+  PARAM_DATA_TYPE post[MAX_NUM_MIXTURES*EM_BLOCK_SIZE];  // p(l|x,theta)
 
   unsigned dim= _numVariables;
 
-  for(unsigned i = 0; i < pointerSet.numSamples; i++){
-    Prob_l_x_theta(Px, pointerSet,postProb,i);  //    postProb = Prob_l_x_theta(Px, x[i]);
-    _logLikelihood -= log(Px);
-    
+  // Work on blocks of samples, so that each inner loop below runs
+  // over contiguous samples. Every accumulator still gets its
+  // samples added in order, so the sums are the same as if the
+  // samples were done one at a time.
+  for(unsigned first = 0; first < pointerSet.numSamples; first += EM_BLOCK_SIZE){
+    const unsigned n = ( pointerSet.numSamples - first < EM_BLOCK_SIZE ) ?
+      pointerSet.numSamples - first : EM_BLOCK_SIZE;
+    gatherBlock(pointerSet, dim, first, n, x);
+    blockPosteriors(x, n, post);
+
     for(unsigned l = 0; l < _numMixtures; l++) {
-      prob_l = postProb[l];
-      _nextAlphas[l] += prob_l;
+      const PARAM_DATA_TYPE *prob_l = post + l*EM_BLOCK_SIZE;
+      PARAM_DATA_TYPE acc = _nextAlphas[l];
+      for(unsigned i = 0; i < n; i++) acc += prob_l[i];
+      _nextAlphas[l] = acc;
+
+      for(unsigned j =0; j<dim;++j) {       //_nextMeans[l] += x[i] * prob_l;
+	const BUFFER_DATA_TYPE *xj = x + j*EM_BLOCK_SIZE;
+	acc = *(_nextMeans + l*dim + j);
+	for(unsigned i = 0; i < n; i++) acc += xj[i] * prob_l[i];
+	*(_nextMeans + l*dim + j) = acc;
+      }
 
-      for(unsigned j =0; j<dim;++j)        //_nextMeans[l] += x[i] * prob_l;
-	*(_nextMeans + l*dim + j) += *(pointerSet.start[j] + i*pointerSet.skip) * prob_l;
-      
-      pOut = _nextCov+l*dim*dim;
+      PARAM_DATA_TYPE *pOut = _nextCov+l*dim*dim;
       //  _nextCov[l] += (x[i]).toColVector() * (x[i]).toRowVector() * prob_l ;
-      for(unsigned ii = 0; ii < dim; ++ii) // used to be vecProdAdd(_nextCov+l*dim*dim, pointerSet, i, prob_l, dim); 
-	for(unsigned jj = 0; jj < dim; ++jj)
-	    *(pOut + ii*dim + jj)  +=   *(pointerSet.start[ii] + i *pointerSet.skip) * *(pointerSet.start[jj] + i *pointerSet.skip) * prob_l;
+      for(unsigned ii = 0; ii < dim; ++ii) {
+	const BUFFER_DATA_TYPE *xii = x + ii*EM_BLOCK_SIZE;
+	for(unsigned jj = 0; jj < dim; ++jj) {
+	  const BUFFER_DATA_TYPE *xjj = x + jj*EM_BLOCK_SIZE;
+	  acc = *(pOut + ii*dim + jj);
+	  for(unsigned i = 0; i < n; i++) acc += xii[i] * xjj[i] * prob_l[i];
+	  *(pOut + ii*dim + jj) = acc;
+	}
+      }
     }
   }
   
@@ -369,27 +405,39 @@ bool MixNormal::addToEpochDiag(const PointerSetToDataPoints &pointerSet) {
   // lambda_l = \frac{\sum_i{p(l|x_i,theta)}}{\sum_i{p(l|x_i,theta)(x_i-mue_i)^2}}
   // B_{ij} = (\sum_i{(x_i-(1-B)u)x_i' p(l|x,theta)})(\sum_i{x_i x_i' p(l|x_i,theta)})^(-1)
 
-  PARAM_DATA_TYPE *pOut;
-  PARAM_DATA_TYPE Px, prob_l;				// p(l|x,theta)
-  PARAM_DATA_TYPE postProb[MAX_NUM_MIXTURES];              // vector of  p(l|x,theta)
+  BUFFER_DATA_TYPE x[MAX_POINTER_SET_DIM*EM_BLOCK_SIZE];
+  PARAM_DATA_TYPE post[MAX_NUM_MIXTURES*EM_BLOCK_SIZE];  // p(l|x,theta)
 
   unsigned dim= _numVariables;
 
-  for(unsigned i = 0; i < pointerSet.numSamples; i++){
-    Prob_l_x_theta(Px, pointerSet,postProb,i);  //    postProb = Prob_l_x_theta(Px, x[i]);
-    _logLikelihood -= log(Px);
-    
-    for(unsigned l = 0; l < _numMixtures; l++) {
-      prob_l = postProb[l];
-      _nextAlphas[l] += prob_l;
+  // blocked the same way as addToEpoch()
+  for(unsigned first = 0; first < pointerSet.numSamples; first += EM_BLOCK_SIZE){
+    const unsigned n = ( pointerSet.numSamples - first < EM_BLOCK_SIZE ) ?
+      pointerSet.numSamples - first : EM_BLOCK_SIZE;
+    gatherBlock(pointerSet, dim, first, n, x);
+    blockPosteriors(x, n, post);
 
-      for(unsigned j =0; j<dim;++j)        //_nextMeans[l] += x[i] * prob_l;
-	*(_nextMeans + l*dim + j) += *(pointerSet.start[j] + i*pointerSet.skip) * prob_l;
+    for(unsigned l = 0; l < _numMixtures; l++) {
+      const PARAM_DATA_TYPE *prob_l = post + l*EM_BLOCK_SIZE;
+      PARAM_DATA_TYPE acc = _nextAlphas[l];
+      for(unsigned i = 0; i < n; i++) acc += prob_l[i];
+      _nextAlphas[l] = acc;
+
+      for(unsigned j =0; j<dim;++j) {       //_nextMeans[l] += x[i] * prob_l;
+	const BUFFER_DATA_TYPE *xj = x + j*EM_BLOCK_SIZE;
+	acc = *(_nextMeans + l*dim + j);
+	for(unsigned i = 0; i < n; i++) acc += xj[i] * prob_l[i];
+	*(_nextMeans + l*dim + j) = acc;
+      }
 
-      pOut = _nextInvVars+l*dim;
+      PARAM_DATA_TYPE *pOut = _nextInvVars+l*dim;
       // we don't store the inverses here as the name _nextInvVars implies.  We will invert it in endEpoch();
-      for ( unsigned k = 0; k < dim; ++k ) // used to be pointProdAdd(_nextInvVars+l*dim, pointerSet, i, prob_l,dim); 
-	*pOut++ += *(pointerSet.start[k]+ i*pointerSet.skip) * *(pointerSet.start[k] + i * pointerSet.skip) * prob_l;
+      for ( unsigned k = 0; k < dim; ++k ) {
+	const BUFFER_DATA_TYPE *xk = x + k*EM_BLOCK_SIZE;
+	acc = pOut[k];
+	for(unsigned i = 0; i < n; i++) acc += xk[i] * xk[i] * prob_l[i];
+	pOut[k] = acc;
+      }
     }
   }
 
@@ -834,6 +882,82 @@ void MixNormal::Prob_l_x_theta(PARAM_DATA_TYPE &Px,
 } // end prob_l_x_theta
 
 
+//////////////////// blockPosteriors ////////////////////
+
+/**
+ * same as Prob_l_x_theta() but for a block of samples, one mixture
+ * component at a time, so that the density and the exp()/log() are
+ * done over contiguous arrays of samples.
+ *
+ * @param x n samples stored variable-major (see gatherBlock())
+ * @param n number of samples in the block, <= EM_BLOCK_SIZE
+ * @param post P(l|x_i,theta) is written to post[l*EM_BLOCK_SIZE + i]
+ */
+void MixNormal::blockPosteriors(const BUFFER_DATA_TYPE *x, unsigned n,
+				PARAM_DATA_TYPE *post) {
+  unsigned dim = _numVariables;
+  PARAM_DATA_TYPE Px[EM_BLOCK_SIZE];
+  PARAM_DATA_TYPE d[MAX_POINTER_SET_DIM*EM_BLOCK_SIZE];
+  PARAM_DATA_TYPE bd[EM_BLOCK_SIZE];
+
+  for(unsigned i = 0; i < n; i++) Px[i] = 0;
+
+  for(unsigned l = 0; l < _numMixtures; l++) {
+    const PARAM_DATA_TYPE *mean = _means + l*dim;
+    const PARAM_DATA_TYPE *invVar = _invVars + l*dim;
+    PARAM_DATA_TYPE *e = post + l*EM_BLOCK_SIZE;
+
+    for(unsigned i = 0; i < n; i++) e[i] = 0.0;
+    if ( _fullCoVar ) {
+      // e = dot(invVar, B(x-u), B(x-u))
+      const PARAM_DATA_TYPE *b = _b + l*dim*dim;
+      for(unsigned j = 0; j < dim; ++j) {
+	const BUFFER_DATA_TYPE *xj = x + j*EM_BLOCK_SIZE;
+	PARAM_DATA_TYPE *dj = d + j*EM_BLOCK_SIZE;
+	for(unsigned i = 0; i < n; i++) dj[i] = xj[i] - mean[j];
+      }
+      for(unsigned ii = 0; ii < dim; ++ii) {
+	for(unsigned i = 0; i < n; i++) bd[i] = 0.0;
+	for(unsigned jj = 0; jj < dim; ++jj) {
+	  const PARAM_DATA_TYPE bij = b[ii*dim + jj];
+	  const PARAM_DATA_TYPE *dj = d + jj*EM_BLOCK_SIZE;
+	  for(unsigned i = 0; i < n; i++) bd[i] += bij * dj[i];
+	}
+	for(unsigned i = 0; i < n; i++) e[i] += invVar[ii] * bd[i] * bd[i];
+      }
+    } else {
+      // e = dot(invVar, x-u, x-u)
+      for(unsigned j = 0; j < dim; ++j) {
+	const BUFFER_DATA_TYPE *xj = x + j*EM_BLOCK_SIZE;
+	const PARAM_DATA_TYPE u = mean[j];
+	const PARAM_DATA_TYPE v = invVar[j];
+	for(unsigned i = 0; i < n; i++) {
+	  const PARAM_DATA_TYPE dd = xj[i] - u;
+	  e[i] += v * dd * dd;
+	}
+      }
+    }
+
+    for(unsigned i = 0; i < n; i++) e[i] = -0.5 * e[i];
+    vexp(n, e, e);
+    const double sqrtInvDet = sqrt( *(_invDets+ l) );
+    for(unsigned i = 0; i < n; i++) {
+      e[i] = e[i] * sqrtInvDet * _inv_pow_sqrt_2pi * _alphas[l];
+      Px[i] = Px[i] + e[i];
+    }
+  }
+
+  for(unsigned l = 0; l < _numMixtures; l++) {
+    PARAM_DATA_TYPE *p = post + l*EM_BLOCK_SIZE;
+    for(unsigned i = 0; i < n; i++)
+      p[i] = ( Px[i] <= FLT_MIN ) ? FLT_MIN : p[i] / Px[i];
+  }
+
+  vlog(n, Px, Px);
+  for(unsigned i = 0; i < n; i++) _logLikelihood -= Px[i];
+} // end blockPosteriors
+
+
 //////////////////// prob_x_theta_l ////////////////////
 
 /**
@@ -318,6 +318,12 @@ public:
 		      const PointerSetToDataPoints &pointerSet, 
 		      PARAM_DATA_TYPE * postProbOutPtr,
 		      unsigned sample) const;
+  // Block version of Prob_l_x_theta for n <= EM_BLOCK_SIZE samples
+  // stored variable-major in x (x[j*EM_BLOCK_SIZE + i] is variable j
+  // of sample i). Puts P(l|x_i,theta) into post[l*EM_BLOCK_SIZE + i]
+  // and subtracts each log P(x_i|theta) from _logLikelihood.
+  void blockPosteriors(const BUFFER_DATA_TYPE *x, unsigned n,
+		       PARAM_DATA_TYPE *post);
   // return the probability from component l
   // P_l(x, theta_l)
   PARAM_DATA_TYPE prob_x_theta_l(const PointerSetToDataPoints &pointerSet, unsigned l, unsigned sample) const;
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <vector>
 
 /*
  *
@@ -25,6 +26,7 @@
 #include "range.h"
 #include "readRange.h"
 #include "error.h"
+#include "work-queue.h"
 
 using namespace std;
 
@@ -152,6 +154,18 @@ void MixNormalCollection::setReRandsPerMixCompRedux(unsigned r) {
 }
 
 
+unsigned MixNormalCollection::numThreads = 1;
+
+/**
+ * set the number of threads the tuples are spread over during EM
+ *
+ * @param n the number of threads
+ */
+void MixNormalCollection::setNumThreads(unsigned n) {
+  numThreads = (n > 0) ? n : 1;
+}
+
+
 
 /**
  * prepare to start an EM epoch
@@ -164,7 +178,45 @@ void MixNormalCollection::startEpoch() {
 
 
 /**
- * add more data set into the EM learning accumulation
+ * the EM accumulation of one segment for the tuples that are still
+ * active, shared by the threads doing it.
+ */
+struct AddToEpochJob {
+  MixNormal *ftrMI;
+  const unsigned *active;  // indices of the active tuples
+  RangeSetCollection *tupleCol;
+  BUFFER_DATA_TYPE *obsMatPtr;
+  size_t featureVecDim;
+  size_t totalNumFramesInSentence;
+  size_t numFramesToProcess;
+  unsigned firstFrameToProcess;
+};
+
+static void addToEpochItem(void *arg, unsigned item, unsigned thread) {
+  const AddToEpochJob &job = *(const AddToEpochJob *) arg;
+  const unsigned i = job.active[item];
+  MixNormal *p = job.ftrMI + i;
+  // the pointer set is the only scratch space needed, so each item has its own
+  PointerSetToDataPoints pointerSet(job.featureVecDim);
+  RangeSet tuple = job.tupleCol->rs[i];
+  pointerSet.setDim(tuple.getSize());
+  const unsigned numFramesProcessed =
+    pointerSet.initialize(job.obsMatPtr, job.totalNumFramesInSentence,
+			  job.numFramesToProcess, job.firstFrameToProcess, tuple);
+  if (numFramesProcessed != 0) {
+    if(p->_fullCoVar) {
+      p->addToEpoch(pointerSet);
+    } else {
+      p->addToEpochDiag(pointerSet);
+    }
+  }
+}
+
+
+/**
+ * add more data set into the EM learning accumulation.  The tuples
+ * are independent, so they are spread over numThreads threads which
+ * share the (read-only) segment data.
  *
  * @param obsMat ObservationMatrix 
  * @param n_ftrs number of features
@@ -181,27 +233,24 @@ void MixNormalCollection::addToEpoch(FileSource *obsMat,
   
   assert(numFramesToProcess > 0);
 
-  unsigned numFramesProcessed;
-  RangeSet tuple;
-  PointerSetToDataPoints pointerSet(featureVecDim);
-
-  unsigned i = 0;
-  for( MixNormal *p = _ftrMI; p != _ftrMI_endp; p++ ){
-    if ( p->active() ) {
-      tuple = tupleCol.rs[i];
-      pointerSet.setDim(tuple.getSize());
-      BUFFER_DATA_TYPE* obsMatPtr = (BUFFER_DATA_TYPE*) obsMat->baseAtFrame(0);
-      numFramesProcessed = pointerSet.initialize(obsMatPtr, totalNumFramesInSentence, numFramesToProcess, firstFrameToProcess, tuple);
-      if (numFramesProcessed != 0) {
-	if(p->_fullCoVar) {
-	  p->addToEpoch(pointerSet);
-	} else {
-	  p->addToEpochDiag(pointerSet);
-	}
-      }
-    }
-    ++i;
-  }
+  vector<unsigned> active;
+  active.reserve(_numMis);
+  for (unsigned i = 0; i < _numMis; i++)
+    if (_ftrMI[i].active())
+      active.push_back(i);
+  if (active.empty())
+    return;
+
+  AddToEpochJob job;
+  job.ftrMI = _ftrMI;
+  job.active = &active[0];
+  job.tupleCol = &tupleCol;
+  job.obsMatPtr = (BUFFER_DATA_TYPE*) obsMat->baseAtFrame(0);
+  job.featureVecDim = featureVecDim;
+  job.totalNumFramesInSentence = totalNumFramesInSentence;
+  job.numFramesToProcess = numFramesToProcess;
+  job.firstFrameToProcess = firstFrameToProcess;
+  runWorkQueue(active.size(), numThreads, addToEpochItem, &job);
 }
 
 
@@ -51,6 +51,10 @@ public:
   static void setReRandOnlyOneComp(bool b);
   static void setNoReRandOnDrop(bool b);
   static void setReRandsPerMixCompRedux(unsigned r);
+  static void setNumThreads(unsigned n);
+
+  // number of threads the tuples are spread over in addToEpoch()
+  static unsigned numThreads;
   ///////////////////////////////////////////////// initialization
 
   bool noSamplesFound(int& rangeSpecNum);
@@ -100,6 +100,7 @@ char       *Output_Fname                = NULL;
 int         Min_Num_Consecutive_Labels  = 0;
 
 int         Num_Iterations_Between_Saves = 100; // Number of iteration between parameter saves
+unsigned    Num_Threads                 = 1;   // Number of threads to spread the tuples over during EM
 float       Cov_Noise_Constant          = 1e-6; // adds a small amount of noise to the diagonal entries of covariance matrices to prevent numerical issues.
 float       Cov_Noise_Max_Rand          = 5e-7; // we add a random number between covAddConst-covAddEpsilon and covAddConst+Epsilon
 double      Clamp_Covariance            = 1e-10;
@@ -209,6 +210,7 @@ Arg Arg::Args[] = {
   Arg("krerands", Arg::Opt, Max_Num_Kmeans_Rerands, "Maximum number of kmeans cluster random re-assignements when null clusters are found"),
   Arg("nacps",    Arg::Opt, Num_Active_To_Inactive_Changes_For_Save,"Number of active->inactive changes for a save"),
   Arg("nips",     Arg::Opt, Num_Iterations_Between_Saves, "Number of iteartions between parameter saves"),
+  Arg("threads",  Arg::Opt, Num_Threads, "Number of threads the tuples are spread over during EM"),
 
   Arg("clampCov",      Arg::Opt, Clamp_Covariance, "Value to clamp the covariance entries to if they fall below it."),
   Arg("addCovConst",   Arg::Opt, Cov_Noise_Constant, "Non random value to add to the diagonal entries of covariance matrices to avoid numerical problems (notably, when the entries become too small)"),
@@ -716,6 +718,10 @@ int main(int argc, const char *argv[]) {
   if (Num_Active_To_Stop < 0) {
       error("-sac argument must be > 0");
   }
+  if (Num_Threads < 1) {
+      error("-threads argument must be >= 1");
+  }
+  MixNormalCollection::setNumThreads(Num_Threads);
 
   // Create objects
 
@@ -0,0 +1,56 @@
+#ifndef _VECTOR_MATH_
+#define _VECTOR_MATH_
+
+/*
+ * Copyright (C) 2004 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+#include <math.h>
+
+// ======================================================================
+// ----------  Interface to external optimized vector routines. ---------
+// ======================================================================
+
+#ifdef HAVE_MVEC
+extern "C" {
+void vexp_(int *n, double *x, int *stridex, double  *y,  int
+     *stridey);
+void vlog_(int *n, double *x, int *stridex, double  *y,  int
+     *stridey);
+}
+#endif
+
+// y[i] = exp(x[i]), i = 0 .. n-1. x and y may be the same array.
+inline void
+vexp(int n,double *x, double *y)
+{
+#ifdef HAVE_MVEC
+  static int one = 1;
+  vexp_(&n,x,&one,y,&one);
+#else
+  double *x_endp = x+n;
+  while (x != x_endp) {
+    *y++ = exp(*x++);
+  }
+#endif
+}
+
+// y[i] = log(x[i]), i = 0 .. n-1. x and y may be the same array.
+inline void
+vlog(int n,double *x, double *y)
+{
+#ifdef HAVE_MVEC
+  static int one = 1;
+  vlog_(&n,x,&one,y,&one);
+#else
+  double *x_endp = x+n;
+  while (x != x_endp) {
+    *y++ = log(*x++);
+  }
+#endif
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2004 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+
+#if defined(_POSIX_THREADS) && _POSIX_THREADS > 0
+#  define WORK_QUEUE_THREADS 1
+#  include <pthread.h>
+#endif
+
+#include "work-queue.h"
+
+
+#if defined(WORK_QUEUE_THREADS)
+
+struct WorkQueue {
+  WorkQueueFunc func;
+  void *arg;
+  unsigned numItems;
+  unsigned nextItem;
+  pthread_mutex_t lock;
+};
+
+struct WorkQueueThread {
+  WorkQueue *queue;
+  unsigned thread;
+};
+
+// Take items off the queue until there are none left.
+static void *
+workQueueThread(void *p)
+{
+  WorkQueueThread *const t = (WorkQueueThread *) p;
+  WorkQueue *const q = t->queue;
+  while (true) {
+    pthread_mutex_lock(&q->lock);
+    const unsigned item = q->nextItem;
+    if (item < q->numItems)
+      q->nextItem++;
+    pthread_mutex_unlock(&q->lock);
+    if (item >= q->numItems)
+      break;
+    q->func(q->arg, item, t->thread);
+  }
+  return NULL;
+}
+
+#endif
+
+
+void
+runWorkQueue(unsigned numItems, unsigned numThreads,
+	     WorkQueueFunc func, void *arg)
+{
+  if (numThreads > numItems)
+    numThreads = numItems;
+#if defined(WORK_QUEUE_THREADS)
+  if (numThreads > 1) {
+    WorkQueue q;
+    q.func = func;
+    q.arg = arg;
+    q.numItems = numItems;
+    q.nextItem = 0;
+    pthread_mutex_init(&q.lock, NULL);
+
+    WorkQueueThread *const threads = new WorkQueueThread[numThreads];
+    pthread_t *const ids = new pthread_t[numThreads];
+    bool *const started = new bool[numThreads];
+    for (unsigned t = 0; t < numThreads; t++) {
+      threads[t].queue = &q;
+      threads[t].thread = t;
+    }
+    // the calling thread works on the queue too; if a thread can't
+    // be started, the others just do its share.
+    for (unsigned t = 1; t < numThreads; t++)
+      started[t] = (pthread_create(&ids[t], NULL, workQueueThread, &threads[t]) == 0);
+    workQueueThread(&threads[0]);
+    for (unsigned t = 1; t < numThreads; t++)
+      if (started[t])
+	pthread_join(ids[t], NULL);
+
+    delete [] started;
+    delete [] ids;
+    delete [] threads;
+    pthread_mutex_destroy(&q.lock);
+    return;
+  }
+#endif
+  for (unsigned i = 0; i < numItems; i++)
+    func(arg, i, 0);
+}
@@ -0,0 +1,28 @@
+#ifndef _WORK_QUEUE_
+#define _WORK_QUEUE_
+
+/*
+ * Copyright (C) 2004 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ */
+
+/**
+ * A work item: does item number 'item' of the job described by 'arg',
+ * running in thread number 'thread' (0 <= thread < numThreads), so
+ * that per-thread scratch space can be indexed by it.
+ */
+typedef void (*WorkQueueFunc)(void *arg, unsigned item, unsigned thread);
+
+/**
+ * Run func for all items 0..numItems-1, handing the items out in order
+ * from a shared counter to numThreads threads (the calling thread
+ * being thread 0). Items must be independent of each other. Returns
+ * when all items are done. Without POSIX threads, or with
+ * numThreads <= 1, the items are done in order by the calling thread.
+ */
+void runWorkQueue(unsigned numItems, unsigned numThreads,
+		  WorkQueueFunc func, void *arg);
+
+#endif
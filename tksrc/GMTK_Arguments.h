@@ -261,6 +261,34 @@ Arg("map",Arg::Opt,dlopenFilenames,"Deterministic mapping dynamic library file.
 #endif
 #endif // defined(GMTK_ARG_CPT_NORM_THRES)
 
+#if defined(GMTK_ARG_FNGRAM_CACHE)
+#if defined(GMTK_ARGUMENTS_DEFINITION)
+
+#elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
+
+  Arg("fngramCacheSize",Arg::Opt,FNGramCPT::maxCachedProbs,"Max number of probabilities per FNGramCPT to cache per segment (0 = no caching)"),
+
+#elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
+
+#else
+#endif
+#endif // defined(GMTK_ARG_FNGRAM_CACHE)
+
+#if defined(GMTK_ARG_DEEPNN_PRECISION)
+#if defined(GMTK_ARGUMENTS_DEFINITION)
+
+#include "GMTK_DeepNN.h"
+
+#elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
+
+  Arg("dnnSinglePrecision",Arg::Opt,DeepNN::singlePrecision,"Evaluate (and in gmtkDMLPtrain, train) deep NNs in single precision"),
+
+#elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
+
+#else
+#endif
+#endif // defined(GMTK_ARG_DEEPNN_PRECISION)
+
 /*==============================================================================================================*/
 /****************************************************************************************************************/
 /****************************************************************************************************************/
@@ -622,6 +650,8 @@ Arg("map",Arg::Opt,dlopenFilenames,"Deterministic mapping dynamic library file.
 
   Arg("ckbeam",Arg::Opt,MaxClique::cliqueBeamMaxNumStates,"Prune to this clique max state space (0 = no pruning)"),
   Arg("cusample",Arg::Opt,MaxClique::cliqueBeamUniformSampleAmount,"Uniformly sample pruned clique (0<v=<=1 fraction, > 1 number)"),
+  Arg("chistbins",Arg::Opt,MaxClique::cliqueHistogramPruneBins,"Do the -ckbeam, -cmbeam, and -cbeam clique pruning together from a score histogram with this many bins (0 = separately)"),
+  Arg("cmemBudget",Arg::Opt,JunctionTree::cliqueMemoryBudget,"Memory budget (MB) for the clique and separator tables. Within a partition that would exceed it, the -ckbeam state limit is tightened; -cbeam and -cpbeam are not changed (0 = no budget)"),
 
 
 #elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
@@ -629,6 +659,9 @@ Arg("map",Arg::Opt,dlopenFilenames,"Deterministic mapping dynamic library file.
     if (MaxClique::cliqueBeamUniformSampleAmount < 0.0) {
       error("ERROR: -cusample option must be non-negative");
     }
+    if (JunctionTree::cliqueMemoryBudget < 0.0) {
+      error("ERROR: -cmemBudget option must be non-negative");
+    }
 
 #else
 #endif
@@ -1374,6 +1407,7 @@ static bool  cliquePrintSwap       = false;
 #elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
 
   Arg("componentCache",Arg::Opt,MixtureCommon::cacheMixtureProbabilities,"Cache mixture and component probabilities, faster but uses more memory."),
+  Arg("dlinkPrecompute",Arg::Opt,DlinkMatrix::precomputeRegressions,"Compute the dlink regressions of all frames of a segment in one pass per dlink matrix, rather than per frame and component."),
 
 #elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
 
@@ -1400,6 +1434,7 @@ static bool  cliquePrintSwap       = false;
 #elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
 
   Arg("componentCache",Arg::Opt,MixtureCommon::cacheMixtureProbabilities,"Cache mixture probabilities, faster but uses more memory."),
+  Arg("dlinkPrecompute",Arg::Opt,DlinkMatrix::precomputeRegressions,"Compute the dlink regressions of all frames of a segment in one pass per dlink matrix, rather than per frame and component."),
 
 #elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
 
@@ -1629,6 +1664,7 @@ static bool accFileIsBinary = true;
 static char *llStoreFile = NULL;
 static char *objsToNotTrainFile=NULL;
 static bool localCliqueNormalization = false;
+static bool emPruneMasks = false;
 
 #elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
 
@@ -1658,6 +1694,11 @@ static bool localCliqueNormalization = false;
   Arg("llStoreFile",Arg::Opt,llStoreFile,"File to store previous sum LL's"), 
   Arg("objsNotToTrain",Arg::Opt,objsToNotTrainFile,"File listing trainable parameter objects to not train."),
   Arg("localCliqueNorm",Arg::Opt,localCliqueNormalization,"Use local clique sum for EM posterior normalization."),
+  Arg("emPruneMask",Arg::Opt,emPruneMasks,"Keep each segment's clique entries that survive pruning, and in the next EM iteration only expand those (see -emPruneMaskBeam). The masks hold every surviving entry of every training segment, so limit them with -emPruneMaskMem. Not available with -island"),
+  Arg("emPruneMaskBeam",Arg::Opt,MaxClique::cliquePruneMaskBeam,"With -emPruneMask, also keep clique entries within this log beam of the best entry so far"),
+  Arg("emPruneMaskMem",Arg::Opt,JunctionTree::pruneMaskMemoryBudget,"Memory (MB) all -emPruneMask masks may use together. Cliques whose mask would go over it get none and are expanded in full (0 = no limit)"),
+  Arg("emBatchStats",Arg::Opt,MixtureCommon::batchEmIncrements,"Sum each mixture's EM posteriors per frame before accumulating component statistics."),
+  Arg("emThreads",Arg::Opt,MixtureCommon::emIncrementThreads,"Number of threads over which -emBatchStats applies the statistics of independent mixtures. Requires -emBatchStats T"),
   Arg("dirichletPriors",Arg::Opt,EMable::useDirichletPriors,"Enable the use of Dirichlet priors for this process."),
 
   Arg("gmarCoeffL2",Arg::Opt,GaussianComponent::gmarCoeffL2,"Gaussian mean l2 accuracy-regularization tradeoff coeff (ie, prior concentration)"),
@@ -1667,6 +1708,20 @@ static bool localCliqueNormalization = false;
 #elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
 
   MixtureCommon::checkForValidRatioValues();
+  if (MixtureCommon::emIncrementThreads < 1)
+    error("%s: -emThreads must be at least 1\n",argerr);
+  if (MixtureCommon::emIncrementThreads > 1 && !MixtureCommon::batchEmIncrements)
+    error("%s: -emThreads %u only applies to -emBatchStats T\n",argerr,MixtureCommon::emIncrementThreads);
+  if (MaxClique::cliquePruneMaskBeam < 0.0)
+    error("%s: -emPruneMaskBeam must be >= 0\n",argerr);
+  if (JunctionTree::pruneMaskMemoryBudget < 0.0)
+    error("%s: -emPruneMaskMem must be >= 0\n",argerr);
+#if defined(GMTK_ARG_ISLAND)
+  // the island algorithm does not collect evidence with
+  // JunctionTree::collectEvidence(), where the masks are kept.
+  if (emPruneMasks && island)
+    error("%s: -emPruneMask can not be used with -island\n",argerr);
+#endif
   MeanVector::checkForValidValues();
   DiagCovarVector::checkForValidValues();
   DlinkMatrix::checkForValidValues();
@@ -1761,6 +1816,7 @@ static unsigned    radius             = 0;
 static unsigned    labelOffset        = 0;
 static bool        oneHot             = true;
 static unsigned    batchQueueSize     = 1000;
+static unsigned    gemmThreads        = 0;
 static char const *saveTrainingFile   = NULL;
 static char const *loadTrainingFile   = NULL;
 
@@ -1803,6 +1859,8 @@ static char const *trainingSchedule = "linear";
 
 Arg("nnChunkSize", Arg::Opt, DBN::nnChunkSize, "Size in MB to use for incremental DeepNN matrix operations"),
 Arg("batchQueueSize", Arg::Opt, batchQueueSize, "Size (in training instances) of the asynchronous batch queue"),
+Arg("gemmThreads", Arg::Opt, gemmThreads, "Maximum number of threads for each internal matrix multiply (0 = one per CPU)"),
+Arg("trainThreads", Arg::Opt, DBN::numTrainThreads, "Number of threads each training minibatch is split over"),
 Arg("deepMLPName", Arg::Req, DMLPName, "Name of deep NN to train"),
 Arg("featureOffset", Arg::Opt, obsOffset, "Offset in observation file where input features start"),
 Arg("numFeatures", Arg::Req, numFeatures, "Number of input features (per frame)"),
@@ -1876,6 +1934,10 @@ Arg("bpHdropP", Arg::Opt, bpHdropP, "Backprop: dropout probability for hidden la
 	  argerr, pretrainActFuncStr);
   }
 
+  if (DBN::numTrainThreads < 1) {
+    error("%s: -trainThreads must be at least 1\n", argerr);
+  }
+
   if (strcasecmp(trainingSchedule, "linear") == 0) {
   } else if (strcasecmp(trainingSchedule, "random") == 0) {
   } else if (strcasecmp(trainingSchedule, "permute") == 0) {
@@ -2274,6 +2336,7 @@ static bool writeLogVals = false;
   static unsigned chunkSkip = 1; 
   static int jut = -1;
   static char* anyTimeTriangulate = NULL;
+  static unsigned anyTimeWorkers = 1;
   static char* timeLimit = NULL;
   static bool rePartition = false;
   static bool reTriangulate = false;
@@ -2360,6 +2423,10 @@ static bool writeLogVals = false;
       Arg::Opt,anyTimeTriangulate,
       "Run the any-time triangulation algorithm for given duration."),
 
+  Arg("anyTimeWorkers",
+      Arg::Opt,anyTimeWorkers,
+      "Number of processes to run the any-time annealing (each with a different random seed) and exhaustive search (split between them) in"),
+
   Arg("timeLimit",
       Arg::Opt,timeLimit,
       "Do not run for longer than the given amount of time."),
@@ -2398,6 +2465,8 @@ static bool writeLogVals = false;
     error("%s: chunk skip parameter S must be >= 1\n",argerr);
   if (maxNumChunksInBoundary < 1)
     error("%s: max number chunks in boundary parameter M must be >= 1\n",argerr);
+  if (anyTimeWorkers < 1)
+    error("%s: -anyTimeWorkers must be >= 1\n",argerr);
   if (fabs(MaxClique::continuousObservationPerFeaturePenalty) > 1.0) {
     infoMsg(IM::Warning,"###\n### !!!DANGER WILL ROBINSON!! LARGE -pfCobWeight VALUE %f MIGHT CAUSE FLOATING POINT EXCEPTION. SUGGEST REDUCE IT IF FPE OCCURS!! ###\n###\n",MaxClique::continuousObservationPerFeaturePenalty);
   }
@@ -2408,6 +2477,61 @@ static bool writeLogVals = false;
 #endif // defined(GMTK_ARG_TRIANGULATION_OPTIONS)
 
 
+/*-----------------------------------------------------------------------------------------------------------*/
+/*************************************************************************************************************/
+/*************************************************************************************************************/
+/*************************************************************************************************************/
+
+
+#if defined(GMTK_ARG_PROFILE_TRIANGULATION)
+#if defined(GMTK_ARGUMENTS_DEFINITION)
+
+  static char* profileHeuristics = NULL;
+  const static char* profileRange = "all";
+  static unsigned profileSeconds = 30;
+  static unsigned profileMaxMemory = 0;
+  static char* profileCacheFile = NULL;
+
+#elif defined(GMTK_ARGUMENTS_DOCUMENTATION)
+
+  Arg("profileHeuristics",
+      Arg::Opt,profileHeuristics,
+      "Comma separated triangulation heuristics to compare by timing inference on the -profileRange segments"),
+
+  Arg("profileRange",
+      Arg::Opt,profileRange,
+      "Range of (development set) segments to time inference on when profiling triangulations"),
+
+  Arg("profileSeconds",
+      Arg::Opt,profileSeconds,
+      "Max CPU seconds to time each candidate triangulation when profiling"),
+
+  Arg("profileMaxMemory",
+      Arg::Opt,profileMaxMemory,
+      "Reject profiled triangulations whose inference uses more than this many MB (0 = no limit)"),
+
+  Arg("profileCacheFile",
+      Arg::Opt,profileCacheFile,
+      "File in which to cache triangulation profiling measurements across runs"),
+
+#elif defined(GMTK_ARGUMENTS_CHECK_ARGS)
+
+  if (profileHeuristics != NULL) {
+    if (profileSeconds < 1)
+      error("%s: -profileSeconds must be >= 1\n",argerr);
+    if (!loadParameters)
+      error("%s: -profileHeuristics requires -loadParameters T\n",argerr);
+    if (ofs[0] == NULL)
+      error("%s: -profileHeuristics requires observation files (-of1, etc.)\n",argerr);
+    if (anyTimeTriangulate != NULL)
+      error("%s: -profileHeuristics can not be used with -anyTimeTriangulate\n",argerr);
+  }
+
+#else
+#endif
+#endif // defined(GMTK_ARG_PROFILE_TRIANGULATION)
+
+
 
 /*-----------------------------------------------------------------------------------------------------------*/
 /*************************************************************************************************************/
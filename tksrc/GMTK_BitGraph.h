@@ -0,0 +1,120 @@
+#ifndef GMTK_BITGRAPH_H
+#define GMTK_BITGRAPH_H
+
+/*
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ * A dense undirected graph over nodes 0..n-1, stored as an n x n
+ * adjacency bit matrix. Each row is also usable as a node set, so
+ * the set operations the triangulation code needs (intersection
+ * sizes, subset tests, iteration in node order) are done a machine
+ * word at a time with no allocation, rather than by walking and
+ * building set<RV*>'s.
+ */
+
+#include <vector>
+
+using namespace std;
+
+class BitGraph {
+public:
+
+  typedef unsigned long Word;
+  enum { BITS_PER_WORD = sizeof(Word) * 8 };
+
+  BitGraph(unsigned n = 0) { resize(n); }
+
+  // clear the graph and make it have n nodes
+  void resize(unsigned n) {
+    numNodes = n;
+    rowWords = (n + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    bits.assign((size_t)n * rowWords, 0);
+  }
+
+  unsigned size() const { return numNodes; }
+
+  // # of Words in a row (node set)
+  unsigned words() const { return rowWords; }
+
+  // the neighbors of node i
+  Word* row(unsigned i) { return &bits[(size_t)i * rowWords]; }
+  const Word* row(unsigned i) const { return &bits[(size_t)i * rowWords]; }
+
+  bool hasEdge(unsigned i, unsigned j) const { return test(row(i), j); }
+  void addEdge(unsigned i, unsigned j) { set(row(i), j); set(row(j), i); }
+
+  ////////////////////////////////////////////////////////////
+  // Operations on node sets of 'nw' Words
+  ////////////////////////////////////////////////////////////
+
+  static bool test(const Word* s, unsigned i) {
+    return (s[i / BITS_PER_WORD] >> (i % BITS_PER_WORD)) & 1;
+  }
+  static void set(Word* s, unsigned i) {
+    s[i / BITS_PER_WORD] |= (Word)1 << (i % BITS_PER_WORD);
+  }
+  static void clear(Word* s, unsigned i) {
+    s[i / BITS_PER_WORD] &= ~((Word)1 << (i % BITS_PER_WORD));
+  }
+
+  static unsigned popcount(Word w) {
+#if defined(__GNUC__)
+    return __builtin_popcountl(w);
+#else
+    unsigned c = 0;
+    for ( ; w; w &= w - 1) c++;
+    return c;
+#endif
+  }
+
+  // |s|
+  static unsigned count(const Word* s, unsigned nw) {
+    unsigned c = 0;
+    for (unsigned k = 0; k < nw; k++) c += popcount(s[k]);
+    return c;
+  }
+
+  // |a intersect b|
+  static unsigned countAnd(const Word* a, const Word* b, unsigned nw) {
+    unsigned c = 0;
+    for (unsigned k = 0; k < nw; k++) c += popcount(a[k] & b[k]);
+    return c;
+  }
+
+  // true iff a is a subset of b
+  static bool isSubset(const Word* a, const Word* b, unsigned nw) {
+    for (unsigned k = 0; k < nw; k++)
+      if (a[k] & ~b[k]) return false;
+    return true;
+  }
+
+  // The smallest member of s that is >= i, or -1 if there isn't
+  // one. Iterate over s with
+  //   for (int i = next(s,nw,0); i >= 0; i = next(s,nw,i+1))
+  static int next(const Word* s, unsigned nw, unsigned i) {
+    unsigned k = i / BITS_PER_WORD;
+    if (k >= nw) return -1;
+    Word w = s[k] & (~(Word)0 << (i % BITS_PER_WORD));
+    while (!w) {
+      if (++k >= nw) return -1;
+      w = s[k];
+    }
+#if defined(__GNUC__)
+    return k * BITS_PER_WORD + __builtin_ctzl(w);
+#else
+    unsigned b = 0;
+    while (!((w >> b) & 1)) b++;
+    return k * BITS_PER_WORD + b;
+#endif
+  }
+
+private:
+
+  unsigned numNodes;
+  unsigned rowWords;
+  vector<Word> bits;
+};
+
+#endif
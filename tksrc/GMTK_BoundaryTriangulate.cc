@@ -46,10 +46,16 @@
 #include "GMTK_GraphicalModel.h"
 #include "GMTK_NetworkFlowTriangulate.h"
 #include "GMTK_CountIterator.h"
+#include "GMTK_BitGraph.h"
 
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
+#if HAVE_WORKING_FORK
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
 #if HAVE_HG_H
 #include "hgstamp.h"
 #endif
@@ -585,7 +591,7 @@ computeFillIn(const set<RV*>& nodes)
     // actually produce the set intersection and then use its size.
     // Done - RR 7/11/12
     count_iterator<set <RV*> > tmp;
-    set_intersection(nodes.begin(),nodes.end(),
+    tmp = set_intersection(nodes.begin(),nodes.end(),
 		     (*j)->neighbors.begin(),(*j)->neighbors.end(),
 		     tmp);
 
@@ -1902,7 +1908,9 @@ triangulateOnce(// input: nodes to be triangulated
 	    // output: resulting max cliques
 	    vector<MaxClique>& cliques,
 	    // output: string giving resulting method used
-	    string& meth_str)
+	    string& meth_str,
+	    // weight a triangulation must beat
+	    const double weight_bound)
 {
   vector<RV*> order;
   string                  annealing_str;
@@ -1929,7 +1937,7 @@ triangulateOnce(// input: nodes to be triangulated
 
     case TS_EXHAUSTIVE:
       triangulateExhaustiveSearch( nodes, jtWeight, nodesRootMustContain,
-				   orgnl_nghbrs, cliques ); 
+				   orgnl_nghbrs, cliques, weight_bound ); 
       meth_str = "exhaustive";
       break;
 
@@ -2144,7 +2152,7 @@ BoundaryTriangulate
       ////////////////////////////////////////////////////////////////////////
       default:
         triangulateOnce( nodes, jtWeight, nodesRootMustContain, tri_heur, 
-          nghbrs_with_extra, cliques, meth_str);
+          nghbrs_with_extra, cliques, meth_str, best_weight);
 
         weight = graphWeight(cliques, jtWeight, nodesRootMustContain);
 
@@ -2176,6 +2184,53 @@ BoundaryTriangulate
 
 }
 
+// marks entries of the weightedFillIn() memo table not computed yet
+#define UNKNOWN_EDGE_WEIGHT (-FLT_MAX)
+
+/*
+ * Same as computeWeightedFillIn(), for the node set 'nodes' of the
+ * bit graph whose nodes are 'rvs'. If edgeWeight is not empty, it
+ * memoizes the weight of each (ordered) pair of nodes.
+ */
+static double
+weightedFillIn(BitGraph& graph, const BitGraph::Word* nodes,
+	       const vector<RV*>& rvs, vector<float>& edgeWeight)
+{
+  const unsigned nw = graph.words();
+  vector<BitGraph::Word> missing(nw);
+  double weight = -1e10;
+  bool start = true;
+  for (int i = BitGraph::next(nodes,nw,0); i >= 0; i = BitGraph::next(nodes,nw,i+1)) {
+    const BitGraph::Word* row = graph.row(i);
+    for (unsigned k = 0; k < nw; k++)
+      missing[k] = nodes[k] & ~row[k];
+    BitGraph::clear(&missing[0],i);
+    for (int j = BitGraph::next(&missing[0],nw,0); j >= 0; j = BitGraph::next(&missing[0],nw,j+1)) {
+      // then we would need to fill it in.
+      float crrnt_weight = UNKNOWN_EDGE_WEIGHT;
+      if (!edgeWeight.empty())
+	crrnt_weight = edgeWeight[i*rvs.size() + j];
+      if (crrnt_weight == UNKNOWN_EDGE_WEIGHT) {
+	set<RV*> edge;
+	edge.insert(rvs[i]);
+	crrnt_weight = MaxClique::computeWeight(edge,rvs[j]);
+	if (!edgeWeight.empty())
+	  edgeWeight[i*rvs.size() + j] = crrnt_weight;
+      }
+      if (start) {
+	start = false;
+	weight = crrnt_weight;
+      } else {
+	weight = log10add(crrnt_weight,weight);
+      }
+    }
+  }
+  // each edge was counted twice
+  weight -= log10(2.0);
+  return weight;
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * BoundaryTriangulate::basicTriangulate()
@@ -2248,11 +2303,49 @@ BoundaryTriangulate
   // orderedNodes == already eliminated nodes. 
   orderedNodes.clear();
 
-  // Also keep ordered (eliminated) nodes as a set for easy
-  // intersection, with other node sets.
-  set<RV*> orderedNodesSet;
+  // The elimination graph is kept as an adjacency bit matrix over
+  // 'nodes' and any outside neighbors they have. Node indices follow
+  // set<RV*> order, so iterating over a bit set visits nodes in the
+  // same order as iterating over the corresponding set<RV*>, and all
+  // the ties, random choices, and floating point sums come out
+  // exactly as they would with sets.
+  set<RV*> allNodes = nodes;
+  for (set<RV*>::const_iterator i = nodes.begin(); i != nodes.end(); i++)
+    allNodes.insert((*i)->neighbors.begin(),(*i)->neighbors.end());
+  vector<RV*> rvs(allNodes.begin(),allNodes.end());
+  map<RV*,unsigned> rv2index;
+  for (unsigned i = 0; i < rvs.size(); i++)
+    rv2index[rvs[i]] = i;
+
+  BitGraph graph(rvs.size());
+  for (unsigned i = 0; i < rvs.size(); i++) {
+    for (set<RV*>::iterator j = rvs[i]->neighbors.begin(); j != rvs[i]->neighbors.end(); j++) {
+      map<RV*,unsigned>::iterator jj = rv2index.find(*j);
+      if (jj != rv2index.end())
+	BitGraph::set(graph.row(i),(*jj).second);
+    }
+  }
+  const unsigned nw = graph.words();
+
+  // nodes that have not been eliminated yet
+  vector<BitGraph::Word> active(nw,0);
+  for (unsigned i = 0; i < rvs.size(); i++)
+    BitGraph::set(&active[0],i);
+
+  // active neighbors of the node being scored or eliminated
+  vector<BitGraph::Word> activeNbrs(nw);
+
+  // Weighted fill-in is a sum of two node clique weights, which are
+  // memoized if the table isn't too big.
+  vector<float> edgeWeight;
+  for (unsigned thi=0;thi<th_v.size();thi++) {
+    if (th_v[thi] == TH_WEIGHTED_MIN_FILLIN && rvs.size() <= 1024)
+      edgeWeight.assign(rvs.size()*rvs.size(),UNKNOWN_EDGE_WEIGHT);
+  }
+
+  // the cliques found so far, as node sets
+  vector< vector<BitGraph::Word> > cliqueSets;
 
-  
   // Approach: essentially, create a priority queue data structure
   // using a multimap. In this case, those nodes with the lowest 'X'
   // where 'X' is the combined prioritized weight heuristics can be
@@ -2266,26 +2359,29 @@ BoundaryTriangulate
 
   // We also need to keep a map to be able to remove elements of
   // 'unorderedNodes' when a node is eliminated. I.e., we need to be
-  // able to map back from a RV* directly to its entry in the priority
-  // queue so that when a node is eliminated, its neighbors can be
-  // removed from the queue (since their weight is now invalid) and
-  // then (only) their weight can be recalculated anew.
-  map<RV*, multimap< vector<float>,RV*>::iterator > 
-    rv2unNodesMap;
+  // able to map back from a node index directly to its entry in the
+  // priority queue so that when a node is eliminated, its neighbors
+  // can be removed from the queue (since their weight is now invalid)
+  // and then (only) their weight can be recalculated anew.
+  vector< multimap< vector<float>,RV*>::iterator >
+    rv2unNodesMap(rvs.size());
 
   // Also, create a set of nodes which are the ones whose weight
   // needs to be updated in the priority queue 'unorderedNodes'.
   // We begin by updating the weights of all nodes.
-  set<RV*> nodesToUpdate = nodes;
+  vector<BitGraph::Word> inNodes(nw,0);
+  for (set<RV*>::const_iterator i = nodes.begin(); i != nodes.end(); i++)
+    BitGraph::set(&inNodes[0],rv2index[*i]);
+  vector<BitGraph::Word> nodesToUpdate(inNodes);
 
   do {
 
-    for (set<RV*>::iterator i = nodesToUpdate.begin();
-	 i != nodesToUpdate.end();
-	 i++) {
+    for (int ii = BitGraph::next(&nodesToUpdate[0],nw,0); ii >= 0;
+	 ii = BitGraph::next(&nodesToUpdate[0],nw,ii+1)) {
+      RV* const rv_i = rvs[ii];
 
       infoMsg(Huge,"TR: computing weight of node %s(%d)\n",
-	      (*i)->name().c_str(),(*i)->frame());
+	      rv_i->name().c_str(),rv_i->frame());
 
       // Create a vector with (weight,fillin,timeframe, etc.)
       // and choose in increasing lexigraphic order in that
@@ -2294,10 +2390,10 @@ BoundaryTriangulate
 
       // Create activeNeighbors, which contains only those neighbors
       // that are active and are not yet eliminated.
-      set<RV*> activeNeighbors;
-      set_difference((*i)->neighbors.begin(),(*i)->neighbors.end(),
-		     orderedNodesSet.begin(),orderedNodesSet.end(),
-		     inserter(activeNeighbors,activeNeighbors.end()));
+      const BitGraph::Word* nbrs = graph.row(ii);
+      for (unsigned k = 0; k < nw; k++)
+	activeNbrs[k] = nbrs[k] & active[k];
+      const unsigned numActiveNbrs = BitGraph::count(&activeNbrs[0],nw);
 
       // pre-allocate and reserve enough space to avoid re-copies.
       weight.reserve(th_v.size());
@@ -2307,42 +2403,53 @@ BoundaryTriangulate
 
 	const BasicTriangulateHeuristic th = th_v[thi];
 
-	// 
+	//
 	// TODO: add another heuristic, which is size^\beta * weight^\gamma
 	//       where \gamma and \beta are command line parameters.
-	// 
+	//
 
 	if (th == TH_MIN_WEIGHT || th == TH_MIN_WEIGHT_NO_D) {
-	  float tmp_weight = MaxClique::computeWeight(activeNeighbors,(*i),
+	  set<RV*> activeNeighbors;
+	  for (int j = BitGraph::next(&activeNbrs[0],nw,0); j >= 0;
+	       j = BitGraph::next(&activeNbrs[0],nw,j+1))
+	    activeNeighbors.insert(activeNeighbors.end(),rvs[j]);
+	  float tmp_weight = MaxClique::computeWeight(activeNeighbors,rv_i,
 					   (th == TH_MIN_WEIGHT));
 	  weight.push_back(tmp_weight);
 	  infoMsg(Huge,"  node has weight = %f\n",tmp_weight);
 	} else if (th == TH_MIN_FILLIN) {
-	  int fill_in = computeFillIn(activeNeighbors);
+	  // each active neighbor j is missing an edge to every other
+	  // active neighbor that is not a neighbor of j
+	  int fill_in = 0;
+	  for (int j = BitGraph::next(&activeNbrs[0],nw,0); j >= 0;
+	       j = BitGraph::next(&activeNbrs[0],nw,j+1))
+	    fill_in += numActiveNbrs - 1 - BitGraph::countAnd(&activeNbrs[0],graph.row(j),nw);
+	  // counted each edge twice
+	  fill_in /= 2;
 	  weight.push_back((float)fill_in);
 	  infoMsg(Huge,"  node has fill_in = %d\n",fill_in);
 	} else if (th == TH_WEIGHTED_MIN_FILLIN) {
-	  double wfill_in = computeWeightedFillIn(activeNeighbors);
+	  double wfill_in = weightedFillIn(graph,&activeNbrs[0],rvs,edgeWeight);
 	  weight.push_back(wfill_in);
 	  infoMsg(Huge,"  node has weighted_fill_in = %f\n",wfill_in);
 	} else if (th == TH_MIN_TIMEFRAME) {
-	  weight.push_back((*i)->frame());
-	  infoMsg(Huge,"  node has time frame = %d\n",(*i)->frame());
+	  weight.push_back(rv_i->frame());
+	  infoMsg(Huge,"  node has time frame = %d\n",rv_i->frame());
 	} else if (th == TH_MAX_TIMEFRAME) {
-	  weight.push_back( - ((*i)->frame()));
-	  infoMsg(Huge,"  node has (neg) time frame = -%d\n",(*i)->frame());
+	  weight.push_back( - (rv_i->frame()));
+	  infoMsg(Huge,"  node has (neg) time frame = -%d\n",rv_i->frame());
 	} else if (th == TH_MIN_SIZE) {
-	  weight.push_back((float)activeNeighbors.size());
+	  weight.push_back((float)numActiveNbrs);
 	  infoMsg(Huge,"  node has active neighbor size = %d\n",
-		  activeNeighbors.size());
+		  numActiveNbrs);
 	} else if (th == TH_MIN_POSITION_IN_FILE) {
-	  weight.push_back((float)(*i)->rv_info.variablePositionInStrFile);
+	  weight.push_back((float)rv_i->rv_info.variablePositionInStrFile);
 	  infoMsg(Huge,"  node has position in file = %d\n",
-		  (*i)->rv_info.variablePositionInStrFile);
+		  rv_i->rv_info.variablePositionInStrFile);
 	} else if (th == TH_MIN_HINT) {
-	  weight.push_back((float)(*i)->rv_info.eliminationOrderHint);
+	  weight.push_back((float)rv_i->rv_info.eliminationOrderHint);
 	  infoMsg(Huge,"  node has elimination order hint = %f\n",
-		  (*i)->rv_info.eliminationOrderHint);
+		  rv_i->rv_info.eliminationOrderHint);
 	} else if (th == TH_RANDOM) {
 	  float tmp = rnd.drand48();
 	  weight.push_back(tmp);
@@ -2351,8 +2458,8 @@ BoundaryTriangulate
 	  warning("Warning: unimplemented triangulation heuristic (ignored)\n");
       }
 
-      pair< vector<float>,RV*> p(weight,(*i));
-      rv2unNodesMap[(*i)] = (unorderedNodes.insert(p));
+      pair< vector<float>,RV*> p(weight,rv_i);
+      rv2unNodesMap[ii] = (unorderedNodes.insert(p));
     }
 
     if (message(Huge)) {
@@ -2375,9 +2482,9 @@ BoundaryTriangulate
     // utilizes the fact that the multimap stores values in ascending
     // order based on key (in this case the weight), and so the first
     // one (i.e., mm.begin() ) should have the lowest weight.
-    pair< 
-      multimap< vector<float>,RV*>::iterator, 
-      multimap< vector<float>,RV*>::iterator 
+    pair<
+      multimap< vector<float>,RV*>::iterator,
+      multimap< vector<float>,RV*>::iterator
       > ip = unorderedNodes.equal_range( (*(unorderedNodes.begin())).first );
 
     const unsigned d = distance(ip.first,ip.second);
@@ -2388,7 +2495,7 @@ BoundaryTriangulate
     // take the max of that with d, so that if more than numRandomTop
     // nodes tie, we still randomly choose from among all the tied
     // nodes.
-    const unsigned curNumRandomTop = 
+    const unsigned curNumRandomTop =
       max(min(numRandomTop,(unsigned)unorderedNodes.size()),d);
 
     if (curNumRandomTop == 1) {
@@ -2417,6 +2524,7 @@ BoundaryTriangulate
     // ip.first now points to the pair containing the random variable that
     // we eliminate.
     RV *rv = (*(ip.first)).second;
+    const unsigned rvi = rv2index[rv];
 
     if (message(Huge)) {
       printf("\nEliminating node %s(%d) with weights:",
@@ -2426,9 +2534,24 @@ BoundaryTriangulate
       printf("\n");
     }
 
-
-    // connect all neighbors of r.v. excluding nodes in 'orderedNodesSet'.
-    rv->connectNeighbors(orderedNodesSet);
+    const BitGraph::Word* nbrs = graph.row(rvi);
+    for (unsigned k = 0; k < nw; k++)
+      activeNbrs[k] = nbrs[k] & active[k];
+
+    // connect all active neighbors of r.v. (this is what
+    // rv->connectNeighbors(eliminated nodes) does, but only the
+    // missing edges are added).
+    for (int n = BitGraph::next(&activeNbrs[0],nw,0); n >= 0;
+	 n = BitGraph::next(&activeNbrs[0],nw,n+1)) {
+      BitGraph::Word* nrow = graph.row(n);
+      for (int m = BitGraph::next(&activeNbrs[0],nw,0); m >= 0;
+	   m = BitGraph::next(&activeNbrs[0],nw,m+1)) {
+	if (m != n && !BitGraph::test(nrow,m)) {
+	  BitGraph::set(nrow,m);
+	  rvs[n]->neighbors.insert(rvs[m]);
+	}
+      }
+    }
 
     // find the cliques if they are asked for.
     if (findCliques) {
@@ -2436,15 +2559,11 @@ BoundaryTriangulate
       // previous maxcliques. If it is not a subset of any previous
       // maxclique, then this node and its neighbors is a new
       // maxclique.
-      set<RV*> candidateMaxClique;
-      set_difference(rv->neighbors.begin(),rv->neighbors.end(),
-		     orderedNodesSet.begin(),orderedNodesSet.end(),
-		     inserter(candidateMaxClique,candidateMaxClique.end()));
-      candidateMaxClique.insert(rv);
+      vector<BitGraph::Word> candidate(activeNbrs);
+      BitGraph::set(&candidate[0],rvi);
       bool is_max_clique = true;
-      for (unsigned i=0;i < cliques.size(); i++) {
-	if (includes(cliques[i].nodes.begin(),cliques[i].nodes.end(),
-		     candidateMaxClique.begin(),candidateMaxClique.end())) {
+      for (unsigned i=0;i < cliqueSets.size(); i++) {
+	if (BitGraph::isSubset(&candidate[0],&cliqueSets[i][0],nw)) {
 	  // then found a 'proven' maxclique that includes our current
 	  // candidate, so the candidate cannot be a maxclique
 	  is_max_clique = false;
@@ -2452,6 +2571,10 @@ BoundaryTriangulate
 	}
       }
       if (is_max_clique) {
+	set<RV*> candidateMaxClique;
+	for (int j = BitGraph::next(&candidate[0],nw,0); j >= 0;
+	     j = BitGraph::next(&candidate[0],nw,j+1))
+	  candidateMaxClique.insert(candidateMaxClique.end(),rvs[j]);
 	if (message(Huge)) {
 	  // print out clique information.
 	  printf("Found a max clique of size %ld while eliminating node %s(%d):",
@@ -2465,36 +2588,34 @@ BoundaryTriangulate
 	  printf("\n");
 	}
  	cliques.push_back(MaxClique(candidateMaxClique));
+	cliqueSets.push_back(candidate);
       }
     }
-      
+
     // insert node into ordered list
     orderedNodes.push_back(rv);
 
-    // insert node into ordered set
-    orderedNodesSet.insert(rv);
+    // mark node as eliminated
+    BitGraph::clear(&active[0],rvi);
 
     // erase node from priority queue
     unorderedNodes.erase(ip.first);
 
     // only update not-yet-eliminated nodes that could possibly have
     // been effected by the current node 'rv' being eliminated. I.e.,
-    // create the set of active neighbors of rv.
-    nodesToUpdate.clear();
-    set_difference(rv->neighbors.begin(),rv->neighbors.end(),
-		   orderedNodesSet.begin(),orderedNodesSet.end(),
-		   inserter(nodesToUpdate,nodesToUpdate.end()));
+    // the active neighbors of rv.
+    for (unsigned k = 0; k < nw; k++)
+      nodesToUpdate[k] = activeNbrs[k] & inNodes[k];
 
     // erase active neighbors of nodes since they will need to be
     // recomputed above.
-    for (set<RV*>::iterator n = nodesToUpdate.begin();
-	 n != nodesToUpdate.end();
-	 n++) {
-      unorderedNodes.erase(rv2unNodesMap[(*n)]);
+    for (int n = BitGraph::next(&nodesToUpdate[0],nw,0); n >= 0;
+	 n = BitGraph::next(&nodesToUpdate[0],nw,n+1)) {
+      unorderedNodes.erase(rv2unNodesMap[n]);
     }
 
     // continue until all nodes are eliminated.
-  } while (orderedNodesSet.size() < num_nodes);
+  } while (orderedNodes.size() < num_nodes);
 
   infoMsg(Huge,"\nENDING BASIC TRIANGULATION --- \n");
 }
@@ -3033,6 +3154,7 @@ triangulateSimulatedAnnealing(
   vector<MaxClique>                rv_cliques;
   vector<triangulateNode*>         dummy_order;
   vector<triangulateNghbrPairType> orgnl_nghbrs;
+  map<string,double>               graph_weights;
 
   back_insert_iterator<vector<triangulateNode*> > bi_crrnt(crrnt_order);
   back_insert_iterator<vector<triangulateNode*> > 
@@ -3108,7 +3230,8 @@ triangulateSimulatedAnnealing(
     chain_length,
     weight_sum,         
     weight_sqr_sum,
-    orgnl_nghbrs);         
+    orgnl_nghbrs,
+    graph_weights);
 
   mean = weight_sum/moves_accepted; 
   ++moves_accepted; 
@@ -3156,7 +3279,8 @@ triangulateSimulatedAnnealing(
                        chain_length,
                        weight_sum,         
                        weight_sqr_sum,
-		       orgnl_nghbrs);         
+		       orgnl_nghbrs,
+		       graph_weights);
 
     ////////////////////////////////////////////////////////////////
     // Lower the temperature and calculate current stop ratio 
@@ -3221,6 +3345,56 @@ triangulateSimulatedAnnealing(
 }
 
 
+// bytes annealChain()'s memo table of graph weights may (roughly)
+// use before it is emptied, and the bytes a map entry takes besides
+// its key
+#define ANNEAL_MEMO_BYTES (64*1024*1024)
+#define ANNEAL_MEMO_ENTRY_OVERHEAD 64
+
+/*
+ * Eliminates the nodes of 'graph' in 'order' (node indices) on a
+ * copy of it in 'filled', and sets 'key' to the fill-in edges (u,w),
+ * u < w, in index order. A triangulation is the original graph plus
+ * its fill-in, so the key identifies the triangulation (and so its
+ * cliques) whatever order gave it.
+ */
+static void
+annealFillInKey(const BitGraph& graph, const vector<unsigned>& order,
+		BitGraph& filled, string& key)
+{
+  filled = graph;
+  const unsigned nw = graph.words();
+  vector<BitGraph::Word> eliminated(nw,0);
+  vector<BitGraph::Word> active(nw);
+  for (unsigned i = 0; i < order.size(); i++) {
+    const BitGraph::Word* row = filled.row(order[i]);
+    for (unsigned k = 0; k < nw; k++)
+      active[k] = row[k] & ~eliminated[k];
+    // the node's remaining neighbors become a clique
+    for (int u = BitGraph::next(&active[0],nw,0); u >= 0; u = BitGraph::next(&active[0],nw,u+1)) {
+      BitGraph::Word* urow = filled.row(u);
+      for (unsigned k = 0; k < nw; k++)
+	urow[k] |= active[k];
+      BitGraph::clear(urow,u);
+    }
+    BitGraph::set(&eliminated[0],order[i]);
+  }
+
+  key.clear();
+  vector<BitGraph::Word> fill(nw);
+  for (unsigned u = 0; u < graph.size(); u++) {
+    const BitGraph::Word* frow = filled.row(u);
+    const BitGraph::Word* grow = graph.row(u);
+    for (unsigned k = 0; k < nw; k++)
+      fill[k] = frow[k] & ~grow[k];
+    for (int w = BitGraph::next(&fill[0],nw,u+1); w >= 0; w = BitGraph::next(&fill[0],nw,w+1)) {
+      const unsigned edge[2] = { u, (unsigned)w };
+      key.append((const char*)edge,sizeof(edge));
+    }
+  }
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * annealChain 
@@ -3236,6 +3410,12 @@ triangulateSimulatedAnnealing(
  *   neighbor members and the parents/neighbors must only point to other 
  *   nodes in the set. 
  *
+ *   The weight of each triangulation is memoized in graph_weights,
+ *   keyed by its fill-in edges (see annealFillInKey()), since a chain
+ *   mostly revisits triangulations it has weighed already: swapping
+ *   two nodes often gives the same fill-in, and rejected moves are
+ *   undone.
+ *
  * Postconditions:
  *   crrnt_order       - the last order of the last accepted perumutation
  *   best_order        - the order giving the best weight found 
@@ -3243,11 +3423,12 @@ triangulateSimulatedAnnealing(
  *   best_this_weight  - the best graph weight found in this chain
  *   weight_sum        - sum of all the weights of accepted triangulations 
  *   weight_sqr_sum    - sum of all the weight^2 of accepted triangulations 
+ *   graph_weights     - has the weights of the new triangulations
  *
  * Side Effects:
- *   The partition is triangulated to the last triangulation in the 
- *   current order.  Neighbor members of each random variable can be 
- *   changed.
+ *   The partition is triangulated to the last triangulation that
+ *   was not in graph_weights.  Neighbor members of each random
+ *   variable can be changed.
  *
  * Results:
  *   The number of permutations that were accepted 
@@ -3268,13 +3449,26 @@ annealChain(
   unsigned                          iterations,
   double&                           weight_sum,         
   double&                           weight_sqr_sum,         
-  vector<triangulateNghbrPairType>& orgnl_nghbrs
+  vector<triangulateNghbrPairType>& orgnl_nghbrs,
+  map<string,double>&               graph_weights
   )
 {  
   vector<MaxClique>               rv_cliques;
   list<vector<triangulateNode*> > list_cliques;
   vector<triangulateNode*>        dummy_order;
 
+  // the original graph as a bit matrix over the indices of nodes, on
+  // which each order's fill-in is found
+  BitGraph orgnl_graph(nodes.size());
+  for (unsigned j = 0; j < orgnl_nghbrs.size(); j++) {
+    const unsigned u = orgnl_nghbrs[j].first - &nodes[0];
+    for (unsigned k = 0; k < orgnl_nghbrs[j].second.size(); k++)
+      orgnl_graph.addEdge(u, orgnl_nghbrs[j].second[k] - &nodes[0]);
+  }
+  BitGraph filled_graph;
+  vector<unsigned> order_index(crrnt_order.size());
+  string fill_in_key;
+
   back_insert_iterator<vector<triangulateNode*> > bi_best(best_order);
 
   triangulateNode* tmp_node; 
@@ -3317,11 +3511,23 @@ annealChain(
     ////////////////////////////////////////////////////////////////
     // Calculate new graph weight 
     ////////////////////////////////////////////////////////////////
-    restoreNeighbors(orgnl_nghbrs);
-    fillInComputation( crrnt_order );
-    maximumCardinalitySearch( nodes, list_cliques, dummy_order, false );
-    listVectorCliquetoVectorSetClique( list_cliques, rv_cliques );
-    crrnt_graph_weight = graphWeight(rv_cliques,jtWeight,nodesRootMustContain);
+    for (unsigned j = 0; j < crrnt_order.size(); j++)
+      order_index[j] = crrnt_order[j] - &nodes[0];
+    annealFillInKey(orgnl_graph, order_index, filled_graph, fill_in_key);
+    map<string,double>::iterator memo = graph_weights.find(fill_in_key);
+    if (memo != graph_weights.end()) {
+      crrnt_graph_weight = (*memo).second;
+    }
+    else {
+      restoreNeighbors(orgnl_nghbrs);
+      fillInComputation( crrnt_order );
+      maximumCardinalitySearch( nodes, list_cliques, dummy_order, false );
+      listVectorCliquetoVectorSetClique( list_cliques, rv_cliques );
+      crrnt_graph_weight = graphWeight(rv_cliques,jtWeight,nodesRootMustContain);
+      if (graph_weights.size()*(fill_in_key.size() + ANNEAL_MEMO_ENTRY_OVERHEAD) > ANNEAL_MEMO_BYTES)
+	graph_weights.clear();
+      graph_weights[fill_in_key] = crrnt_graph_weight;
+    }
 
     ////////////////////////////////////////////////////////////////
     // Check if it is the best ordering so far 
@@ -5819,6 +6025,12 @@ listVectorCliquetoVectorSetClique(
  * triangulateExhaustiveSearch 
  *   Tries every possible combination of edges to determine find a 
  *   minimum weight triangulation.
+ *
+ *   Only triangulations with a weight below weight_bound are kept,
+ *   and without the JT weight a combination's cliques are only
+ *   weighed until their sum reaches the best weight so far. Only
+ *   every exhaustiveNumShares'th combination (starting at
+ *   exhaustiveShare) is tried.
  * 
  * Preconditions:
  *   Each variable in the set of nodes must have valid parent and 
@@ -5826,8 +6038,9 @@ listVectorCliquetoVectorSetClique(
  *   nodes in the set. 
  *
  * Postconditions:
- *   The minimum weight triangulation is stored in best_cliques.  Graph 
- *   is triangulated.
+ *   The minimum weight triangulation is stored in best_cliques (or
+ *   some triangulation if none beats weight_bound).  Graph is
+ *   triangulated.
  *
  * Side Effects:
  *   Neighbor members of each random variable can be changed.  
@@ -5843,7 +6056,8 @@ triangulateExhaustiveSearch(
   const bool                   jtWeight,
   const set<RV*>&  nodesRootMustContain,
   const SavedGraph&            orgnl_nghbrs,
-  vector<MaxClique>&           best_cliques   
+  vector<MaxClique>&           best_cliques,
+  const double                 weight_bound
   )
 {
   // define local constants used in this routine.
@@ -5940,7 +6154,7 @@ triangulateExhaustiveSearch(
   ////////////////////////////////////////////////////////////////////
   // Begin Search 
   ////////////////////////////////////////////////////////////////////
-  double best_weight = DBL_MAX; 
+  double best_weight = weight_bound; 
   double weight; 
   bool done = false;
   bool chordal;
@@ -5979,19 +6193,54 @@ triangulateExhaustiveSearch(
     }
  
     //////////////////////////////////////////////////////////////////
-    // Test current configuration  
+    // Test current configuration, if it is in this search's share 
     //////////////////////////////////////////////////////////////////
-    maximumCardinalitySearch( triangulate_nodes, cliques, order, false);
-    chordal = testZeroFillIn( order );
+    if ((crrnt_trial-1) % exhaustiveNumShares == exhaustiveShare) {
+      maximumCardinalitySearch( triangulate_nodes, cliques, order, false);
+      chordal = testZeroFillIn( order );
+    }
+    else {
+      chordal = false;
+    }
 
     if (chordal) {
 
-      triangulation_found = true;
+      if (jtWeight) {
+        listVectorCliquetoVectorSetClique( cliques, vector_cliques );
+        weight = graphWeight(vector_cliques,jtWeight,nodesRootMustContain);
+      }
+      else {
+        ////////////////////////////////////////////////////////////////
+        // Same sum as graphWeight(), but the sum only grows, so stop
+        // once it can no longer beat the best weight.
+        ////////////////////////////////////////////////////////////////
+        weight = -1;
+        for( crrnt_clique = cliques.begin(), 
+             end_clique   = cliques.end();
+             crrnt_clique != end_clique && weight < best_weight; 
+             ++crrnt_clique ) {
 
-      listVectorCliquetoVectorSetClique( cliques, vector_cliques );
-      weight = graphWeight(vector_cliques,jtWeight,nodesRootMustContain);
+          set<RV*> clique_nodes;
+          for( crrnt_node = (*crrnt_clique).begin(), 
+	       end_node   = (*crrnt_clique).end(); 
+               crrnt_node != end_node;
+	       crrnt_node++ ) { 
+            clique_nodes.insert( (*crrnt_node)->randomVariable );
+          }
+          double crrnt_weight = MaxClique::computeWeight(clique_nodes);
+          if (weight < 0) {
+            weight = crrnt_weight; 
+          }
+          else {
+            weight = log10add(crrnt_weight,weight);
+          } 
+        }
+      }
 
       if (weight < best_weight) {
+
+        triangulation_found = true;
+
         infoMsg(IM::Low, "----- New Best: %f -----\n", weight); 
 
         infoMsg(IM::Moderate, "    ");
@@ -6581,25 +6830,114 @@ BoundaryTriangulate
 {
   assert (timer != NULL);
 
-  NghbrPairType nghbr_pair;
-  SavedGraph orgnl_P_nghbrs;
-  SavedGraph orgnl_C_nghbrs;
-  SavedGraph orgnl_E_nghbrs;
-  string best_P_method_str;
-  string best_C_method_str;
-  string best_E_method_str;
-  double best_P_weight = DBL_MAX;
-  double best_C_weight = DBL_MAX;
-  double best_E_weight = DBL_MAX;
-  const set <RV*> emptySet;
+  if (numAnyTimeWorkers > 1) {
+    parallelAnyTimeTriangulate(gm_template,jtWeight,doP,doC,doE);
+  } else {
+    double best_weight[3];
+    anyTimeSearch(gm_template,jtWeight,doP,doC,doE,best_weight);
+  }
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * BoundaryTriangulate::anyTimeSearch()
+ *  The anytime procedure itself: triangulate the P,C, and E partitions
+ *  with a sequence of increasingly expensive methods until the timer
+ *  expires.
+ *
+ * Preconditions:
+ *   Same as anyTimeTriangulate()
+ *
+ * Postconditions:
+ *   Same as anyTimeTriangulate()
+ *
+ * Side Effects:
+ *   Neighbor members of each random variable can be changed.
+ *
+ * Results:
+ *   best_weight[0], best_weight[1], best_weight[2] are set to the
+ *   weights of the best triangulations of P, C, and E (DBL_MAX for
+ *   partitions that were not triangulated)
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+BoundaryTriangulate
+::anyTimeSearch(GMTemplate& gm_template,
+		const bool jtWeight,
+		const bool doP,
+		const bool doC,
+		const bool doE,
+		double best_weight[3])
+{
+  SavedGraph orgnl_nghbrs[3];
 
   ////////////////////////////////////////////////////////////////////////
   // Save the untriangulated graphs so that they can be quickly restored
   // for multiple iterations
   ////////////////////////////////////////////////////////////////////////
-  if (doP) saveCurrentNeighbors(gm_template.P,orgnl_P_nghbrs);
-  if (doC) saveCurrentNeighbors(gm_template.C,orgnl_C_nghbrs);
-  if (doE) saveCurrentNeighbors(gm_template.E,orgnl_E_nghbrs);
+  if (doP) saveCurrentNeighbors(gm_template.P,orgnl_nghbrs[0]);
+  if (doC) saveCurrentNeighbors(gm_template.C,orgnl_nghbrs[1]);
+  if (doE) saveCurrentNeighbors(gm_template.E,orgnl_nghbrs[2]);
+
+  anyTimeHeuristics(gm_template,jtWeight,doP,doC,doE,orgnl_nghbrs,best_weight);
+  anyTimeRefine(gm_template,jtWeight,doP,doC,doE,orgnl_nghbrs,best_weight);
+
+  ////////////////////////////////////////////////////////////////////////
+  // Return with the best triangulations found, which is
+  // be stored within the template at this point.
+  ////////////////////////////////////////////////////////////////////////
+  if (doP) restoreNeighbors(orgnl_nghbrs[0]);
+  if (doC) restoreNeighbors(orgnl_nghbrs[1]);
+  if (doE) restoreNeighbors(orgnl_nghbrs[2]);
+  gm_template.triangulatePartitionsByCliqueCompletion();
+
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * BoundaryTriangulate::anyTimeHeuristics()
+ *  The first half of anyTimeSearch(): a preliminary triangulation of
+ *  the P,C, and E partitions and then the elimination heuristics.
+ *
+ * Preconditions:
+ *   Same as anyTimeTriangulate(), and orgnl_nghbrs[0..2] hold the
+ *   untriangulated P, C, and E graphs.
+ *
+ * Postconditions:
+ *   The best triangulations found are stored in the partitions' cliques.
+ *
+ * Side Effects:
+ *   Neighbor members of each random variable can be changed.
+ *
+ * Results:
+ *   best_weight[0..2] are set to the weights of the best
+ *   triangulations of P, C, and E (DBL_MAX for partitions that were
+ *   not triangulated)
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+BoundaryTriangulate
+::anyTimeHeuristics(GMTemplate& gm_template,
+		    const bool jtWeight,
+		    const bool doP,
+		    const bool doC,
+		    const bool doE,
+		    SavedGraph orgnl_nghbrs[3],
+		    double best_weight[3])
+{
+  SavedGraph& orgnl_P_nghbrs = orgnl_nghbrs[0];
+  SavedGraph& orgnl_C_nghbrs = orgnl_nghbrs[1];
+  SavedGraph& orgnl_E_nghbrs = orgnl_nghbrs[2];
+  double& best_P_weight = best_weight[0];
+  double& best_C_weight = best_weight[1];
+  double& best_E_weight = best_weight[2];
+  const set <RV*> emptySet;
+
+  best_P_weight = best_C_weight = best_E_weight = DBL_MAX;
 
   ////////////////////////////////////////////////////////////////////////
   // Triangulate using a basic heuristic so that something valid is in 
@@ -6680,7 +7018,52 @@ BoundaryTriangulate
 			  gm_template.P.triMethod, best_P_weight );
   }
   
-  infoMsg(IM::Tiny, "Time Remaining: %d\n", (int)timer->SecondsLeft() ); 
+  infoMsg(IM::Tiny, "Time Remaining: %d\n", (int)timer->SecondsLeft() );
+
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * BoundaryTriangulate::anyTimeRefine()
+ *  The second half of anyTimeSearch(): simulated annealing and then
+ *  exhaustive search of the P,C, and E partitions, for as long as the
+ *  timer allows.
+ *
+ * Preconditions:
+ *   Same as anyTimeHeuristics(), and best_weight[0..2] and the
+ *   partitions' cliques hold the best triangulations so far (as left
+ *   by anyTimeHeuristics()).
+ *
+ * Postconditions:
+ *   The best triangulations found are stored in the partitions' cliques.
+ *
+ * Side Effects:
+ *   Neighbor members of each random variable can be changed.
+ *
+ * Results:
+ *   best_weight[0..2] are lowered to the weights of any better
+ *   triangulations found.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+BoundaryTriangulate
+::anyTimeRefine(GMTemplate& gm_template,
+		const bool jtWeight,
+		const bool doP,
+		const bool doC,
+		const bool doE,
+		SavedGraph orgnl_nghbrs[3],
+		double best_weight[3])
+{
+  SavedGraph& orgnl_P_nghbrs = orgnl_nghbrs[0];
+  SavedGraph& orgnl_C_nghbrs = orgnl_nghbrs[1];
+  SavedGraph& orgnl_E_nghbrs = orgnl_nghbrs[2];
+  double& best_P_weight = best_weight[0];
+  double& best_C_weight = best_weight[1];
+  double& best_E_weight = best_weight[2];
+  const set <RV*> emptySet;
 
   ////////////////////////////////////////////////////////////////////////
   // Triangulate using simulated annealing 
@@ -6753,16 +7136,240 @@ BoundaryTriangulate
     infoMsg(IM::Tiny, "Time Remaining: %d\n", (int)timer->SecondsLeft() ); 
   }
 
+}
 
-  ////////////////////////////////////////////////////////////////////////
-  // Return with the best triangulations found, which is
-  // be stored within the template at this point.
-  ////////////////////////////////////////////////////////////////////////
-  if (doP) restoreNeighbors(orgnl_P_nghbrs);
-  if (doC) restoreNeighbors(orgnl_C_nghbrs);
-  if (doE) restoreNeighbors(orgnl_E_nghbrs);
-  gm_template.triangulatePartitionsByCliqueCompletion();
 
+#if HAVE_WORKING_FORK
+
+// Write/read all n bytes to/from a pipe, returning false on failure.
+static bool
+writeAll(int fd, const void* buf, size_t n)
+{
+  const char* p = (const char*)buf;
+  while (n > 0) {
+    ssize_t rc = write(fd,p,n);
+    if (rc < 0 && errno == EINTR) continue;
+    if (rc <= 0) return false;
+    p += rc; n -= rc;
+  }
+  return true;
+}
+
+static bool
+readAll(int fd, void* buf, size_t n)
+{
+  char* p = (char*)buf;
+  while (n > 0) {
+    ssize_t rc = read(fd,p,n);
+    if (rc < 0 && errno == EINTR) continue;
+    if (rc <= 0) return false;
+    p += rc; n -= rc;
+  }
+  return true;
+}
+
+
+// Send the triangulation of a partition (its weight, method string,
+// and cliques) from a worker process to the parent. Since the worker
+// is a fork of the parent, nodes are sent as positions in the
+// partition's (identically ordered) node set.
+static bool
+writePartitionTriangulation(int fd, Partition& part, double weight)
+{
+  map<RV*,unsigned> position;
+  unsigned i = 0;
+  for (set<RV*>::iterator it = part.nodes.begin(); it != part.nodes.end(); it++)
+    position[*it] = i++;
+
+  vector<unsigned> buf;
+  buf.push_back(part.triMethod.size());
+  buf.push_back(part.cliques.size());
+  for (unsigned c=0; c < part.cliques.size(); c++) {
+    set<RV*>& nodes = part.cliques[c].nodes;
+    buf.push_back(nodes.size());
+    for (set<RV*>::iterator it = nodes.begin(); it != nodes.end(); it++)
+      buf.push_back(position[*it]);
+  }
+  unsigned len = buf.size();
+  return writeAll(fd,&weight,sizeof(weight)) &&
+    writeAll(fd,&len,sizeof(len)) &&
+    writeAll(fd,&buf[0],len*sizeof(unsigned)) &&
+    writeAll(fd,part.triMethod.data(),part.triMethod.size());
+}
+
+
+static bool
+readPartitionTriangulation(int fd, Partition& part, double& weight,
+			   vector<MaxClique>& cliques, string& triMethod)
+{
+  vector<RV*> nodes(part.nodes.begin(),part.nodes.end());
+  unsigned len;
+  if (!readAll(fd,&weight,sizeof(weight)) || !readAll(fd,&len,sizeof(len)) || len < 2)
+    return false;
+  vector<unsigned> buf(len);
+  if (!readAll(fd,&buf[0],len*sizeof(unsigned)))
+    return false;
+  unsigned k = 0;
+  unsigned methodLength = buf[k++];
+  unsigned numCliques = buf[k++];
+  cliques.clear();
+  for (unsigned c=0; c < numCliques; c++) {
+    if (k >= len) return false;
+    unsigned size = buf[k++];
+    if (k + size > len) return false;
+    set<RV*> clique;
+    for (unsigned j=0; j < size; j++) {
+      if (buf[k] >= nodes.size()) return false;
+      clique.insert(nodes[buf[k++]]);
+    }
+    cliques.push_back(MaxClique(clique));
+  }
+  triMethod.resize(methodLength);
+  return methodLength == 0 || readAll(fd,&triMethod[0],methodLength);
+}
+
+#endif
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * BoundaryTriangulate::parallelAnyTimeTriangulate()
+ *  Run the anytime procedure with its second half in
+ *  numAnyTimeWorkers forked processes. The preliminary and heuristic
+ *  triangulations (anyTimeHeuristics()) are the same in every
+ *  process, so they are done once here. Each worker then starts from
+ *  their result and weights, which bound the exhaustive search, and
+ *  runs anyTimeRefine() until the common timer expires. Each worker
+ *  anneals with its own random number stream (worker i uses stream i
+ *  of the current seed, so the search is repeatable), and tries only
+ *  its share of the exhaustive search's edge combinations. The best
+ *  triangulation of each partition is kept (ties go to the heuristic
+ *  result, and then to the lowest numbered worker).
+ *
+ * Preconditions:
+ *   Same as anyTimeTriangulate()
+ *
+ * Postconditions:
+ *   Same as anyTimeTriangulate()
+ *
+ * Side Effects:
+ *   Neighbor members of each random variable can be changed.
+ *
+ * Results:
+ *   none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+BoundaryTriangulate
+::parallelAnyTimeTriangulate(GMTemplate& gm_template,
+			     const bool jtWeight,
+			     const bool doP,
+			     const bool doC,
+			     const bool doE)
+{
+#if HAVE_WORKING_FORK
+  const bool doPart[3] = { doP, doC, doE };
+  Partition* part[3] = { &gm_template.P, &gm_template.C, &gm_template.E };
+  const char* partName[3] = { "P", "C", "E" };
+
+  vector<pid_t> pids(numAnyTimeWorkers);
+  vector<int> fds(numAnyTimeWorkers);
+
+  SavedGraph orgnl_nghbrs[3];
+  for (unsigned i=0; i < 3; i++) {
+    if (doPart[i])
+      saveCurrentNeighbors(*part[i],orgnl_nghbrs[i]);
+  }
+  double best_weight[3];
+  anyTimeHeuristics(gm_template,jtWeight,doP,doC,doE,orgnl_nghbrs,best_weight);
+
+  infoMsg(IM::Low, "Running anytime triangulation in %u processes\n",numAnyTimeWorkers);
+  fflush(stdout);
+  fflush(stderr);
+  for (unsigned w=0; w < numAnyTimeWorkers; w++) {
+    int filedes[2];
+    if (pipe(&filedes[0])) {
+      error("ERROR: can't create pipe. errno = %d, %s\n",errno,strerror(errno));
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+      error("ERROR: can't fork anytime triangulation worker. errno = %d, %s\n",errno,strerror(errno));
+    }
+    if (pid == 0) {
+      // this is worker w
+      close(filedes[0]);
+      for (unsigned v=0; v < w; v++)
+	close(fds[v]);
+      rnd.seedStream(w);
+      exhaustiveShare = w;
+      exhaustiveNumShares = numAnyTimeWorkers;
+      anyTimeRefine(gm_template,jtWeight,doP,doC,doE,orgnl_nghbrs,best_weight);
+      bool ok = true;
+      for (unsigned i=0; ok && i < 3; i++) {
+	if (doPart[i])
+	  ok = writePartitionTriangulation(filedes[1],*part[i],best_weight[i]);
+      }
+      fflush(stdout);
+      fflush(stderr);
+      _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(filedes[1]);
+    pids[w] = pid;
+    fds[w] = filedes[0];
+  }
+
+  // collect the results
+  vector<MaxClique> best_cliques[3];
+  string best_method[3];
+  int best_worker[3] = { -1, -1, -1 };
+  unsigned numFailed = 0;
+  for (unsigned w=0; w < numAnyTimeWorkers; w++) {
+    bool ok = true;
+    for (unsigned i=0; ok && i < 3; i++) {
+      if (!doPart[i]) continue;
+      double weight;
+      vector<MaxClique> cliques;
+      string method;
+      ok = readPartitionTriangulation(fds[w],*part[i],weight,cliques,method);
+      if (ok && weight < best_weight[i]) {
+	best_weight[i] = weight;
+	best_cliques[i] = cliques;
+	best_method[i] = method;
+	best_worker[i] = w;
+      }
+    }
+    close(fds[w]);
+    int status = 0;
+    while (waitpid(pids[w],&status,0) < 0 && errno == EINTR)
+      ;
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      warning("WARNING: anytime triangulation worker %u failed (status = 0x%X)\n",w,status);
+      numFailed++;
+    }
+  }
+  if (numFailed == numAnyTimeWorkers)
+    warning("WARNING: all %u anytime triangulation workers failed, keeping the heuristic triangulations\n",numAnyTimeWorkers);
+
+  for (unsigned i=0; i < 3; i++) {
+    if (!doPart[i]) continue;
+    restoreNeighbors(orgnl_nghbrs[i]);
+    if (best_worker[i] < 0) {
+      infoMsg(IM::Low, "Best triangulation of %s (weight %f) found by the heuristics: %s\n",
+	      partName[i],best_weight[i],part[i]->triMethod.c_str());
+      continue;
+    }
+    infoMsg(IM::Low, "Best triangulation of %s (weight %f) found by worker %d: %s\n",
+	    partName[i],best_weight[i],best_worker[i],best_method[i].c_str());
+    part[i]->cliques = best_cliques[i];
+    part[i]->triMethod = best_method[i];
+  }
+  gm_template.triangulatePartitionsByCliqueCompletion();
+#else
+  warning("WARNING: parallel anytime triangulation is not supported on this platform, using 1 process\n");
+  double best_weight[3];
+  anyTimeSearch(gm_template,jtWeight,doP,doC,doE,best_weight);
+#endif
 }
 
 
@@ -20,6 +20,7 @@
 #include <list>
 #include <map>
 
+#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -214,6 +215,15 @@ private:
   // for debugging and informational purposes.
   unsigned boundaryRecursionDepth;
 
+  // Number of processes the anytime algorithm runs in parallel.
+  unsigned numAnyTimeWorkers;
+
+  // The exhaustive search only tests the edge configurations whose
+  // number is exhaustiveShare modulo exhaustiveNumShares, so that the
+  // anytime workers can split it between them.
+  unsigned exhaustiveShare;
+  unsigned exhaustiveNumShares;
+
 
   /////////////////////////////////////////////////////
   // Private support routines
@@ -247,6 +257,31 @@ private:
     const vector<MaxClique>& cliques 
   );
 
+  // The body of anyTimeTriangulate(). Returns the weights of the
+  // best triangulations found in best_weight[0..2] (for P, C, E).
+  void anyTimeSearch(GMTemplate& gm_template,
+		     const bool jtWeight,
+		     const bool doP, const bool doC, const bool doE,
+		     double best_weight[3]);
+  // The two halves of anyTimeSearch(): the preliminary and heuristic
+  // triangulations, and then the annealing and exhaustive search.
+  // orgnl_nghbrs[0..2] hold the untriangulated P, C, and E graphs.
+  void anyTimeHeuristics(GMTemplate& gm_template,
+			 const bool jtWeight,
+			 const bool doP, const bool doC, const bool doE,
+			 SavedGraph orgnl_nghbrs[3],
+			 double best_weight[3]);
+  void anyTimeRefine(GMTemplate& gm_template,
+		     const bool jtWeight,
+		     const bool doP, const bool doC, const bool doE,
+		     SavedGraph orgnl_nghbrs[3],
+		     double best_weight[3]);
+
+  // anyTimeTriangulate() with numAnyTimeWorkers > 1
+  void parallelAnyTimeTriangulate(GMTemplate& gm_template,
+				  const bool jtWeight,
+				  const bool doP, const bool doC, const bool doE);
+
 
   ////////////////////////////////////////////////////////////
   // options
@@ -323,7 +358,10 @@ private:
 		       // output: resulting max cliques
 		       vector<MaxClique>& best_cliques,
 		       // output: string giving resulting method used
-		       string& meth_str );
+		       string& meth_str,
+		       // weight a triangulation must beat (searches
+		       // may use it to give up early)
+		       const double weight_bound = DBL_MAX );
   
   // High-level generic graph triangulation using optionally all methods below.
   void triangulatePartition(// input: nodes to be triangulated
@@ -509,7 +547,8 @@ private:
 				   const bool         jtWeight,
 				   const set<RV*>&    nodesRootMustContain,
 				   const SavedGraph&  orgnl_nghbrs,
-				   vector<MaxClique>& cliques
+				   vector<MaxClique>& cliques,
+				   const double       weight_bound = DBL_MAX
 				   );
 
   // Triangulate by pre-specified elimination order
@@ -860,7 +899,8 @@ private:
     unsigned                  iterations,
     double&                   weight_sum,         
     double&                   weight_sqr_sum,         
-    vector<triangulateNghbrPairType>&    orgnl_nghbrs
+    vector<triangulateNghbrPairType>&    orgnl_nghbrs,
+    map<string,double>&       graph_weights
     );
 
   /* Not currently implemented
@@ -926,6 +966,9 @@ public:
 		      const unsigned arg_S,
 		      double arg_boundaryTraverseFraction = 1.0) 
     : fp(arg_fp),M(arg_M),S(arg_S),
+      numAnyTimeWorkers(1),
+      exhaustiveShare(0),
+      exhaustiveNumShares(1),
       noBoundaryMemoize(false),
       boundaryTraverseFraction(arg_boundaryTraverseFraction)
   {   
@@ -994,6 +1037,13 @@ public:
 			  const bool jtWeight,
 			  bool doP = true, bool doC = true, bool doE = true);
 
+  // Run the anytime search in numAnyTimeWorkers processes at once,
+  // each with its own random number stream, and keep the best
+  // triangulation of each partition.
+  void useAnyTimeWorkers(unsigned n) {
+    numAnyTimeWorkers = (n == 0) ? 1 : n;
+  }
+
   // Given the template, just unroll it flat-out a given number of
   // times and triangulate the result (possibly unconstrained
   // but depending on the heuristics given in 'th').
@@ -125,6 +125,17 @@ public:
 		   const int stride)
   { return ::exp(log_p(x,base,stride).val()); }
 
+  // Variants used when the frame index of the observation is
+  // known, so that per-segment precomputed values can be used.
+  // prepareFrames() must be called before any pointers into the
+  // observation matrix are obtained for log_p_frame().
+  virtual void prepareFrames() { }
+  virtual logpr log_p_frame(const unsigned frameIndex,
+			    const float *const x,
+			    const Data32* const base,
+			    const int stride)
+  { return log_p(x,base,stride); }
+
 
   // return the maximum possible value of this component. Default
   // return value is 1.0 (which is not even a bound for continuous RVs
@@ -71,7 +71,7 @@ matrices:0 % will cause an error if not updated
 #include "general.h"
 #include "error.h"
 #include "rand.h"
-#include "phipac.h"
+#include "gemm.h"
 
 #include "GMTK_DeepNN.h"
 #include "GMTK_GMParms.h"
@@ -81,6 +81,9 @@ matrices:0 % will cause an error if not updated
 VCID(HGID)
 
 
+bool DeepNN::singlePrecision = false;
+
+
 ////////////////////////////////////////////////////////////////////
 //        General create, read, destroy routines 
 ////////////////////////////////////////////////////////////////////
@@ -374,14 +377,14 @@ DeepNN::write(oDataStreamFile& os)
 #endif
 }
 
-void static
-rectlin(double *q, unsigned len) {
+template <class T> void static
+rectlin(T *q, unsigned len) {
   for (unsigned i=0; i < len; i+=1)
     if (q[i] < 0.0) q[i] = 0.0;
 }
 
-void static
-softmax(double *q, unsigned len) {
+template <class T> void static
+softmax(T *q, unsigned len) {
   double k  = *q;
 #if 1
   // Unrolled max by 2 was fastest of a few implementations I tried
@@ -414,25 +417,25 @@ softmax(double *q, unsigned len) {
   }
 }
 
-void static
-logistic(double *q, unsigned len, float beta=1.0) {
+template <class T> void static
+logistic(T *q, unsigned len, float beta=1.0) {
   for (unsigned i=0; i < len; i+=1)
     if (q[i] < -30)
       q[i] = 0;
     else if (q[i] > 30)
       q[i] = 1;
     else
-      q[i] = 1.0 / (1.0 + exp( -beta * q[i] ));
+      q[i] = 1.0 / (1.0 + exp( -beta * (double)q[i] ));
 }
 
-void static
-hyptan(double *q, unsigned len) {
+template <class T> void static
+hyptan(T *q, unsigned len) {
   for (unsigned i=0; i < len; i+=1) 
-    q[i] = tanh(q[i]);
+    q[i] = tanh((double)q[i]);
 }
 
-void static 
-oddroot(double *q, unsigned len) {
+template <class T> void static
+oddroot(T *q, unsigned len) {
 #if 0
 // Mathematica's inverse of $\frac{x^3}{3} + x$
 #define CUBE_ROOT_OF_2 1.25992104989
@@ -462,8 +465,10 @@ oddroot(double *q, unsigned len) {
 }
 
 
-void static
-squash(DeepNN::SquashFunction fn, double *q, unsigned len, float beta=1.0) {
+// The squash functions work on double or float layer outputs; the
+// arithmetic is done in double either way.
+template <class T> void static
+squash(DeepNN::SquashFunction fn, T *q, unsigned len, float beta=1.0) {
   switch (fn) {
   case DeepNN::SOFTMAX:
     softmax(q, len);
@@ -489,18 +494,75 @@ squash(DeepNN::SquashFunction fn, double *q, unsigned len, float beta=1.0) {
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * DeepNN::applyDeepModelFloat(inputs)
+ *      Single precision version of applyDeepModel(). The layer matrices
+ *      are converted to float the first time through (and again after
+ *      setParams()), the layers are evaluated with gmtk_sgemm(), and the
+ *      top layer's outputs are copied back into output_vector[0].
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+DeepNN::applyDeepModelFloat(float *inputs) {
+  if (layer_matrix_float.size() != num_matrices) {
+    layer_matrix_float.resize(num_matrices);
+    for (unsigned layer=0; layer < num_matrices; layer += 1) {
+      DoubleMatrix *w = layer_matrix[layer];
+      unsigned n = w->_rows * w->_cols;
+      layer_matrix_float[layer].resize(n);
+      for (unsigned i=0; i < n; i+=1)
+	layer_matrix_float[layer][i] = (float) w->values[i];
+    }
+    unsigned vector_length = max_outputs > num_inputs ? max_outputs : num_inputs;
+    float_output_vector[0].resize(vector_length+1);
+    float_output_vector[1].resize(vector_length+1);
+  }
+  float *input_vector = &float_output_vector[1][0];
+  memcpy(input_vector, inputs, num_inputs * sizeof(float));
+  input_vector[num_inputs] = 1.0f;                 // homogeneous coordinates
+
+  unsigned cur_output_vector = 1;
+  unsigned layer_inputs = num_inputs;
+  for (unsigned layer=0; layer < num_matrices; layer += 1) {
+    input_vector = &float_output_vector[cur_output_vector][0];
+    cur_output_vector = (cur_output_vector + 1) % 2;
+    float *out = &float_output_vector[cur_output_vector][0];
+    gmtk_sgemm('T', 'N', layer_output_count[layer], 1, layer_inputs+1,
+	       1.0f, &layer_matrix_float[layer][0], layer_inputs+1,
+	       input_vector, layer_inputs+1,
+	       0.0f, out, layer_output_count[layer]);
+    squash(layer_squash_func[layer], out, layer_output_count[layer], layer_logistic_beta[layer]);
+    out[layer_output_count[layer]] = 1.0f;
+    layer_inputs = layer_output_count[layer];
+  }
+
+  float *out = &float_output_vector[cur_output_vector][0];
+  for (unsigned i=0; i <= layer_inputs; i+=1)
+    output_vector[0][i] = (double) out[i];
+}
+
+
 double *
 DeepNN::applyDeepModel(float *inputs) {
   assert(output_vector[0] && output_vector[1]);
+  if (singlePrecision) {
+    applyDeepModelFloat(inputs);
+    return output_vector[0];
+  }
   double *input_vector = output_vector[1];
   input_vector[num_inputs] = 1.0;                  // homogeneous coordinates
   for (unsigned i = 0; i < num_inputs; i+=1) {
     input_vector[i] = (double)inputs[i];
   }
   memset(output_vector[0], 0, (max_outputs+1) * sizeof(double));
-  mul_mdmd_md(layer_output_count[0], num_inputs+1, 1, 
-	      layer_matrix[0]->values.ptr, input_vector, output_vector[0], 
-	      num_inputs+1, 1, 1);
+  // the layer matrices are row-major, so each is the transpose of
+  // a column-major num_inputs+1 x outputs matrix
+  gmtk_dgemm('T', 'N', layer_output_count[0], 1, num_inputs+1,
+	     1.0, layer_matrix[0]->values.ptr, num_inputs+1,
+	     input_vector, num_inputs+1,
+	     0.0, output_vector[0], layer_output_count[0]);
   squash(layer_squash_func[0], output_vector[0], layer_output_count[0], layer_logistic_beta[0]);
   output_vector[0][layer_output_count[0]] = 1.0;
 
@@ -509,9 +571,10 @@ DeepNN::applyDeepModel(float *inputs) {
     input_vector = output_vector[cur_output_vector];
     cur_output_vector = (cur_output_vector + 1) % 2;
     memset(output_vector[cur_output_vector], 0, (max_outputs+1) * sizeof(double));
-    mul_mdmd_md(layer_output_count[layer], layer_output_count[layer-1]+1, 1, 
-		layer_matrix[layer]->values.ptr, input_vector, output_vector[cur_output_vector], 
-		layer_output_count[layer-1]+1, 1, 1);
+    gmtk_dgemm('T', 'N', layer_output_count[layer], 1, layer_output_count[layer-1]+1,
+	       1.0, layer_matrix[layer]->values.ptr, layer_output_count[layer-1]+1,
+	       input_vector, layer_output_count[layer-1]+1,
+	       0.0, output_vector[cur_output_vector], layer_output_count[layer]);
     squash(layer_squash_func[layer], output_vector[cur_output_vector], layer_output_count[layer], layer_logistic_beta[layer]);
     output_vector[cur_output_vector][layer_output_count[layer]] = 1.0;
   }
@@ -52,8 +52,19 @@ class DeepNN : public NamedObject {
   // storage for layer outputs
   double *output_vector[2];
 
+  // single precision copies of the layer matrices and the layer
+  // outputs, built on first use when singlePrecision is set
+  vector< vector<float> > layer_matrix_float;
+  vector<float>           float_output_vector[2];
+
+  void applyDeepModelFloat(float *inputs);
+
 public:
 
+  // If true, evaluate (and train, in gmtkDMLPtrain) the networks
+  // in single precision
+  static bool singlePrecision;
+
   ///////////////////////////////////////////////////////////  
   // General constructor, 
 
@@ -108,6 +119,23 @@ public:
       }
       w->values[ r * cols + c ] = bias[r];
     }
+    layer_matrix_float.clear(); // rebuilt from the new values on next use
+  }
+
+  // Single precision version, for networks trained in float
+  void setParams(unsigned layer, float const *weights, unsigned ld, float const *bias) {
+    assert(layer < layer_matrix.size());
+    DoubleMatrix *w = layer_matrix[layer];
+    unsigned rows = w->_rows;
+    unsigned cols = w->_cols;
+    for (unsigned r=0; r < rows; r+=1) {
+      unsigned c;
+      for (c=0; c < cols - 1; c+=1) {
+	w->values[ r * cols + c ] = (double) weights[ r * ld + c ];
+      }
+      w->values[ r * cols + c ] = (double) bias[r];
+    }
+    layer_matrix_float.clear();
   }
 
   unsigned numLayers() { return num_matrices; }
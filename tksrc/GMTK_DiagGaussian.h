@@ -108,6 +108,10 @@ public:
 
 
 
+  // the (possibly shared) mean and covariance
+  MeanVector* getMean() { return mean; }
+  DiagCovarVector* getCovar() { return covar; }
+
   //////////////////////////////////
   // probability evaluation
   logpr log_p(const float *const x,    // real-valued scoring obs at time t
@@ -49,6 +49,7 @@ VCID(HGID)
 ////////////////////////////////////////////////////////////////////
 
 double DlinkMatrix::cloneSTDfrac = 0.0;
+bool DlinkMatrix::precomputeRegressions = false;
 
 void DlinkMatrix::checkForValidValues()
 {
@@ -79,6 +80,8 @@ void DlinkMatrix::checkForValidValues()
  */
 DlinkMatrix::DlinkMatrix() 
 {
+  regressionNumFrames = 0;
+  regressionSegment = 0;
 }
 
 
@@ -89,6 +92,70 @@ DlinkMatrix::DlinkMatrix()
 ////////////////////////////////////////////////////////////////////
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * precomputeSegmentRegressions()
+ *      Compute the regression term B*z for all (cacheable) frames of
+ *      the current segment at once. The z's are gathered once per
+ *      segment by the Dlinks object (shared by all matrices using
+ *      it), and each row of B is then applied along the frames, which
+ *      unlike the per-frame dot products in log_p() vectorizes. The
+ *      sums are accumulated in the same order as in log_p(), so the
+ *      results are identical.
+ *
+ * Preconditions:
+ *      Object must be read in, and dLinks->preCompute() must have been
+ *      called. No pointers into the observation matrix may be held
+ *      by the caller.
+ *
+ * Postconditions:
+ *      regressionAtFrame() returns the cached values for this segment.
+ *
+ * Side Effects:
+ *      Changes the observation matrix's frame window.
+ *
+ * Results:
+ *      none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+DlinkMatrix::precomputeSegmentRegressions()
+{
+  if (regressionSegment == Dlinks::segmentCount())
+    return;
+  regressionSegment = Dlinks::segmentCount();
+  regressionNumFrames = 0;
+  if (!dLinks->gatherFrames())
+    return;
+
+  const unsigned numFrames = dLinks->zFramesCacheNumFrames;
+  const unsigned d = dim();
+  regressionCache.growIfNeeded(numFrames*d);
+  regressionRow.growIfNeeded(numFrames);
+  float *const row = regressionRow.ptr;
+  const float *bp = arr.ptr;
+  const float *zp = dLinks->zFramesCache.ptr;
+  for (unsigned i=0;i<d;i++) {
+    for (unsigned t=0;t<numFrames;t++)
+      row[t] = 0.0;
+    const int nLinks = dLinks->numLinks(i);
+    for (int l=0;l<nLinks;l++) {
+      const float b = *bp++;
+      for (unsigned t=0;t<numFrames;t++)
+	row[t] += b*zp[t];
+      zp += numFrames;
+    }
+    float *cp = regressionCache.ptr + i;
+    for (unsigned t=0;t<numFrames;t++) {
+      *cp = row[t];
+      cp += d;
+    }
+  }
+  regressionNumFrames = numFrames;
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * read(is)
@@ -168,6 +235,7 @@ DlinkMatrix::read(iDataStreamFile& is)
   setBasicAllocatedBit();
   numTimesShared = 0;
   refCount = 0;
+  regressionSegment = 0;
 }
 
 
@@ -244,6 +312,7 @@ DlinkMatrix::makeRandom()
 
   for (int i=0;i<arr.len();i++)
     arr[i] = rnd.drand48pe();
+  regressionSegment = 0;
 }
 
 
@@ -275,6 +344,7 @@ DlinkMatrix::makeUniform()
 
   for (int i=0;i<arr.len();i++)
     arr[i] = 0;
+  regressionSegment = 0;
 }
 
 
@@ -927,6 +997,7 @@ DlinkMatrix::emSwapCurAndNew()
   for (int i=0;i<arr.len();i++) {
     genSwap(arr[i],nextArr[i]);
   }
+  regressionSegment = 0;
   // make no longer swappable
   emClearSwappableBit();
 }
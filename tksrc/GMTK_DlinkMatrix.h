@@ -70,6 +70,17 @@ class DlinkMatrix : public EMable  {
   // the object files.
   unsigned refCount;
 
+  ///////////////////////////////////////////////////////////
+  // Per-segment cache of the regression term B*z of every frame
+  // (frame-major, dim() values per frame), used when
+  // precomputeRegressions is set. Frames are relative to
+  // dLinks->zFramesCacheFirstFrame.
+  sArray< float > regressionCache;
+  sArray< float > regressionRow;
+  unsigned regressionNumFrames;
+  // the Dlinks::segmentCount() the cache is valid for, 0 if none.
+  unsigned regressionSegment;
+
 public:
 
   ///////////////////////////////////////////////////////////
@@ -83,6 +94,27 @@ public:
   static double cloneSTDfrac;
   static void checkForValidValues();
 
+  // If true, the regression terms of all frames of a segment
+  // are computed in one pass per segment rather than once per
+  // frame for each component that uses this matrix.
+  static bool precomputeRegressions;
+
+  ///////////////////////////////////////////////////////////
+  // Compute regressionCache for the current segment if needed.
+  // This moves the observation window, so it must not be called
+  // while holding pointers into the observation matrix.
+  void precomputeSegmentRegressions();
+  // Returns the cached B*z for the given frame, or NULL if it is
+  // not available (so it must be computed directly).
+  const float* regressionAtFrame(const unsigned frameIndex) const {
+    if (regressionSegment != Dlinks::segmentCount())
+      return NULL;
+    const unsigned t = frameIndex - dLinks->zFramesCacheFirstFrame;
+    if (frameIndex < dLinks->zFramesCacheFirstFrame || t >= regressionNumFrames)
+      return NULL;
+    return regressionCache.ptr + t*(unsigned)dim();
+  }
+
   //////////////////////////////////
   // set all current parameters to random/uniform values
   void makeRandom();
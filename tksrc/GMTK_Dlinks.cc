@@ -31,6 +31,7 @@
 
 #include "GMTK_Dlinks.h"
 #include "GMTK_DlinkMatrix.h"
+#include "GMTK_ObservationSource.h"
 
 #if HAVE_CONFIG_H
 #include <config.h>
@@ -47,6 +48,8 @@ VCID(HGID)
 ////////////////////////////////////////////////////////////////////
 
 // ok if -startSkip <= _globalMinLag
+unsigned Dlinks::_segmentCount = 1;
+
 int Dlinks::_globalMinLag = 0;
 // ok if endSkip >= _globalMaxLag
 int Dlinks::_globalMaxLag = 0;
@@ -73,7 +76,9 @@ int Dlinks::_globalMaxOffset = -1000000;
  */
 Dlinks::Dlinks()
 {
-
+  zFramesCacheFirstFrame = 0;
+  zFramesCacheNumFrames = 0;
+  zFramesCacheSegment = 0;
 }
 
 
@@ -319,3 +324,61 @@ Dlinks::cacheArrays(const Data32* const base, const float *const f)
   arrayCacheTag = base;
 }
 
+
+/*-
+ *-----------------------------------------------------------------------
+ * gatherFrames()
+ *      Gather the dlink inputs of all frames of the current segment
+ *      of the global observation matrix into zFramesCache (link-major),
+ *      unless that has already been done for this segment.
+ * 
+ * Preconditions:
+ *      preCompute() must have been called. Since this moves the
+ *      observation matrix's frame window over the whole segment, no
+ *      pointers into the observation matrix may be held by the caller.
+ *
+ * Postconditions:
+ *      zFramesCache holds totalNumberLinks() x zFramesCacheNumFrames values,
+ *      for the frames starting at zFramesCacheFirstFrame.
+ *
+ * Side Effects:
+ *      Changes the observation matrix's frame window.
+ *
+ * Results:
+ *      false if no frame of the segment can be cached (e.g., the number
+ *      of frames isn't known for streamed observations), true otherwise.
+ *
+ *-----------------------------------------------------------------------
+ */
+bool
+Dlinks::gatherFrames()
+{
+  if (zFramesCacheSegment == _segmentCount)
+    return zFramesCacheNumFrames > 0;
+  zFramesCacheSegment = _segmentCount;
+
+  // frames whose dlinks would reach outside of the segment are left
+  // to the usual per-frame computation.
+  const int segFrames = (int)globalObservationMatrix->numFrames();
+  const int firstFrame = (_minLag < 0 ? -_minLag : 0);
+  const int endFrame = segFrames - (_maxLag > 0 ? _maxLag : 0);
+  zFramesCacheFirstFrame = firstFrame;
+  zFramesCacheNumFrames = 0;
+  if (endFrame <= firstFrame)
+    return false;
+  const unsigned numFrames = endFrame - firstFrame;
+  zFramesCacheNumFrames = numFrames;
+
+  const unsigned nLinks = totalNumberLinks();
+  zFramesCache.growIfNeeded(nLinks*numFrames);
+  for (unsigned t=0;t<numFrames;t++) {
+    const float *const base =
+      (const float*)globalObservationMatrix->baseAtFrame(firstFrame+t);
+    float *zp = zFramesCache.ptr + t;
+    for (unsigned l=0;l<nLinks;l++) {
+      *zp = base[preComputedOffsets.ptr[l]];
+      zp += numFrames;
+    }
+  }
+  return true;
+}
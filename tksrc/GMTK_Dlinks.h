@@ -78,6 +78,24 @@ class Dlinks : public NamedObject {
   // --- precomputed length support
   unsigned _zzAccumulatorLength;
   /////////////////////////////////////////////////////////
+
+  /////////////////////////////////////////////////////////
+  // Support for DlinkMatrix::precomputeRegressions: the dlink
+  // inputs z of every frame of the current segment, gathered once
+  // for all DlinkMatrix objects sharing this structure. Stored
+  // link-major (all frames of the first link, then all frames
+  // of the second, ...) so the regressions can run along frames.
+  // Only frames whose links all lie inside the segment are kept,
+  // i.e., frames zFramesCacheFirstFrame onwards.
+  sArray <float> zFramesCache;
+  unsigned zFramesCacheFirstFrame;
+  unsigned zFramesCacheNumFrames;
+  unsigned zFramesCacheSegment;
+  // returns false if the current segment's length isn't known
+  bool gatherFrames();
+  // incremented whenever a new segment is started
+  static unsigned _segmentCount;
+  /////////////////////////////////////////////////////////
   
 
 public:
@@ -116,6 +134,11 @@ public:
   // clear the internal cache
   void clearArrayCache();
 
+  ////////////////////////////////////////////////
+  // invalidate all per-segment caches of all dlinks
+  static void newSegment() { _segmentCount++; }
+  static unsigned segmentCount() { return _segmentCount; }
+
   ///////////////////////////////////////////////////////////    
   // read in the basic parameters, assuming file pointer 
   // is located at the correct position.
@@ -24,6 +24,7 @@
  */
 
 
+#include <algorithm>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -1388,6 +1389,202 @@ inline logpr FNGramImp::bgChildProbSum(unsigned nodeId, BackoffGraphNode::HashEn
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramImp::distribution
+ *      calculate the probabilities of all values of the child with
+ *      backing-off support, i.e., probBackingOff() for val = 0,
+ *      ..., _card-1.
+ *
+ * Results:
+ *      The probabilities are written to dist.
+ *
+ * Side Effects:
+ *      As in probBackingOff, the backing-off weights computed with
+ *      generalized backoff are stored in the context tables.
+ *
+ *-----------------------------------------------------------------------
+ */
+void FNGramImp::distribution(unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries, const std::vector<unsigned> &parentsValues, logpr *dist) {
+	std::vector<logpr*> nodeDists(_numberOfBGNodes, (logpr*)NULL);
+
+	const logpr *nodeDist = nodeDistribution(nodeId, contextEntries, parentsValues, nodeDists);
+	for ( unsigned i = 0; i < _card; i++ )
+		dist[i] = nodeDist[i];
+
+	for ( unsigned i = 0; i < _numberOfBGNodes; i++ )
+		delete [] nodeDists[i];
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramImp::nodeDistribution
+ *      the distribution of the child at a node of the backoff graph.
+ *      This does what probBackingOff does, for all values at once.
+ *
+ * Results:
+ *      Return the distribution, which is owned by nodeDists.
+ *
+ * Side Effects:
+ *      The distributions of the nodes below nodeId are computed and
+ *      kept in nodeDists as needed.
+ *
+ *-----------------------------------------------------------------------
+ */
+const logpr* FNGramImp::nodeDistribution(unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries, const std::vector<unsigned> &parentsValues, std::vector<logpr*> &nodeDists) {
+	if ( nodeDists[nodeId] != NULL )
+		return nodeDists[nodeId];
+
+	logpr *dist = nodeDists[nodeId] = new logpr [_card];
+	unsigned val;
+	logpr prob;
+
+	if ( nodeId == 0 ) {
+		// the unigram node: whatever is not in the table has zero prob
+		for ( unsigned i = 0; i < _card; i++ )
+			dist[i].set_to_zero();
+		HashMTable<logpr>::iterator it(*_probabilities, 0, _probStartBlockSize);
+		while ( it.next(val, prob) ) {
+			if ( val < _card )
+				dist[val] = prob;
+		}
+		return dist;
+	}
+
+	// start with the backed-off probabilities of all values
+	BackoffGraphNode::HashEntry * contextEntry = contextEntries[nodeId];
+	bgChildDistribution(nodeId, contextEntries, parentsValues, nodeDists, dist);
+
+	if ( (contextEntry != NULL) && (! contextEntry->backingOffWeight.essentially_zero()) ) {
+		// we already have backing-off weight
+		for ( unsigned i = 0; i < _card; i++ )
+			dist[i] = contextEntry->backingOffWeight * dist[i];
+	} else if ( _bgNodes[nodeId].requiresGenBackoff() ) {
+		// the backing-off weight normalizes the backed-off
+		// probabilities, as in bgChildProbSum
+		logpr sum;
+		for ( unsigned i = 0; i < _card; i++ )
+			sum += dist[i];
+
+#ifdef FNGRAM_BOW_GROW_DYNA
+		if ( contextEntries[nodeId] == NULL ) {
+			// construct the context value
+			unsigned *context = new unsigned [_bgNodes[nodeId].order - 1];
+			std::vector<unsigned> onPos = bitsOn(nodeId);	// this will be something like 0, 1, 3
+			for ( unsigned i = 0; i < _bgNodes[nodeId].order - 1; i++ ) {
+				context[i] = parentsValues[onPos[i]];
+			}
+
+			contextEntries[nodeId] = _bgNodes[nodeId].contextTable->insert(context, BackoffGraphNode::HashEntry());
+		}
+
+		contextEntries[nodeId]->backingOffWeight.setFromLogP(-sum.val());
+#endif
+
+		for ( unsigned i = 0; i < _card; i++ )
+			dist[i] = dist[i] / sum;
+	}
+
+	// the explicit probabilities of the context take precedence
+	if ( contextEntry != NULL ) {
+		HashMTable<logpr>::iterator it(*_probabilities, contextEntry->probTableOffSet, contextEntry->probTableBlockSize);
+		while ( it.next(val, prob) ) {
+			if ( val < _card )
+				dist[val] = prob;
+		}
+	}
+
+	return dist;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramImp::bgChildDistribution
+ *      general graph backoff algorithm for multiple BG children, for
+ *      all values at once. See bgChildProbBackingOff.
+ *
+ * Results:
+ *      The probabilities are written to dist.
+ *
+ * Side Effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------
+ */
+void FNGramImp::bgChildDistribution(unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries, const std::vector<unsigned> &parentsValues, std::vector<logpr*> &nodeDists, logpr *dist) {
+	// create a reference to speed up
+	BackoffGraphNode& bgNode = _bgNodes[nodeId];
+	const logpr *childDist;
+	unsigned bg_child;
+
+	// special case numBGChildren == 1 for speed.
+	if ( bgNode.numBGChildren == 1 ) {
+		bg_child = nodeId & (~bgNode.backoffConstraint);
+		if ( _bgNodes[bg_child].valid ) {
+			childDist = nodeDistribution(bg_child, contextEntries, parentsValues, nodeDists);
+			for ( unsigned i = 0; i < _card; i++ )
+				dist[i] = childDist[i];
+			return;
+		}
+	}
+
+	// still here? Do the general case.
+	if ( bgNode.backoffCombine == ProdBgChild || bgNode.backoffCombine == GmeanBgChild ) {
+		for ( unsigned i = 0; i < _card; i++ )
+			dist[i].set_to_one();
+		BGChildIter citer(_numParents, nodeId, bgNode.backoffConstraint);
+		while ( citer.next(bg_child) ) {
+			if ( _bgNodes[bg_child].valid ) {
+				childDist = nodeDistribution(bg_child, contextEntries, parentsValues, nodeDists);
+				for ( unsigned i = 0; i < _card; i++ )
+					dist[i] *= childDist[i];
+			}
+		}
+
+		if ( bgNode.backoffCombine == GmeanBgChild ) {
+			for ( unsigned i = 0; i < _card; i++ )
+				dist[i].setFromLogP(dist[i].val() / bgNode.numBGChildren);
+		}
+	} else if ( bgNode.backoffCombine == SumBgChild || bgNode.backoffCombine == AvgBgChild) {
+		for ( unsigned i = 0; i < _card; i++ )
+			dist[i].set_to_zero();
+		BGChildIter citer(_numParents, nodeId, bgNode.backoffConstraint);
+		while ( citer.next(bg_child) ) {
+			if ( _bgNodes[bg_child].valid ) {
+				childDist = nodeDistribution(bg_child, contextEntries, parentsValues, nodeDists);
+				for ( unsigned i = 0; i < _card; i++ )
+					dist[i] += childDist[i];
+			}
+		}
+		if ( bgNode.backoffCombine == AvgBgChild ) {
+			for ( unsigned i = 0; i < _card; i++ )
+				dist[i] /= (double)bgNode.numBGChildren;
+		}
+	} else if ( bgNode.backoffCombine == WmeanBgChild ) {
+		for ( unsigned i = 0; i < _card; i++ )
+			dist[i].set_to_zero();
+		BGChildIter citer(_numParents, nodeId, bgNode.backoffConstraint);
+		unsigned cpos = 0;
+		while ( citer.next(bg_child) ) {
+			if ( _bgNodes[bg_child].valid ) {
+				childDist = nodeDistribution(bg_child, contextEntries, parentsValues, nodeDists);
+				for ( unsigned i = 0; i < _card; i++ )
+					dist[i] += bgNode.wmean[cpos] * childDist[i];
+				cpos++;
+			}
+		}
+	} else {
+		// choose only one backoff node, which may differ for each value
+		for ( unsigned i = 0; i < _card; i++ ) {
+			unsigned chosen_descendant = boNode(i, nodeId, contextEntries, parentsValues);
+			dist[i] = nodeDistribution(chosen_descendant, contextEntries, parentsValues, nodeDists)[i];
+		}
+	}
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * FNGramImp::boNode
@@ -1959,11 +2156,14 @@ const unsigned FNGramImp::maxNumParentsPerChild = 32;
  *
  *-----------------------------------------------------------------------
  */
-FNGramCPT::FNGramCPT() : CPT(di_FNGramCPT), _fngram(NULL), _startNode(0), _numberOfActiveIterators(0) {
+FNGramCPT::FNGramCPT() : CPT(di_FNGramCPT), _fngram(NULL), _startNode(0), _sampleParents(NULL), _numberOfActiveIterators(0), _cache(NULL), _numCachedProbs(0) {
 	_numParents = 0;
 }
 
 
+unsigned FNGramCPT::maxCachedProbs = 1000000;
+
+
 /*-
  *-----------------------------------------------------------------------
  * FNGramCPT::~FNGramCPT
@@ -1981,6 +2181,7 @@ FNGramCPT::~FNGramCPT() {
 	for ( unsigned i = 0; i < _contextEntriesStack.size(); i++ ) {
 		free(_contextEntriesStack[i]);
 	}
+	clearCache();
 }
 
 
@@ -2042,7 +2243,9 @@ void FNGramCPT::setParentsPositions(const vector<unsigned> &parentsPositions) {
 /*-
  *-----------------------------------------------------------------------
  * FNGramCPT::becomeAwareOfParentValues
- *      Set context entry pointers when parents values are known.
+ *      Remember the parents for randomSample(). The context entries
+ *      are only found when an iteration begins, with
+ *      becomeAwareOfParentValuesAndIterBegin().
  *
  * Results:
  *      None.
@@ -2053,7 +2256,7 @@ void FNGramCPT::setParentsPositions(const vector<unsigned> &parentsPositions) {
  *-----------------------------------------------------------------------
  */
 void FNGramCPT::becomeAwareOfParentValues(vector< RV* >& parents, const RV* rv) {
-	error("FNGramCPT::becomeAwareOfParentValues shouldn't be used alone");
+	_sampleParents = &parents;
 }
 
 
@@ -2094,6 +2297,18 @@ void FNGramCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV*>& parents,
 						      logpr& p) {
 	assert(parents.size() == _numParents);
 
+	CachedDistribution *cached = cachedDistribution(parents);
+	if ( cached != NULL ) {
+		// iterate over the cached non-zero probabilities, the
+		// position of which is kept in the iterator
+		it.drv = drv;
+		it.internalStatePtr = cached;
+		it.uInternalState = 0;
+		drv->val = cached->values[0];
+		p = cached->probs[0];
+		return;
+	}
+
 	FNGramImp::BackoffGraphNode::HashEntry **ptr;
 
 	// we allocate CPT iterators in groups of 4 (thus the constant 4). We then use up each of the four and 
@@ -2109,39 +2324,11 @@ void FNGramCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV*>& parents,
 	// increment counter and set inter point for iterator
 	_numberOfActiveIterators++;
 
-	memset(ptr, 0, sizeof(FNGramImp::BackoffGraphNode::HashEntry*) * _fngram->_numberOfBGNodes);
-
-	// TODO: pre-allocate context to save time rather than allocationg/deleting all the time.
-	unsigned * context = new unsigned [_numParents];
-
-	// descend down the BG, level by level except buttom (0)
-	for ( int level = _numParents; level > 0; level-- ) {
-		FNGramImp::LevelIter liter(_numParents, level);
-		for ( unsigned nodeAtLevel; liter.next(nodeAtLevel); ) {
-			// we make sure it is somewhere below startNode
-
-		  // TODO: This if condition does not make sense. See ticket #98
-		  // Determine what was really meant here and fix it.
-		  if ( _fngram->_bgNodes[nodeAtLevel].valid && (nodeAtLevel | (_startNode == _startNode)) ) {
-				// figure out which bits are on
-				std::vector<unsigned> onPos = FNGramImp::bitsOn(nodeAtLevel);	// this will be something like 0, 1, 3
-				for ( unsigned i = 0; i < _fngram->_bgNodes[nodeAtLevel].order - 1; i++ ) {
-					context[i] = RV2DRV(parents[onPos[i]])->val;
-				}
-				ptr[nodeAtLevel] = _fngram->_bgNodes[nodeAtLevel].contextTable->find(context);
-			}
-		}
-	}
-
-	delete [] context;
-
-#ifdef FNGRAM_BOW_GROW_DYNA
-	for ( unsigned i = 0; i < _numParents; i++ )
-		_parentsValues[_parentsPositions[i]] = RV2DRV(parents[i])->val;
-#endif
+	findContextEntries(parents, ptr);
 
 	it.drv = drv;
 	it.internalStatePtr = ptr;
+	it.uInternalState = ~0x0u;
 	register DiscRVType value = 0;
 	p = _fngram->probBackingOff(value, _startNode, ptr, _parentsValues);
 
@@ -2173,9 +2360,43 @@ void FNGramCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV*>& parents,
 logpr FNGramCPT::probGivenParents(vector < RV* >& parents, DiscRV* drv) {
 	assert(parents.size() == _numParents);
 
+	// a single probability is not worth computing a distribution
+	// for, but use it if it is already there.
+	CachedDistribution *cached = findCachedDistribution(parents);
+	if ( cached != NULL ) {
+		std::vector<DiscRVType>::const_iterator pos = std::lower_bound(cached->values.begin(), cached->values.end(), drv->val);
+		if ( pos != cached->values.end() && *pos == drv->val )
+			return cached->probs[pos - cached->values.begin()];
+	}
+
 	FNGramImp::BackoffGraphNode::HashEntry ** contextEntries = new FNGramImp::BackoffGraphNode::HashEntry * [_fngram->_numberOfBGNodes];
+	findContextEntries(parents, contextEntries);
+
+	logpr prob = _fngram->probBackingOff(drv->val, _startNode, contextEntries, _parentsValues);
+
+	delete [] contextEntries;
+	return prob;
+}
+
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramCPT::findContextEntries
+ *      Set context entry pointers when parents values are known.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      contextEntries and _parentsValues are set.
+ *
+ *-----------------------------------------------------------------------
+ */
+void FNGramCPT::findContextEntries(vector< RV* >& parents, FNGramImp::BackoffGraphNode::HashEntry **contextEntries) {
 	memset(contextEntries, 0, sizeof(FNGramImp::BackoffGraphNode::HashEntry*) * _fngram->_numberOfBGNodes);
 
+	// TODO: pre-allocate context to save time rather than allocationg/deleting all the time.
 	unsigned * context = new unsigned [_numParents];
 
 	// descend down the BG, level by level except buttom (0)
@@ -2203,14 +2424,119 @@ logpr FNGramCPT::probGivenParents(vector < RV* >& parents, DiscRV* drv) {
 	for ( unsigned i = 0; i < _numParents; i++ )
 		_parentsValues[_parentsPositions[i]] = RV2DRV(parents[i])->val;
 #endif
+}
 
-	logpr prob = _fngram->probBackingOff(drv->val, _startNode, contextEntries, _parentsValues);
 
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramCPT::findCachedDistribution
+ *      Look up the cached distribution for the parents values.
+ *
+ * Results:
+ *      Return the cached distribution, or NULL if there is none.
+ *
+ * Side Effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------
+ */
+FNGramCPT::CachedDistribution* FNGramCPT::findCachedDistribution(vector< RV* >& parents) {
+	if ( _cache == NULL )
+		return NULL;
+
+	for ( unsigned i = 0; i < _numParents; i++ )
+		_cacheKey[i] = RV2DRV(parents[i])->val;
+
+	CachedDistribution **cached = _cache->find(&_cacheKey[0]);
+	return cached == NULL ? NULL : *cached;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramCPT::cachedDistribution
+ *      Find the cached distribution for the parents values, computing
+ *      and caching it if it is not there yet.
+ *
+ * Results:
+ *      Return the cached distribution, or NULL if caching is off or
+ *      the cache is full.
+ *
+ * Side Effects:
+ *      The distribution might be added to the cache.
+ *
+ *-----------------------------------------------------------------------
+ */
+FNGramCPT::CachedDistribution* FNGramCPT::cachedDistribution(vector< RV* >& parents) {
+	if ( maxCachedProbs == 0 )
+		return NULL;
+
+	if ( _cache == NULL ) {
+		// a zero length key is not allowed, so there is always one
+		_cacheKey.resize(_numParents > 0 ? _numParents : 1, 0);
+		_cache = new vshash_map<unsigned, CachedDistribution*>(_cacheKey.size());
+	}
+
+	CachedDistribution *cached = findCachedDistribution(parents);
+	if ( cached != NULL || _numCachedProbs >= maxCachedProbs )
+		return cached;
+
+	FNGramImp::BackoffGraphNode::HashEntry ** contextEntries = new FNGramImp::BackoffGraphNode::HashEntry * [_fngram->_numberOfBGNodes];
+	findContextEntries(parents, contextEntries);
+
+	logpr *dist = new logpr [_card];
+	_fngram->distribution(_startNode, contextEntries, _parentsValues, dist);
+
+	// keep only the values the iterator would visit
+	cached = new CachedDistribution;
+	for ( unsigned i = 0; i < _card; i++ ) {
+		if ( ! dist[i].essentially_zero() ) {
+			cached->values.push_back(i);
+			cached->probs.push_back(dist[i]);
+		}
+	}
+	// We keep the following assertion as we
+	// must have that at least one entry is non-zero.
+	assert(cached->values.size() > 0);
+
+	delete [] dist;
 	delete [] contextEntries;
-	return prob;
+
+	_cachedDistributions.push_back(cached);
+	_cache->insert(&_cacheKey[0], cached);
+	_numCachedProbs += cached->values.size();
+
+	return cached;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * FNGramCPT::setSegment
+ *      Start of a new segment.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      The cached distributions of the previous segment are dropped.
+ *
+ *-----------------------------------------------------------------------
+ */
+void FNGramCPT::setSegment(const unsigned segNo) {
+	clearCache();
 }
 
 
+void FNGramCPT::clearCache() {
+	for ( unsigned i = 0; i < _cachedDistributions.size(); i++ )
+		delete _cachedDistributions[i];
+	_cachedDistributions.clear();
+	delete _cache;
+	_cache = NULL;
+	_numCachedProbs = 0;
+}
+
 
 /*-
  *-----------------------------------------------------------------------
@@ -2226,6 +2552,16 @@ logpr FNGramCPT::probGivenParents(vector < RV* >& parents, DiscRV* drv) {
  *-----------------------------------------------------------------------
  */
 bool FNGramCPT::next(iterator &it, logpr& p) {
+	if ( it.uInternalState != ~0x0u ) {
+		// iterating over a cached distribution
+		CachedDistribution *cached = (CachedDistribution*)it.internalStatePtr;
+		if ( ++it.uInternalState >= cached->values.size() )
+			return false;
+		it.drv->val = cached->values[it.uInternalState];
+		p = cached->probs[it.uInternalState];
+		return true;
+	}
+
 	do{
 		if ( (++it.drv->val) >= card() ) {
 			// need to clean the stack pointer
@@ -2257,15 +2593,21 @@ bool FNGramCPT::next(iterator &it, logpr& p) {
  */
 int FNGramCPT::randomSample(DiscRV* drv)
 {
+  assert(_sampleParents != NULL);
   logpr prob = rnd.drand48();
   iterator it;
   logpr p;
-  FNGramCPT::begin(it,drv,p);
+  FNGramCPT::becomeAwareOfParentValuesAndIterBegin(*_sampleParents,it,drv,p);
   logpr sum;
   do {
     sum += p;
-    if ( prob <= sum )
+    if ( prob <= sum ) {
+      // an iteration that backs off gives its context entries back
+      // in next() only when it runs to the end
+      if ( it.uInternalState == ~0x0u )
+        --_numberOfActiveIterators;
       break;
+    }
   } while ( FNGramCPT::next(it,p) );
   return drv->val;
 }
@@ -216,6 +216,12 @@ public:
 
 	logpr probBackingOff(unsigned val, unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries, const std::vector<unsigned> &parentsValues);
 
+	// Compute probBackingOff() for every value 0.._card-1 of the
+	// child at once, into dist. Each backoff graph node's
+	// distribution is computed only once, from the explicit
+	// probabilities of its context and its children's distributions.
+	void distribution(unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries, const std::vector<unsigned> &parentsValues, logpr *dist);
+
 	// return the number of parameters for object.
 	unsigned totalNumberOfParameters() {return _totalNumberOfParameters;}
 
@@ -241,6 +247,13 @@ protected:
 	double backoffValueRSubCtxW(unsigned val, BackoffNodeStrategy parentsStrategy, unsigned nodeId,
 		BackoffGraphNode::HashEntry **contextEntries, const std::vector<unsigned> &parentsValues);
 
+	// the whole distribution versions of the above, with each node's
+	// distribution computed once and kept in nodeDists
+	const logpr* nodeDistribution(unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries,
+		const std::vector<unsigned> &parentsValues, std::vector<logpr*> &nodeDists);
+	void bgChildDistribution(unsigned nodeId, BackoffGraphNode::HashEntry **contextEntries,
+		const std::vector<unsigned> &parentsValues, std::vector<logpr*> &nodeDists, logpr *dist);
+
 	// data fields
 	unsigned _childIndex;				// child id as W in P(W|F1, F2,...)
 	unsigned _card;
@@ -279,6 +292,17 @@ public:
 	void setFNGramImp(FNGramImp *fngram);
 	void setParentsPositions(const vector<unsigned> &parentsPositions);
 
+	// The child distributions of the parent contexts seen in a
+	// segment are cached, so the backoff graph is evaluated only once
+	// per context, rather than for each value every time the context
+	// comes up in clique expansion. This is the maximum number of
+	// (non-zero) probabilities cached per FNGramCPT; contexts beyond
+	// it are evaluated directly. 0 turns off caching.
+	static unsigned maxCachedProbs;
+
+	// start of a new segment: drop the cached distributions
+	void setSegment(const unsigned segNo);
+
 	///////////////////////////////////////////////////////////
 	// virtual functions from class CPT
 
@@ -352,6 +376,9 @@ protected:
 	unsigned _startNode;
 	std::vector<unsigned> _parentsPositions;
 
+	// the parents given to becomeAwareOfParentValues(), for randomSample()
+	vector< RV* > *_sampleParents;
+
 	// this will be set when parents value is known
 #ifdef FNGRAM_BOW_GROW_DYNA
 	std::vector<unsigned> _parentsValues;
@@ -359,6 +386,22 @@ protected:
 
 	std::vector<void *> _contextEntriesStack;
 	unsigned _numberOfActiveIterators;
+
+	// the non-zero probabilities of the child in a given context
+	struct CachedDistribution {
+		std::vector<DiscRVType> values;
+		std::vector<logpr> probs;
+	};
+	// cached distributions, keyed by parent values
+	vshash_map<unsigned, CachedDistribution*> *_cache;
+	std::vector<CachedDistribution*> _cachedDistributions;
+	unsigned long _numCachedProbs;
+	std::vector<unsigned> _cacheKey;
+
+	void findContextEntries(vector< RV* >& parents, FNGramImp::BackoffGraphNode::HashEntry **contextEntries);
+	CachedDistribution* findCachedDistribution(vector< RV* >& parents);
+	CachedDistribution* cachedDistribution(vector< RV* >& parents);
+	void clearCache();
 };
 
 
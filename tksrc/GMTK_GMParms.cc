@@ -31,6 +31,9 @@
 #include <string.h>
 #include <float.h>
 #include <assert.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "general.h"
 #include "error.h"
@@ -1635,6 +1638,42 @@ writeDecisionTreeIndexFiles()
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * GMParms::writeSegmentArchive()
+ *
+ * Preconditions:
+ *    The iterableDts and iterableLatticeAdts vectors have been filled
+ *    in by reading the master file.
+ *
+ * Postconditions:
+ *    The archive holds an object for each iterable DT and lattice.
+ *
+ * Side Effects:
+ *    The first decison tree is set to 0 for all trees, and all
+ *    iterable objects are left at their last segment.
+ *
+ * Results:
+ *    none
+ *-----------------------------------------------------------------------
+ */
+void 
+GMParms::
+writeSegmentArchive(const char *fileName)
+{
+  SegmentArchive::Writer w(fileName);
+
+  for (unsigned i=0; i<iterableDts.size(); i++) {
+    iterableDts[i]->setFirstDecisionTree(0);
+    iterableDts[i]->writeArchive(w);
+  }
+  for (unsigned i=0; i<iterableLatticeAdts.size(); i++) {
+    iterableLatticeAdts[i]->writeArchive(w);
+  }
+  w.close();
+}
+
+
 
 
 /*-
@@ -2877,6 +2916,7 @@ GMParms::begin()
   for ( unsigned i = 0; i < iterableLatticeAdts.size(); i++ ) {
 	  iterableLatticeAdts[i]->beginIterableLattice();
   }
+  Dlinks::newSegment();
   for (unsigned i=0;i<dLinks.size();i++) {
     dLinks[i]->clearArrayCache();
   }
@@ -2916,6 +2956,7 @@ GMParms::next()
   for ( unsigned i = 0; i < iterableLatticeAdts.size(); i++ ) {
 	  iterableLatticeAdts[i]->nextIterableLattice();
   }
+  Dlinks::newSegment();
   for (unsigned i=0;i<dLinks.size();i++) {
     dLinks[i]->clearArrayCache();
   }
@@ -2983,6 +3024,10 @@ GMParms::setSegment(const unsigned segmentNo)
 #endif
   }
 
+  // drop the distributions cached for the previous segment
+  for (unsigned i=0; i< fngramCpts.size(); i++)
+    fngramCpts[i]->setSegment(segmentNo);
+
   // FIXME - investigate if lattice CPTs work with stream input (where
   //         the number of frames isn't known)
   if (numFrames != 0) {
@@ -3001,6 +3046,7 @@ GMParms::setSegment(const unsigned segmentNo)
 
   }
 
+  Dlinks::newSegment();
   for (unsigned i=0;i<dLinks.size();i++) {
     dLinks[i]->clearArrayCache();
   }
@@ -3507,6 +3553,180 @@ GMParms::makeUniform()
 
 
 
+#if HAVE_PTHREAD
+// A worker for GMParms::emFlushIncrements(): repeatedly takes the next
+// unclaimed group of mixtures and finishes their flushes in order.
+struct EmFlushWork {
+  vector< vector<Mixture*> > *groups;
+  unsigned nextGroup;
+  pthread_mutex_t lock;
+};
+struct EmFlushWorker {
+  EmFlushWork *work;
+  unsigned long missed;
+};
+
+static void *
+emFlushThread(void *arg)
+{
+  EmFlushWorker *worker = (EmFlushWorker*)arg;
+  EmFlushWork *work = worker->work;
+  while (1) {
+    pthread_mutex_lock(&work->lock);
+    unsigned g = work->nextGroup++;
+    pthread_mutex_unlock(&work->lock);
+    if (g >= work->groups->size())
+      break;
+    vector<Mixture*> &group = (*work->groups)[g];
+    for (unsigned i=0;i<group.size();i++)
+      group[i]->emFinishFlush(worker->missed);
+  }
+  return NULL;
+}
+
+// find the representative of x's set
+static unsigned
+emFlushFind(vector<unsigned> &parent, unsigned x)
+{
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+#endif
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * emFlushIncrements()
+ *      Have all mixtures apply the EM increments they have batched up
+ *      (see Mixture::emFlushIncrements()).
+ *
+ *      With MixtureCommon::emIncrementThreads > 1, the mixtures with
+ *      pending increments are split into groups such that no two groups
+ *      share weights, components, means or covariances. The feature
+ *      vectors are copied out of the observation matrix here, and the
+ *      groups are then applied by worker threads. Within a group the
+ *      mixtures are applied in the same order as in the serial case, so
+ *      every accumulator sees its increments in the same order and the
+ *      result does not depend on the number of threads. Mixtures that
+ *      can't be applied by a worker (see
+ *      Mixture::emFlushCanRunConcurrently()) are applied here afterwards.
+ *
+ * Preconditions:
+ *      The observations of the segment that was just incremented
+ *      must still be available.
+ *
+ * Postconditions:
+ *      No mixture has pending increments.
+ *
+ * Side Effects:
+ *      Changes the EM accumulators of the mixtures and their components.
+ *
+ * Results:
+ *      nil
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+GMParms::emFlushIncrements()
+{
+#if HAVE_PTHREAD
+  if (MixtureCommon::emIncrementThreads > 1) {
+    vector<Mixture*> pending;
+    for (unsigned i=0;i<mixtures.size();i++) {
+      if (mixtures[i]->emHasPendingIncrements())
+	pending.push_back(mixtures[i]);
+    }
+    if (pending.size() == 0)
+      return;
+
+    // union mixtures that have an EM object in common
+    vector<unsigned> parent(pending.size());
+    map<void*,unsigned> owner;
+    vector<void*> objs;
+    for (unsigned i=0;i<pending.size();i++) {
+      parent[i] = i;
+      objs.clear();
+      pending[i]->emIncrementSharedObjects(objs);
+      for (unsigned j=0;j<objs.size();j++) {
+	map<void*,unsigned>::iterator it = owner.find(objs[j]);
+	if (it == owner.end()) {
+	  owner[objs[j]] = i;
+	} else {
+	  unsigned a = emFlushFind(parent,i), b = emFlushFind(parent,it->second);
+	  if (a != b)
+	    parent[a < b ? b : a] = (a < b ? a : b);
+	}
+      }
+    }
+
+    // a group can go to a worker only if all its mixtures can
+    vector<bool> concurrent(pending.size(),true);
+    for (unsigned i=0;i<pending.size();i++) {
+      if (!pending[i]->emFlushCanRunConcurrently())
+	concurrent[emFlushFind(parent,i)] = false;
+    }
+
+    // groups in order of their first mixture, mixtures in index order
+    vector< vector<Mixture*> > groups;
+    vector<Mixture*> serial;
+    map<unsigned,unsigned> groupOf;
+    for (unsigned i=0;i<pending.size();i++) {
+      unsigned root = emFlushFind(parent,i);
+      if (!concurrent[root]) {
+	serial.push_back(pending[i]);
+	continue;
+      }
+      map<unsigned,unsigned>::iterator it = groupOf.find(root);
+      if (it == groupOf.end()) {
+	groupOf[root] = groups.size();
+	groups.push_back(vector<Mixture*>());
+	it = groupOf.find(root);
+      }
+      groups[it->second].push_back(pending[i]);
+      // this reads the observation matrix, so is done here
+      pending[i]->emPrepareFlush(true);
+    }
+
+    unsigned numThreads = MixtureCommon::emIncrementThreads;
+    if (numThreads > groups.size())
+      numThreads = groups.size();
+    EmFlushWork work;
+    work.groups = &groups;
+    work.nextGroup = 0;
+    pthread_mutex_init(&work.lock,NULL);
+    vector<EmFlushWorker> workers(numThreads > 0 ? numThreads : 1);
+    vector<pthread_t> threads(workers.size());
+    vector<bool> started(workers.size(),false);
+    for (unsigned t=0;t<workers.size();t++) {
+      workers[t].work = &work;
+      workers[t].missed = 0;
+    }
+    // the calling thread is worker 0, and also does the work of any
+    // thread that can't be started.
+    for (unsigned t=1;t<workers.size();t++)
+      started[t] = (pthread_create(&threads[t],NULL,emFlushThread,&workers[t]) == 0);
+    emFlushThread(&workers[0]);
+    for (unsigned t=1;t<workers.size();t++) {
+      if (started[t])
+	pthread_join(threads[t],NULL);
+    }
+    pthread_mutex_destroy(&work.lock);
+    for (unsigned t=0;t<workers.size();t++)
+      EMable::missedIncrementCount += workers[t].missed;
+
+    for (unsigned i=0;i<serial.size();i++)
+      serial[i]->emFlushIncrements();
+    return;
+  }
+#endif
+  for (unsigned i=0;i<mixtures.size();i++)
+    mixtures[i]->emFlushIncrements();
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * emEndIteration()
@@ -487,6 +487,11 @@ public:
   // Support for EM, applies to all EMable objects contained herein.
   ///////////////////////////////////////////////////////////
 
+  ////////////////////////////////////////////////////////////////////
+  // applies any EM increments the mixtures have batched up for the
+  // current segment. Called after each segment's EM increment.
+  void emFlushIncrements();
+
   ////////////////////////////////////////////////////////////////////
   // calls the end EM on all objects EM epochs
   void emEndIteration();
@@ -521,6 +526,10 @@ public:
   // Write index files for iterable decision trees 
   void writeDecisionTreeIndexFiles();
 
+  ////////////////////////////////////////////////////////////////////////////
+  // Write all iterable decision trees and lattices to a segment archive
+  void writeSegmentArchive(const char *fileName);
+
   ////////////////////////////////////////////////////////////////////////////
   // Register a C function determinisic mapping function as a decision tree.
   void registerDeterministicCMapper(const char *name,
@@ -60,6 +60,10 @@ VCID(HGID)
 
 // clear all memory on each new segment.
 bool JunctionTree::perSegmentClearCliqueValueCache = true;
+// no clique table memory budget by default.
+double JunctionTree::cliqueMemoryBudget = 0.0;
+// no limit on the EM prune masks by default.
+double JunctionTree::pruneMaskMemoryBudget = 0.0;
 // turns on or off VE separators, and determins the type to use PC, or PCG. 
 unsigned JunctionTree::useVESeparators = (VESEP_PC | VESEP_PCG);
 // turn off VE separators by default.
@@ -3822,6 +3826,12 @@ JunctionTree::prepareForUnrolling(JT_Partition& part)
  *   but in general the network will be T(P') + k*T(C') + T(E) frames long, and in general
  *   T(C') >= S. This also depends on if the boundary algorithm was run or not. 
  *
+ *   The unrolled rvs and partition structures only depend on whether the
+ *   segment is unrolled to [P' E'], [P' C' E'], or [P' C' C' E'], so they
+ *   are kept for each of these and reused by later segments (see
+ *   clearAfterUnroll()). Likewise, the partition tables are reset rather
+ *   than reallocated when a segment needs as many of them as the last one.
+ *
  * Preconditions:
  *   The partitions must be validly instantiated with cliques, and
  *   the routine assignRVsToCliques() must have been called.
@@ -3868,7 +3878,7 @@ JunctionTree::unroll(const unsigned int numFrames,
 	  fp.numFramesInP() + gm_template.M * fp.numFramesInC() + fp.numFramesInE());
   const int numCoPartitionTables = modifiedTemplateMaxUnrollAmount+1;
   const int numCoPartitionStructures= modifiedTemplateMinUnrollAmount+1;
-  const int numPartitionStructures= modifiedTemplateMinUnrollAmount+3;
+  const unsigned numPartitionStructures= modifiedTemplateMinUnrollAmount+3;
 
   // we should never have more than 2 C structures since 2 is the max
   // necessary.
@@ -3885,9 +3895,32 @@ JunctionTree::unroll(const unsigned int numFrames,
   // mapping from 'name+frame' to integer index into unrolled_rvs.
   // map < RVInfo::rvParent, unsigned > ppf;
 
-  // Only unroll the minimum amount since unrolling is expensive and
-  // takes up much memory.
-  fp.unroll(basicTemplateMinUnrollAmount,cur_unrolled_rvs,cur_ppf);
+  // The unrolled rvs and partition structures only depend on
+  // which of the three layouts this segment has, so switch to those
+  // of a previous segment with the same layout if there was one.
+  const int layout = modifiedTemplateMinUnrollAmount+1;
+  if (layout != cur_unrolled_layout) {
+    if (cur_unrolled_layout >= 0)
+      swapUnrolledStructures(cur_unrolled_layout);
+    swapUnrolledStructures(layout);
+    cur_unrolled_layout = layout;
+    cur_CC_CE_rvs_valid = false;
+  }
+  const bool reuseStructures = (partitionStructureArray.size() > 0);
+
+  if (reuseStructures) {
+    // undo any shifting done by inference on the previous segment.
+    for (unsigned i=0;i<cur_unrolled_rvs.size();i++)
+      cur_unrolled_rvs[i]->adjustFrameBy((int)cur_unrolled_frames[i]
+					 - (int)cur_unrolled_rvs[i]->frame());
+  } else {
+    // Only unroll the minimum amount since unrolling is expensive and
+    // takes up much memory.
+    fp.unroll(basicTemplateMinUnrollAmount,cur_unrolled_rvs,cur_ppf);
+    cur_unrolled_frames.resize(cur_unrolled_rvs.size());
+    for (unsigned i=0;i<cur_unrolled_rvs.size();i++)
+      cur_unrolled_frames[i] = cur_unrolled_rvs[i]->frame();
+  }
 
   // set the observed variables for now, but these may/will be modified later.
   setObservedRVs(cur_unrolled_rvs);
@@ -3895,30 +3928,33 @@ JunctionTree::unroll(const unsigned int numFrames,
   prepareForNextInferenceRound();
   // this clears the shared caches in the origin cliques
   clearCliqueSepValueCache(perSegmentClearCliqueValueCache);
+  // no tables held yet against the clique memory budget.
+  ceMemoryHeld = 0;
+  ceCliquesToCome = 0;
+  ceAvgCliqueBytes = ceAvgCliqueValues = 0.0;
 
-  // clear out the old and pre-allocate for new size.
-  partitionStructureArray.clear();
-  partitionTableArray.clear();
-
-  // 
-  // For the structure array, we always only need to unroll by the
-  // amount corresponding to the amount by which the basic random
-  // variables have been unrolled.
-  partitionStructureArray.resize(numPartitionStructures);
-  unsigned partNo = 0;
-  new (&partitionStructureArray[partNo++]) PartitionStructures(P1
-							       ,cur_unrolled_rvs
-							       ,cur_ppf
-							       ,0*gm_template.S*fp.numFramesInC(),
-							       false // does not have a li separator
-							       );
-  for (int p=0;p<numCoPartitionStructures;p++) {
-    new (&partitionStructureArray[partNo]) PartitionStructures(Co,cur_unrolled_rvs,cur_ppf,p*gm_template.S*fp.numFramesInC());
-    partNo++;
-  }
-  new (&partitionStructureArray[partNo++]) 
-    PartitionStructures(E1,cur_unrolled_rvs,cur_ppf,
-			modifiedTemplateMinUnrollAmount*gm_template.S*fp.numFramesInC());
+  if (!reuseStructures) {
+    // 
+    // For the structure array, we always only need to unroll by the
+    // amount corresponding to the amount by which the basic random
+    // variables have been unrolled.
+    partitionStructureArray.resize(numPartitionStructures);
+    unsigned partNo = 0;
+    new (&partitionStructureArray[partNo++]) PartitionStructures(P1
+								 ,cur_unrolled_rvs
+								 ,cur_ppf
+								 ,0*gm_template.S*fp.numFramesInC(),
+								 false // does not have a li separator
+								 );
+    for (int p=0;p<numCoPartitionStructures;p++) {
+      new (&partitionStructureArray[partNo]) PartitionStructures(Co,cur_unrolled_rvs,cur_ppf,p*gm_template.S*fp.numFramesInC());
+      partNo++;
+    }
+    new (&partitionStructureArray[partNo++]) 
+      PartitionStructures(E1,cur_unrolled_rvs,cur_ppf,
+			  modifiedTemplateMinUnrollAmount*gm_template.S*fp.numFramesInC());
+  }
+  assert ( partitionStructureArray.size() == numPartitionStructures );
 
    
   // 
@@ -3929,7 +3965,19 @@ JunctionTree::unroll(const unsigned int numFrames,
   //     but below is how much to allocate.
   //  2) we need a partition for P, even if it is empty. (+1) 
   //  3) we need a partition for E, even if it is empty. (+1)
-  if (tableOption == LongTable) {
+  const unsigned numPartitionTables =
+    (tableOption == LongTable ? modifiedTemplateMaxUnrollAmount+3 :
+     (tableOption == ShortTable ? numPartitionStructures : 0));
+  if (numPartitionTables > 0 && partitionTableArray.size() == numPartitionTables) {
+    // The previous segment had the same number of tables, and
+    // therefore the same [P C ... C E] sequence of them, so just
+    // reset them instead of reallocating.
+    for (unsigned p=0;p<numPartitionTables;p++) {
+      const unsigned ps_i = (p == 0 ? 0 :
+			     (p == numPartitionTables-1 ? numPartitionStructures-1 : 1));
+      partitionTableArray[p].init(partitionStructureArray[ps_i]);
+    }
+  } else if (tableOption == LongTable) {
     // then we pre-allocate the table array to correspond to the
     // entire length of the segment. I.e., each table is unique.  With
     // this option, it is possible to store all of the tables in
@@ -3963,10 +4011,10 @@ JunctionTree::unroll(const unsigned int numFrames,
     new (&partitionTableArray[partNo++])
       PartitionTables(E1);
     assert (partNo == partitionStructureArray.size());
-  } else if (tableOption == ZeroTable) {
-    partitionTableArray.clear();
   } else {
-    // assume NoTouchTable, so leave it alone.
+    // ZeroTable, and NoTouchTable which has always ended up with
+    // no tables here as well.
+    partitionTableArray.clear();
   }
   
   if (viterbiScore == true) {
@@ -4026,13 +4074,97 @@ JunctionTree::clearAfterUnroll()
 {
   for (unsigned i=0; i < cur_unrolled_rvs.size(); i++) 
     delete cur_unrolled_rvs[i];
+  cur_unrolled_rvs.clear();
+  cur_unrolled_frames.clear();
+  cur_ppf.clear();
   // clear out the old and pre-allocate for new size.
   partitionStructureArray.clear();
+  // and those kept for the other layouts.
+  for (unsigned l=0;l<3;l++) {
+    UnrolledStructures& us = unrolledStructuresCache[l];
+    for (unsigned i=0; i < us.rvs.size(); i++) 
+      delete us.rvs[i];
+    us.rvs.clear();
+    us.frames.clear();
+    us.ppf.clear();
+    us.partitionStructureArray.clear();
+  }
+  cur_unrolled_layout = -1;
+  cur_CC_CE_rvs_valid = false;
   // this clears the shared caches. 
   clearCliqueSepValueCache(perSegmentClearCliqueValueCache);
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * JunctionTree::swapUnrolledStructures()
+ *   Swaps the current unrolled rvs and partition structures with
+ *   those kept for the given layout (see unroll()).
+ *
+ * Preconditions:
+ *   0 <= layout < 3
+ *
+ * Postconditions:
+ *   The current and the kept structures of the layout are exchanged.
+ *
+ * Side Effects:
+ *   Modifies member variables in this object.
+ *
+ * Results:
+ *   none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+JunctionTree::swapUnrolledStructures(const int layout)
+{
+  assert ( layout >= 0 && layout < 3 );
+  UnrolledStructures& us = unrolledStructuresCache[layout];
+  cur_unrolled_rvs.swap(us.rvs);
+  cur_unrolled_frames.swap(us.frames);
+  cur_ppf.swap(us.ppf);
+  partitionStructureArray.swap(us.partitionStructureArray);
+}
+
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * JunctionTree::clearPruneMasks()
+ *   Frees the clique prune masks of all segments, and stops using
+ *   prune masks until setPruneMaskSegment() is called again.
+ *
+ * Preconditions:
+ *   none
+ *
+ * Postconditions:
+ *   There are no prune masks.
+ *
+ * Side Effects:
+ *   Modifies member variables in this object.
+ *
+ * Results:
+ *   none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+JunctionTree::clearPruneMasks()
+{
+  map< unsigned, map< unsigned, vector< CliqueValueMask* > > >::iterator s;
+  for (s = cePruneMasks.begin(); s != cePruneMasks.end(); s++) {
+    map< unsigned, vector< CliqueValueMask* > >::iterator p;
+    for (p = (*s).second.begin(); p != (*s).second.end(); p++)
+      for (unsigned i=0;i<(*p).second.size();i++)
+	delete (*p).second[i];
+  }
+  cePruneMasks.clear();
+  cePruneMaskSegment = NULL;
+  cePruneMaskBytes = 0;
+}
+
+
 
 
 /*-
@@ -124,6 +124,27 @@ class JunctionTree {
   logpr cur_prob_evidence;
   // the EM training beam used for island training (TODO:, move this elsewhere, perhaps in clique)
   double curEMTrainingBeam;
+  // bytes of clique/separator tables of earlier partitions that are
+  // still held while the current partition is collected, counted
+  // against cliqueMemoryBudget.
+  unsigned long ceMemoryHeld;
+  // number of cliques of the later partitions whose tables will be
+  // held along with the current one's.
+  unsigned long ceCliquesToCome;
+  // average bytes and state space per clique of the last partition
+  // collected with the user's beams under cliqueMemoryBudget.
+  double ceAvgCliqueBytes;
+  double ceAvgCliqueValues;
+  // The clique prune masks kept across EM iterations: for each
+  // segment, for each partition (by number in the unrolled graph), the
+  // mask of each clique (NULL when there is none yet). See
+  // setPruneMaskSegment().
+  map< unsigned, map< unsigned, vector< CliqueValueMask* > > > cePruneMasks;
+  // the masks of the current segment, or NULL to not use masks.
+  map< unsigned, vector< CliqueValueMask* > >* cePruneMaskSegment;
+  // bytes of all the masks in cePruneMasks, counted against
+  // pruneMaskMemoryBudget.
+  unsigned long cePruneMaskBytes;
 
   ////////////////////////////////////////////////////////////////////////
   // collect/distribute/probE support variables used in various routines.
@@ -131,6 +152,25 @@ class JunctionTree {
   vector <RV*> cur_unrolled_rvs;
   // current mapping from 'name+frame' to integer index into unrolled_rvs.
   map < RVInfo::rvParent, unsigned > cur_ppf;
+  // frame of each of cur_unrolled_rvs before any inference shifting.
+  vector <unsigned> cur_unrolled_frames;
+  // Which unrolled layout cur_unrolled_rvs and partitionStructureArray
+  // are for, namely modifiedTemplateMinUnrollAmount+1 (so 0 for
+  // [P' E'], 1 for [P' C' E'], and 2 for [P' C' C' E']), or -1 if
+  // nothing is unrolled.
+  int cur_unrolled_layout;
+  // The unrolled rvs and partition structures of the other layouts,
+  // kept so that a later segment with one of those layouts can reuse
+  // them rather than unrolling again. These depend only on the layout,
+  // not on the segment length.
+  struct UnrolledStructures {
+    vector <RV*> rvs;
+    vector <unsigned> frames;
+    map < RVInfo::rvParent, unsigned > ppf;
+    sArray <PartitionStructures> partitionStructureArray;
+  };
+  UnrolledStructures unrolledStructuresCache[3];
+  void swapUnrolledStructures(const int layout);
   ////////////////////////////////////////////////////////////////////////
 
   ////////////////////////////////////////////////////////////////////////
@@ -587,6 +627,9 @@ class JunctionTree {
   unsigned cur_cc_shift;
   set <RV*> cur_CE_rvs;
   unsigned cur_ce_shift;
+  // true if cur_CC_rvs and cur_CE_rvs are for the current
+  // partitionStructureArray, which they only depend on.
+  bool cur_CC_CE_rvs_valid;
   void shiftCCtoPosition(int);
   void shiftCCrelative(int delta) { shiftCCtoPosition(cur_cc_shift+delta); }
   void shiftCEtoPosition(int);
@@ -711,6 +754,21 @@ class JunctionTree {
 			const unsigned part_num,
 			const bool clearWhenDone = false,
 			const bool alsoClearOrigins = false);
+  bool ceApplyMemoryBudget(const unsigned long usedTableBytes,
+			   const unsigned numDone,
+			   const unsigned long numValuesDone,
+			   const unsigned numCliques,
+			   const bool tightened,
+			   const unsigned origMaxNumStates,
+			   const char*const part_type_name,
+			   const unsigned part_num);
+  void ceSetPruneMask(PartitionStructures& ps,
+		      const unsigned part_num,
+		      const unsigned clique);
+  void ceUpdatePruneMask(PartitionStructures& ps,
+			 PartitionTables& pt,
+			 const unsigned part_num,
+			 const unsigned clique);
 
   void ceSendForwardsCrossPartitions(PartitionStructures& previous_ps,
 			     PartitionTables& previous_pt,
@@ -828,6 +886,18 @@ public:
   // an increase in memory use on each segment.
   static bool perSegmentClearCliqueValueCache;
 
+  // If > 0, the number of MBs the clique and separator tables may
+  // use during collect evidence. When a partition's tables look like
+  // they will go over, the clique beams are tightened for the rest of
+  // that partition, and put back once it is done.
+  static double cliqueMemoryBudget;
+
+  // If > 0, the number of MBs the EM prune masks (see
+  // setPruneMaskSegment()) of all segments may use together. A
+  // clique whose new mask would go over gets none, and so is expanded
+  // in full the next time its segment is collected.
+  static double pruneMaskMemoryBudget;
+
   // Set to true if the JT weight that we compute should be an upper
   // bound.  It is not guaranteed to be a tight upper bound, but is
   // guaranteed to at least be *an* upper bound.
@@ -924,7 +994,15 @@ public:
   JunctionTree(GMTemplate& arg_gm_template)
     : partitionDebugRange("all",0,0x7FFFFFFF),
       curEMTrainingBeam(-LZERO),
+      ceMemoryHeld(0),
+      ceCliquesToCome(0),
+      ceAvgCliqueBytes(0.0),
+      ceAvgCliqueValues(0.0),
+      cePruneMaskSegment(NULL),
+      cePruneMaskBytes(0),
+      cur_unrolled_layout(-1),
       inference_it(*this),
+      cur_CC_CE_rvs_valid(false),
       fp(arg_gm_template.fp),
       gm_template(arg_gm_template)
   {
@@ -934,6 +1012,7 @@ public:
     delete pPartCliquePrintRange;
     delete cPartCliquePrintRange;
     delete ePartCliquePrintRange;
+    clearPruneMasks();
     clearAfterUnroll();
   }
 
@@ -1092,6 +1171,19 @@ public:
   void printMessageOrder(FILE *f,vector< pair<unsigned,unsigned> >& message_order);
   void printCurrentRVValues(FILE* f);
 
+  // Use (and keep) clique prune masks for the given segment in the
+  // following collect evidence calls: each clique only gets the entries
+  // that survived its pruning the last time the segment was collected
+  // (plus those within MaxClique::cliquePruneMaskBeam of its best
+  // entry), and the entries that survive this time become the new
+  // mask. Used by EM training, where the same segments are collected
+  // in every iteration.
+  void setPruneMaskSegment(const unsigned segment) {
+    cePruneMaskSegment = &cePruneMasks[segment];
+  }
+  // free all prune masks and stop using them.
+  void clearPruneMasks();
+
   // various forms of clique printing
   void setCliquePrintRanges(char *p,char*c,char*e);
   // this one is general.
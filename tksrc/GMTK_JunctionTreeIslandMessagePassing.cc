@@ -1264,8 +1264,14 @@ JunctionTree::collectDistributeIsland(// number of frames in this segment.
   } catch (ZeroCliqueException &e) {
     islandsMap.clear();
     E1.useLISeparator();
+    // apply what was accumulated before the zero clique while this
+    // segment's observations are still available.
+    if (runEMalgorithm)
+      GM_Parms.emFlushIncrements();
     throw ZeroCliqueException();
   }
+  if (runEMalgorithm)
+    GM_Parms.emFlushIncrements();
   // TODO: if we get zero probability, right now the code unwinds all
   // the way to delete the islands. Since we have all the islands here
   // in this map data structure, we don't need to do that and can jump
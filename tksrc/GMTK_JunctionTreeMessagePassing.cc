@@ -106,15 +106,21 @@ JunctionTree::init_CC_CE_rvs(ptps_iterator& ptps_it)
   if (ptps_it.num_c_partitions() > 2) { 
     // we only need to fill this set of we have more than 2 table
     // partitions (meaning we will need to do some RV adjustment).
-    set <RV*> tmp1,tmp2;
-    tmp1 = partitionStructureArray[1].returnRVsAndTheirObservedParentsAsSet();
-    tmp2 = partitionStructureArray[2].returnRVsAndTheirObservedParentsAsSet();
-    unionRVs(tmp1,tmp2,cur_CC_rvs);
-    tmp1 = partitionStructureArray[3].returnRVsAndTheirObservedParentsAsSet();
-    unionRVs(tmp1,tmp2,cur_CE_rvs);
+    // The sets are kept for as long as the partition structures
+    // are reused by later segments.
+    if (!cur_CC_CE_rvs_valid) {
+      set <RV*> tmp1,tmp2;
+      tmp1 = partitionStructureArray[1].returnRVsAndTheirObservedParentsAsSet();
+      tmp2 = partitionStructureArray[2].returnRVsAndTheirObservedParentsAsSet();
+      unionRVs(tmp1,tmp2,cur_CC_rvs);
+      tmp1 = partitionStructureArray[3].returnRVsAndTheirObservedParentsAsSet();
+      unionRVs(tmp1,tmp2,cur_CE_rvs);
+      cur_CC_CE_rvs_valid = true;
+    }
   } else {
     cur_CC_rvs.clear();
     cur_CE_rvs.clear();
+    cur_CC_CE_rvs_valid = false;
   } 
   cur_cc_shift = cur_ce_shift = 0;
   ptps_it.go_to_part_no(0);
@@ -2237,6 +2243,187 @@ JunctionTree::setRootToMaxCliqueValue()
 ///////////////////////////////////////////////////////////////////////////////////////
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * JunctionTree::ceApplyMemoryBudget
+ *
+ *   Called before each clique of a partition is collected when there
+ *   is a -cmemBudget. The tables of the earlier partitions that are
+ *   still held, this partition's tables so far (usedBytes, which
+ *   ceGatherIntoRoot() keeps as a running total so the tables need
+ *   not be walked for every clique), and the cliques still
+ *   to come (the rest of this partition and the ceCliquesToCome
+ *   cliques of the later partitions that will be held along with it)
+ *   times the average memory per clique give the projected memory.
+ *   The average is that of the last partition collected with the
+ *   user's beams, or of this partition so far if it has none
+ *   tightened yet.
+ *
+ *   If the projection is over cliqueMemoryBudget, the cliques to come
+ *   may only use the remaining fraction of the average: the k-state
+ *   pruning is limited to that fraction of the average clique state
+ *   space. Otherwise it is set back to the user's -ckbeam. Only the
+ *   k-state limit is governed, since it bounds a clique's size
+ *   directly; a score beam (-cbeam, -cpbeam) has no such relation to
+ *   memory, and narrowing -cpbeam can leave a clique with no entries
+ *   at all.
+ *
+ * Preconditions:
+ *   numDone cliques of the partition have been collected.
+ *
+ * Postconditions:
+ *   The MaxClique beams are set for the next clique.
+ *
+ * Side Effects:
+ *   changes MaxClique::cliqueBeamMaxNumStates.
+ *
+ * Results:
+ *   true if the beams were tightened.
+ *
+ *-----------------------------------------------------------------------
+ */
+bool
+JunctionTree::ceApplyMemoryBudget(// bytes of this partition's tables so far
+				  const unsigned long usedTableBytes,
+				  // cliques collected so far, their total
+				  // state space, and the number of cliques
+				  // in the partition
+				  const unsigned numDone,
+				  const unsigned long numValuesDone,
+				  const unsigned numCliques,
+				  // true if an earlier clique of this
+				  // partition was already tightened
+				  const bool tightened,
+				  // the -ckbeam as given by the user
+				  const unsigned origMaxNumStates,
+				  const char*const part_type_name,
+				  const unsigned part_num)
+{
+  const double budget = cliqueMemoryBudget*1024.0*1024.0;
+  const double usedBytes = (double)usedTableBytes;
+  double avgBytes = ceAvgCliqueBytes;
+  double avgValues = ceAvgCliqueValues;
+  if (numDone > 0 && !tightened) {
+    avgBytes = usedBytes/numDone;
+    avgValues = (double)numValuesDone/numDone;
+  }
+  const double numToCome = (double)(numCliques - numDone) + (double)ceCliquesToCome;
+  const double projected = (double)ceMemoryHeld + usedBytes + numToCome*avgBytes;
+
+  if (avgBytes == 0.0 || projected <= budget) {
+    MaxClique::cliqueBeamMaxNumStates = origMaxNumStates;
+    return false;
+  }
+
+  double fraction = (budget - (double)ceMemoryHeld - usedBytes)/(numToCome*avgBytes);
+  if (fraction < 0.0)
+    fraction = 0.0;
+
+  unsigned k = (unsigned)(fraction*avgValues);
+  if (k < 1)
+    k = 1;
+  if (origMaxNumStates > 0 && origMaxNumStates < k)
+    k = origMaxNumStates;
+  MaxClique::cliqueBeamMaxNumStates = k;
+
+  infoMsg(IM::Inference, IM::Low,
+	  "CE: %s,part[%d]: projected clique memory %.1fMB over budget of %.1fMB, limiting the next clique to %u states\n",
+	  part_type_name,part_num,
+	  projected/(1024.0*1024.0),
+	  cliqueMemoryBudget,
+	  k);
+  return true;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * JunctionTree::ceSetPruneMask
+ *   
+ *   Gives a clique's origin the prune mask it got the last time the
+ *   current segment was collected (if any), so that only entries that
+ *   survived pruning then (or are close to the best entry) are
+ *   inserted.
+ *
+ * Preconditions:
+ *   cePruneMaskSegment is not NULL.
+ *
+ * Postconditions:
+ *   The clique's origin's cePruneMask is set (possibly to NULL).
+ *
+ * Side Effects:
+ *   none
+ *
+ * Results:
+ *   none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+JunctionTree::ceSetPruneMask(PartitionStructures& ps,
+			     const unsigned part_num,
+			     const unsigned clique)
+{
+  vector< CliqueValueMask* >& masks = (*cePruneMaskSegment)[part_num];
+  ps.maxCliquesSharedStructure[clique].origin->cePruneMask =
+    (clique < masks.size() ? masks[clique] : NULL);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * JunctionTree::ceUpdatePruneMask
+ *   
+ *   Replaces a clique's prune mask for the current segment by the
+ *   entries that survived pruning this time. If that would take the
+ *   masks of all segments over pruneMaskMemoryBudget, the clique is
+ *   left without a mask instead.
+ *
+ * Preconditions:
+ *   cePruneMaskSegment is not NULL, and the clique has just been
+ *   gathered.
+ *
+ * Postconditions:
+ *   The new mask is stored, and the clique's origin no longer
+ *   uses a mask.
+ *
+ * Side Effects:
+ *   frees the old mask.
+ *
+ * Results:
+ *   none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+JunctionTree::ceUpdatePruneMask(PartitionStructures& ps,
+				PartitionTables& pt,
+				const unsigned part_num,
+				const unsigned clique)
+{
+  vector< CliqueValueMask* >& masks = (*cePruneMaskSegment)[part_num];
+  if (masks.size() <= clique)
+    masks.resize(ps.maxCliquesSharedStructure.size(),NULL);
+  MaxClique& origin = *(ps.maxCliquesSharedStructure[clique].origin);
+  origin.cePruneMask = NULL;
+  if (masks[clique] != NULL) {
+    cePruneMaskBytes -= masks[clique]->memoryUsage();
+    delete masks[clique];
+  }
+  CliqueValueMask* mask = pt.maxCliques[clique].makePruneMask(origin);
+  if (mask != NULL) {
+    const unsigned long bytes = mask->memoryUsage();
+    if (pruneMaskMemoryBudget > 0.0 &&
+	(double)(cePruneMaskBytes + bytes) > pruneMaskMemoryBudget*1024.0*1024.0) {
+      delete mask;
+      mask = NULL;
+    } else
+      cePruneMaskBytes += bytes;
+  }
+  masks[clique] = mask;
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * JunctionTree::ceGatherIntoRoot
@@ -2300,6 +2487,18 @@ JunctionTree::ceGatherIntoRoot(PartitionStructures& ps,
     IM::setGlbMsgLevel(IM::InferenceMemory, IM::glbMsgLevel(IM::DefaultModule));
   }
 
+  // the -ckbeam as given, which the memory budget tightens for this
+  // partition only.
+  const unsigned origMaxNumStates = MaxClique::cliqueBeamMaxNumStates;
+  const unsigned numCliques = message_order.size() + 1;
+  unsigned long numValuesDone = 0;
+  bool tightened = false;
+  // running total of the bytes of this partition's tables, starting
+  // with the separators already filled from the previous partition
+  // and updated as each clique and separator is filled or cleared.
+  unsigned long usedBytes =
+    (cliqueMemoryBudget > 0.0) ? pt.memoryUsage(ps) : 0;
+
   bool zeroClique = false;
   try {
     // Now, do partition messages.
@@ -2310,11 +2509,22 @@ JunctionTree::ceGatherIntoRoot(PartitionStructures& ps,
 	      "CE: gathering into %s,part[%d]: clique %d\n",
 	      part_type_name,part_num,from);
 
+      if (cliqueMemoryBudget > 0.0)
+	tightened |= ceApplyMemoryBudget(usedBytes,msgNo,numValuesDone,numCliques,
+					 tightened,origMaxNumStates,
+					 part_type_name,part_num);
+
+      if (cePruneMaskSegment != NULL)
+	ceSetPruneMask(ps,part_num,from);
+
       // this may now throw an exception on zero clique errors - RR
       pt.maxCliques[from].
 	ceGatherFromIncommingSeparators(ps.maxCliquesSharedStructure[from],
 					pt.separatorCliques,
 					ps.separatorCliquesSharedStructure.ptr);
+
+      if (cePruneMaskSegment != NULL)
+	ceUpdatePruneMask(ps,pt,part_num,from);
   
       infoMsg(IM::Inference, IM::Mod,
 	      "CE: message %s,part[%d]: clique %d --> clique %d\n",
@@ -2323,12 +2533,22 @@ JunctionTree::ceGatherIntoRoot(PartitionStructures& ps,
 	ceSendToOutgoingSeparator(ps.maxCliquesSharedStructure[from],
 				  pt.separatorCliques,
 				  ps.separatorCliquesSharedStructure.ptr);
+      numValuesDone += pt.maxCliques[from].numCliqueValues();
+      if (cliqueMemoryBudget > 0.0)
+	usedBytes += pt.maxCliques[from].memoryUsage()
+	  + pt.separatorCliques[ps.maxCliquesSharedStructure[from].origin->ceSendSeparator].memoryUsage();
 
       // TODO: if we are just computing probE here, we should delete
       // memory in pt.maxCliques[from]. Also, if we're only doing probE,
       // we should not keep the cliques around at all, only the outgoing
       // separator.
       if (clearWhenDone) {
+	if (cliqueMemoryBudget > 0.0) {
+	  const MaxClique& origin = *(ps.maxCliquesSharedStructure[from].origin);
+	  usedBytes -= pt.maxCliques[from].memoryUsage();
+	  for (unsigned i=0;i<origin.ceReceiveSeparators.size();i++)
+	    usedBytes -= pt.separatorCliques[origin.ceReceiveSeparators[i]].memoryUsage();
+	}
 	pt.maxCliques[from].
 	  clearCliqueAndIncommingSeparatorMemory(ps.maxCliquesSharedStructure[from],
 						 pt.separatorCliques,
@@ -2349,10 +2569,20 @@ JunctionTree::ceGatherIntoRoot(PartitionStructures& ps,
 	    "CE: gathering into partition root %s,part[%d]: clique %d\n",
 	    part_type_name,part_num,root);
     try {
+      if (cliqueMemoryBudget > 0.0)
+	tightened |= ceApplyMemoryBudget(usedBytes,numCliques-1,numValuesDone,numCliques,
+					 tightened,origMaxNumStates,
+					 part_type_name,part_num);
+      if (cePruneMaskSegment != NULL)
+	ceSetPruneMask(ps,part_num,root);
       pt.maxCliques[root].
 	ceGatherFromIncommingSeparators(ps.maxCliquesSharedStructure[root],
 					pt.separatorCliques,
 					ps.separatorCliquesSharedStructure.ptr);
+      if (cePruneMaskSegment != NULL)
+	ceUpdatePruneMask(ps,pt,part_num,root);
+      if (cliqueMemoryBudget > 0.0)
+	usedBytes += pt.maxCliques[root].memoryUsage();
     } catch (ZeroCliqueException &e) {
       zeroClique = true; // abort this partition & segment
     }
@@ -2362,6 +2592,29 @@ JunctionTree::ceGatherIntoRoot(PartitionStructures& ps,
       }
     }
   }
+  if (zeroClique && cePruneMaskSegment != NULL) {
+    // don't leave a mask behind in the clique that was aborted.
+    for (unsigned i=0;i<ps.maxCliquesSharedStructure.size();i++)
+      ps.maxCliquesSharedStructure[i].origin->cePruneMask = NULL;
+  }
+  if (cliqueMemoryBudget > 0.0) {
+    // relax -ckbeam again, and if it was not tightened keep this
+    // partition's averages for projecting the next ones.
+    MaxClique::cliqueBeamMaxNumStates = origMaxNumStates;
+    if (!zeroClique) {
+      numValuesDone += pt.maxCliques[root].numCliqueValues();
+      if (!tightened) {
+	ceAvgCliqueBytes = (double)usedBytes/numCliques;
+	ceAvgCliqueValues = (double)numValuesDone/numCliques;
+      }
+      infoMsg(IM::Inference, IM::Low,
+	      "CE: %s,part[%d]: %lu clique states, %.6fMB held of budget %.6fMB, %s\n",
+	      part_type_name,part_num,numValuesDone,
+	      (ceMemoryHeld + usedBytes)/(1024.0*1024.0),cliqueMemoryBudget,
+	      tightened ? "limited" : "not limited");
+    }
+  }
+
   if (! partitionDebugRange.contains((int)part_num)) {
 #if 0
     printf("ceGather [part %u]: raising inference level to %d\n", 
@@ -2533,6 +2786,17 @@ JunctionTree::collectEvidence()
   new (&inference_it) ptps_iterator(*this);
 
   init_CC_CE_rvs(inference_it);
+  // nothing held yet against the clique memory budget, and all
+  // partitions will be held together.
+  ceMemoryHeld = 0;
+  ceCliquesToCome = 0;
+  if (cliqueMemoryBudget > 0.0) {
+    ptps_iterator later(inference_it);
+    for (unsigned part=1;part < later.pt_len();part++) {
+      later.go_to_part_no(part);
+      ceCliquesToCome += partitionStructureArray[later.ps_i()].maxCliquesSharedStructure.size();
+    }
+  }
 
   // we skip the first Co's LI separator if there is no P1
   // partition, since otherwise we'll get zero probability.
@@ -2563,6 +2827,10 @@ JunctionTree::collectEvidence()
 		       inference_it.pt_i());
   }
 
+  // all partitions' tables are kept for distribute evidence.
+  if (cliqueMemoryBudget > 0.0)
+    ceMemoryHeld += partitionTableArray[inference_it.pt_i()].memoryUsage(partitionStructureArray[inference_it.ps_i()]);
+
   // if the LI separator was turned off, we need to turn it back on.
   if (inference_it.at_first_c() && P1.cliques.size() == 0)
     Co.useLISeparator();
@@ -2588,6 +2856,9 @@ JunctionTree::collectEvidence()
 			  inference_it.pt_i());
 
 
+    if (cliqueMemoryBudget > 0.0)
+      ceCliquesToCome -= partitionStructureArray[inference_it.ps_i()].maxCliquesSharedStructure.size();
+
     // we skip the first Co's LI separator if there is no P1
     // partition, since otherwise we'll get zero probability.
     if (inference_it.at_first_c() && P1.cliques.size() == 0)
@@ -2623,6 +2894,9 @@ JunctionTree::collectEvidence()
 			 inference_it.pt_i());
     }
     
+    if (cliqueMemoryBudget > 0.0)
+      ceMemoryHeld += partitionTableArray[inference_it.pt_i()].memoryUsage(partitionStructureArray[inference_it.ps_i()]);
+
     if (!inference_it.has_c_partition() && P1.cliques.size() == 0)
       E1.useLISeparator();
 
@@ -3163,6 +3437,9 @@ JunctionTree::emIncrement(const logpr probE,
 		  localCliqueNormalization,
 		  emTrainingBeam);
   }
+  // apply the increments batched up by the mixtures while this
+  // segment's observations are still available.
+  GM_Parms.emFlushIncrements();
 
 
 
@@ -3460,6 +3737,9 @@ JunctionTree::probEvidenceFixedUnroll(const unsigned int numFrames,
   init_CC_CE_rvs(inference_it);
 
   PartitionTables* prev_part_tab = NULL;
+  ceMemoryHeld = 0;
+  // later partitions are not held along with the current one.
+  ceCliquesToCome = 0;
   PartitionTables* cur_part_tab
     = new PartitionTables(inference_it.cur_jt_partition());
 
@@ -3502,6 +3782,11 @@ JunctionTree::probEvidenceFixedUnroll(const unsigned int numFrames,
     prev_part_tab = cur_part_tab;
 
     setCurrentInferenceShiftTo(part);
+
+    // the previous partition's tables are kept until this one is done.
+    ceMemoryHeld = (cliqueMemoryBudget > 0.0) ?
+      prev_part_tab->memoryUsage(partitionStructureArray[inference_it.ps_prev_i()]) : 0;
+
     cur_part_tab
       = new PartitionTables(inference_it.cur_jt_partition());
 
@@ -3922,6 +4207,9 @@ printf("onlineFixedUnroll: total # partitions %u\n", totalNumberPartitions);
   init_CC_CE_rvs(inference_it);
 
   PartitionTables* prev_part_tab = NULL;
+  ceMemoryHeld = 0;
+  // later partitions are not held along with the current one.
+  ceCliquesToCome = 0;
   PartitionTables* cur_part_tab
     = new PartitionTables(inference_it.cur_jt_partition());
 
@@ -4007,6 +4295,10 @@ printf("onlineFixedUnroll: total # partitions %u\n", totalNumberPartitions);
 
     setCurrentInferenceShiftTo(part);
 
+    // the previous partition's tables are kept until this one is done.
+    ceMemoryHeld = (cliqueMemoryBudget > 0.0) ?
+      prev_part_tab->memoryUsage(partitionStructureArray[inference_it.ps_prev_i()]) : 0;
+
     cur_part_tab
       = new PartitionTables(inference_it.cur_jt_partition());
 
@@ -16,6 +16,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
 
 #include "GMTK_LatticeADT.h"
 #include "GMTK_NamedObject.h"
@@ -65,6 +66,7 @@ LatticeADT::LatticeADT()
     _frameRate(fabs(_defaultFrameRate)), 
     _frameRelax(0),
     _latticeFile(NULL), _numLattices(0), _curNum(0),
+    _archive(NULL), _archiveObject(-1),
     _nodeCardinality(0), _wordCardinality(0), _timeCardinality(0), score_options(0) {
 }
 
@@ -88,35 +90,6 @@ LatticeADT::~LatticeADT() {
 }
 
 
-/*-
- *-----------------------------------------------------------------------
- * LatticeADT::LaticeNode::~LatticeNode();
- *     default destructor
- *
- * Results:
- *     no results:
- *-----------------------------------------------------------------------
- */
-LatticeADT::LatticeNode::~LatticeNode() {
-  // We need to do an iterator through the hash table and free up any
-  // memory for used cells.
-  shash_map_iter<unsigned, LatticeEdgeList>::iterator it;
-  if (edges.begin(it)) {
-    // unsigned i=0;
-    do {
-      LatticeEdgeList& cur_list = (*it);
-      // need to clear this explicitl since we're using an sArray_sd,
-      // which does no have its own destructor.
-      //       printf("clearning edge array %d, size = %d, ptr = 0x%X\n",i++,
-      // 	     cur_list.edge_array.size(),
-      // 	     (unsigned)cur_list.edge_array.ptr);
-      cur_list.edge_array.clear();
-    } while ( it.next() );
-  }
-
-}
-
-
 /*-
  *-----------------------------------------------------------------------
  * LatticeADT::readFromHTKLattice(ifs, vocab)
@@ -214,7 +187,7 @@ void LatticeADT::readFromHTKLattice(iDataStreamFile &ifs, const Vocab &vocab)
 
   if ( _latticeNodes )
     delete [] _latticeNodes;
-  _latticeNodes = new LatticeNode [_numberOfNodes];
+  _latticeNodes = new LatticeNode [_numberOfNodes+1];
 
   const unsigned linesize = 4096;
   char line[linesize];
@@ -318,6 +291,7 @@ void LatticeADT::readFromHTKLattice(iDataStreamFile &ifs, const Vocab &vocab)
   // reading links
   double score;
   unsigned endNodeId = 0;
+  vector<PendingEdge> pending(_numberOfLinks);
   for ( unsigned i = 0; i < _numberOfLinks; i++ ) {
     ifs.readLine(line, linesize);
     ptr = strtok(line, seps);
@@ -417,35 +391,18 @@ void LatticeADT::readFromHTKLattice(iDataStreamFile &ifs, const Vocab &vocab)
 	    id, _latticeNodes[id].time, 
 	    endNodeId, _latticeNodes[endNodeId].time);
 
-    LatticeEdgeList* edge_listp = _latticeNodes[id].edges.find(endNodeId);
-    if (edge_listp == NULL) {
-      // need to insert new edge list
-      LatticeEdgeList edge_list;
-      // start with only one edge (conserve memory)
-      edge_list.edge_array.resize(1);
-      // place edge (using copy).
-      edge_list.edge_array[0] = edge;
-      // record edge.
-      edge_list.num_edges  = 1;
-      // and lastly, insert it in the hash table
-      _latticeNodes[id].edges.insert(endNodeId,edge_list);
-    } else {
-      // edge list already there, add to the end.
-      assert ( edge_listp->num_edges > 0 );
-
-      // make sure there is room for at least one more, use a
-      // conservative growth rate
-      const float growth_rate = 1.25;
-      edge_listp->edge_array.growByFIfNeededAndCopy(growth_rate,
-						    edge_listp->num_edges+1);
-
-      // place edge (using copy).
-      edge_listp->edge_array[edge_listp->num_edges] = edge;
-      edge_listp->num_edges++;
-    }
+    if ( id >= _numberOfNodes || endNodeId >= _numberOfNodes )
+      error("Error in lattice '%s', lattice edge %d, node ids (%d,%d) must be less than the number of lattice nodes %d",
+	    ifs.fileName(), i, id, endNodeId, _numberOfNodes);
 
+    // the arcs are built once all the edges are in.
+    pending[i].source = id;
+    pending[i].dest = endNodeId;
+    pending[i].edge = edge;
   }
 
+  buildArcs(pending);
+
   if ( _timeMarks && _latticeNodes[_start].time >= _latticeNodes[_end].time )
     error("Error in lattice '%s', overall start node %d time (%f) should be earlier than end node %d time(%f)",
 	  ifs.fileName(),
@@ -590,7 +547,7 @@ void LatticeADT::read(iDataStreamFile &is) {
     }
 
     // read in vocab filename
-    string vocabName;
+    string &vocabName = _vocabName;
     is.read(vocabName, "Can't read vocab name");
 
     if ( GM_Parms.vocabsMap.find(vocabName) == GM_Parms.vocabsMap.end() )
@@ -642,6 +599,14 @@ void LatticeADT::seek(unsigned nmbr)
     error("ERROR: trying to seek in non-iterable lattice, '%s'\n",
 	  _curName.c_str() );
 
+  if ( _archive != NULL ) {
+    // archived lattices are read by number, so there is nothing to seek.
+    if ( _numLattices <= nmbr )
+      error("number of lattices (%d) in '%s' is less than segment number (%d)", _numLattices, _latticeFileName.c_str(), nmbr);
+    _curNum = nmbr - 1;
+    return;
+  }
+
   // rewind the file
   _latticeFile->rewind();
   _latticeFile->read(_numLattices, "num lattices");
@@ -695,10 +660,22 @@ void LatticeADT::initializeIterableLattice(const string &fileName) {
     error("ERROR: can't call initializeIterableDT() for recursively");
 
   _latticeFileName = fileName;
-  _latticeFile = new iDataStreamFile(_latticeFileName.c_str(), false, false);
   _numLattices = 0;
   _curNum = -1;
 
+  // the lattices are either already parsed in a segment archive, in
+  // which case this lattice's object is looked up by its name, or
+  // listed in a text file.
+  if ( SegmentArchive::isArchive(_latticeFileName.c_str()) ) {
+    _archive = SegmentArchive::open(_latticeFileName.c_str());
+    _archiveObject = _archive->findObject(SegmentArchive::LatticeObject, name());
+    if ( _archiveObject < 0 )
+      error("ERROR: segment archive '%s' has no lattices for lattice '%s'", _latticeFileName.c_str(), name().c_str());
+    _numLattices = _archive->numRecords(_archiveObject);
+  } else {
+    _latticeFile = new iDataStreamFile(_latticeFileName.c_str(), false, false);
+  }
+
   beginIterableLattice();
 }
 
@@ -715,8 +692,10 @@ void LatticeADT::initializeIterableLattice(const string &fileName) {
 void LatticeADT::beginIterableLattice() {
   if ( ! iterable() )
     error("ERROR: can't call beginIterableDT() for non-file lattice");
-  _latticeFile->rewind();
-  _latticeFile->read(_numLattices, "num lattices");
+  if ( _archive == NULL ) {
+    _latticeFile->rewind();
+    _latticeFile->read(_numLattices, "num lattices");
+  }
   _curNum = -1;
 
   // read in the fist lattice
@@ -742,6 +721,10 @@ void LatticeADT::nextIterableLattice()
 
   // increment the index
   ++_curNum;
+  if ( _archive != NULL ) {
+    readArchiveRecord(_curNum);
+    return;
+  }
   _latticeFile->read(readLatticeNum, "lattice index");
   if ( _curNum != readLatticeNum )
     error("ERROR: reading from file '%s', expecting DT number %d but got number %d\n", _latticeFileName.c_str(), _curNum, readLatticeNum);
@@ -765,7 +748,7 @@ void LatticeADT::nextIterableLattice()
   }
 
   // read in vocab filename
-  string vocabName;
+  string &vocabName = _vocabName;
   _latticeFile->read(vocabName, "Can't read vocab name");
 
   if ( GM_Parms.vocabsMap.find(vocabName) == GM_Parms.vocabsMap.end() )
@@ -786,6 +769,199 @@ void LatticeADT::nextIterableLattice()
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * LatticeADT::buildArcs(pending)
+ *     fill in the arcs and edges of the lattice from its list of
+ *     edges: edges are grouped by source node, then by destination
+ *     node (keeping the order they were given in within an arc), and
+ *     each (source,destination) group becomes an arc.
+ *
+ * Results:
+ *     None. pending is sorted.
+ *-----------------------------------------------------------------------
+ */
+void LatticeADT::buildArcs(vector<PendingEdge> &pending)
+{
+  std::stable_sort(pending.begin(), pending.end(), pendingEdgeLess);
+
+  // count the arcs so that they can be allocated at once.
+  unsigned numArcsTotal = 0;
+  for ( unsigned e = 0; e < pending.size(); e++ ) {
+    if ( e == 0 || pendingEdgeLess(pending[e-1], pending[e]) )
+      numArcsTotal++;
+  }
+  _arcs.resize(numArcsTotal+1);
+  _edges.resize(pending.size());
+
+  unsigned arc = 0;
+  unsigned e = 0;
+  for ( unsigned i = 0; i < _numberOfNodes; i++ ) {
+    _latticeNodes[i].firstArc = arc;
+    while ( e < pending.size() && pending[e].source == i ) {
+      if ( arc == _latticeNodes[i].firstArc || _arcs[arc-1].dest != pending[e].dest ) {
+	_arcs[arc].dest = pending[e].dest;
+	_arcs[arc].firstEdge = e;
+	arc++;
+      }
+      _edges[e] = pending[e].edge;
+      e++;
+    }
+  }
+  assert ( arc == numArcsTotal && e == pending.size() );
+  _latticeNodes[_numberOfNodes].firstArc = arc;
+  _arcs[numArcsTotal].dest = 0;
+  _arcs[numArcsTotal].firstEdge = e;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * LatticeADT::writeArchive(w)
+ *     write all the lattices of an iterable lattice to a segment
+ *     archive, as an object named by this lattice with one record
+ *     per lattice. Each record has the lattice as read from the HTK
+ *     lattice (with normalized posteriors) and its options, so that
+ *     loading it only needs the GMTK scores to be set.
+ *
+ * Results:
+ *     None. The last lattice of the file is left loaded.
+ *-----------------------------------------------------------------------
+ */
+void LatticeADT::writeArchive(SegmentArchive::Writer &w)
+{
+  assert ( iterable() );
+  if ( _archive != NULL )
+    error("ERROR: lattice '%s' already comes from segment archive '%s'", name().c_str(), _latticeFileName.c_str());
+
+  infoMsg(IM::Default, "Writing %s\n", name().c_str());
+  w.beginObject(SegmentArchive::LatticeObject, name());
+
+  beginIterableLattice();
+  for ( unsigned n = 0; n < _numLattices; n++ ) {
+    if ( n > 0 )
+      nextIterableLattice();
+
+    w.beginRecord();
+    w.writeString(_curName);
+    w.writeUnsigned(_nodeCardinality);
+    w.writeUnsigned(_timeCardinality);
+    w.writeString(_vocabName);
+    w.writeUnsigned(_wordCardinality);
+    w.writeUnsigned(score_options);
+    w.writeUnsigned(_frameRelax);
+
+    w.writeUnsigned(_timeMarks);
+    w.writeUnsigned(_numberOfNodes);
+    w.writeUnsigned(_numberOfLinks);
+    w.writeUnsigned(_start);
+    w.writeUnsigned(_end);
+    w.writeDouble(_lmscale);
+    w.writeDouble(_wdpenalty);
+    w.writeDouble(_acscale);
+    w.writeDouble(_base);
+
+    for ( unsigned i = 0; i < _numberOfNodes; i++ ) {
+      LatticeNode &node = _latticeNodes[i];
+      w.writeFloat(node.time);
+      w.writeUnsigned(node.startFrame);
+      w.writeUnsigned(node.endFrame);
+      w.writeUnsigned(numArcs(i));
+      for ( unsigned a = node.firstArc; a < _latticeNodes[i+1].firstArc; a++ ) {
+	w.writeUnsigned(_arcs[a].dest);
+	w.writeUnsigned(numEdges(&_arcs[a]));
+	for ( unsigned e = _arcs[a].firstEdge; e < _arcs[a+1].firstEdge; e++ ) {
+	  LatticeEdge &edge = _edges[e];
+	  w.writeUnsigned(edge.emissionId);
+	  w.writeDouble(edge.ac_score.val());
+	  w.writeDouble(edge.lm_score.val());
+	  w.writeDouble(edge.posterior.val());
+	}
+      }
+    }
+  }
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * LatticeADT::readArchiveRecord(nmbr)
+ *     load lattice nmbr from the segment archive, in place of
+ *     reading its entry from the lattice list and its HTK lattice.
+ *
+ * Results:
+ *     None.
+ *-----------------------------------------------------------------------
+ */
+void LatticeADT::readArchiveRecord(unsigned nmbr)
+{
+  SegmentArchive::Record r = _archive->record(_archiveObject, nmbr);
+
+  r.readString(_curName);
+  _nodeCardinality = r.readUnsigned();
+  _timeCardinality = r.readUnsigned();
+  r.readString(_vocabName);
+  unsigned wordCardinality = r.readUnsigned();
+
+  // the emission ids are indices into the vocab the archive was
+  // written with, so it had better be the same one.
+  if ( GM_Parms.vocabsMap.find(_vocabName) == GM_Parms.vocabsMap.end() )
+    error("Error: segment archive '%s', LatticeCPT '%s' specifies Vocab name '%s' that does not exist", _latticeFileName.c_str(), _name.c_str(), _vocabName.c_str());
+  _wordCardinality = GM_Parms.vocabs[GM_Parms.vocabsMap[_vocabName]]->size();
+  if ( _wordCardinality != wordCardinality )
+    error("Error: segment archive '%s', LatticeCPT '%s' was written with Vocab '%s' of size %u, but it now has size %u", _latticeFileName.c_str(), _name.c_str(), _vocabName.c_str(), wordCardinality, _wordCardinality);
+
+  score_options = r.readUnsigned();
+  _frameRelax = r.readUnsigned();
+
+  _timeMarks = (r.readUnsigned() != 0) && !_ignoreLatticeNodeTimeMarks;
+  _numberOfNodes = r.readUnsigned();
+  _numberOfLinks = r.readUnsigned();
+  _start = r.readUnsigned();
+  _end = r.readUnsigned();
+  _lmscale = r.readDouble();
+  _wdpenalty = r.readDouble();
+  _acscale = r.readDouble();
+  _base = r.readDouble();
+
+  if ( _numberOfNodes > _nodeCardinality || _start >= _numberOfNodes || _end >= _numberOfNodes )
+    error("ERROR: segment archive '%s' is corrupt", _latticeFileName.c_str());
+
+  if ( _latticeNodes )
+    delete [] _latticeNodes;
+  _latticeNodes = new LatticeNode [_numberOfNodes+1];
+
+  vector<PendingEdge> pending;
+  pending.reserve(_numberOfLinks);
+  for ( unsigned i = 0; i < _numberOfNodes; i++ ) {
+    LatticeNode &node = _latticeNodes[i];
+    node.time = r.readFloat();
+    node.startFrame = r.readUnsigned();
+    node.endFrame = r.readUnsigned();
+    unsigned numNodeArcs = r.readUnsigned();
+    for ( unsigned a = 0; a < numNodeArcs; a++ ) {
+      PendingEdge pe;
+      pe.source = i;
+      pe.dest = r.readUnsigned();
+      if ( pe.dest >= _numberOfNodes )
+	error("ERROR: segment archive '%s' is corrupt", _latticeFileName.c_str());
+      unsigned numArcEdges = r.readUnsigned();
+      for ( unsigned e = 0; e < numArcEdges; e++ ) {
+	pe.edge.emissionId = r.readUnsigned();
+	pe.edge.ac_score.setFromLogP(r.readDouble());
+	pe.edge.lm_score.setFromLogP(r.readDouble());
+	pe.edge.posterior.setFromLogP(r.readDouble());
+	pending.push_back(pe);
+      }
+    }
+  }
+  // the arcs were written in order, so this only lays them out.
+  buildArcs(pending);
+
+  setGMTKScores();
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * LatticeADT::resetFrameIndices(lastFrameId)
@@ -842,86 +1018,80 @@ void LatticeADT::resetFrameIndices(unsigned numFrames) {
 void LatticeADT::setGMTKScores()
 {
 
-  for ( unsigned i = 0; i < _numberOfNodes; ++i ) {
-    if ( _latticeNodes[i].edges.totalNumberEntries() > 0 ) {
-      shash_map_iter<unsigned, LatticeEdgeList>::iterator it;
-      _latticeNodes[i].edges.begin(it);
-      do {
-	
-	LatticeEdgeList	&edge_list = (*it);
-	edge_list.max_gmtk_score.set_to_zero();	
-	for (unsigned edge_ctr=0;edge_ctr < edge_list.num_edges; edge_ctr ++ ) {
-	  LatticeEdge &edge = edge_list.edge_array[edge_ctr];
-
-	  // the final score of the edge in ln value that GMTK will
-	  // use. This is a log score, so our initial score is unity
-	  // (log(unity) = 0). This means that the lattice is only
-	  // used as a sequencer that does nothing other than provide
-	  // valid values, and does not produce any score.
-	  double score = 0;
-
-	  if ( score_options & LADT_SCORE_OPTION_POSTERIOR ) {
-	    // use only posterior, ignore all the other scores.
-	    score = edge.posterior.val();
-	  } else {
-
-	    bool assigned = false;
-	    // do we use AC score?
-	    if (score_options & LADT_SCORE_OPTION_AC) {
-	      // AC score only
-	      score = edge.ac_score.val();
-	      assigned = true;
-	    } else if (score_options & LADT_SCORE_OPTION_ACSCALE) {
-	      // ac^acscale
-	      score = edge.ac_score.val() * _acscale;
-	      assigned = true;
-	    }
-
-	    if (score_options & LADT_SCORE_OPTION_LMSCALE) {
-	      if (assigned) 
-		score += edge.lm_score.val();
-	      else 
-		score = edge.lm_score.val();
-	      assigned = true;
-	    } else if (score_options & LADT_SCORE_OPTION_LM) {
-	      if (assigned)
-		score += edge.lm_score.val() * _lmscale;
-	      else
-		score = edge.lm_score.val() * _lmscale;
-	      assigned = true;
-	    }
-	    
-	    // do we use insertion penalty?
-	    if ( score_options & 0x10 ) {
-	      if (assigned)
-		score += log(_base)*_wdpenalty;
-	      else
-		score = log(_base)*_wdpenalty;
-	    }
-	  }
-
-	  // check whether the score is too small that will have zero
-	  // probability.
-	  if ( score <= LSMALL )
-	    warning("score is essentially zero in lattice\n");
-
-	  edge.gmtk_score.setFromLogP(score);
-	  if (edge.gmtk_score > edge_list.max_gmtk_score) 
-	    edge_list.max_gmtk_score = edge.gmtk_score;
+  for ( unsigned a = 0; a + 1 < (unsigned)_arcs.size(); ++a ) {
+
+    LatticeArc &arc = _arcs[a];
+    arc.max_gmtk_score.set_to_zero();
+    for (unsigned edge_ctr=arc.firstEdge;edge_ctr < _arcs[a+1].firstEdge; edge_ctr ++ ) {
+      LatticeEdge &edge = _edges[edge_ctr];
+
+      // the final score of the edge in ln value that GMTK will
+      // use. This is a log score, so our initial score is unity
+      // (log(unity) = 0). This means that the lattice is only
+      // used as a sequencer that does nothing other than provide
+      // valid values, and does not produce any score.
+      double score = 0;
+
+      if ( score_options & LADT_SCORE_OPTION_POSTERIOR ) {
+	// use only posterior, ignore all the other scores.
+	score = edge.posterior.val();
+      } else {
+
+	bool assigned = false;
+	// do we use AC score?
+	if (score_options & LADT_SCORE_OPTION_AC) {
+	  // AC score only
+	  score = edge.ac_score.val();
+	  assigned = true;
+	} else if (score_options & LADT_SCORE_OPTION_ACSCALE) {
+	  // ac^acscale
+	  score = edge.ac_score.val() * _acscale;
+	  assigned = true;
 	}
 
-	if (_latticeNodeUseMaxScore) {
-	  // need to renormize the edge scores.
-	  for (unsigned edge_ctr=0;edge_ctr < edge_list.num_edges; edge_ctr ++ ) {
-	    LatticeEdge &edge = edge_list.edge_array[edge_ctr];
-	    edge.gmtk_score = edge.gmtk_score / edge_list.max_gmtk_score;
-	  }
-	} else {
-	  // need to reset the max scores to 1 so that they are
-	  // effectively not used.
-	  edge_list.max_gmtk_score.set_to_one();
+	if (score_options & LADT_SCORE_OPTION_LMSCALE) {
+	  if (assigned) 
+	    score += edge.lm_score.val();
+	  else 
+	    score = edge.lm_score.val();
+	  assigned = true;
+	} else if (score_options & LADT_SCORE_OPTION_LM) {
+	  if (assigned)
+	    score += edge.lm_score.val() * _lmscale;
+	  else
+	    score = edge.lm_score.val() * _lmscale;
+	  assigned = true;
+	}
+
+	// do we use insertion penalty?
+	if ( score_options & 0x10 ) {
+	  if (assigned)
+	    score += log(_base)*_wdpenalty;
+	  else
+	    score = log(_base)*_wdpenalty;
 	}
-      } while ( it.next() );
+      }
+
+      // check whether the score is too small that will have zero
+      // probability.
+      if ( score <= LSMALL )
+	warning("score is essentially zero in lattice\n");
+
+      edge.gmtk_score.setFromLogP(score);
+      if (edge.gmtk_score > arc.max_gmtk_score) 
+	arc.max_gmtk_score = edge.gmtk_score;
+    }
+
+    if (_latticeNodeUseMaxScore) {
+      // need to renormize the edge scores.
+      for (unsigned edge_ctr=arc.firstEdge;edge_ctr < _arcs[a+1].firstEdge; edge_ctr ++ ) {
+	LatticeEdge &edge = _edges[edge_ctr];
+	edge.gmtk_score = edge.gmtk_score / arc.max_gmtk_score;
+      }
+    } else {
+      // need to reset the max scores to 1 so that they are
+      // effectively not used.
+      arc.max_gmtk_score.set_to_one();
     }
   }
 }
@@ -982,27 +1152,22 @@ void LatticeADT::printLatticeInfo(FILE *f)
 	    i, 
 	   _latticeNodes[i].startFrame, _latticeNodes[i].endFrame);
     fprintf(f,"\tNumber of outgoing adjacent nodes = %d\n",
-	   _latticeNodes[i].edges.totalNumberEntries());
-
-    if ( _latticeNodes[i].edges.totalNumberEntries() > 0 ) {
-      shash_map_iter<unsigned, LatticeEdgeList>::iterator it;
-      bool res = _latticeNodes[i].edges.begin(it);
-      assert ( res ); // there has to be at least one edge.
-      do {
-	LatticeEdgeList &edge_list = (*it);
-	fprintf(f,"\tOutgoing node %u, %d edge(s), node pair (%d,%d) gmtk score = %f\n",
-		it.key(),
-		edge_list.num_edges,
-		i,it.key(),
-		edge_list.max_gmtk_score.val());
-	for (unsigned edge_ctr=0;edge_ctr < edge_list.num_edges; edge_ctr ++ ) {
-	  LatticeEdge &edge = edge_list.edge_array[edge_ctr];
-	  fprintf(f,"\t-- to %u, w=%d, ac=%f, lm=%f, p=%f, t=%f gmtk score=%f\n", 
-		 it.key(), 
-		 edge.emissionId, edge.ac_score.val(), edge.lm_score.val(), 
-		 edge.posterior.val(), _latticeNodes[it.key()].time, edge.gmtk_score.val());
-	}
-      } while ( it.next() );
+	   numArcs(i));
+
+    for ( unsigned a = _latticeNodes[i].firstArc; a < _latticeNodes[i+1].firstArc; a++ ) {
+      LatticeArc &arc = _arcs[a];
+      fprintf(f,"\tOutgoing node %u, %d edge(s), node pair (%d,%d) gmtk score = %f\n",
+	      arc.dest,
+	      numEdges(&arc),
+	      i,arc.dest,
+	      arc.max_gmtk_score.val());
+      for (unsigned edge_ctr=arc.firstEdge;edge_ctr < _arcs[a+1].firstEdge; edge_ctr ++ ) {
+	LatticeEdge &edge = _edges[edge_ctr];
+	fprintf(f,"\t-- to %u, w=%d, ac=%f, lm=%f, p=%f, t=%f gmtk score=%f\n", 
+	       arc.dest, 
+	       edge.emissionId, edge.ac_score.val(), edge.lm_score.val(), 
+	       edge.posterior.val(), _latticeNodes[arc.dest].time, edge.gmtk_score.val());
+      }
     }
   }
   fprintf(f,"--- Done Printing Lattice Information ---\n");
@@ -1024,31 +1189,18 @@ void LatticeADT::normalizePosterior() {
   // those contains the real log probabilities which can be used
   // with proper scale factors.
   for ( unsigned i = 0; i < _numberOfNodes; ++i ) {
-    if ( _latticeNodes[i].edges.totalNumberEntries() > 0 ) {
-      shash_map_iter<unsigned, LatticeEdgeList>::iterator it;
-      _latticeNodes[i].edges.begin(it);
+    // all the edges out of node i are contiguous.
+    unsigned firstEdge = _arcs[_latticeNodes[i].firstArc].firstEdge;
+    unsigned lastEdge = _arcs[_latticeNodes[i+1].firstArc].firstEdge;
+    if ( firstEdge < lastEdge ) {
       logpr sum;
       sum.set_to_zero();
-      {
-	do {
-	  LatticeEdgeList &edge_list = (*it);
-	  for (unsigned edge_ctr=0;edge_ctr < edge_list.num_edges; edge_ctr ++ ) {
-	    LatticeEdge &edge = edge_list.edge_array[edge_ctr];
-	    sum += edge.posterior;
-	  }
-	} while ( it.next() );
+      for (unsigned edge_ctr=firstEdge;edge_ctr < lastEdge; edge_ctr ++ ) {
+	sum += _edges[edge_ctr].posterior;
       }
       if (! sum.essentially_zero()) {
-	// start iter again
-	_latticeNodes[i].edges.begin(it);
-	{
-	  do {
-	    LatticeEdgeList &edge_list = (*it);
-	    for (unsigned edge_ctr=0;edge_ctr < edge_list.num_edges; edge_ctr ++ ) {
-	      LatticeEdge &edge = edge_list.edge_array[edge_ctr];
-	      edge.posterior = edge.posterior / sum;
-	    }
-	  } while ( it.next() );
+	for (unsigned edge_ctr=firstEdge;edge_ctr < lastEdge; edge_ctr ++ ) {
+	  _edges[edge_ctr].posterior = _edges[edge_ctr].posterior / sum;
 	}
       }
     }
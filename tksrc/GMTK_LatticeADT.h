@@ -19,10 +19,13 @@
 #define GMTK_LATTICE_ADT_H
 
 
+#include <vector>
+
 #include "GMTK_NamedObject.h"
 #include "GMTK_Vocab.h"
+#include "GMTK_SegmentArchive.h"
 #include "fileParser.h"
-#include "shash_map_iter.h"
+#include "sArray.h"
 #include "logp.h"
 
 
@@ -60,13 +63,17 @@ class LatticeADT : public NamedObject {
   void printScoreOptions(FILE* f);
 
   // this lattice is iterable
-  inline bool iterable() const { return _latticeFile != NULL; }
+  inline bool iterable() const { return _latticeFile != NULL || _archive != NULL; }
 
   void seek(unsigned nmbr);
   void initializeIterableLattice(const string &fileName);
   void beginIterableLattice();
   void nextIterableLattice();
 
+  // write all the lattices of an iterable lattice as an object of a
+  // segment archive
+  void writeArchive(SegmentArchive::Writer &w);
+
   // reset the frame indices
   void resetFrameIndices(unsigned numFrames);
   void setGMTKScores();
@@ -100,23 +107,21 @@ class LatticeADT : public NamedObject {
 
   /*
    * For every pair of connected, nodes there can be one or more
-   * edges.  This list contains those edges associated with a
+   * edges.  An arc stands for those edges associated with a
    * connected pair of nodes. This also contains the precomputed score
    * to be used for the node->node transition for this set of edges
    * (which can either be unity, or can be the max score of each of
    * the edges) -- depending on this score, the lattice node will need
    * to be scored differently.
    */
-  struct LatticeEdgeList {
-    unsigned num_edges;
-    // use an sArray without a destructor, so that when hash table
-    // resizes, it doesn't delete the memory used.
-    sArray_nd < LatticeADT::LatticeEdge > edge_array;
+  struct LatticeArc {
+    /** the node the edges go to */
+    unsigned dest;
+    /** the edges are _edges[firstEdge] up to the next arc's firstEdge */
+    unsigned firstEdge;
 
     /** max score used in GMTK for all the edges */
     logpr max_gmtk_score;
-
-    LatticeEdgeList() : num_edges(0) {} 
   };
 
   /**
@@ -129,21 +134,76 @@ class LatticeADT : public NamedObject {
     unsigned startFrame;
     /** ending frame number */
     unsigned endFrame;
-    /** possible out-going edges */
-    shash_map_iter<unsigned, LatticeEdgeList > edges;
+    /** the node's out-going arcs are _arcs[firstArc] up to the next node's firstArc */
+    unsigned firstArc;
 
-    LatticeNode() : startFrame(0), endFrame(0), edges(shash_map_iter<unsigned, LatticeEdgeList>(1)) {}
-    ~LatticeNode(); 
+    LatticeNode() : startFrame(0), endFrame(0), firstArc(0) {}
   };
 
+  /**
+   * an edge as it is read in, before the arcs are built
+   */
+  struct PendingEdge {
+    unsigned source;
+    unsigned dest;
+    LatticeEdge edge;
+  };
+  static bool pendingEdgeLess(const PendingEdge &a, const PendingEdge &b) {
+    return a.source < b.source || (a.source == b.source && a.dest < b.dest);
+  }
+
+  /**
+   * build the nodes' arcs and the edge array from all the edges of
+   * the lattice (which are reordered)
+   */
+  void buildArcs(vector<PendingEdge> &pending);
+
+  /*
+   * The lattice is kept in compressed sparse row form: the arcs out
+   * of node i are _arcs[_latticeNodes[i].firstArc ..
+   * _latticeNodes[i+1].firstArc-1], sorted by destination node, and
+   * the edges of arc a are _edges[_arcs[a].firstEdge ..
+   * _arcs[a+1].firstEdge-1]. _latticeNodes and _arcs each have one
+   * extra entry at the end so that the last node and arc have an end.
+   */
+  inline unsigned numArcs(unsigned node) const {
+    return _latticeNodes[node+1].firstArc - _latticeNodes[node].firstArc;
+  }
+  inline unsigned numEdges(const LatticeArc *arc) const {
+    return arc[1].firstEdge - arc[0].firstEdge;
+  }
+
+  /**
+   * the arc from node source to node dest, or NULL if there is none
+   */
+  inline LatticeArc* findArc(unsigned source, unsigned dest) const {
+    LatticeArc *lo = _arcs.ptr + _latticeNodes[source].firstArc;
+    LatticeArc *hi = _arcs.ptr + _latticeNodes[source+1].firstArc;
+    while ( lo < hi ) {
+      LatticeArc *mid = lo + (hi - lo)/2;
+      if ( mid->dest < dest )
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+    return (lo != _arcs.ptr + _latticeNodes[source+1].firstArc && lo->dest == dest) ? lo : NULL;
+  }
+
 
   /**
    * renormalize posterior
    */
   void normalizePosterior();
 
-  /** lattice nodes */
+  /**
+   * load lattice nmbr from the segment archive
+   */
+  void readArchiveRecord(unsigned nmbr);
+
+  /** lattice nodes, arcs and edges */
   LatticeNode *_latticeNodes;
+  sArray<LatticeArc> _arcs;
+  sArray<LatticeEdge> _edges;
   /* are there node time marks in this lattice */
   bool _timeMarks;
   /** number of nodes in lattice this should be smaller than node cardinality */
@@ -179,6 +239,11 @@ class LatticeADT : public NamedObject {
   unsigned _numLattices; // number of lattices in this file
   int _curNum; // the current lattice number
   string _curName; // the current lattice cpt name
+  string _vocabName; // the vocab of the current lattice
+  // if the lattices come from a segment archive rather than a text
+  // file, the archive and this lattice's object within it.
+  SegmentArchive* _archive;
+  int _archiveObject;
 
   // the following is GM paramters
   unsigned _nodeCardinality;
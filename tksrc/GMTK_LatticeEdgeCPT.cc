@@ -63,17 +63,17 @@ LatticeEdgeCPT::~LatticeEdgeCPT() {
  *-----------------------------------------------------------------------
  */
 logpr LatticeEdgeCPT::probGivenParents(vector< RV* >& parents, DiscRV* drv) {
-  LatticeADT::LatticeEdgeList* outEdges
-    = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val].edges.find(RV2DRV(parents[1])->val);
-  if ( outEdges == NULL) {
+  LatticeADT::LatticeArc* outArc
+    = _latticeAdt->findArc(RV2DRV(parents[0])->val, RV2DRV(parents[1])->val);
+  if ( outArc == NULL) {
     // then this is an impossible pair of nodes, so give it zero
     // probability.
     return logpr(0.0);
   }
   // we've got an edge, but how many?  We've got to search to find
   // one with a matching drv->val.
-  for (unsigned edge_ctr=0;edge_ctr < outEdges->num_edges; edge_ctr ++ ) {
-    LatticeADT::LatticeEdge &edge = outEdges->edge_array[edge_ctr];
+  for (unsigned edge_ctr=outArc->firstEdge;edge_ctr < outArc[1].firstEdge; edge_ctr ++ ) {
+    const LatticeADT::LatticeEdge &edge = _latticeAdt->_edges.ptr[edge_ctr];
     if (edge.emissionId == drv->val) {
       return edge.gmtk_score;
     }
@@ -99,9 +99,9 @@ void LatticeEdgeCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parent
 							   DiscRV* drv, 
 							   logpr& p) 
 {
-  LatticeADT::LatticeEdgeList* outEdge 
-    = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val].edges.find(RV2DRV(parents[1])->val);
-  if ( outEdge == NULL ) {
+  LatticeADT::LatticeArc* outArc
+    = _latticeAdt->findArc(RV2DRV(parents[0])->val, RV2DRV(parents[1])->val);
+  if ( outArc == NULL ) {
     // If this occurs, it means that there is no outgoing edge
     // in the lattice starting from the node with value parent0->val.
     // We are guaranteed that the corresponding LatticeNodeCPT, when
@@ -121,20 +121,24 @@ void LatticeEdgeCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parent
     // give some junk values.
 
     it.drv = drv;
+    it.internalStatePtr = NULL;
+    it.uInternalState = 0;
     // Set to zero (0), a dummy number that has no meaning.
     drv->val = 0;	
     p.set_to_zero();
     return;
   }
 
-  // get first edge of list, we are guaranteed that there is at least
-  // one edge in the array.
-  assert ( outEdge->edge_array.size() > 0 );
+  // get first edge of the arc, we are guaranteed that there is at
+  // least one. The iterator state is the current edge and the number
+  // of edges left after it.
+  assert ( _latticeAdt->numEdges(outArc) > 0 );
+  LatticeADT::LatticeEdge *edge = _latticeAdt->_edges.ptr + outArc->firstEdge;
   it.drv = drv;
-  it.uInternalState = 0;
-  it.internalStatePtr = outEdge;
-  drv->val = outEdge->edge_array[it.uInternalState].emissionId;
-  p = outEdge->edge_array[it.uInternalState].gmtk_score;
+  it.uInternalState = _latticeAdt->numEdges(outArc) - 1;
+  it.internalStatePtr = (void*)edge;
+  drv->val = edge->emissionId;
+  p = edge->gmtk_score;
 }
 
 
@@ -150,12 +154,14 @@ void LatticeEdgeCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parent
  */
 bool LatticeEdgeCPT::next(iterator &it, logpr& p)
 {
-  LatticeADT::LatticeEdgeList* outEdge =
-    (LatticeADT::LatticeEdgeList*) it.internalStatePtr;
-  if (it.uInternalState+1 < outEdge->edge_array.size()) {
-    it.uInternalState++;
-    it.drv->val = outEdge->edge_array[it.uInternalState].emissionId;
-    p = outEdge->edge_array[it.uInternalState].gmtk_score;
+  LatticeADT::LatticeEdge* edge =
+    (LatticeADT::LatticeEdge*) it.internalStatePtr;
+  if (edge != NULL && it.uInternalState > 0) {
+    edge++;
+    it.uInternalState--;
+    it.internalStatePtr = (void*)edge;
+    it.drv->val = edge->emissionId;
+    p = edge->gmtk_score;
     return true;
   } else {
     p.set_to_zero();
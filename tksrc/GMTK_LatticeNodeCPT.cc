@@ -116,19 +116,18 @@ logpr LatticeNodeCPT::probGivenParents(vector< RV* >& parents, DiscRV* drv)
 	// Then a transition is being asked for.
 
 	// iterate next lattice nodes find the out going edge
-	LatticeADT::LatticeNode &node = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val];
+	unsigned src = RV2DRV(parents[0])->val;
 
 	// if the lattice node is the end, return prob zero
-	if ( node.edges.totalNumberEntries() == 0 ) {
+	if ( _latticeAdt->numArcs(src) == 0 ) {
 	  rc.set_to_zero();
 	} else {
-	  LatticeADT::LatticeEdgeList* outEdges
-	    = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val].edges.find(drv->val);
-	  if ( outEdges == NULL )
+	  LatticeADT::LatticeArc* outArc = _latticeAdt->findArc(src, drv->val);
+	  if ( outArc == NULL )
 	    rc.set_to_zero();
 	  else {
 	    if (LatticeADT::_latticeNodeUseMaxScore) {
-	      rc = outEdges->max_gmtk_score;
+	      rc = outArc->max_gmtk_score;
 	    } else {
 	      rc.set_to_one();
 	    }
@@ -174,18 +173,17 @@ logpr LatticeNodeCPT::probGivenParents(vector< RV* >& parents, DiscRV* drv)
 
       if ( RV2DRV(parents[1])->val ) {
 	// find the out going edge
-	LatticeADT::LatticeNode &node = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val];
+	unsigned src = RV2DRV(parents[0])->val;
 	// if the lattice node is the end, return prob zero
-	if ( node.edges.totalNumberEntries() == 0 ) {
+	if ( _latticeAdt->numArcs(src) == 0 ) {
 	  rc.set_to_zero();
 	} else {
-	  LatticeADT::LatticeEdgeList* outEdges
-	    = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val].edges.find(drv->val);
-	  if ( outEdges == NULL )
+	  LatticeADT::LatticeArc* outArc = _latticeAdt->findArc(src, drv->val);
+	  if ( outArc == NULL )
 	    rc.set_to_zero();
 	  else {
 	    if (LatticeADT::_latticeNodeUseMaxScore) {
-	      rc = outEdges->max_gmtk_score;
+	      rc = outArc->max_gmtk_score;
 	    } else {
 	      rc.set_to_one();
 	    }
@@ -318,32 +316,27 @@ void LatticeNodeCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parent
 	// Then a transition is being asked for.
 
 	// iterate next lattice nodes find the out going edge
-	LatticeADT::LatticeNode &node = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val];
+	unsigned src = RV2DRV(parents[0])->val;
 
 	// if the lattice node is the end, return prob zero
-	if ( node.edges.totalNumberEntries() == 0 ) {
+	if ( _latticeAdt->numArcs(src) == 0 ) {
 	  it.internalStatePtr = NULL;
 	  p.set_to_zero();
 	  return;
 	}
 
-	// check out the out-going edges based on parent value
-	shash_map_iter<unsigned, LatticeADT::LatticeEdgeList>::iterator *pit 
-	  = new shash_map_iter<unsigned, LatticeADT::LatticeEdgeList>::iterator();
-
-	// now the current node can have next transition
-	// find the correct iterators
-	node.edges.begin(*pit);
-
-	// set up the internal state for iterator
-	it.internalStatePtr = (void*)pit;
-	it.internalState = RV2DRV(parents[0])->val;
+	// the out-going arcs of the parent node are contiguous, so
+	// the iterator is just a pointer to the current arc and the
+	// number of arcs left after it.
+	LatticeADT::LatticeArc *arc = _latticeAdt->_arcs.ptr + _latticeAdt->_latticeNodes[src].firstArc;
+	it.internalStatePtr = (void*)arc;
+	it.uInternalState = _latticeAdt->numArcs(src) - 1;
 	it.drv = drv;
 
-	drv->val = pit->key();
+	drv->val = arc->dest;
 
 	if (LatticeADT::_latticeNodeUseMaxScore) {
-	  p = (**pit).max_gmtk_score;
+	  p = arc->max_gmtk_score;
 	} else {
 	  // then the various lattice edges handle the scoring
 	  p.set_to_one();
@@ -391,32 +384,26 @@ void LatticeNodeCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parent
       if ( RV2DRV(parents[1])->val ) {
         // iterate next lattice nodes
         // find the out going edge
-        LatticeADT::LatticeNode &node = _latticeAdt->_latticeNodes[RV2DRV(parents[0])->val];
+        unsigned src = RV2DRV(parents[0])->val;
 
         // if the lattice node is the end, return prob zero
-        if ( node.edges.totalNumberEntries() == 0 ) {
+        if ( _latticeAdt->numArcs(src) == 0 ) {
 	  it.internalStatePtr = NULL;
           p.set_to_zero();
           return;
         }
 
-        // check out the out-going edges based on parent value
-        shash_map_iter<unsigned, LatticeADT::LatticeEdgeList>::iterator *pit 
-	  = new shash_map_iter<unsigned, LatticeADT::LatticeEdgeList>::iterator();
-
-        // now the current node can have next transition
-        // find the correct iterators
-        node.edges.begin(*pit);
-
-        // set up the internal state for iterator
-        it.internalStatePtr = (void*)pit;
-        it.internalState = RV2DRV(parents[0])->val;
+        // set up the internal state for iterator: the current arc
+        // and the number of arcs left after it
+        LatticeADT::LatticeArc *arc = _latticeAdt->_arcs.ptr + _latticeAdt->_latticeNodes[src].firstArc;
+        it.internalStatePtr = (void*)arc;
+        it.uInternalState = _latticeAdt->numArcs(src) - 1;
         it.drv = drv;
 
-        drv->val = pit->key();
+        drv->val = arc->dest;
 
 	if (LatticeADT::_latticeNodeUseMaxScore) {
-	  p = (**pit).max_gmtk_score;
+	  p = arc->max_gmtk_score;
 	} else {
 	  // then the various lattice edges handle the scoring
 	  p.set_to_one();
@@ -451,11 +438,10 @@ void LatticeNodeCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parent
  *-----------------------------------------------------------------------
  */
 bool LatticeNodeCPT::next(iterator &it, logpr& p) {
-  shash_map_iter<unsigned, LatticeADT::LatticeEdgeList>::iterator* pit 
-    = (shash_map_iter<unsigned, LatticeADT::LatticeEdgeList>::iterator*) it.internalStatePtr;
+  LatticeADT::LatticeArc* arc = (LatticeADT::LatticeArc*) it.internalStatePtr;
 
-  // check whether pit is null
-  if ( pit == NULL ) {
+  // check whether arc is null
+  if ( arc == NULL ) {
     p.set_to_zero();
     return false;
   }
@@ -464,23 +450,24 @@ bool LatticeNodeCPT::next(iterator &it, logpr& p) {
   // transitions.  The reason is once the time passed
   // checking in BeginIterate, it already satisfies the constrains.
 
-  // find the next available in the tree
-  if ( pit->next() ) {
+  // the next arc out of the parent node, if any
+  if ( it.uInternalState > 0 ) {
+    arc++;
+    it.uInternalState--;
+    it.internalStatePtr = (void*)arc;
     // set up the values
-    it.drv->val = pit->key();
+    it.drv->val = arc->dest;
 
     if (LatticeADT::_latticeNodeUseMaxScore) {
-      p = (**pit).max_gmtk_score;
+      p = arc->max_gmtk_score;
     } else {
       p.set_to_one();
     }
 
     return true;
   } else {
-    // we're done with all the next nodes for this current node
-    // so we free things up.
-    delete pit;
-    // and return that we're done.
+    // we're done with all the next nodes for this current node,
+    // so return that we're done.
     it.internalStatePtr = NULL;
     p.set_to_zero();
     return false;
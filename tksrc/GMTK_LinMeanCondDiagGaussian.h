@@ -138,6 +138,14 @@ public:
   logpr log_p(const float *const x,    // real-valued scoring obs at time t
 	      const Data32* const base, // ptr to base obs at time t
 	      const int stride);       // stride
+  void prepareFrames() {
+    if (DlinkMatrix::precomputeRegressions)
+      dLinkMat->precomputeSegmentRegressions();
+  }
+  logpr log_p_frame(const unsigned frameIndex,
+		    const float *const x,
+		    const Data32* const base,
+		    const int stride);
   //////////////////////////////////
 
 
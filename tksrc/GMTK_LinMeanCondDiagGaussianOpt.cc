@@ -131,6 +131,65 @@ LinMeanCondDiagGaussian::log_p(const float *const x,
 
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * log_p_frame()
+ *      Same as log_p(), but uses the regression term of the frame
+ *      precomputed by the dlink matrix for the current segment, if
+ *      there is one.
+ * 
+ * Preconditions:
+ *      preCompute() must have been called before this, and
+ *      prepareFrames() before x and base were obtained.
+ *
+ * Postconditions:
+ *      nil
+ *
+ * Side Effects:
+ *      nil, other than possible FPEs if the values are garbage
+ *
+ * Results:
+ *      Returns the probability.
+ *
+ *-----------------------------------------------------------------------
+ */
+
+logpr
+LinMeanCondDiagGaussian::log_p_frame(const unsigned frameIndex,
+				     const float *const x,
+				     const Data32* const base,
+				     const int stride)
+{
+  const float *regp = dLinkMat->regressionAtFrame(frameIndex);
+  if (regp == NULL)
+    return log_p(x,base,stride);
+  assert ( basicAllocatedBitIsSet() );
+
+  const float *xp = x;
+  const float *const x_endp = x + _dim;
+  const float *mean_p = mean->basePtr();
+  const float *var_inv_p = covar->baseVarInvPtr();
+  DIAG_GAUSSIAN_TMP_ACCUMULATOR_TYPE d=0.0;
+  do {
+    float u = *regp;
+    u += *mean_p;
+
+    const DIAG_GAUSSIAN_TMP_ACCUMULATOR_TYPE tmp
+      = (*xp - u);
+
+    d += tmp*tmp*(*var_inv_p);
+
+    xp++;
+    regp++;
+    mean_p++;
+    var_inv_p++;
+  } while (xp != x_endp);
+  d *= -0.5;
+  return logpr(0,(covar->log_inv_normConst() + d));
+}
+
+
+
 /////////////////
 // EM routines //
 /////////////////
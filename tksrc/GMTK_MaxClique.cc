@@ -401,6 +401,24 @@ double
 MaxClique::cliqueBeamUniformSampleAmount = 0.0;
 
 
+/*
+ * If > 0, the k, mass, and beam clique pruning is done together from a
+ * histogram of the clique scores with this many bins, rather than by
+ * the separate (quickselect, sort, and scan) pruning routines.
+ */
+unsigned
+MaxClique::cliqueHistogramPruneBins = 0;
+
+
+/*
+ * With -emPruneMask, entries of a clique that did not survive pruning
+ * in the previous EM iteration are still inserted if they are within
+ * this (log) beam of the best entry found so far.
+ */
+double
+MaxClique::cliquePruneMaskBeam = 2.0;
+
+
 /*
  *
  * separator beam width, for separator-based beam pruning.  Default value is
@@ -439,6 +457,206 @@ psp(FILE*f,const int numSpaceChars,const char c = ' ')
 
 
 
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+//        CliqueValueMask support
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+
+CliqueValueMask::CliqueValueMask(const unsigned arg_packedLen,
+				 const unsigned maxNumValues,
+				 const unsigned arg_numDepths)
+  : packedLen(arg_packedLen),
+    numValues(0),
+    valueSet(arg_packedLen,maxNumValues),
+    numDepths(arg_numDepths)
+{
+  // at least one, so that the storage is never empty.
+  values.resize(packedLen*(maxNumValues > 0 ? maxNumValues : 1));
+  prefixSets.resize(numDepths > 0 ? numDepths : 1);
+  for (unsigned d=0;d<(unsigned)prefixSets.size();d++)
+    prefixSets.ptr[d] = NULL;
+  scratch.resize(packedLen);
+}
+
+
+CliqueValueMask::~CliqueValueMask()
+{
+  for (unsigned d=0;d<numDepths;d++) {
+    if (prefixSets.ptr[d] != &valueSet)
+      delete prefixSets.ptr[d];
+  }
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * CliqueValueMask::add()
+ *    Adds a copy of a packed clique value to the mask.
+ *
+ * Preconditions:
+ *      Fewer than the maxNumValues given to the constructor have been
+ *      added, and the value has not been added before.
+ *
+ * Postconditions:
+ *      contains() is true for the value.
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *      None
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+CliqueValueMask::add(const unsigned* packedValue)
+{
+  assert ((numValues+1)*packedLen <= (unsigned)values.size());
+  unsigned *const key = values.ptr + numValues*packedLen;
+  for (unsigned i=0;i<packedLen;i++)
+    key[i] = packedValue[i];
+  valueSet.insertUnique(key);
+  numValues++;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * CliqueValueMask::makePrefixSets()
+ *    Makes, for each depth to be checked, the set of the added
+ *    values masked to the bits fixed at that depth.
+ *
+ * Preconditions:
+ *      All values have been added. bits has numDepths+1 packed
+ *      values, the last of which has the bits of all the values, and
+ *      checkDepth has numDepths entries.
+ *
+ * Postconditions:
+ *      checksPrefix(d) is true exactly for the depths d for which
+ *      checkDepth[d] is true.
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *      None
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+CliqueValueMask::makePrefixSets(const unsigned* bits,const bool* checkDepth)
+{
+  prefixBits.resize(packedLen*(numDepths > 0 ? numDepths : 1));
+  for (unsigned i=0;i<packedLen*numDepths;i++)
+    prefixBits.ptr[i] = bits[i];
+
+  // First count the distinct masked values of each depth, so that
+  // the keys can be stored without moving once the sets point at
+  // them.
+  vector< unsigned > numDistinct(numDepths,0);
+  unsigned totalDistinct = 0;
+  sArray< unsigned > masked(packedLen*(numValues+1));
+  for (unsigned d=0;d<numDepths;d++) {
+    if (!checkDepth[d])
+      continue;
+    const unsigned *const dbits = prefixBits.ptr + d*packedLen;
+    const unsigned *const allBits = bits + numDepths*packedLen;
+    bool allFixed = true;
+    for (unsigned i=0;i<packedLen && allFixed;i++)
+      allFixed = (dbits[i] == allBits[i]);
+    if (allFixed) {
+      // the whole value is fixed, so the prefix is the value.
+      prefixSets.ptr[d] = &valueSet;
+      continue;
+    }
+    vhash_set< unsigned > seen(packedLen,numValues);
+    unsigned n = 0;
+    for (unsigned v=0;v<numValues;v++) {
+      unsigned *const key = masked.ptr + n*packedLen;
+      for (unsigned i=0;i<packedLen;i++)
+	key[i] = values.ptr[v*packedLen+i] & dbits[i];
+      bool foundp;
+      seen.insert(key,foundp);
+      if (!foundp)
+	n++;
+    }
+    numDistinct[d] = n;
+    totalDistinct += n;
+  }
+
+  // then store them. The slot after the last key is written (and not
+  // claimed) by values that are already in the set.
+  prefixValues.resize(packedLen*(totalDistinct+1));
+  unsigned n = 0;
+  for (unsigned d=0;d<numDepths;d++) {
+    if (!checkDepth[d] || prefixSets.ptr[d] != NULL)
+      continue;
+    const unsigned *const dbits = prefixBits.ptr + d*packedLen;
+    prefixSets.ptr[d] = new vhash_set< unsigned >(packedLen,numDistinct[d]);
+    for (unsigned v=0;v<numValues;v++) {
+      unsigned *const key = prefixValues.ptr + n*packedLen;
+      for (unsigned i=0;i<packedLen;i++)
+	key[i] = values.ptr[v*packedLen+i] & dbits[i];
+      bool foundp;
+      prefixSets.ptr[d]->insert(key,foundp);
+      if (!foundp)
+	n++;
+    }
+  }
+  assert (n == totalDistinct);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * CliqueValueMask::containsPrefix()
+ *    Checks the value in scratchValue() against the prefix set of a
+ *    depth.
+ *
+ * Preconditions:
+ *      checksPrefix(depth) is true, and the clique's current values
+ *      have been packed into scratchValue().
+ *
+ * Postconditions:
+ *      scratchValue() holds the value masked to the depth's bits.
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *      true if some added value has the same values in the bits
+ *      fixed at the depth.
+ *
+ *-----------------------------------------------------------------------
+ */
+bool
+CliqueValueMask::containsPrefix(const unsigned depth)
+{
+  const unsigned *const dbits = prefixBits.ptr + depth*packedLen;
+  for (unsigned i=0;i<packedLen;i++)
+    scratch.ptr[i] &= dbits[i];
+  return prefixSets.ptr[depth]->find(scratch.ptr);
+}
+
+
+unsigned long
+CliqueValueMask::memoryUsage()
+{
+  unsigned long bytes = sizeof(unsigned)*((unsigned long)values.size()
+					  + prefixBits.size()
+					  + prefixValues.size()
+					  + scratch.size())
+    + valueSet.bytesRequested();
+  for (unsigned d=0;d<numDepths;d++) {
+    if (prefixSets.ptr[d] != NULL && prefixSets.ptr[d] != &valueSet)
+      bytes += prefixSets.ptr[d]->bytesRequested();
+  }
+  return bytes;
+}
+
+
 ////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////
 //        MaxClique support
@@ -473,7 +691,8 @@ MaxClique::MaxClique(MaxClique& from_clique,
 		     map < RVInfo::rvParent, unsigned >& ppf,
 		     const unsigned int frameDelta)
 
-  :  cliqueValueSpaceManager(1,     // starting size
+  :  cePruneMask(NULL),
+     cliqueValueSpaceManager(1,     // starting size
 			     spaceMgrGrowthRate,   // growth rate
 			     1,     // growth addition
 			     spaceMgrDecayRate)    // decay rate 
@@ -2152,7 +2371,9 @@ void MaxCliqueTable::init(MaxClique& origin)
   // TODO: optimize this and make depend on if clique is all hidden, has observed, etc.
   // NOTE: This must be set to something greater than 0.
   // cliqueValues.resize(3); // 10000
-  cliqueValues.resize(origin.cliqueValueSpaceManager.currentSize());
+  // (a table being re-used that already has this size keeps its storage)
+  if (cliqueValues.size() != origin.cliqueValueSpaceManager.currentSize())
+    cliqueValues.resize(origin.cliqueValueSpaceManager.currentSize());
 
 }
 
@@ -3214,6 +3435,14 @@ MaxCliqueTable::ceIterateAssignedNodesRecurse(MaxCliqueTable::SharedLocalStructu
   if (p*origin.sortedAssignedContinuationScores[nodeNumber] <= cliqueBeamThresholdEstimate)
     return;
 
+  // With a prune mask, skip the whole subtree if no entry that
+  // survived pruning in the previous EM iteration starts with the
+  // values fixed so far.
+  if (origin.cePruneMask != NULL
+      && nodeNumber < sharedStructure.fSortedAssignedNodes.size()
+      && cePruneMaskExcludesPrefix(sharedStructure,nodeNumber,maxCEValue,p))
+    return;
+
   // No pruning, so we go ahead with the continued expansion.
 
   if (nodeNumber == sharedStructure.fSortedAssignedNodes.size()) {
@@ -3240,11 +3469,18 @@ MaxCliqueTable::ceIterateAssignedNodesRecurse(MaxCliqueTable::SharedLocalStructu
     // be different for differnet cliques). Answer: We can do this
     // check once at beginning of iteration of assigned nodes, and
     // have two versions of this code.
+    // With a prune mask from the previous EM iteration, entries that
+    // did not survive pruning then (unless they score close to the
+    // best entry so far) are left out right after they are packed.
     if (origin.packer.packedLen() <= IMC_NWWOH) {
       // pack the clique values directly into place
       origin.packer.pack(
 			 (unsigned**)sharedStructure.discreteValuePtrs.ptr,
 			 (unsigned*)&(cliqueValues.ptr[numCliqueValuesUsed].val[0]));
+      if (origin.cePruneMask != NULL &&
+	  cePruneMaskExcludes(origin,maxCEValue,p,
+			      (unsigned*)&(cliqueValues.ptr[numCliqueValuesUsed].val[0])))
+	return;
     } else {
 
 #ifdef USE_TEMPORARY_LOCAL_CLIQUE_VALUE_POOL      
@@ -3258,6 +3494,8 @@ MaxCliqueTable::ceIterateAssignedNodesRecurse(MaxCliqueTable::SharedLocalStructu
       unsigned *pcv = 
 	&origin.temporaryCliqueValuePool.ptr[lindex];
       origin.packer.pack((unsigned**)sharedStructure.discreteValuePtrs.ptr,(unsigned*)pcv);
+      if (origin.cePruneMask != NULL && cePruneMaskExcludes(origin,maxCEValue,p,pcv))
+	return;
       // store integer value of the location.
       cliqueValues.ptr[numCliqueValuesUsed].ival = lindex;
 #else
@@ -3268,6 +3506,9 @@ MaxCliqueTable::ceIterateAssignedNodesRecurse(MaxCliqueTable::SharedLocalStructu
       unsigned *pcv = origin.valueHolder.curCliqueValuePtr();
       // Next, pack the clique values into this position.
       origin.packer.pack((unsigned**)sharedStructure.discreteValuePtrs.ptr,(unsigned*)pcv);
+      // so that an entry left out does not claim shared storage.
+      if (origin.cePruneMask != NULL && cePruneMaskExcludes(origin,maxCEValue,p,pcv))
+	return;
       // Look it up in the hash table.
       bool foundp;
       unsigned *key;
@@ -4546,6 +4787,270 @@ MaxCliqueTable::ceCliqueBeamPrune(MaxClique& origin,
 
 
 
+// Log width of the ceCliqueHistogramPrune() histogram when there is
+// no clique beam to give it one. Entries further than this below the
+// maximum have at most exp(-50) of its weight.
+static const double histPruneDefaultWidth = 50.0;
+
+// Histogram bin of the log score v for ceCliqueHistogramPrune(). Bin
+// 0 holds the highest scores, bins 0 to numBins-1 evenly split
+// [hi-width,hi], and bin numBins holds everything below hi-width.
+static inline unsigned
+histPruneBin(const double v,const double hi,const double lo,
+	     const double scale,const unsigned numBins)
+{
+  if (v < lo)
+    return numBins;
+  if (v >= hi)
+    return 0;
+  const unsigned b = (unsigned)((hi - v)*scale);
+  return (b < numBins ? b : numBins-1);
+}
+
+// Put the highest num log scores of the clique values falling in bin
+// b into scores, sorted descending if sorted is set and otherwise in
+// no particular order. Only the num wanted are ever sorted, so taking
+// a few from the bottom bin does not sort it whole.
+template <class CV>
+static void
+histPruneBinTop(CV* cv,const unsigned n,
+		const double hi,const double lo,
+		const double scale,const unsigned numBins,
+		const unsigned b,const unsigned num,const bool sorted,
+		vector<double>& scores)
+{
+  scores.clear();
+  for (unsigned i=0;i<n;i++) {
+    const double v = cv[i].p.valref();
+    if (histPruneBin(v,hi,lo,scale,numBins) == b)
+      scores.push_back(v);
+  }
+  if (num < scores.size()) {
+    nth_element(scores.begin(),scores.begin()+num,scores.end(),greater<double>());
+    scores.resize(num);
+  }
+  if (sorted)
+    sort(scores.begin(),scores.end(),greater<double>());
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * MaxCliqueTable::ceCliqueHistogramPrune()
+ *
+ *    Collect Evidence, Clique Prune: does the k-state, mass, and beam
+ *    pruning of ceDoAllPruning() (ceCliqueStatePrune(),
+ *    ceCliqueMassPrune(), and ceCliqueBeamPrune(), in that order) in
+ *    O(N) rather than with a quickselect, a full sort, and a scan.
+ *
+ *    Each of the three keeps a top-scoring part of what the previous
+ *    one kept, so together they keep the top m entries for some m. m
+ *    is found from a histogram of the log scores holding the count
+ *    and exponentiated mass of each bin. Its cliqueHistogramPruneBins
+ *    bins span the clique beam (or histPruneDefaultWidth without one)
+ *    below maxCEValue, and one more bottom bin holds everything below
+ *    that, such as zero-probability entries. The rank-k and mass
+ *    cut-offs then only need the entries of the bin they fall in to
+ *    be ranked. The bottom bin is never ranked when there is a beam,
+ *    since the beam removes it whole. The table is then compacted
+ *    once.
+ *
+ *    The result is the same as the separate routines up to ties and
+ *    the order in which the mass is summed.
+ *
+ * Preconditions:
+ *   same as ceCliqueBeamPrune(), and k is the state pruning size
+ *   computed by ceDoAllPruning().
+ *
+ * Postconditions:
+ *    Clique table has been pruned, and memory for it has NOT been
+ *    re-allocated to fit the smaller size. The pruned entries are
+ *    left after the first numCliqueValuesUsed entries.
+ *
+ * Side Effects:
+ *    changes the clique size
+ *
+ * Results:
+ *     nothing
+ *
+ *-----------------------------------------------------------------------
+ */
+
+void 
+MaxCliqueTable::ceCliqueHistogramPrune(MaxClique& origin,
+				       logpr maxCEValue,
+				       const unsigned k)
+{
+  const unsigned n = numCliqueValuesUsed;
+  if (n == 0)
+    return;
+  CliqueValue *const cv = cliqueValues.ptr;
+
+  const double removeFraction = 1.0 - origin.cliqueBeamMassRetainFraction;
+  const double exponentiate = origin.cliqueBeamMassExponentiate;
+  const unsigned minSize = origin.cliqueBeamMassMinSize;
+  const bool beamPrune = (origin.cliqueBeam != (-LZERO));
+
+  // number of top entries to keep, as the state pruning would.
+  unsigned m = (k > 0 && k < n) ? k : n;
+  const bool massPrune = (removeFraction > 0.0 && m > minSize);
+
+  if (m == n && !massPrune) {
+    // nothing to rank, at most a beam to apply.
+    if (beamPrune)
+      ceCliqueBeamPrune(origin,maxCEValue);
+    return;
+  }
+  if (massPrune && exponentiate < 0) {
+    error("ERROR: trying to do exponentiated mass clique pruning with a negative exponent (%e). Exponent must be non-negative for sensible pruning.\n",exponentiate);
+  }
+
+  // the histogram, with bin numBins below the range.
+  const unsigned numBins = origin.cliqueHistogramPruneBins;
+  const double hi = maxCEValue.valref();
+  const double width = beamPrune ? origin.cliqueBeam : histPruneDefaultWidth;
+  const double lo = hi - width;
+  const double scale = (width > 0.0) ? (double)numBins/width : 0.0;
+  vector<unsigned> binCount(numBins+1,0);
+  for (unsigned i=0;i<n;i++)
+    binCount[histPruneBin(cv[i].p.valref(),hi,lo,scale,numBins)]++;
+
+  // bin holding the m'th highest score, and the number of entries in
+  // higher bins.
+  unsigned mBin = 0, mBefore = 0;
+  while (mBefore + binCount[mBin] < m)
+    mBefore += binCount[mBin++];
+
+  // exponentiated mass of the bins above mBin (the only ones the
+  // mass pruning can need whole).
+  vector<logpr> binMass(massPrune ? mBin : 0);
+  logpr origSum, desiredSum, actualSum;
+  if (massPrune) {
+    for (unsigned i=0;i<n;i++) {
+      const unsigned b = histPruneBin(cv[i].p.valref(),hi,lo,scale,numBins);
+      if (b < mBin)
+	binMass[b] += cv[i].p.pow(exponentiate);
+    }
+    for (unsigned b=0;b<mBin;b++)
+      origSum += binMass[b];
+    vector<double> mScores;
+    histPruneBinTop(cv,n,hi,lo,scale,numBins,mBin,m-mBefore,false,mScores);
+    for (unsigned j=0;j<mScores.size();j++)
+      origSum += logpr((void*)0,mScores[j]).pow(exponentiate);
+  }
+
+  if (massPrune && !origSum.zero()) {
+    desiredSum = (origSum - (origSum*removeFraction));
+    // go down whole bins until the one where the mass is reached,
+    // then down that bin's sorted entries.
+    unsigned b = 0, before = 0;
+    while (b < mBin && !(actualSum + binMass[b] >= desiredSum)) {
+      actualSum += binMass[b];
+      before += binCount[b++];
+    }
+    const unsigned lim = (b == mBin) ? m - mBefore : binCount[b];
+    vector<double> scores;
+    histPruneBinTop(cv,n,hi,lo,scale,numBins,b,lim,true,scores);
+    unsigned massK = m;
+    for (unsigned j=0;j<lim;j++) {
+      actualSum += logpr((void*)0,scores[j]).pow(exponentiate);
+      if (actualSum >= desiredSum) {
+	massK = before + j + 1;
+	break;
+      }
+    }
+
+    if (origin.cliqueBeamMassFurtherBeam != 0.0 && massK < m) {
+      // also keep everything within the further beam of the first
+      // entry not needed for the mass.
+      double nextScore;
+      if (massK < before + lim) {
+	nextScore = scores[massK - before];
+      } else {
+	// the next entry is the best one of a later bin.
+	unsigned b2 = b+1;
+	while (binCount[b2] == 0)
+	  b2++;
+	vector<double> b2Scores;
+	histPruneBinTop(cv,n,hi,lo,scale,numBins,b2,1,true,b2Scores);
+	nextScore = b2Scores[0];
+      }
+      logpr threshold = logpr((void*)0,nextScore)/logpr((void*)0,origin.cliqueBeamMassFurtherBeam);
+      unsigned numAbove = 0;
+      for (unsigned i=0;i<n;i++)
+	if (!(cv[i].p < threshold))
+	  numAbove++;
+      massK = min(m,numAbove);
+    }
+
+    if (massK < minSize)
+      massK = min(minSize,m);
+    infoMsg(IM::Inference, IM::Med,"Clique histogram mass-beam pruning: state space = %d (exp-mass=%e), new state space = %d, desired exp-mass = %e, actual exp-mass = %e\n",
+	    m,origSum.val(),massK,desiredSum.val(),actualSum.val());
+
+    if (massK != m) {
+      m = massK;
+      mBin = 0; mBefore = 0;
+      while (mBefore + binCount[mBin] < m)
+	mBefore += binCount[mBin++];
+    }
+  }
+
+  // keep the top m: the bins above mBin, and of mBin its top
+  // m-mBefore entries, taking only as many entries tied with the m'th
+  // score as needed; and of those only the ones within the beam. mBin
+  // needs no ranking when it is kept whole, or when it is the bottom
+  // bin and the beam removes it anyway.
+  const bool rankMBin = (m - mBefore < binCount[mBin])
+    && !(beamPrune && mBin == numBins);
+  double mScore = 0.0;
+  unsigned numTiesToKeep = 0;
+  if (rankMBin) {
+    vector<double> mScores;
+    histPruneBinTop(cv,n,hi,lo,scale,numBins,mBin,m-mBefore,false,mScores);
+    mScore = *min_element(mScores.begin(),mScores.end());
+    for (unsigned j=0;j<mScores.size();j++)
+      if (mScores[j] == mScore)
+	numTiesToKeep++;
+  }
+  logpr beamThreshold((void*)0);
+  if (beamPrune)
+    beamThreshold.valref() = maxCEValue.valref() - origin.cliqueBeam;
+  else
+    beamThreshold.set_to_zero();
+
+  unsigned numKept = 0;
+  for (unsigned i=0;i<n;i++) {
+    const double v = cv[i].p.valref();
+    const unsigned b = histPruneBin(v,hi,lo,scale,numBins);
+    bool keep = (b <= mBin);
+    if (keep && b == mBin && rankMBin) {
+      keep = (v > mScore);
+      if (!keep && v == mScore && numTiesToKeep > 0) {
+	keep = true;
+	numTiesToKeep--;
+      }
+    }
+    if (keep && cv[i].p < beamThreshold)
+      keep = false;
+    if (keep) {
+      // swap so the pruned entries stay at the end, as in the other
+      // pruning routines.
+      swap(cv[numKept],cv[i]);
+      numKept++;
+    }
+  }
+  numCliqueValuesUsed = numKept;
+
+  infoMsg(IM::Inference, IM::Med,"Clique histogram pruning: k = %d, beam thres = %f. Original clique state space = %d, new clique state space = %d, %2.2f%% reduction\n",
+	  k,
+	  beamThreshold.valref(),
+	  n,
+	  numCliqueValuesUsed,
+	  100*(1.0 - (double)numCliqueValuesUsed/(double)n));
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * MaxCliqueTable::ceDoAllPruning()
@@ -4604,24 +5109,29 @@ MaxCliqueTable::ceDoAllPruning(MaxClique& origin,
   // origin.cliqueBeamRetainFraction,numCliqueValuesUsed,k);
   // printf("starting k pruning with state space %d\n",numCliqueValuesUsed); fflush(stdout);
 
-  if (k < numCliqueValuesUsed) {
-    infoMsg(IM::Inference, IM::Med,"Clique k-beam pruning with k=%d: Original clique state space = %d\n",k,
-	    numCliqueValuesUsed);
-    numCliqueValuesUsed = ceCliqueStatePrune(k,cliqueValues.ptr,numCliqueValuesUsed);
-  }
+  if (origin.cliqueHistogramPruneBins > 0) {
+    // k, mass, and beam pruning from one histogram of the scores.
+    ceCliqueHistogramPrune(origin,maxCEValue,k);
+  } else {
+    if (k < numCliqueValuesUsed) {
+      infoMsg(IM::Inference, IM::Med,"Clique k-beam pruning with k=%d: Original clique state space = %d\n",k,
+	      numCliqueValuesUsed);
+      numCliqueValuesUsed = ceCliqueStatePrune(k,cliqueValues.ptr,numCliqueValuesUsed);
+    }
 
-  // printf("ending k pruning\n"); fflush(stdout);
+    // printf("ending k pruning\n"); fflush(stdout);
 
-  // next do mass pruning.
-  numCliqueValuesUsed = ceCliqueMassPrune(1.0 - origin.cliqueBeamMassRetainFraction,
-					  origin.cliqueBeamMassExponentiate,
-					  origin.cliqueBeamMassFurtherBeam,
-					  origin.cliqueBeamMassMinSize,
-					  cliqueValues.ptr,
-					  numCliqueValuesUsed);
+    // next do mass pruning.
+    numCliqueValuesUsed = ceCliqueMassPrune(1.0 - origin.cliqueBeamMassRetainFraction,
+					    origin.cliqueBeamMassExponentiate,
+					    origin.cliqueBeamMassFurtherBeam,
+					    origin.cliqueBeamMassMinSize,
+					    cliqueValues.ptr,
+					    numCliqueValuesUsed);
 
-  // next, do normal beam pruning.
-  ceCliqueBeamPrune(origin,maxCEValue);
+    // next, do normal beam pruning.
+    ceCliqueBeamPrune(origin,maxCEValue);
+  }
 
   // do diversity pruning.
   // printf("starting diversity pruning with state space %d\n",numCliqueValuesUsed); fflush(stdout);
@@ -5908,6 +6418,200 @@ reportMemoryUsageTo(MaxClique& origin,FILE *f)
 
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * MaxCliqueTable::memoryUsage()
+ *
+ *    The number of bytes allocated for the clique table (not
+ *    counting the origin clique), as reported by reportMemoryUsageTo().
+ *
+ * Preconditions:
+ *      Clique data structures must be created.
+ *
+ * Postconditions:
+ *      none
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *     number of bytes
+ *
+ *-----------------------------------------------------------------------
+ */
+unsigned long
+MaxCliqueTable::
+memoryUsage()
+{
+  return sizeof(CliqueValue)*(unsigned long)cliqueValues.size();
+}
+
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * MaxCliqueTable::cePruneMaskExcludes()
+ *
+ *    Checks a packed clique value against origin's prune mask.
+ *
+ * Preconditions:
+ *      origin.cePruneMask is not NULL, pcv is the packed value of the
+ *      next entry, and maxCEValue (the best score so far) includes p.
+ *
+ * Postconditions:
+ *      none
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *     true if the entry with score p should not be inserted, i.e., it
+ *     is not in the mask and is more than MaxClique::cliquePruneMaskBeam
+ *     below the best entry so far.
+ *
+ *-----------------------------------------------------------------------
+ */
+bool
+MaxCliqueTable::
+cePruneMaskExcludes(MaxClique& origin,const logpr maxCEValue,const logpr p,
+		    unsigned* pcv)
+{
+  if (p.val() >= maxCEValue.val() - MaxClique::cliquePruneMaskBeam)
+    return false;
+  return !origin.cePruneMask->contains(pcv);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * MaxCliqueTable::cePruneMaskExcludesPrefix()
+ *
+ *    Checks the values fixed so far, before the assigned node at
+ *    depth nodeNumber is iterated, against origin's prune mask.
+ *
+ * Preconditions:
+ *      origin.cePruneMask is not NULL, nodeNumber is less than the
+ *      number of sorted assigned nodes, and p is the score so far.
+ *
+ * Postconditions:
+ *      none
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *     true if no entry of the subtree below should be inserted, i.e.,
+ *     the values fixed so far are a prefix of no value in the mask,
+ *     and p times the continuation score of the rest of the assigned
+ *     nodes (the same estimate that the clique beam uses) is more
+ *     than MaxClique::cliquePruneMaskBeam below the best entry so far.
+ *
+ *-----------------------------------------------------------------------
+ */
+bool
+MaxCliqueTable::
+cePruneMaskExcludesPrefix(MaxCliqueTable::SharedLocalStructure& sharedStructure,
+			  const unsigned nodeNumber,
+			  const logpr maxCEValue,const logpr p)
+{
+  MaxClique& origin = *(sharedStructure.origin);
+  CliqueValueMask& mask = *origin.cePruneMask;
+  if (!mask.checksPrefix(nodeNumber))
+    return false;
+  if ((p*origin.sortedAssignedContinuationScores[nodeNumber]).val()
+      >= maxCEValue.val() - MaxClique::cliquePruneMaskBeam)
+    return false;
+  origin.packer.pack((unsigned**)sharedStructure.discreteValuePtrs.ptr,
+		     mask.scratchValue());
+  return !mask.containsPrefix(nodeNumber);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * MaxCliqueTable::makePruneMask()
+ *
+ *    Makes a mask of the packed values of the current clique table
+ *    entries, to restrict the clique in the next EM iteration.
+ *
+ * Preconditions:
+ *      The clique has been collected (and pruned), and its values are
+ *      in the shared pool (i.e., insertLocalCliqueValuesIntoSharedPool()
+ *      has been called).
+ *
+ * Postconditions:
+ *      none
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *     a new mask, owned by the caller, or NULL if the clique has no
+ *     hidden values.
+ *
+ *-----------------------------------------------------------------------
+ */
+CliqueValueMask*
+MaxCliqueTable::
+makePruneMask(MaxClique& origin)
+{
+  // nothing to restrict in an all observed clique.
+  if (origin.hashableNodes.size() == 0)
+    return NULL;
+  const bool imc_nwwoh_p = (origin.packer.packedLen() <= IMC_NWWOH);
+  const unsigned packedLen = origin.packer.packedLen();
+  const unsigned numDepths = origin.sortedAssignedNodes.size();
+  CliqueValueMask* mask = new CliqueValueMask(packedLen,
+					      numCliqueValuesUsed,
+					      numDepths);
+  for (unsigned cvn=0;cvn<numCliqueValuesUsed;cvn++) {
+    if (imc_nwwoh_p)
+      mask->add((unsigned*)&(cliqueValues.ptr[cvn].val[0]));
+    else
+      mask->add(cliqueValues.ptr[cvn].ptr);
+  }
+
+  // The hashable nodes that are fixed before the assigned node at
+  // depth d is iterated are those that are not assigned nodes at
+  // depth d or later. A depth is worth checking when something was
+  // fixed since the previous depth checked (i.e., at depth 0, or
+  // after a hashable assigned node).
+  map< RV*, unsigned > hashableIndex;
+  for (unsigned i=0;i<origin.hashableNodes.size();i++)
+    hashableIndex[origin.hashableNodes[i]] = i;
+  sArray< bool > fixed(origin.hashableNodes.size());
+  fixed.assignAllToValue(true);
+  for (unsigned d=0;d<numDepths;d++) {
+    map< RV*, unsigned >::iterator it = hashableIndex.find(origin.sortedAssignedNodes[d]);
+    if (it != hashableIndex.end())
+      fixed.ptr[it->second] = false;
+  }
+  sArray< unsigned > bits(packedLen*(numDepths+1));
+  sArray< bool > checkDepth(numDepths > 0 ? numDepths : 1);
+  bool anyFixed = false;
+  for (unsigned i=0;i<origin.hashableNodes.size();i++)
+    anyFixed = anyFixed || fixed.ptr[i];
+  for (unsigned d=0;d<numDepths;d++) {
+    bool hashableBefore = false;
+    if (d > 0) {
+      map< RV*, unsigned >::iterator it = hashableIndex.find(origin.sortedAssignedNodes[d-1]);
+      if (it != hashableIndex.end()) {
+	fixed.ptr[it->second] = true;
+	hashableBefore = true;
+      }
+    }
+    checkDepth.ptr[d] = (d == 0) ? anyFixed : hashableBefore;
+    origin.packer.bitsOf(fixed.ptr,bits.ptr + d*packedLen);
+  }
+  fixed.assignAllToValue(true);
+  origin.packer.bitsOf(fixed.ptr,bits.ptr + numDepths*packedLen);
+  mask->makePrefixSets(bits.ptr,checkDepth.ptr);
+
+  return mask;
+}
+
+
+
 
 /*-
  *-----------------------------------------------------------------------
@@ -9394,6 +10098,46 @@ reportMemoryUsageTo(SeparatorClique& origin, FILE *f)
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * ConditionalSeparatorTable::memoryUsage()
+ *
+ *    The number of bytes allocated for the separator table, its
+ *    remainders, and their hash tables (not counting the origin
+ *    separator), as reported by reportMemoryUsageTo(). VE separators
+ *    and separators whose memory has been cleared count as zero.
+ *
+ * Preconditions:
+ *      Clique data structures must be created.
+ *
+ * Postconditions:
+ *      none
+ *
+ * Side Effects:
+ *      None
+ *
+ * Results:
+ *     number of bytes
+ *
+ *-----------------------------------------------------------------------
+ */
+unsigned long
+ConditionalSeparatorTable::
+memoryUsage()
+{
+  if (veSeparator() || separatorValues == NULL)
+    return 0;
+  unsigned long bytes = sizeof(AISeparatorValue)*(unsigned long)separatorValues->size();
+  if (iAccHashMap != NULL)
+    bytes += iAccHashMap->bytesRequested();
+  for (unsigned long i =0; i< numSeparatorValuesUsed; i++) {
+    bytes += sizeof(RemainderValue)*(unsigned long)separatorValues->ptr[i].remValues.size();
+    bytes += separatorValues->ptr[i].iRemHashMap.bytesRequested();
+  }
+  return bytes;
+}
+
+
 
 
 
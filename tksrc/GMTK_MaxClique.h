@@ -184,6 +184,81 @@ public:
 // a special vhash class, for mapping from keys consisting of
 // compressed sets of RV values, to items consisting of array indices.
 typedef vhash_map < unsigned, unsigned > VHashMapUnsignedUnsigned;
+
+
+// The packed values of the entries of a clique table that survived
+// pruning. With -emPruneMask, one of these is kept for each clique of
+// each training segment, and in the next EM iteration the clique only
+// gets entries that are in it (or near the clique's best score, see
+// MaxClique::cliquePruneMaskBeam).
+//
+// The mask also holds, for each depth of the clique's sorted assigned
+// nodes, the values masked to the bits of the nodes that are already
+// fixed at that depth. Clique expansion uses these to skip a subtree
+// whose fixed values are a prefix of no value in the mask.
+class CliqueValueMask {
+
+  // number of unsigneds in a packed value.
+  const unsigned packedLen;
+  // the packed values, one after another.
+  sArray< unsigned > values;
+  // number of values added so far.
+  unsigned numValues;
+  // the set of the packed values (the keys point into 'values').
+  vhash_set< unsigned > valueSet;
+
+  // number of sorted assigned nodes of the clique.
+  const unsigned numDepths;
+  // for each depth, a packed value with ones in the bits of the
+  // values fixed before the node at that depth is iterated.
+  sArray< unsigned > prefixBits;
+  // the distinct masked values of all depths, one after another.
+  sArray< unsigned > prefixValues;
+  // for each depth, the set of the masked values (keys point into
+  // 'prefixValues', or the set is valueSet if every value is fixed),
+  // or NULL if that depth fixes nothing new to check.
+  sArray< vhash_set< unsigned >* > prefixSets;
+  // a value to be checked with containsPrefix().
+  sArray< unsigned > scratch;
+
+  // not copyable
+  CliqueValueMask(const CliqueValueMask&);
+  CliqueValueMask& operator=(const CliqueValueMask&);
+
+public:
+
+  // room for maxNumValues packed values of packedLen unsigneds each,
+  // for a clique with numDepths sorted assigned nodes.
+  CliqueValueMask(const unsigned arg_packedLen,const unsigned maxNumValues,
+		  const unsigned arg_numDepths);
+  ~CliqueValueMask();
+
+  // add a copy of a packed value.
+  void add(const unsigned* packedValue);
+
+  // after all values are added, make the prefix set for each depth
+  // for which checkDepth is true. bits has the bits fixed at each
+  // depth (one packed value per depth), and then the bits of the
+  // whole value.
+  void makePrefixSets(const unsigned* bits,const bool* checkDepth);
+
+  // true if the packed value was added.
+  bool contains(unsigned* packedValue) { return valueSet.find(packedValue); }
+
+  // true if there is a prefix set to check at the depth.
+  bool checksPrefix(const unsigned depth) { return prefixSets.ptr[depth] != NULL; }
+  // where to pack the value passed to containsPrefix().
+  unsigned* scratchValue() { return scratch.ptr; }
+  // true if scratchValue(), masked to the bits fixed at the depth,
+  // is a prefix of an added value. scratchValue() is changed.
+  bool containsPrefix(const unsigned depth);
+
+  unsigned size() const { return numValues; }
+
+  // number of bytes allocated for the values and the sets.
+  unsigned long memoryUsage();
+
+};
 class VHashMapUnsignedUnsignedKeyUpdatable : public VHashMapUnsignedUnsigned {
 public:
   //////////////////////
@@ -321,6 +396,19 @@ class MaxClique : public IM {
   // amount to re-sample from pruned clique. =0.0 to turn off.
   static double cliqueBeamUniformSampleAmount;
 
+  // number of score histogram bins used to do the k, mass, and beam
+  // clique pruning in one go. =0 to run them one after another.
+  static unsigned cliqueHistogramPruneBins;
+
+  // With -emPruneMask, clique entries that are not in cePruneMask are
+  // still inserted if they are within this beam of the best entry
+  // found so far.
+  static double cliquePruneMaskBeam;
+  // If not NULL, only entries in this mask (or within
+  // cliquePruneMaskBeam) are inserted into the clique table being
+  // built. Set by the junction tree around collecting the clique.
+  CliqueValueMask* cePruneMask;
+
 
   // set to true to store all deterministic children that exist in
   // this clique with its parents in the clique sorage. Otherwise, set
@@ -363,7 +451,7 @@ class MaxClique : public IM {
   ///////////////////////////////////////////////////////
 
   // basic constructor with a set of nodes
-  MaxClique(set<RV*> arg) {
+  MaxClique(set<RV*> arg) : cePruneMask(NULL) {
     nodes = arg;
   }
 
@@ -1473,6 +1561,8 @@ public:
 
   // memory reporting
   void reportMemoryUsageTo(SeparatorClique&,FILE *f);
+  // bytes of the separator table counted by reportMemoryUsageTo()
+  unsigned long memoryUsage();
 
 };
 
@@ -1760,8 +1850,10 @@ public:
     // apply factors so far from separators or unassigned nodes.
 
     // if (true || sharedStructure.fSortedAssignedNodes.size() == 0 || message(High)) {
-    if (sharedStructure.fSortedAssignedNodes.size() == 0 || message(Inference,High)) {
-      // let recursive version handle degenerate or message full case
+    if (sharedStructure.fSortedAssignedNodes.size() == 0 || message(Inference,High)
+	|| sharedStructure.origin->cePruneMask != NULL) {
+      // let recursive version handle degenerate or message full case,
+      // and the prune mask checks.
       ceIterateAssignedNodesRecurse(sharedStructure,
 				    cliqueBeamThresholdEstimate,
 				    maxCEValue,
@@ -1807,6 +1899,7 @@ public:
 
   void ceDoAllPruning(MaxClique& origin,logpr maxCEValue);
   void ceCliqueBeamPrune(MaxClique& origin,logpr maxCEValue);
+  void ceCliqueHistogramPrune(MaxClique& origin,logpr maxCEValue,const unsigned k);
   unsigned ceCliqueStatePrune(const unsigned k,
 			      CliqueValue*,
 			      const unsigned);
@@ -1873,6 +1966,20 @@ public:
 
   // memory reporting.
   void reportMemoryUsageTo(MaxClique& origin,FILE *f);
+  // bytes of the clique table counted by reportMemoryUsageTo()
+  unsigned long memoryUsage();
+  // number of clique values currently in the table
+  unsigned numCliqueValues() const { return numCliqueValuesUsed; }
+  // a mask of the packed values of the current clique entries.
+  CliqueValueMask* makePruneMask(MaxClique& origin);
+  // true if the entry packed at pcv is to be left out under origin's mask.
+  bool cePruneMaskExcludes(MaxClique& origin,const logpr maxCEValue,const logpr p,
+			   unsigned* pcv);
+  // true if every entry below assigned node nodeNumber is to be left
+  // out under origin's mask.
+  bool cePruneMaskExcludesPrefix(MaxCliqueTable::SharedLocalStructure& sharedStructure,
+				 const unsigned nodeNumber,
+				 const logpr maxCEValue,const logpr p);
 
 
   // compute the max probability and return its value, and also
@@ -26,6 +26,7 @@
 
 #include <string>
 #include <algorithm>
+#include <typeinfo>
 
 #include "general.h"
 #if HAVE_CONFIG_H
@@ -42,6 +43,7 @@ VCID(HGID)
 
 #include "GMTK_Mixture.h"
 #include "GMTK_GMParms.h"
+#include "GMTK_DlinkMatrix.h"
 #if 0
 #  include "GMTK_ObservationMatrix.h"
 #else
@@ -335,6 +337,13 @@ Mixture::log_p(const unsigned frameIndex,
 	  firstFeatureElement);
   */
 
+  // per-segment precomputation (which may move the observation
+  // window) has to happen before we get pointers into the observations.
+  if (DlinkMatrix::precomputeRegressions) {
+    for (unsigned i=0;i<numComponents;i++)
+      components[i]->prepareFrames();
+  }
+
   // we assume that frameIndex exists since we unroll the graph with respect to
   // the global observation matrix.
   const float *const x = globalObservationMatrix->floatVecAtFrame(frameIndex,firstFeatureElement);
@@ -368,7 +377,7 @@ Mixture::log_p(const unsigned frameIndex,
     // TODO: this stuff is needed only for EM, don't cache components
     // when just doing decoding.
     for (unsigned i=0;i<numComponents;i++) {
-      logpr tmp = dense1DPMF->p(i)* components[i]->log_p(x,base,stride);
+      logpr tmp = dense1DPMF->p(i)* components[i]->log_p_frame(frameIndex,x,base,stride);
       // this stuff is needed only for EM, so don't cache components
       // when just doing decoding.
       if (cacheComponentsInEmTraining) {
@@ -385,7 +394,7 @@ Mixture::log_p(const unsigned frameIndex,
     // don't cache our probabilities.
     logpr rc;
     for (unsigned i=0;i<numComponents;i++) {
-      logpr tmp = dense1DPMF->p(i)* components[i]->log_p(x,base,stride);
+      logpr tmp = dense1DPMF->p(i)* components[i]->log_p_frame(frameIndex,x,base,stride);
       rc += tmp;
     }
     return rc;
@@ -568,9 +577,227 @@ Mixture::emIncrement(logpr prob,
   } 
   accumulatedProbability+= prob;
 
-  const float *const x = globalObservationMatrix->floatVecAtFrame(frameIndex,firstFeatureElement);
-  const Data32* const base = globalObservationMatrix->baseAtFrame(frameIndex);
-  const int stride = globalObservationMatrix->stride();
+  if (!batchEmIncrements) {
+    emIncrementFrame(prob,frameIndex,
+		     globalObservationMatrix->floatVecAtFrame(frameIndex,firstFeatureElement),
+		     globalObservationMatrix->baseAtFrame(frameIndex),
+		     globalObservationMatrix->stride(),
+		     missedIncrementCount);
+    return;
+  }
+
+  // Consecutive increments of a mixture usually come from entries of
+  // the same clique and so are for the same frame; just sum them.
+  if (pendingIncrements.size() > 0
+      && pendingIncrements.back().frameIndex == frameIndex
+      && pendingIncrements.back().firstFeatureElement == firstFeatureElement) {
+    pendingIncrements.back().prob += prob;
+    return;
+  }
+  if (pendingIncrements.size() >= maxPendingIncrements)
+    emFlushIncrements();
+  PendingIncrement pi;
+  pi.frameIndex = frameIndex;
+  pi.firstFeatureElement = firstFeatureElement;
+  pi.prob = prob;
+  pendingIncrements.push_back(pi);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * emFlushIncrements()
+ *      Apply the increments batched up by emIncrement(). The pending
+ *      entries are sorted by frame, entries for the same frame are
+ *      merged, and then the mixture posterior is computed and the
+ *      weights and components are incremented once per distinct frame.
+ * 
+ * Preconditions:
+ *      The observations and component cache of the segment the increments
+ *      came from must still be available (i.e., this must be called before
+ *      the next segment is set up).
+ *
+ * Postconditions:
+ *      No increments are pending.
+ *
+ * Side Effects:
+ *      Changes the EM accumulators of the weights and components.
+ *
+ * Results:
+ *      none.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Mixture::emFlushIncrements()
+{
+  if (pendingIncrements.size() == 0)
+    return;
+  emPrepareFlush(false);
+  emFinishFlush(missedIncrementCount);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * emPrepareFlush()
+ *      First half of emFlushIncrements(): sort and merge the pending
+ *      entries and, if copyFeatures is true, copy each entry's feature
+ *      vector out of the observation matrix so that emFinishFlush()
+ *      doesn't need to access it. This must run in the main thread.
+ * 
+ * Preconditions:
+ *      as for emFlushIncrements(); copyFeatures may only be true if
+ *      emFlushCanRunConcurrently().
+ *
+ * Postconditions:
+ *      pendingIncrements has one entry per distinct frame, in frame order.
+ *
+ * Side Effects:
+ *      none other than the above.
+ *
+ * Results:
+ *      none.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Mixture::emPrepareFlush(const bool copyFeatures)
+{
+  pendingFeatures.clear();
+  if (pendingIncrements.size() == 0)
+    return;
+
+  sort(pendingIncrements.begin(),pendingIncrements.end(),PendingIncrementLess());
+
+  unsigned n = 0;
+  for (unsigned i=1;i<pendingIncrements.size();i++) {
+    if (pendingIncrements[i].frameIndex == pendingIncrements[n].frameIndex
+	&& pendingIncrements[i].firstFeatureElement == pendingIncrements[n].firstFeatureElement) {
+      pendingIncrements[n].prob += pendingIncrements[i].prob;
+    } else {
+      pendingIncrements[++n] = pendingIncrements[i];
+    }
+  }
+  pendingIncrements.resize(n+1);
+
+  if (copyFeatures) {
+    pendingFeatures.resize(pendingIncrements.size()*_dim);
+    for (unsigned i=0;i<pendingIncrements.size();i++) {
+      const float *const x = 
+	globalObservationMatrix->floatVecAtFrame(pendingIncrements[i].frameIndex,
+						 pendingIncrements[i].firstFeatureElement);
+      ::memcpy(&pendingFeatures[i*_dim],x,_dim*sizeof(float));
+    }
+  }
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * emFinishFlush()
+ *      Second half of emFlushIncrements(): increment the weights and
+ *      components for each (merged) pending entry. If emPrepareFlush()
+ *      copied the features, this touches only this mixture, its weights
+ *      and its components, and so may run in a worker thread as long
+ *      as no other thread is flushing a mixture that shares any of those
+ *      objects (see GMParms::emFlushIncrements()). Increments that are
+ *      too small are counted in 'missed' rather than in the global
+ *      missedIncrementCount.
+ * 
+ * Preconditions:
+ *      emPrepareFlush() must have been called.
+ *
+ * Postconditions:
+ *      No increments are pending.
+ *
+ * Side Effects:
+ *      Changes the EM accumulators of the weights and components.
+ *
+ * Results:
+ *      none.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Mixture::emFinishFlush(unsigned long &missed)
+{
+  for (unsigned i=0;i<pendingIncrements.size();i++) {
+    const PendingIncrement &cur = pendingIncrements[i];
+    if (pendingFeatures.size() > 0) {
+      // only Gaussians with no dependencies on other features
+      // get here, so base and stride are not needed.
+      emIncrementFrame(cur.prob,cur.frameIndex,&pendingFeatures[i*_dim],NULL,0,missed);
+    } else {
+      emIncrementFrame(cur.prob,cur.frameIndex,
+		       globalObservationMatrix->floatVecAtFrame(cur.frameIndex,cur.firstFeatureElement),
+		       globalObservationMatrix->baseAtFrame(cur.frameIndex),
+		       globalObservationMatrix->stride(),
+		       missed);
+    }
+  }
+  pendingIncrements.clear();
+  pendingFeatures.clear();
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * emFlushCanRunConcurrently()
+ *      Returns true if emFinishFlush() on copied features can run
+ *      in a worker thread, i.e., if the component posteriors come from
+ *      the component cache and all components are plain diagonal
+ *      Gaussians (whose increments only need the feature vector).
+ *
+ *-----------------------------------------------------------------------
+ */
+bool
+Mixture::emFlushCanRunConcurrently()
+{
+  if (!cacheMixtureProbabilities || !cacheComponentsInEmTraining)
+    return false;
+  for (unsigned i=0;i<numComponents;i++) {
+    if (typeid(*components[i]) != typeid(DiagGaussian))
+      return false;
+  }
+  return true;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * emIncrementSharedObjects()
+ *      Add to 'objs' every object whose EM accumulators emFinishFlush()
+ *      changes and which might be shared with other mixtures (the
+ *      weights, the components, and the Gaussians' means and
+ *      covariances). Two mixtures may only be flushed concurrently
+ *      if they have none of these in common.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+Mixture::emIncrementSharedObjects(vector<void*> &objs)
+{
+  objs.push_back(dense1DPMF);
+  for (unsigned i=0;i<numComponents;i++) {
+    objs.push_back(components[i]);
+    if (typeid(*components[i]) == typeid(DiagGaussian)) {
+      DiagGaussian *dg = (DiagGaussian*)components[i];
+      objs.push_back(dg->getMean());
+      objs.push_back(dg->getCovar());
+    }
+  }
+}
+
+
+void
+Mixture::emIncrementFrame(logpr prob,
+			  const unsigned frameIndex, 
+			  const float *const x,
+			  const Data32* const base,
+			  const int stride,
+			  unsigned long &missed)
+{
 
   /*
   fprintf(stderr,"Calling emIncrement with this = 0x%X, frameindex = %d, and firstFeatureElement = %d, and prob=%f\n",
@@ -614,8 +841,15 @@ Mixture::emIncrement(logpr prob,
   // increment the mixture weights
   dense1DPMF->emIncrement(prob,weightedPostDistribution);
 
-  // and the components themselves.
+  // and the components themselves. The components would skip (and
+  // count) increments that are too small themselves; it is done here
+  // so that the count goes to 'missed'.
   for (unsigned i=0;i<numComponents;i++) {
+    if (weightedPostDistribution[i] < minIncrementProbabilty
+	&& components[i]->emAmTrainingBitIsSet()) {
+      missed++;
+      continue;
+    }
     components[i]->emIncrement(weightedPostDistribution[i],
 			       x,base,stride);
   }
@@ -656,6 +890,9 @@ Mixture::emEndIteration()
   if ( !emOnGoingBitIsSet() )
     return; // done already
 
+  // normally already done at the end of the last segment.
+  emFlushIncrements();
+
   // floor to zero of small.
 
   accumulatedProbability.floor();
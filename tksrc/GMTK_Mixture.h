@@ -75,6 +75,37 @@ class Mixture : public MixtureCommon {
 
   cArray< CompCacheArray > componentCache;
 
+  ///////////////////////////////////////////
+  // For batched EM (see MixtureCommon::batchEmIncrements), the
+  // (frame, posterior) pairs this mixture has been incremented with
+  // since the last emFlushIncrements(). Posteriors for the same frame
+  // are summed so that the component statistics are touched once
+  // per distinct frame rather than once per clique entry.
+  struct PendingIncrement {
+    unsigned frameIndex;
+    unsigned firstFeatureElement;
+    logpr prob;
+  };
+  struct PendingIncrementLess {
+    bool operator()(const PendingIncrement& a,const PendingIncrement& b) const {
+      return (a.frameIndex < b.frameIndex) ||
+	(a.frameIndex == b.frameIndex && a.firstFeatureElement < b.firstFeatureElement);
+    }
+  };
+  vector < PendingIncrement > pendingIncrements;
+  // the features of each pending entry, when copied by emPrepareFlush().
+  vector < float > pendingFeatures;
+  // flush early once this many distinct entries are pending.
+  static const unsigned maxPendingIncrements = 8192;
+
+  // increment the weights and components for one frame.
+  void emIncrementFrame(logpr prob,
+			const unsigned frameIndex,
+			const float *const x,
+			const Data32* const base,
+			const int stride,
+			unsigned long &missed);
+
   ///////////////////////////////////////////
 
   ///////////////////////////////////////////
@@ -157,6 +188,16 @@ public:
   void emIncrement(logpr prob, 
 		   const unsigned frameIndex, 
 		   const unsigned firstFeatureElement);
+  // apply any pending batched increments. Must be called while the
+  // observations of the segment they came from are still available.
+  void emFlushIncrements();
+  // emFlushIncrements() in two halves, so that the second half of
+  // independent mixtures can run in parallel (see GMParms::emFlushIncrements()).
+  bool emHasPendingIncrements() { return pendingIncrements.size() > 0; }
+  bool emFlushCanRunConcurrently();
+  void emIncrementSharedObjects(vector<void*> &objs);
+  void emPrepareFlush(const bool copyFeatures);
+  void emFinishFlush(unsigned long &missed);
   void emEndIteration();
   void emSwapCurAndNew();
 
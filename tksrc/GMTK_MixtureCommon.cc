@@ -66,6 +66,12 @@ MixtureCommon::cacheComponentsInEmTraining = true;
 bool
 MixtureCommon::cacheMixtureProbabilities = true;
 
+bool
+MixtureCommon::batchEmIncrements = false;
+
+unsigned
+MixtureCommon::emIncrementThreads = 1;
+
 void
 MixtureCommon::checkForValidRatioValues() {
   // this next check guarantees that we will never eliminate
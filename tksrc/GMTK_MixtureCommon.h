@@ -128,6 +128,17 @@ public:
   // during EM training.
   static bool cacheComponentsInEmTraining;
 
+  ///////////////////////////////////////////////////////////
+  // set to true if EM increments are to be collected per frame and
+  // applied to the components once per distinct frame (at the end of
+  // each segment) rather than once per clique entry.
+  static bool batchEmIncrements;
+
+  ///////////////////////////////////////////////////////////
+  // number of threads over which the batched increments of
+  // independent mixtures are applied at the end of each segment.
+  static unsigned emIncrementThreads;
+
   //////////////////////////////////////////////////////
   // force splitting of the number of top mixture componets
   // regardless of all else. Zero to turn off.
@@ -149,6 +149,11 @@ void NGramCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parents, ite
     // This is not a "==" so that lower order ngram can use it.
     assert(it.uInternalState <= _numParents);
 
+    if ( _packedLM ) {
+        packedIterBegin(parents, it, drv, p);
+        return;
+    }
+
     ContextHashEntry **ptr;
 
     if ( _numberOfActiveIterators >= _contextEntriesStack.size() * 4 ) {
@@ -191,6 +196,77 @@ void NGramCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parents, ite
 
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * NGramCPT::packedIterBegin
+ *      becomeAwareOfParentValuesAndIterBegin for a packed model.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      The context nodes are kept in the same per iterator buffer
+ *      as the hash table entries.
+ *
+ *-----------------------------------------------------------------------
+ */
+void NGramCPT::packedIterBegin(vector< RV* >& parents, iterator &it, DiscRV*drv, logpr& p) {
+    PackedNGramLM::Node *nodes;
+
+    // a Node is no bigger than a pointer, so a slot always fits
+    if ( _numberOfActiveIterators >= _contextEntriesStack.size() * 4 ) {
+        void *tmpPtr = (void *) malloc(sizeof(ContextHashEntry *) * 4 * _numParents);
+        _contextEntriesStack.push_back(tmpPtr);
+        nodes = (PackedNGramLM::Node *)tmpPtr;
+    } else {
+        nodes = (PackedNGramLM::Node *)(((ContextHashEntry **)_contextEntriesStack[_numberOfActiveIterators / 4]) + (_numberOfActiveIterators % 4) * _numParents);
+    }
+    _numberOfActiveIterators++;
+
+    findPackedContexts(parents, nodes);
+
+    it.drv = drv;
+    it.internalStatePtr = nodes;
+    register DiscRVType value = 0;
+
+    p = probBackingOff(value, nodes, it.uInternalState);
+    while ( p.essentially_zero() ) {
+        value++;
+        assert(value < card());
+        p = probBackingOff(value, nodes, it.uInternalState);
+    }
+    drv->val = value;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * NGramCPT::findPackedContexts
+ *      Find the packed model's context node for the most recent 1, 2,
+ *      ... parents.
+ *
+ * Results:
+ *      nodes[i] is the context of the i+1 most recent parents, or
+ *      NO_NODE.
+ *
+ * Side Effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------
+ */
+void NGramCPT::findPackedContexts(vector< RV* >& parents, PackedNGramLM::Node *nodes) {
+    const unsigned n = parents.size();
+    if ( n == 0 )
+        return;
+    PackedNGramLM::Node node = _packedLM->unigramContext(RV2DRV(parents[n-1])->val);
+    nodes[0] = node;
+    for ( unsigned j = 1; j < n; j++ ) {
+        node = _packedLM->extendContext(j, node, RV2DRV(parents[n-1-j])->val);
+        nodes[j] = node;
+    }
+}
+
+
 /*-
  *-----------------------------------------------------------------------
  * NGramCPT::probGivenParents
@@ -206,6 +282,14 @@ void NGramCPT::becomeAwareOfParentValuesAndIterBegin(vector< RV* >& parents, ite
 logpr NGramCPT::probGivenParents(vector<RV *>& parents, DiscRV* drv) {
     unsigned numExistsParents = parents.size();
     assert(numExistsParents <= _numParents);
+
+    if ( _packedLM ) {
+        PackedNGramLM::Node *nodes = new PackedNGramLM::Node [numExistsParents];
+        findPackedContexts(parents, nodes);
+        logpr prob = probBackingOff(drv->val, nodes, numExistsParents);
+        delete [] nodes;
+        return prob;
+    }
     ContextHashEntry **ptr = new ContextHashEntry* [numExistsParents];
 
     unsigned j = 0;
@@ -303,7 +387,10 @@ bool NGramCPT::next(iterator &it,logpr& p) {
             _numberOfActiveIterators--;
             return false;
         }
-        p = probBackingOff(it.drv->val, (ContextHashEntry**)it.internalStatePtr, it.uInternalState);
+        if ( _packedLM )
+            p = probBackingOff(it.drv->val, (const PackedNGramLM::Node*)it.internalStatePtr, it.uInternalState);
+        else
+            p = probBackingOff(it.drv->val, (ContextHashEntry**)it.internalStatePtr, it.uInternalState);
     } while ( p.essentially_zero() );
 
     return true;
@@ -355,6 +442,8 @@ int NGramCPT::randomSample(DiscRV* drv) {
  *              1 % number of parents (order -1)
  *              10 10 % cardinalities
  *              bigram.lm.idx [ascii] % ARPA lm file or [binary]
+ *          or a packed model file
+ *              bigram.lm.plm [packed]
  *      (3) For standard ARPA file format, please refer to other documents.
  *      (4) The index file is for speed reason because there are two passes
  *          in reading an ARPA file.  Refer writeNGramIndexFile for details.
@@ -417,6 +506,17 @@ void NGramCPT::read(iDataStreamFile &is) {
         _lmIndexFileBin = true;
         iDataStreamFile sis(_lmIndexFile, true);            // binary
         readNGramIndexFile(sis);
+    } else if ( strcmp(vocabName.c_str(), "[packed]") == 0 ) {
+        delete _packedLM;
+        _packedLM = new PackedNGramLM();
+        _packedLM->open(_lmIndexFile);
+        if ( _packedLM->order() < _numParents + 1 )
+            error("ERROR: reading file '%s' line %d, NGramCPT '%s' has %d parents but packed lm file '%s' is only a %d-gram model",
+                  is.fileName(), is.lineNo(), name().c_str(), _numParents, _lmIndexFile, _packedLM->order());
+        if ( _packedLM->card() != card() )
+            error("ERROR: reading file '%s' line %d, NGramCPT '%s' card %d does not equal packed lm file '%s' vocab card %d",
+                  is.fileName(), is.lineNo(), name().c_str(), card(), _lmIndexFile, _packedLM->card());
+        _totalNumberOfParameters = _packedLM->totalNumberParameters();
     } else {
         if ( GM_Parms.vocabsMap.find(vocabName) ==  GM_Parms.vocabsMap.end())
             error("ERROR: reading file '%s' line %d, NGramCPT '%s' specifies Vobab name '%s' that does not exist", is.fileName(), is.lineNo(),_name.c_str(), vocabName.c_str());
@@ -8,7 +8,7 @@
  *
  *  This file contains an implementation for ngrams data type and its
  *  associated backoff data-structure. It supports the ARPA format
- *  N-gram language model format. There are actually three ways to use
+ *  N-gram language model format. There are actually four ways to use
  *  an ARPA language model in GMTK:
  *
  * 1. use lm file with Vocab object
@@ -29,8 +29,16 @@
  *          VOCAB_SIZE VOCAB_SIZE % cards
  *          ./DATA/bigram.arpa.idx [binary] % ARPA lm indexing file
  *
- * The latter two read in much faster, but first require the
- * conversion of the ARPA lm file to the GMTK idx file format.
+ * 4. use packed model file created by gmtkNGramIndex -packed T
+ *          bigram
+ *          1 % number of parents
+ *          VOCAB_SIZE VOCAB_SIZE % cards
+ *          ./DATA/bigram.arpa.plm [packed] % packed lm file
+ *
+ * The latter three read in much faster, but first require the
+ * conversion of the ARPA lm file to the GMTK idx file format. The
+ * packed format is not read at all, but used in place from a
+ * (shared) memory mapping of the file; see GMTK_PackedNGramLM.h.
  *
  *  $Header$
  *
@@ -48,6 +56,7 @@
 #include "GMTK_CPT.h"
 #include "GMTK_Vocab.h"
 #include "GMTK_DiscRV.h"
+#include "GMTK_PackedNGramLM.h"
 #include "fileParser.h"
 #include "hash_mtable.h"
 
@@ -77,7 +86,7 @@ public:
 	 *
 	 *-----------------------------------------------------------------------
 	 */
-	NGramCPT() : CPT(di_NGramCPT), _contextStartBlockSize(0), _probStartBlockSize(0), _totalNumberOfParameters(0), _lmIndexFile(NULL), _lmIndexFileBin(false) {
+	NGramCPT() : CPT(di_NGramCPT), _contextStartBlockSize(0), _probStartBlockSize(0), _totalNumberOfParameters(0), _lmIndexFile(NULL), _lmIndexFileBin(false), _packedLM(NULL) {
 		_numParents = 0;
 		_numberOfActiveIterators = 0;
 	}
@@ -97,6 +106,7 @@ public:
 	 */
 	~NGramCPT() {
 		delete [] _lmIndexFile;
+		delete _packedLM;
 	}
 
 	///////////////////////////////////////////////////////////  
@@ -228,6 +238,18 @@ protected:
 
 	logpr probBackingOff(const int val, ContextHashEntry**ptr, unsigned numOfExistsParents);
 
+	// The packed model versions: find the context node of each
+	// (most recent) prefix of the parents, and the probability given
+	// those contexts.
+	void findPackedContexts(vector< RV* >& parents, PackedNGramLM::Node *nodes);
+	void packedIterBegin(vector< RV* >& parents, iterator &it, DiscRV* drv, logpr& p);
+	inline logpr probBackingOff(const int val, const PackedNGramLM::Node *nodes, unsigned numOfExistsParents) {
+		double lp;
+		if ( ! _packedLM->logProb(val, nodes, numOfExistsParents, lp) )
+			return logpr(0.0);
+		return logpr(NULL, lp);
+	}
+
 	///////////////////////////////////////////////////////////////
 	// context hash M table and probability hash M table
 	HashMTable<ContextHashEntry> _contextTable;
@@ -245,6 +267,10 @@ protected:
 
 	char *_lmIndexFile;				// filename for indexing file.  see writeNGramIndexFile for file format.
 	bool _lmIndexFileBin;			// indexing file is binary
+
+	// the packed model, if one was read, in which case the hash M
+	// tables above are not used
+	PackedNGramLM *_packedLM;
 };
 
 
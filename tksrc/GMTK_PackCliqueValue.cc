@@ -750,6 +750,45 @@ PackCliqueValue::PackCliqueValue(vector<RV*>& nodes)
 
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * PackCliqueValue::bitsOf()
+ *   make a packed bit mask of some of the unpacked values.
+ *
+ * Preconditions:
+ *   which has unPackedLen() entries, packed_vec has packedLen().
+ * 
+ * Postconditions:
+ *   packed_vec has ones in the bits of the values whose entries in
+ *   which are true, and zeros elsewhere.
+ *
+ * Side Effects:
+ *   none
+ *
+ * Results:
+ *   none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+PackCliqueValue::bitsOf(const bool *const which,unsigned *const packed_vec)
+{
+  // pack an all-ones value of the right width for each chosen entry
+  sArray < unsigned > ones(unpackedVectorLength);
+  for (unsigned i=0;i<unpackedVectorLength;i++) {
+    const unsigned loc = valLocators.ptr[i].loc;
+    if (!which[loc])
+      ones.ptr[loc] = 0;
+    else if (valBits.ptr[i] >= sizeof(unsigned)*8)
+      ones.ptr[loc] = ~0u;
+    else
+      ones.ptr[loc] = (1u << valBits.ptr[i]) - 1;
+  }
+  pack(ones.ptr,packed_vec);
+}
+
+
+
 #ifdef MAIN
 
 
@@ -294,6 +294,11 @@ public:
   // TODO: make a query() function that given a packed vector
   // and a position, returns the integer for that position.
 
+  // Sets in packed_vec exactly the bits that hold the unpacked values
+  // whose entries in 'which' are true, so that and-ing a packed value
+  // with packed_vec keeps just those values.
+  void bitsOf(const bool *const which,unsigned *const packed_vec);
+
 
   unsigned hamming_bit_distance(const unsigned *const vec1,
 				const unsigned *const vec2);
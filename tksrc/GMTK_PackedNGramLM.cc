@@ -0,0 +1,754 @@
+/*-
+ * GMTK_PackedNGramLM.cc
+ *
+ * This part of the code has the implementation of class PackedNGramLM
+ * for gmtk.  Please see GMTK_PackedNGramLM.h for more information.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "GMTK_PackedNGramLM.h"
+#include "GMTK_NGramCPT.h"
+#include "fileParser.h"
+#include "error.h"
+
+#define MAX_LINE_LENGTH 1024
+
+/*
+ * A packed model file is
+ *
+ *   PLMHeader
+ *   order x PLMTableHeader      the n-gram probabilities, n = 1..order
+ *   order-1 x PLMTableHeader    the contexts at level L = 1..order-1
+ *
+ * followed by the records and codebooks of the tables, each at an
+ * 8 byte aligned offset given in its table header. The records of a
+ * table are packed into native 64 bit words, with one extra word at
+ * the end so that a field can always be read with two word loads.
+ */
+#define PLM_MAGIC       "GMTKPLM"
+#define PLM_MAGIC_LEN   8
+#define PLM_BYTE_ORDER  0x01020304
+#define PLM_VERSION     1
+
+// unigram probability of a word that is not in the model
+#define PLM_NO_PROB     (-FLT_MAX)
+
+struct PLMHeader {
+	char magic[PLM_MAGIC_LEN];
+	Uint32 byteOrder;
+	Uint32 version;
+	Uint32 order;
+	Uint32 card;
+	Uint32 quantBits;
+	Uint32 totalParameters;
+};
+
+struct PLMTableHeader {
+	uint64_t bitsOffset;
+	uint64_t numRecords;
+	uint64_t codebookOffset;	// 0 if there is no codebook
+	Uint32 codebookSize;
+	Uint32 wordBits;
+	Uint32 valueBits;
+	Uint32 probPtrBits;
+	Uint32 childPtrBits;
+	Uint32 pad;
+};
+
+
+const PackedNGramLM::Node PackedNGramLM::NO_NODE;
+
+
+PackedNGramLM::PackedNGramLM() : _order(0), _card(0), _totalNumberOfParameters(0), _mapBase(NULL), _mapSize(0) {
+}
+
+
+PackedNGramLM::~PackedNGramLM() {
+	release();
+}
+
+
+void PackedNGramLM::release() {
+	if ( _mapBase ) {
+#ifdef HAVE_MMAP
+		if ( _mapSize )
+			munmap(_mapBase, _mapSize);
+		else
+#endif
+			free(_mapBase);
+	}
+	_mapBase = NULL;
+	_mapSize = 0;
+	_probs.clear();
+	_contexts.clear();
+}
+
+
+float PackedNGramLM::Table::value(uint64_t r) const {
+	uint64_t v = get(bits, r * recordBits + wordBits, valueBits);
+	if ( codebook )
+		return codebook[v];
+	Uint32 u = (Uint32)v;
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * PackedNGramLM::Table::find
+ *      Interpolation search for a word in a sorted range of records.
+ *      Word ids within a range are close to uniformly spread, so this
+ *      usually touches only a couple of cache lines; the last few
+ *      records are scanned linearly.
+ *
+ * Results:
+ *      The record in [lo,hi) with word w, or hi if there is none.
+ *
+ * Side Effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------
+ */
+uint64_t PackedNGramLM::Table::find(uint64_t lo, uint64_t hi, unsigned w) const {
+	const uint64_t end = hi;
+	if ( lo >= hi )
+		return end;
+	unsigned wlo = word(lo), whi = word(hi - 1);
+	if ( w < wlo || w > whi )
+		return end;
+	while ( hi - lo > 8 ) {
+		// here wlo == word(lo) <= w <= whi == word(hi-1), and wlo < whi
+		uint64_t pivot = lo + (uint64_t)((double)(w - wlo) / (double)(whi - wlo) * (double)(hi - 1 - lo));
+		unsigned wp = word(pivot);
+		if ( wp < w ) {
+			lo = pivot + 1;
+			wlo = word(lo);
+			if ( w < wlo )
+				return end;
+		} else if ( wp > w ) {
+			hi = pivot;
+			whi = word(hi - 1);
+			if ( w > whi )
+				return end;
+		} else
+			return pivot;
+	}
+	for ( ; lo < hi; ++lo ) {
+		unsigned wl = word(lo);
+		if ( wl == w )
+			return lo;
+		if ( wl > w )
+			break;
+	}
+	return end;
+}
+
+
+PackedNGramLM::Node PackedNGramLM::extendContext(unsigned level, Node n, unsigned w) const {
+	if ( n == NO_NODE || level + 1 >= _order )
+		return NO_NODE;
+	const Table &t = _contexts[level - 1];
+	uint64_t lo = t.childPtr(n), hi = t.childPtr(n + 1);
+	uint64_t r = _contexts[level].find(lo, hi, w);
+	return (r < hi) ? (Node)r : NO_NODE;
+}
+
+
+bool PackedNGramLM::logProb(unsigned w, const Node *nodes, unsigned numNodes, double &lp) const {
+	if ( w >= _card )
+		return false;
+	float p = _probs[0].value(w);
+	if ( p == PLM_NO_PROB )
+		return false;
+	double prob = p;
+
+	for ( unsigned i = 0; (i < numNodes) && (i + 1 < _order) && (nodes[i] != NO_NODE); i++ ) {
+		const Table &c = _contexts[i];
+		const Table &pt = _probs[i + 1];
+		uint64_t lo = c.probPtr(nodes[i]), hi = c.probPtr(nodes[i] + 1);
+		uint64_t r = pt.find(lo, hi, w);
+		if ( r < hi )
+			prob = pt.value(r);
+		else
+			prob += c.value(nodes[i]);
+	}
+
+	lp = prob;
+	return true;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * PackedNGramLM::open
+ *      Map a packed model file.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Any previously opened model is released. Exits with an error
+ *      if the file is not a valid packed model.
+ *
+ *-----------------------------------------------------------------------
+ */
+void PackedNGramLM::open(const char *fileName) {
+	release();
+
+	int fd = ::open(fileName, O_RDONLY);
+	if ( fd < 0 )
+		error("ERROR: can't open packed language model file '%s': %s", fileName, strerror(errno));
+	struct stat st;
+	if ( fstat(fd, &st) != 0 )
+		error("ERROR: can't stat packed language model file '%s': %s", fileName, strerror(errno));
+	size_t fileSize = (size_t)st.st_size;
+	if ( fileSize < sizeof(PLMHeader) )
+		error("ERROR: '%s' is not a packed language model file", fileName);
+
+#ifdef HAVE_MMAP
+	void *mapped = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+	if ( mapped != MAP_FAILED ) {
+		_mapBase = mapped;
+		_mapSize = fileSize;
+	}
+#endif
+	if ( _mapBase == NULL ) {
+		_mapBase = malloc(fileSize);
+		if ( _mapBase == NULL )
+			error("ERROR: out of memory reading packed language model file '%s'", fileName);
+		size_t done = 0;
+		while ( done < fileSize ) {
+			ssize_t n = pread(fd, (char *)_mapBase + done, fileSize - done, done);
+			if ( n <= 0 )
+				error("ERROR: can't read packed language model file '%s': %s", fileName, strerror(errno));
+			done += n;
+		}
+	}
+	close(fd);
+
+	const char *base = (const char *)_mapBase;
+	const PLMHeader *h = (const PLMHeader *)base;
+	if ( memcmp(h->magic, PLM_MAGIC, PLM_MAGIC_LEN) != 0 )
+		error("ERROR: '%s' is not a packed language model file", fileName);
+	if ( h->byteOrder != PLM_BYTE_ORDER )
+		error("ERROR: packed language model file '%s' was written on a machine with a different byte order. Re-run gmtkNGramIndex on this machine", fileName);
+	if ( h->version != PLM_VERSION )
+		error("ERROR: packed language model file '%s' has version %u, expected %u. Re-run gmtkNGramIndex", fileName, h->version, PLM_VERSION);
+	if ( h->order == 0 || fileSize < sizeof(PLMHeader) + (2 * h->order - 1) * sizeof(PLMTableHeader) )
+		error("ERROR: packed language model file '%s' is corrupt", fileName);
+
+	_order = h->order;
+	_card = h->card;
+	_totalNumberOfParameters = h->totalParameters;
+
+	const PLMTableHeader *th = (const PLMTableHeader *)(base + sizeof(PLMHeader));
+	for ( unsigned i = 0; i < 2 * _order - 1; i++ ) {
+		Table t;
+		t.numRecords = th[i].numRecords;
+		t.wordBits = th[i].wordBits;
+		t.valueBits = th[i].valueBits;
+		t.probPtrBits = th[i].probPtrBits;
+		t.childPtrBits = th[i].childPtrBits;
+		t.recordBits = t.wordBits + t.valueBits + t.probPtrBits + t.childPtrBits;
+		uint64_t bitsBytes = ((t.numRecords * t.recordBits + 63) / 64 + 1) * sizeof(uint64_t);
+		if ( t.wordBits > 32 || t.valueBits > 32 || t.probPtrBits > 64 || t.childPtrBits > 64 ||
+		     th[i].bitsOffset % sizeof(uint64_t) != 0 || th[i].bitsOffset + bitsBytes > fileSize ||
+		     th[i].codebookOffset + (uint64_t)th[i].codebookSize * sizeof(float) > fileSize )
+			error("ERROR: packed language model file '%s' is corrupt", fileName);
+		t.bits = (const uint64_t *)(base + th[i].bitsOffset);
+		if ( th[i].codebookOffset )
+			t.codebook = (const float *)(base + th[i].codebookOffset);
+		if ( i < _order )
+			_probs.push_back(t);
+		else
+			_contexts.push_back(t);
+	}
+	if ( _probs[0].numRecords != _card || (_order > 1 && _contexts[0].numRecords != _card + 1) )
+		error("ERROR: packed language model file '%s' is corrupt", fileName);
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Building a packed model
+/////////////////////////////////////////////////////////////////
+
+namespace {
+
+// the n-grams of one order, as read from the ARPA file
+struct ARPAOrder {
+	unsigned n;
+	std::vector<unsigned> words;	// n words per n-gram
+	std::vector<float> probs;
+	std::vector<float> bows;
+	std::vector<bool> hasBow;
+};
+
+// number of bits needed to hold values 0..x
+unsigned bitsFor(uint64_t x) {
+	unsigned b = 0;
+	while ( x ) {
+		++b;
+		x >>= 1;
+	}
+	return b;
+}
+
+// lexicographic comparison of len words
+int compareWords(const unsigned *a, const unsigned *b, unsigned len) {
+	for ( unsigned k = 0; k < len; k++ ) {
+		if ( a[k] != b[k] )
+			return (a[k] < b[k]) ? -1 : 1;
+	}
+	return 0;
+}
+
+// Orders n-grams by their trie key: the context words most recent
+// first, then (if withWord) the predicted word. With withWord false
+// this is the key of the n-gram as a context node.
+struct TrieKeyLess {
+	const ARPAOrder *o;
+	bool withWord;
+	TrieKeyLess(const ARPAOrder *o, bool withWord) : o(o), withWord(withWord) {}
+	bool operator()(unsigned a, unsigned b) const {
+		const unsigned n = o->n;
+		const unsigned *wa = &o->words[(size_t)a * n], *wb = &o->words[(size_t)b * n];
+		if ( withWord ) {
+			for ( int k = (int)n - 2; k >= 0; --k )
+				if ( wa[k] != wb[k] )
+					return wa[k] < wb[k];
+			return wa[n-1] < wb[n-1];
+		}
+		for ( int k = (int)n - 1; k >= 0; --k )
+			if ( wa[k] != wb[k] )
+				return wa[k] < wb[k];
+		return false;
+	}
+};
+
+// the trie key of n-gram e of o (see TrieKeyLess)
+void trieKey(const ARPAOrder &o, unsigned e, bool withWord, unsigned *key) {
+	const unsigned n = o.n;
+	const unsigned *w = &o.words[(size_t)e * n];
+	if ( withWord ) {
+		for ( unsigned k = 0; k + 1 < n; k++ )
+			key[k] = w[n - 2 - k];
+		key[n-1] = w[n-1];
+	} else {
+		for ( unsigned k = 0; k < n; k++ )
+			key[k] = w[n - 1 - k];
+	}
+}
+
+// Equal count binning of the values into at most 2^bits centers.
+void makeCodebook(std::vector<float> values, unsigned bits, std::vector<float> &codebook) {
+	codebook.clear();
+	if ( values.empty() )
+		return;
+	std::sort(values.begin(), values.end());
+	const size_t n = values.size(), K = (size_t)1 << bits;
+	if ( n <= K ) {
+		codebook = values;
+	} else {
+		for ( size_t b = 0; b < K; b++ ) {
+			size_t lo = b * n / K, hi = (b + 1) * n / K;
+			double sum = 0;
+			for ( size_t i = lo; i < hi; i++ )
+				sum += values[i];
+			codebook.push_back((float)(sum / (hi - lo)));
+		}
+	}
+	codebook.erase(std::unique(codebook.begin(), codebook.end()), codebook.end());
+}
+
+// index of the codebook entry nearest to v
+unsigned quantize(const std::vector<float> &codebook, float v) {
+	std::vector<float>::const_iterator it = std::lower_bound(codebook.begin(), codebook.end(), v);
+	if ( it == codebook.end() )
+		return codebook.size() - 1;
+	unsigned i = it - codebook.begin();
+	if ( i > 0 && v - codebook[i-1] < *it - v )
+		--i;
+	return i;
+}
+
+// a table being built
+struct TableBuilder {
+	PLMTableHeader h;
+	std::vector<uint64_t> bits;
+	std::vector<float> codebook;
+
+	TableBuilder() {
+		memset(&h, 0, sizeof(h));
+	}
+
+	void setup(uint64_t numRecords, unsigned wordBits, unsigned valueBits, unsigned probPtrBits, unsigned childPtrBits) {
+		h.numRecords = numRecords;
+		h.wordBits = wordBits;
+		h.valueBits = valueBits;
+		h.probPtrBits = probPtrBits;
+		h.childPtrBits = childPtrBits;
+		bits.assign((numRecords * recordBits() + 63) / 64 + 1, 0);
+	}
+
+	unsigned recordBits() const {
+		return h.wordBits + h.valueBits + h.probPtrBits + h.childPtrBits;
+	}
+
+	void put(uint64_t pos, unsigned width, uint64_t v) {
+		if ( width == 0 )
+			return;
+		size_t i = (size_t)(pos >> 6);
+		unsigned shift = (unsigned)(pos & 63);
+		bits[i] |= v << shift;
+		if ( shift + width > 64 )
+			bits[i+1] |= v >> (64 - shift);
+	}
+
+	// Set the value of record r: an index into the codebook if
+	// there is one, otherwise the bits of the float.
+	void setValue(uint64_t r, float v) {
+		uint64_t pos = r * recordBits() + h.wordBits;
+		if ( codebook.empty() ) {
+			Uint32 u;
+			memcpy(&u, &v, sizeof(u));
+			put(pos, h.valueBits, u);
+		} else
+			put(pos, h.valueBits, quantize(codebook, v));
+	}
+	void setWord(uint64_t r, unsigned w) {
+		put(r * recordBits(), h.wordBits, w);
+	}
+	void setProbPtr(uint64_t r, uint64_t p) {
+		put(r * recordBits() + h.wordBits + h.valueBits, h.probPtrBits, p);
+	}
+	void setChildPtr(uint64_t r, uint64_t p) {
+		put(r * recordBits() + h.wordBits + h.valueBits + h.probPtrBits, h.childPtrBits, p);
+	}
+};
+
+// The value field width for a set of values: raw floats, or the
+// index of a quantization codebook.
+unsigned valueBitsFor(TableBuilder &t, const std::vector<float> &values, unsigned quantBits) {
+	if ( quantBits == 0 )
+		return 32;
+	makeCodebook(values, quantBits, t.codebook);
+	return t.codebook.empty() ? 0 : bitsFor(t.codebook.size() - 1);
+}
+
+// Assign each n-gram (in trie key order) the index of the context
+// node whose key is the first 'level' words of the n-gram's key.
+// The nodes' keys (level words each) are in sorted order.
+void findContexts(const std::vector<unsigned> &nodeKeys, unsigned level,
+		  const std::vector<unsigned> &keys, unsigned stride,
+		  std::vector<Uint32> &context, const char *lmFile) {
+	const size_t numNodes = nodeKeys.size() / level, num = keys.size() / stride;
+	context.resize(num);
+	size_t p = 0;
+	for ( size_t i = 0; i < num; i++ ) {
+		const unsigned *k = &keys[i * stride];
+		while ( p < numNodes && compareWords(&nodeKeys[p * level], k, level) < 0 )
+			++p;
+		if ( p == numNodes || compareWords(&nodeKeys[p * level], k, level) != 0 )
+			error("ERROR: %d-gram in lm file %s whose %d word context has no backoff weight", stride, lmFile, level);
+		context[i] = p;
+	}
+}
+
+// The start of each node's range in a list of items sorted by node
+// (numNodes+1 entries; the last is the end).
+void rangeStarts(const std::vector<Uint32> &node, size_t numNodes, std::vector<uint64_t> &start) {
+	start.assign(numNodes + 1, 0);
+	for ( size_t i = 0; i < node.size(); i++ )
+		start[node[i] + 1]++;
+	for ( size_t i = 1; i <= numNodes; i++ )
+		start[i] += start[i-1];
+}
+
+void writeOrDie(FILE *f, const void *p, size_t n, const char *outFile) {
+	if ( n > 0 && fwrite(p, n, 1, f) != 1 )
+		error("ERROR: can't write packed language model file '%s': %s", outFile, strerror(errno));
+}
+
+} // namespace
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * PackedNGramLM::build
+ *      Read an ARPA model and write it as a packed model file.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      The whole model is held in memory while building.
+ *
+ *-----------------------------------------------------------------------
+ */
+void PackedNGramLM::build(const char *lmFile, const Vocab &vocab, unsigned quantBits, const char *outFile) {
+	if ( quantBits > 24 )
+		error("ERROR: can't quantize a language model to more than 24 bits");
+	const unsigned card = vocab.size();
+	if ( card == 0 )
+		error("ERROR: empty vocabulary for lm file %s", lmFile);
+
+	iDataStreamFile ifs(lmFile, false, false);	// ascii, no cpp
+	char *line = new char [MAX_LINE_LENGTH];
+	char seps[] = " \t\r\n";
+
+	// read the ARPA header
+	do {
+		if ( ! ifs.readLine(line, MAX_LINE_LENGTH) )
+			error("ERROR: expect '\\data\\' in lm file %s", lmFile);
+	} while ( strstr(line, "\\data\\") != line );
+
+	std::vector<unsigned> numNGrams;
+	while ( true ) {
+		if ( ! ifs.readLine(line, MAX_LINE_LENGTH) )
+			error("ERROR: invalid ARPA lm format in %s", lmFile);
+		if ( line[0] == '\\' )
+			break;
+		unsigned index, num;
+		if ( sscanf(line, " ngram %u = %u", &index, &num) == 2 ) {
+			if ( index != numNGrams.size() + 1 )
+				error("ERROR: Wrong ARPA format in %s at '%s'", lmFile, line);
+			numNGrams.push_back(num);
+		}
+	}
+	const unsigned order = numNGrams.size();
+	if ( order == 0 )
+		error("ERROR: no n-grams in lm file %s", lmFile);
+
+	// read the n-grams
+	std::vector<ARPAOrder> ngrams(order + 1);
+	unsigned totalParameters = 0;
+	for ( unsigned n = 1; n <= order; n++ ) {
+		// the "\n-grams:" line has been read
+		if ( (unsigned)atoi(line + 1) != n )
+			error("ERROR: expect '\\%d-grams:' in lm file %s, found '%s'", n, lmFile, line);
+		ARPAOrder &o = ngrams[n];
+		o.n = n;
+		const unsigned num = numNGrams[n-1];
+		o.words.reserve((size_t)num * n);
+		o.probs.reserve(num);
+		o.bows.reserve(num);
+		for ( unsigned j = 0; j < num; ++j ) {
+			char *tok;
+			do {
+				if ( ! ifs.readLine(line, MAX_LINE_LENGTH) )
+					error("ERROR: invalid ARPA lm format in %s", lmFile);
+			} while ( (tok = strtok(line, seps)) == NULL );
+
+			o.probs.push_back((float)(atof(tok) * M_LN10));
+			for ( unsigned k = 0; k < n; k++ ) {
+				if ( (tok = strtok(NULL, seps)) == NULL )
+					error("ERROR: error reading %d-gram %d in lm file %s", n, j, lmFile);
+				unsigned wid = vocab.index(tok);
+				if ( wid >= card || (wid == vocab.unkId() && (0 != strcmp(tok, "<unk>"))) )
+					error("ERROR: unknown word %s in vocabulary in lm file %s", tok, lmFile);
+				o.words.push_back(wid);
+			}
+			// the highest order's backoff weights are never used
+			if ( (tok = strtok(NULL, seps)) != NULL && n < order ) {
+				o.bows.push_back((float)(atof(tok) * M_LN10));
+				o.hasBow.push_back(true);
+				++totalParameters;
+			} else {
+				o.bows.push_back(0);
+				o.hasBow.push_back(false);
+			}
+		}
+		totalParameters += num;
+		if ( n < order ) {
+			do {
+				if ( ! ifs.readLine(line, MAX_LINE_LENGTH) )
+					error("ERROR: invalid ARPA lm format in %s", lmFile);
+			} while ( line[0] != '\\' );
+		}
+	}
+	delete [] line;
+
+	// _probs tables 1..order, then _contexts tables 1..order-1
+	std::vector<TableBuilder> tables(2 * order - 1);
+	TableBuilder *probs = &tables[0] - 1;		// probs[n], n = 1..order
+	TableBuilder *contexts = &tables[order] - 1;	// contexts[L], L = 1..order-1
+
+	// The context nodes at each level, in trie key order: the
+	// n-gram index and trie key of each. Level 1 has a node for
+	// every word.
+	std::vector< std::vector<unsigned> > nodeEntry(order), nodeKeys(order);
+	if ( order > 1 ) {
+		std::vector<unsigned> &k1 = nodeKeys[1];
+		k1.resize(card);
+		for ( unsigned w = 0; w < card; w++ )
+			k1[w] = w;
+	}
+	for ( unsigned L = 2; L < order; L++ ) {
+		const ARPAOrder &o = ngrams[L];
+		std::vector<unsigned> &e = nodeEntry[L];
+		for ( unsigned i = 0; i < o.probs.size(); i++ )
+			if ( o.hasBow[i] )
+				e.push_back(i);
+		std::sort(e.begin(), e.end(), TrieKeyLess(&o, false));
+		nodeKeys[L].resize((size_t)e.size() * L);
+		for ( size_t i = 0; i < e.size(); i++ )
+			trieKey(o, e[i], false, &nodeKeys[L][i * L]);
+	}
+
+	// The n-gram probabilities of each order, in trie key order,
+	// and the context node of each.
+	std::vector< std::vector<unsigned> > probEntry(order + 1);
+	std::vector< std::vector<Uint32> > probContext(order + 1);
+	for ( unsigned n = 2; n <= order; n++ ) {
+		const ARPAOrder &o = ngrams[n];
+		std::vector<unsigned> &e = probEntry[n];
+		e.resize(o.probs.size());
+		for ( unsigned i = 0; i < e.size(); i++ )
+			e[i] = i;
+		std::sort(e.begin(), e.end(), TrieKeyLess(&o, true));
+		std::vector<unsigned> keys((size_t)e.size() * n);
+		for ( size_t i = 0; i < e.size(); i++ )
+			trieKey(o, e[i], true, &keys[i * n]);
+		findContexts(nodeKeys[n-1], n - 1, keys, n, probContext[n], lmFile);
+	}
+
+	// The parent of each context node at levels 2 and above.
+	std::vector< std::vector<Uint32> > nodeParent(order);
+	for ( unsigned L = 2; L < order; L++ )
+		findContexts(nodeKeys[L-1], L - 1, nodeKeys[L], L, nodeParent[L], lmFile);
+
+	const unsigned wordBits = bitsFor(card - 1);
+
+	// unigram probabilities, dense and exact
+	{
+		const ARPAOrder &o = ngrams[1];
+		std::vector<float> uni(card, PLM_NO_PROB);
+		for ( unsigned i = 0; i < o.probs.size(); i++ )
+			uni[o.words[i]] = o.probs[i];
+		probs[1].setup(card, 0, 32, 0, 0);
+		for ( unsigned w = 0; w < card; w++ )
+			probs[1].setValue(w, uni[w]);
+	}
+
+	// higher order probabilities
+	for ( unsigned n = 2; n <= order; n++ ) {
+		const ARPAOrder &o = ngrams[n];
+		const std::vector<unsigned> &e = probEntry[n];
+		std::vector<float> values(e.size());
+		for ( size_t i = 0; i < e.size(); i++ )
+			values[i] = o.probs[e[i]];
+		TableBuilder &t = probs[n];
+		unsigned valueBits = valueBitsFor(t, values, quantBits);
+		t.setup(e.size(), wordBits, valueBits, 0, 0);
+		for ( size_t i = 0; i < e.size(); i++ ) {
+			t.setWord(i, o.words[(size_t)e[i] * n + n - 1]);
+			t.setValue(i, values[i]);
+		}
+	}
+
+	// context nodes
+	for ( unsigned L = 1; L < order; L++ ) {
+		const size_t numNodes = (L == 1) ? card : nodeEntry[L].size();
+		std::vector<uint64_t> probStart, childStart;
+		rangeStarts(probContext[L+1], numNodes, probStart);
+		if ( L + 1 < order )
+			rangeStarts(nodeParent[L+1], numNodes, childStart);
+
+		std::vector<float> bows(numNodes, 0);
+		if ( L == 1 ) {
+			const ARPAOrder &o = ngrams[1];
+			for ( unsigned i = 0; i < o.probs.size(); i++ )
+				if ( o.hasBow[i] )
+					bows[o.words[i]] = o.bows[i];
+		} else {
+			for ( size_t i = 0; i < numNodes; i++ )
+				bows[i] = ngrams[L].bows[nodeEntry[L][i]];
+		}
+
+		TableBuilder &t = contexts[L];
+		unsigned valueBits = (L == 1) ? 32 : valueBitsFor(t, bows, quantBits);
+		t.setup(numNodes + 1, (L == 1) ? 0 : wordBits, valueBits,
+			bitsFor(probStart[numNodes]),
+			(L + 1 < order) ? bitsFor(childStart[numNodes]) : 0);
+		for ( size_t i = 0; i <= numNodes; i++ ) {
+			if ( i < numNodes ) {
+				if ( L > 1 )
+					t.setWord(i, nodeKeys[L][i * L + L - 1]);
+				t.setValue(i, bows[i]);
+			}
+			t.setProbPtr(i, probStart[i]);
+			if ( L + 1 < order )
+				t.setChildPtr(i, childStart[i]);
+		}
+	}
+
+	// lay out the file
+	uint64_t offset = sizeof(PLMHeader) + tables.size() * sizeof(PLMTableHeader);
+	for ( size_t i = 0; i < tables.size(); i++ ) {
+		offset = (offset + 7) & ~(uint64_t)7;
+		tables[i].h.bitsOffset = offset;
+		offset += tables[i].bits.size() * sizeof(uint64_t);
+		if ( ! tables[i].codebook.empty() ) {
+			tables[i].h.codebookOffset = offset;
+			tables[i].h.codebookSize = tables[i].codebook.size();
+			offset += tables[i].codebook.size() * sizeof(float);
+		}
+	}
+
+	PLMHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, PLM_MAGIC, PLM_MAGIC_LEN);
+	h.byteOrder = PLM_BYTE_ORDER;
+	h.version = PLM_VERSION;
+	h.order = order;
+	h.card = card;
+	h.quantBits = quantBits;
+	h.totalParameters = totalParameters;
+
+	FILE *f = fopen(outFile, "wb");
+	if ( f == NULL )
+		error("ERROR: can't open packed language model file '%s' for writing: %s", outFile, strerror(errno));
+	writeOrDie(f, &h, sizeof(h), outFile);
+	for ( size_t i = 0; i < tables.size(); i++ )
+		writeOrDie(f, &tables[i].h, sizeof(PLMTableHeader), outFile);
+	uint64_t pos = sizeof(PLMHeader) + tables.size() * sizeof(PLMTableHeader);
+	const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for ( size_t i = 0; i < tables.size(); i++ ) {
+		writeOrDie(f, zeros, tables[i].h.bitsOffset - pos, outFile);
+		writeOrDie(f, &tables[i].bits[0], tables[i].bits.size() * sizeof(uint64_t), outFile);
+		writeOrDie(f, tables[i].codebook.empty() ? NULL : &tables[i].codebook[0],
+			   tables[i].codebook.size() * sizeof(float), outFile);
+		pos = tables[i].h.bitsOffset + tables[i].bits.size() * sizeof(uint64_t)
+			+ tables[i].codebook.size() * sizeof(float);
+	}
+	if ( fclose(f) != 0 )
+		error("ERROR: can't write packed language model file '%s': %s", outFile, strerror(errno));
+}
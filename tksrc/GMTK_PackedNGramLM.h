@@ -0,0 +1,150 @@
+/*- -*- C++ -*-
+ * GMTK_PackedNGramLM
+ *      A compact, read-only n-gram backoff language model that is
+ *      used in place (mmap()ed) from a file written by gmtkNGramIndex.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ * NGramCPT normally builds hash tables of the whole ARPA model when
+ * it is read, which for large models takes a long time and a lot of
+ * memory in every process using the model. A packed model instead
+ * holds the same backoff trie as sorted arrays of bit-packed records
+ * that are used directly from a read-only mapping of the file, so
+ * loading is (almost) free and the pages are shared by all the
+ * processes using the model.
+ *
+ * The trie is the same one NGramCPT uses: a context (history) node
+ * at level L is an L-gram w1..wL that has a backoff weight, found
+ * from the root by the words wL, wL-1, ..., w1 (most recent first).
+ * For each level there is an array of context nodes, each with its
+ * word w1, its backoff weight, and the start of its children (in the
+ * next level's array) and of its probabilities (in the array of
+ * (L+1)-gram probabilities). Since the nodes of a level are sorted
+ * by (parent, word), and the probabilities by (context, word), the
+ * end of each range is the start of the next node's, and a child or
+ * probability is found by an interpolation search over the words of
+ * a range. Level 1 is dense (indexed by word), as are the unigram
+ * probabilities. Word ids and pointers use as few bits as the
+ * vocabulary and model sizes allow, and the probabilities and
+ * backoff weights of order 2 and above can be quantized to 2^q
+ * values per order (unigrams are always exact).
+ *
+ * The file is written in native byte order and refused on a machine
+ * with another byte order (just re-run gmtkNGramIndex there).
+ *
+ */
+
+#ifndef GMTK_PACKED_NGRAM_LM_H
+#define GMTK_PACKED_NGRAM_LM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "machine-dependent.h"
+#include "GMTK_Vocab.h"
+
+
+class PackedNGramLM {
+
+public:
+
+	// index of a context node within its level
+	typedef Uint32 Node;
+	// no such context in the model
+	static const Node NO_NODE = 0xFFFFFFFF;
+
+	PackedNGramLM();
+	~PackedNGramLM();
+
+	// Read the ARPA model lmFile (using vocab for the word ids)
+	// and write it as a packed model to outFile. Probabilities and
+	// backoff weights of order 2 and above are quantized to
+	// quantBits bits, or stored exactly if quantBits is 0.
+	static void build(const char *lmFile, const Vocab &vocab, unsigned quantBits, const char *outFile);
+
+	// map the packed model in fileName
+	void open(const char *fileName);
+
+	unsigned order() const { return _order; }
+	unsigned card() const { return _card; }
+	unsigned totalNumberParameters() const { return _totalNumberOfParameters; }
+
+	// The context node of the one word history w, or NO_NODE.
+	Node unigramContext(unsigned w) const {
+		return (w < _card) ? (Node)w : NO_NODE;
+	}
+
+	// The context node at level+1 extending context node n (at
+	// level) one word further back with w, or NO_NODE.
+	Node extendContext(unsigned level, Node n, unsigned w) const;
+
+	// Compute the backoff log (base e) probability of word w given
+	// the contexts nodes[0..numNodes-1], where nodes[i] is the
+	// context of the i+1 most recent words (or NO_NODE, after which
+	// the rest are ignored). Returns false if w has zero probability.
+	bool logProb(unsigned w, const Node *nodes, unsigned numNodes, double &lp) const;
+
+protected:
+
+	// An array of fixed size bit-packed records. Fields are, in
+	// order, a word id, a value (probability or backoff weight),
+	// a probability range start, and a child range start; any of
+	// them may have 0 width.
+	struct Table {
+		const uint64_t *bits;
+		uint64_t numRecords;
+		unsigned recordBits;
+		unsigned wordBits, valueBits, probPtrBits, childPtrBits;
+		// values are indices into this, or raw floats if NULL
+		const float *codebook;
+
+		Table() : bits(NULL), numRecords(0), recordBits(0), wordBits(0), valueBits(0), probPtrBits(0), childPtrBits(0), codebook(NULL) {}
+
+		static uint64_t get(const uint64_t *bits, uint64_t pos, unsigned width) {
+			if ( width == 0 )
+				return 0;
+			const uint64_t *w = bits + (pos >> 6);
+			unsigned shift = (unsigned)(pos & 63);
+			uint64_t v = w[0] >> shift;
+			if ( shift + width > 64 )
+				v |= w[1] << (64 - shift);
+			return (width == 64) ? v : (v & (((uint64_t)1 << width) - 1));
+		}
+
+		unsigned word(uint64_t r) const {
+			return (unsigned)get(bits, r * recordBits, wordBits);
+		}
+		float value(uint64_t r) const;
+		uint64_t probPtr(uint64_t r) const {
+			return get(bits, r * recordBits + wordBits + valueBits, probPtrBits);
+		}
+		uint64_t childPtr(uint64_t r) const {
+			return get(bits, r * recordBits + wordBits + valueBits + probPtrBits, childPtrBits);
+		}
+
+		// the record in [lo,hi) with word w, or hi if there is none
+		uint64_t find(uint64_t lo, uint64_t hi, unsigned w) const;
+	};
+
+	unsigned _order;
+	unsigned _card;
+	unsigned _totalNumberOfParameters;
+
+	// _probs[n-1] holds the n-gram probabilities, n = 1.._order,
+	// and _contexts[L-1] the context nodes at level L = 1.._order-1
+	// (each with a final sentinel record holding the range ends).
+	std::vector<Table> _probs;
+	std::vector<Table> _contexts;
+
+	void *_mapBase;
+	size_t _mapSize;		// 0 if _mapBase is malloc()ed
+
+	void release();
+};
+
+
+#endif
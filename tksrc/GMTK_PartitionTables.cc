@@ -166,6 +166,39 @@ PartitionTables::reportMemoryUsageTo(PartitionStructures& ps,FILE *f)
 }
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * PartitionTables::memoryUsage()
+ *   The number of bytes used by the clique and separator tables of
+ *   the partition, the total of what reportMemoryUsageTo() reports
+ *   for the tables.
+ *
+ * Preconditions:
+ *   The partitions must be validly instantiated with clique & separator structures.
+ *
+ * Postconditions:
+ *   none
+ *
+ * Side Effects:
+ *   none
+ *
+ * Results:
+ *   number of bytes
+ *
+ *-----------------------------------------------------------------------
+ */
+unsigned long
+PartitionTables::memoryUsage(PartitionStructures& ps)
+{
+  unsigned long bytes = 0;
+  for (unsigned cliqueNo=0;cliqueNo < ps.maxCliquesSharedStructure.size(); cliqueNo++ )
+    bytes += maxCliques[cliqueNo].memoryUsage();
+  for (unsigned i=0;i<ps.separatorCliquesSharedStructure.size();i++)
+    bytes += separatorCliques[i].memoryUsage();
+  return bytes;
+}
+
+
 
 
 /////////////////////////////////////////////	
@@ -93,6 +93,8 @@ struct PartitionTables {
 
   // memory use reporting
   void reportMemoryUsageTo(PartitionStructures& ps,FILE *f);
+  // bytes used by all the clique and separator tables
+  unsigned long memoryUsage(PartitionStructures& ps);
 
 };
 
@@ -160,7 +160,7 @@ RAND rnd(true);
  *-----------------------------------------------------------------------
  */
 RngDecisionTree::RngDecisionTree(string name, CFunctionMapperType _func,unsigned numFeatures)
-  : indexFile(NULL), dtFile(NULL), firstDT(0), root(NULL)
+  : indexFile(NULL), dtFile(NULL), firstDT(0), archive(NULL), archiveObject(-1), root(NULL)
 {
   setName(name);
   _numFeatures = numFeatures;
@@ -408,10 +408,25 @@ RngDecisionTree::initializeIterableDT(
   // Initialize variables 
   //////////////////////////////////////////////////////////////////////
   dtFileName = fileName;
-  dtFile     = new iDataStreamFile(dtFileName.c_str(), false, false);
   numDTs     = 0;
   dtNum      = -1;
 
+  //////////////////////////////////////////////////////////////////////
+  // The DTs are either pre-parsed in a segment archive, in which case
+  // this DT's object is looked up by its name, or in a text file.
+  //////////////////////////////////////////////////////////////////////
+  if (SegmentArchive::isArchive(dtFileName.c_str())) {
+    archive = SegmentArchive::open(dtFileName.c_str());
+    archiveObject = archive->findObject(SegmentArchive::DecisionTreeObject, name());
+    if (archiveObject < 0) {
+      error("ERROR: segment archive '%s' has no decision trees for DT '%s'",
+	    dtFileName.c_str(), name().c_str());
+    }
+    numDTs = archive->numRecords(archiveObject);
+  } else {
+    dtFile = new iDataStreamFile(dtFileName.c_str(), false, false);
+  }
+
   //////////////////////////////////////////////////////////////////////
   // Read in the first decision tree 
   //////////////////////////////////////////////////////////////////////
@@ -459,6 +474,14 @@ RngDecisionTree::seek(
 	  dt_nmbr, dtFileName.c_str(), numDTs);
   }
 
+  //////////////////////////////////////////////////////////////////////////
+  // Archived DTs are read by number, so there is nothing to seek.
+  //////////////////////////////////////////////////////////////////////////
+  if (archive != NULL) {
+    dtNum = dt_nmbr - 1;
+    return;
+  }
+
   //////////////////////////////////////////////////////////////////////////
   // Open index file if necessary
   //////////////////////////////////////////////////////////////////////////
@@ -2561,6 +2584,55 @@ RngDecisionTree::EquationClass::write(
   os.write("}","RngDecisionTree::EquationClass::write equation");
 }
 
+
+/*-
+ *-----------------------------------------------------------------------
+ * RngDecisionTree::EquationClass::writeArchive
+ *   Save the equation and its parsed commands to a segment archive,
+ *   so that readArchive() need not parse it again.
+ * 
+ * Preconditions:
+ *   Equation must have been parsed
+ *
+ * Postconditions:
+ *   none     
+ *
+ * Side Effects:
+ *   Writes to the archive
+ *
+ * Results:
+ *   none     
+ *-----------------------------------------------------------------------
+ */
+void 
+RngDecisionTree::EquationClass::writeArchive(
+  SegmentArchive::Writer& w
+  )
+{
+  w.writeString(equation);
+  w.writeUnsigned(commands.size());
+  for (unsigned i=0; i<commands.size(); ++i) {
+    w.writeUnsigned(commands[i]);
+  }
+}
+
+
+void 
+RngDecisionTree::EquationClass::readArchive(
+  SegmentArchive::Record& r
+  )
+{
+  r.readString(equation);
+  unsigned numCommands = r.readUnsigned();
+  commands.resize(numCommands);
+  for (unsigned i=0; i<numCommands; ++i) {
+    commands[i] = r.readUnsigned();
+  }
+  // parsing sizes the evaluation stack; an equation can't push more
+  // values than it has commands.
+  stack.growIfNeeded(numCommands);
+}
+
 /*-
  *-----------------------------------------------------------------------
  * beginIterableDT
@@ -2593,10 +2665,12 @@ RngDecisionTree::beginIterableDT()
 
   //////////////////////////////////////////////////////////////////////
   // Rewind file pointer to the beginning of the files and read the 
-  // number decision trees 
+  // number decision trees (an archive already knows the number)
   //////////////////////////////////////////////////////////////////////
-  dtFile->rewind();
-  dtFile->read(numDTs, "num DTs");
+  if (archive == NULL) {
+    dtFile->rewind();
+    dtFile->read(numDTs, "num DTs");
+  }
   dtNum = -1;
 
   //////////////////////////////////////////////////////////////////////
@@ -2650,6 +2724,11 @@ RngDecisionTree::nextIterableDT()
   //////////////////////////////////////////////////////////////////////
   dtNum++;
 
+  if (archive != NULL) {
+    readArchiveRecord(dtNum);
+    return;
+  }
+
   dtFile->read(readDTNum, "DT num");
   if (readDTNum != dtNum) {
     error("ERROR: reading from file '%s', expecting DT number %d but got number %d\n",
@@ -2709,6 +2788,11 @@ RngDecisionTree::writeIndexFile()
 
   assert(iterable()); 
 
+  if (archive != NULL) {
+    error("ERROR: DT '%s' comes from segment archive '%s', which needs no index file",
+	  name().c_str(), dtFileName.c_str());
+  }
+
   //////////////////////////////////////////////////////////////////////////
   // Open index file for writing 
   //////////////////////////////////////////////////////////////////////////
@@ -2879,6 +2963,276 @@ RngDecisionTree::writeRecurse(oDataStreamFile& os,
 
 
 
+/*-
+ *-----------------------------------------------------------------------
+ * writeArchive
+ *   Writes all the DTs of an iterable DT to a segment archive, as
+ *   an object named by this DT with one record per DT.
+ * 
+ * Preconditions:
+ *   The DT must be iterable and come from a text file.
+ *
+ * Postconditions:
+ *   The object is written. 
+ *
+ * Side Effects:
+ *   The last DT of the file is left loaded. If the DT is to be used
+ *   again beginIterableDT must be called. 
+ *
+ * Results:
+ *   none
+ *-----------------------------------------------------------------------
+ */
+void
+RngDecisionTree::writeArchive(SegmentArchive::Writer& w)
+{
+  assert(iterable()); 
+
+  if (archive != NULL) {
+    error("ERROR: DT '%s' already comes from segment archive '%s'",
+	  name().c_str(), dtFileName.c_str());
+  }
+
+  infoMsg(IM::Default,"Writing %s\n", name().c_str());
+  w.beginObject(SegmentArchive::DecisionTreeObject, name());
+
+  unsigned savedFirstDT = firstDT;
+  firstDT = 0;
+  beginIterableDT();
+  for (unsigned i=0; i<numDTs; i++) {
+    if (i > 0) 
+      nextIterableDT();
+    w.beginRecord();
+    w.writeString(curName);
+    w.writeUnsigned(_numFeatures);
+    writeArchiveRecurse(w,root);
+  }
+  firstDT = savedFirstDT;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * writeArchiveRecurse:
+ *      writes a node and its children to a segment archive record. Each
+ *      node is its type followed by what is needed to rebuild it
+ *      without any parsing.
+ * 
+ * Preconditions:
+ *      object should be filled in
+ *
+ * Postconditions:
+ *      none
+ *
+ * Side Effects:
+ *      none
+ *
+ * Results:
+ *      none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+RngDecisionTree::writeArchiveRecurse(SegmentArchive::Writer& w,
+				     RngDecisionTree::Node *n)
+{
+  w.writeUnsigned(n->nodeType);
+  switch (n->nodeType) {
+  case LeafNodeVal:
+    w.writeUnsigned(n->ln_v().value);
+    break;
+
+  case LeafNodeEquation:
+    n->ln_e().equation.writeArchive(w);
+    break;
+
+  case NonLeafNodeArray:
+    w.writeInt(n->nln_a().ftr);
+    w.writeUnsigned(n->nln_a().base);
+    w.writeUnsigned(n->nln_a().children.size());
+    for (unsigned i=0;i<n->nln_a().children.size();i++) 
+      writeArchiveRecurse(w,&(n->nln_a().children[i]));
+    break;
+
+  case NonLeafNodeHash: {
+    NonLeafNodeHashStruct &h = n->nln_h();
+    w.writeInt(h.ftr);
+    w.writeUnsigned(h.children.size());
+    // each of the (children.size()-1) hashed values, with the
+    // index of its child. The last child is the default.
+    shash_map_iter < unsigned, Node* >::iterator it;
+    if (h.nodeMapper.begin(it)) {
+      do {
+	w.writeUnsigned(it.key());
+	w.writeUnsigned((unsigned)((*it) - &(h.children[0])));
+      } while (it.next());
+    }
+    for (unsigned i=0;i<h.children.size();i++) 
+      writeArchiveRecurse(w,&(h.children[i]));
+    break;
+  }
+
+  case NonLeafNodeRngs:
+    w.writeInt(n->nln_r().ftr);
+    w.writeUnsigned(n->nln_r().ordered);
+    w.writeUnsigned(n->nln_r().children.size());
+    for (unsigned i=0;i<n->nln_r().children.size();i++) {
+      w.writeString(n->nln_r().children[i].rng.rangeStr());
+      writeArchiveRecurse(w,&(n->nln_r().children[i].nd));
+    }
+    writeArchiveRecurse(w,n->nln_r().def);
+    break;
+
+  default:
+    error("ERROR: DT '%s' uses a C function, which can't be written to a segment archive",
+	  name().c_str());
+    break;
+  }
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * readArchiveRecord:
+ *      loads DT number dt_nmbr from the segment archive
+ * 
+ * Preconditions:
+ *      DT must come from an archive
+ *
+ * Postconditions:
+ *      The DT is filled in.
+ *
+ * Side Effects:
+ *      The old DT is deleted.
+ *
+ * Results:
+ *      none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+RngDecisionTree::readArchiveRecord(unsigned dt_nmbr)
+{
+  SegmentArchive::Record r = archive->record(archiveObject, dt_nmbr);
+
+  if (root != NULL) {
+    destructorRecurse(root);
+    delete root;
+    root = NULL;
+  }
+
+  r.readString(curName);
+  _numFeatures = r.readUnsigned();
+  root = new Node;
+  readArchiveRecurse(r,*root);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * readArchiveRecurse:
+ *      rebuilds a node written by writeArchiveRecurse.
+ * 
+ * Preconditions:
+ *      node should not be filled in.
+ *
+ * Postconditions:
+ *      node will be filled in.
+ *
+ * Side Effects:
+ *      might kill program if the archive is corrupt.
+ *
+ * Results:
+ *      none
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+RngDecisionTree::readArchiveRecurse(SegmentArchive::Record& r,Node& node)
+{
+  unsigned nodeType = r.readUnsigned();
+  switch (nodeType) {
+  case LeafNodeVal:
+    node.nodeType = LeafNodeVal;
+    new (&node.ln_v()) LeafNodeValStruct();
+    node.ln_v().value = r.readUnsigned();
+    return;
+
+  case LeafNodeEquation:
+    node.nodeType = LeafNodeEquation;
+    new (&node.ln_e()) LeafNodeEquationStruct();
+    node.ln_e().equation.readArchive(r);
+    return;
+
+  case NonLeafNodeArray: {
+    node.nodeType = NonLeafNodeArray;
+    new (&node.nln_a()) NonLeafNodeArrayStruct();
+    node.nln_a().ftr = r.readInt();
+    node.nln_a().base = r.readUnsigned();
+    unsigned numChildren = r.readUnsigned();
+    node.nln_a().children.resize(numChildren);
+    for (unsigned i=0;i<numChildren;i++) 
+      readArchiveRecurse(r,node.nln_a().children[i]);
+    break;
+  }
+
+  case NonLeafNodeHash: {
+    node.nodeType = NonLeafNodeHash;
+    int ftr = r.readInt();
+    unsigned numChildren = r.readUnsigned();
+    if (numChildren < 1)
+      error("ERROR: segment archive '%s' is corrupt", archive->fileName());
+    new (&node.nln_h()) NonLeafNodeHashStruct(numChildren-1);
+    NonLeafNodeHashStruct &h = node.nln_h();
+    h.ftr = ftr;
+    h.children.resize(numChildren);
+    for (unsigned i=0;i<numChildren-1;i++) {
+      unsigned key = r.readUnsigned();
+      unsigned child = r.readUnsigned();
+      if (child >= numChildren-1)
+	error("ERROR: segment archive '%s' is corrupt", archive->fileName());
+      h.nodeMapper.insert(key,&(h.children[child]));
+    }
+    for (unsigned i=0;i<numChildren;i++) 
+      readArchiveRecurse(r,h.children[i]);
+    break;
+  }
+
+  case NonLeafNodeRngs: {
+    node.nodeType = NonLeafNodeRngs;
+    new (&node.nln_r()) NonLeafNodeRngsStruct();
+    node.nln_r().ftr = r.readInt();
+    node.nln_r().ordered = (r.readUnsigned() != 0);
+    unsigned numChildren = r.readUnsigned();
+    node.nln_r().children.resize(numChildren);
+    node.nln_r().def = new Node;
+    string rng;
+    for (unsigned i=0;i<numChildren;i++) {
+      r.readString(rng);
+      new (&node.nln_r().children[i].rng) BP_Range(rng.c_str(),
+						   0,
+						   MAX_BP_RANGE_VALUE);
+      readArchiveRecurse(r,node.nln_r().children[i].nd);
+    }
+    readArchiveRecurse(r,*node.nln_r().def);
+    break;
+  }
+
+  default:
+    error("ERROR: segment archive '%s' is corrupt, unknown DT node type %u",
+	  archive->fileName(), nodeType);
+  }
+
+  // all the non-leaf nodes query a feature
+  int ftr = (node.nodeType == NonLeafNodeArray) ? node.nln_a().ftr :
+    (node.nodeType == NonLeafNodeHash) ? node.nln_h().ftr : node.nln_r().ftr;
+  if (ftr < 0 || ftr >= (int)_numFeatures)
+    error("ERROR: segment archive '%s' is corrupt, DT '%s' feature number (=%d) must be < numFeatures (=%d)",
+	  archive->fileName(), name().c_str(), ftr, _numFeatures);
+}
+
+
+
 //////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////
 //                    Querying the decision tree
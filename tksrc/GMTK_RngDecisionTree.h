@@ -38,9 +38,11 @@
 #include "logp.h"
 #include "sArray.h"
 #include "shash_map.h"
+#include "shash_map_iter.h"
 
 #include "GMTK_DiscRV.h"
 #include "GMTK_CFunctionDeterministicMappings.h"
+#include "GMTK_SegmentArchive.h"
 
 #include <algorithm>
 #include <map>
@@ -125,6 +127,10 @@ protected:
   int              dtNum;      // the current DT number
   string           curName;    // the current DT name
   unsigned         firstDT;    // index of the first decision tree
+  // if the DTs come from a segment archive rather than a text file,
+  // the archive and this DT's object within it.
+  SegmentArchive*  archive;
+  int              archiveObject;
 
   string getSourceString();
 
@@ -187,6 +193,10 @@ protected:
 
     void write(oDataStreamFile& os); 
 
+    // save/restore the parsed equation in a segment archive
+    void writeArchive(SegmentArchive::Writer& w);
+    void readArchive(SegmentArchive::Record& r);
+
 
     // returns true iff name is a key in the function map
     static bool functionNameCollision(string const &name);
@@ -443,7 +453,7 @@ protected:
     sArray < Node > children;
     // hash table from parent int value to pointer to node within children.
     // TODO: the hash member is big, try to use something smaller.
-    shash_map < unsigned, Node* > nodeMapper;
+    shash_map_iter < unsigned, Node* > nodeMapper;
 
     NonLeafNodeHashStruct(unsigned starting_size)
       : nodeMapper(starting_size) {}
@@ -598,6 +608,12 @@ protected:
 		    Node *n,
 		    const int depth); 
 
+  ///////////////////////////////////////////////////////////    
+  // support for segment archives
+  void writeArchiveRecurse(SegmentArchive::Writer& w, Node *n);
+  void readArchiveRecurse(SegmentArchive::Record& r, Node& node);
+  void readArchiveRecord(unsigned dt_nmbr);
+
 
 
   ///////////////////////////////////////////////////////////    
@@ -619,19 +635,19 @@ protected:
 public:
 
   // constructors
-  RngDecisionTree() : indexFile(NULL), dtFile(NULL), firstDT(0), root(NULL) {}; 
+  RngDecisionTree() : indexFile(NULL), dtFile(NULL), firstDT(0), archive(NULL), archiveObject(-1), root(NULL) {}; 
   ~RngDecisionTree();
 
   // Create a "decision tree" for Viterbi printing trigger expressions on the command line
-  RngDecisionTree(string exprString) :  indexFile(NULL), dtFile(NULL), dtFileName(exprString), firstDT(0), root(NULL) {};
+  RngDecisionTree(string exprString) :  indexFile(NULL), dtFile(NULL), dtFileName(exprString), firstDT(0), archive(NULL), archiveObject(-1), root(NULL) {};
 
   // Create a "decision tree" that has a single internal C function.
   RngDecisionTree(string name, CFunctionMapperType _func,unsigned numFeatures);
 
   // return true if this DT changes from one segment to the next. We
-  // know this by if the dtFile is available (if it is, presumably
-  // this DT is iterable).
-  bool iterable() { return (dtFile != NULL); }
+  // know this by if the dtFile or archive is available (if it is,
+  // presumably this DT is iterable).
+  bool iterable() { return (dtFile != NULL || archive != NULL); }
 
   ///////////////////////////////////////////////////////////    
   // read in the basic parameters, assuming file pointer 
@@ -714,6 +730,11 @@ public:
   // write index file for a iterable DT 
   void writeIndexFile();
 
+  ///////////////////////////////////////////////////////////    
+  // write all the DTs of an iterable DT as an object of a
+  // segment archive
+  void writeArchive(SegmentArchive::Writer& w);
+
   ///////////////////////////////////////////////////////////    
   // count the number of parent assignments that satisfy a 
   // observed child. All variables are discrete.
@@ -0,0 +1,360 @@
+/*-
+ * GMTK_SegmentArchive.cc
+ *
+ * This part of the code has the implementation of class SegmentArchive
+ * for gmtk.  Please see GMTK_SegmentArchive.h for more information.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include <map>
+#include <string>
+
+#include "GMTK_SegmentArchive.h"
+#include "error.h"
+
+/*
+ * A segment archive file is
+ *
+ *   GSAHeader
+ *   the records, one after the other
+ *   the index, at GSAHeader::indexOffset, which for each object is
+ *     Uint32 type, Uint32 numRecords, Uint32 nameLength, the name,
+ *     and numRecords+1 uint64_t offsets (the start of each record,
+ *     then the end of the last one)
+ *
+ * All values are in native byte order and nothing is aligned.
+ */
+#define GSA_MAGIC       "GMTKGSA"
+#define GSA_MAGIC_LEN   8
+#define GSA_BYTE_ORDER  0x01020304
+#define GSA_VERSION     1
+
+struct GSAHeader {
+  char magic[GSA_MAGIC_LEN];
+  Uint32 byteOrder;
+  Uint32 version;
+  Uint32 numObjects;
+  Uint32 unused;
+  uint64_t indexOffset;
+};
+
+
+//////////////////////////////////////////////////////////////////////
+//                    SegmentArchive::Record
+//////////////////////////////////////////////////////////////////////
+
+void
+SegmentArchive::Record::get(void *dst, size_t n)
+{
+  memcpy(dst, skip(n), n);
+}
+
+
+const char *
+SegmentArchive::Record::skip(size_t n)
+{
+  if ((size_t)(end - cur) < n)
+    error("ERROR: segment archive '%s' is corrupt, read past the end of a record", fileName);
+  const char *p = cur;
+  cur += n;
+  return p;
+}
+
+
+void
+SegmentArchive::Record::readString(std::string &s)
+{
+  Uint32 len = readUnsigned();
+  s.assign(skip(len), len);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//                    SegmentArchive::Writer
+//////////////////////////////////////////////////////////////////////
+
+/*-
+ *-----------------------------------------------------------------------
+ * SegmentArchive::Writer::Writer
+ *      Start writing an archive to fileName.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Exits with an error if the file can't be created.
+ *
+ *-----------------------------------------------------------------------
+ */
+SegmentArchive::Writer::Writer(const char *fn)
+  : fp(NULL), fileName(fn), pos(0)
+{
+  fp = fopen(fn, "wb");
+  if (fp == NULL)
+    error("ERROR: can't create segment archive '%s': %s", fn, strerror(errno));
+
+  // the header is rewritten with the index offset when closing
+  GSAHeader h;
+  memset(&h, 0, sizeof(h));
+  put(&h, sizeof(h));
+}
+
+
+SegmentArchive::Writer::~Writer()
+{
+  if (fp != NULL)
+    close();
+}
+
+
+void
+SegmentArchive::Writer::put(const void *src, size_t n)
+{
+  if (fwrite(src, 1, n, fp) != n)
+    error("ERROR: can't write segment archive '%s': %s", fileName.c_str(), strerror(errno));
+  pos += n;
+}
+
+
+void
+SegmentArchive::Writer::writeString(const std::string &s)
+{
+  writeUnsigned((Uint32)s.size());
+  put(s.data(), s.size());
+}
+
+
+void
+SegmentArchive::Writer::beginObject(ObjectType type, const std::string &name)
+{
+  endObject();
+  for (unsigned i = 0; i < objects.size(); i++) {
+    if (objects[i].type == (Uint32)type && objects[i].name == name)
+      error("ERROR: segment archive '%s' already has an object named '%s'", fileName.c_str(), name.c_str());
+  }
+  objects.push_back(Object());
+  objects.back().type = type;
+  objects.back().name = name;
+}
+
+
+void
+SegmentArchive::Writer::beginRecord()
+{
+  if (objects.size() == 0)
+    error("ERROR: segment archive '%s': record written before any object", fileName.c_str());
+  objects.back().offsets.push_back(pos);
+}
+
+
+// record the end of the last record of the current object
+void
+SegmentArchive::Writer::endObject()
+{
+  if (objects.size() > 0)
+    objects.back().offsets.push_back(pos);
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * SegmentArchive::Writer::close
+ *      Finish the archive.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      The index and header are written and the file is closed.
+ *
+ *-----------------------------------------------------------------------
+ */
+void
+SegmentArchive::Writer::close()
+{
+  endObject();
+
+  GSAHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, GSA_MAGIC, strlen(GSA_MAGIC));
+  h.byteOrder = GSA_BYTE_ORDER;
+  h.version = GSA_VERSION;
+  h.numObjects = objects.size();
+  h.indexOffset = pos;
+
+  for (unsigned i = 0; i < objects.size(); i++) {
+    Object &o = objects[i];
+    writeUnsigned(o.type);
+    writeUnsigned((Uint32)(o.offsets.size() - 1));
+    writeString(o.name);
+    put(&o.offsets[0], o.offsets.size() * sizeof(uint64_t));
+  }
+
+  if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, fp) != 1 || fclose(fp) != 0)
+    error("ERROR: can't write segment archive '%s': %s", fileName.c_str(), strerror(errno));
+  fp = NULL;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//                    SegmentArchive
+//////////////////////////////////////////////////////////////////////
+
+bool
+SegmentArchive::isArchive(const char *fn)
+{
+  char magic[GSA_MAGIC_LEN];
+  FILE *f = fopen(fn, "rb");
+  if (f == NULL)
+    return false;
+  bool res = (fread(magic, 1, GSA_MAGIC_LEN, f) == GSA_MAGIC_LEN && memcmp(magic, GSA_MAGIC, GSA_MAGIC_LEN) == 0);
+  fclose(f);
+  return res;
+}
+
+
+SegmentArchive*
+SegmentArchive::open(const char *fn)
+{
+  static std::map<std::string, SegmentArchive*> archives;
+  std::map<std::string, SegmentArchive*>::iterator it = archives.find(fn);
+  if (it != archives.end())
+    return it->second;
+  SegmentArchive *a = new SegmentArchive(fn);
+  archives[fn] = a;
+  return a;
+}
+
+
+/*-
+ *-----------------------------------------------------------------------
+ * SegmentArchive::SegmentArchive
+ *      Map an archive file and read its index.
+ *
+ * Results:
+ *      None.
+ *
+ * Side Effects:
+ *      Exits with an error if the file is not a valid archive.
+ *
+ *-----------------------------------------------------------------------
+ */
+SegmentArchive::SegmentArchive(const char *fn)
+  : _fileName(fn), mapBase(NULL), mapSize(0)
+{
+  int fd = ::open(fn, O_RDONLY);
+  if (fd < 0)
+    error("ERROR: can't open segment archive '%s': %s", fn, strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    error("ERROR: can't stat segment archive '%s': %s", fn, strerror(errno));
+  size_t fileSize = (size_t)st.st_size;
+  if (fileSize < sizeof(GSAHeader))
+    error("ERROR: '%s' is not a segment archive", fn);
+
+#ifdef HAVE_MMAP
+  void *mapped = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped != MAP_FAILED) {
+    mapBase = (const char *)mapped;
+    mapSize = fileSize;
+  }
+#endif
+  if (mapBase == NULL) {
+    char *buf = (char *)malloc(fileSize);
+    if (buf == NULL)
+      error("ERROR: out of memory reading segment archive '%s'", fn);
+    size_t done = 0;
+    while (done < fileSize) {
+      ssize_t n = pread(fd, buf + done, fileSize - done, done);
+      if (n <= 0)
+	error("ERROR: can't read segment archive '%s': %s", fn, strerror(errno));
+      done += n;
+    }
+    mapBase = buf;
+  }
+  ::close(fd);
+
+  GSAHeader h;
+  memcpy(&h, mapBase, sizeof(h));
+  if (memcmp(h.magic, GSA_MAGIC, GSA_MAGIC_LEN) != 0)
+    error("ERROR: '%s' is not a segment archive", fn);
+  if (h.byteOrder != GSA_BYTE_ORDER)
+    error("ERROR: segment archive '%s' was written on a machine with a different byte order. Re-run gmtkDTindex on this machine", fn);
+  if (h.version != GSA_VERSION)
+    error("ERROR: segment archive '%s' has version %u, expected %u. Re-run gmtkDTindex", fn, h.version, GSA_VERSION);
+  if (h.indexOffset > fileSize)
+    error("ERROR: segment archive '%s' is corrupt", fn);
+
+  // read the index, checking that all the records are in the file
+  Record index(mapBase + h.indexOffset, mapBase + fileSize, _fileName.c_str());
+  objects.resize(h.numObjects);
+  for (unsigned i = 0; i < h.numObjects; i++) {
+    Object &o = objects[i];
+    o.type = index.readUnsigned();
+    o.numRecords = index.readUnsigned();
+    index.readString(o.name);
+    o.offsets = index.skip(((size_t)o.numRecords + 1) * sizeof(uint64_t));
+    uint64_t prev = sizeof(GSAHeader);
+    for (unsigned r = 0; r <= o.numRecords; r++) {
+      uint64_t off = offset(o, r);
+      if (off < prev || off > h.indexOffset)
+	error("ERROR: segment archive '%s' is corrupt", fn);
+      prev = off;
+    }
+  }
+}
+
+
+SegmentArchive::~SegmentArchive()
+{
+#ifdef HAVE_MMAP
+  if (mapSize > 0) {
+    munmap((void *)mapBase, mapSize);
+    return;
+  }
+#endif
+  free((void *)mapBase);
+}
+
+
+int
+SegmentArchive::findObject(ObjectType type, const std::string &name) const
+{
+  for (unsigned i = 0; i < objects.size(); i++) {
+    if (objects[i].type == (Uint32)type && objects[i].name == name)
+      return (int)i;
+  }
+  return -1;
+}
+
+
+SegmentArchive::Record
+SegmentArchive::record(unsigned object, unsigned recordNo) const
+{
+  const Object &o = objects[object];
+  if (recordNo >= o.numRecords)
+    error("ERROR: segment %u requested from object '%s' of segment archive '%s', which has only %u segments",
+	  recordNo, o.name.c_str(), _fileName.c_str(), o.numRecords);
+  return Record(mapBase + offset(o, recordNo), mapBase + offset(o, recordNo + 1), _fileName.c_str());
+}
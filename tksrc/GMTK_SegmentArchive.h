@@ -0,0 +1,165 @@
+/*- -*- C++ -*-
+ * GMTK_SegmentArchive.h
+ *      An indexed binary archive of the per-segment objects (iterable
+ *      decision trees and lattices) of a model.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ * Iterable decision trees and lattice CPTs change with each segment,
+ * and normally come from text files that are parsed one segment at a
+ * time as the segments advance (decision trees can be seeked with
+ * the index files written by gmtkDTindex, lattices only by reading
+ * up to the segment). A segment archive, written by gmtkDTindex
+ * -segmentArchive, instead holds all the iterable objects of a
+ * master file already parsed, each as one record per segment, with
+ * an index of where each record starts. The archive is mmap()ed, so
+ * going to any segment of any object is just an index lookup, and
+ * loading a segment's object only copies its record into the object
+ * (no parsing of DT text or HTK lattices).
+ *
+ * To use an archive, give its file name in the master file in place
+ * of the DT or lattice list file. Objects are found in the archive
+ * by their name in the master file, e.g.,
+ *
+ *    DT_IN_FILE inline 1
+ *    0 wordTransition segments.gsa
+ *
+ * The file is written in native byte order and refused on a machine
+ * with another byte order (just re-run gmtkDTindex there).
+ *
+ */
+
+#ifndef GMTK_SEGMENT_ARCHIVE_H
+#define GMTK_SEGMENT_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "machine-dependent.h"
+
+
+class SegmentArchive {
+
+public:
+
+  // the kinds of objects in an archive
+  enum ObjectType { DecisionTreeObject = 1, LatticeObject = 2 };
+
+  ///////////////////////////////////////////////////////////
+  // One object's record for one segment, read back field by
+  // field in the order it was written.
+  class Record {
+  public:
+    Record() : cur(NULL), end(NULL), fileName("") {}
+    Record(const char *b, const char *e, const char *fn) : cur(b), end(e), fileName(fn) {}
+
+    Uint32 readUnsigned() { Uint32 v; get(&v, sizeof(v)); return v; }
+    Int32 readInt() { Int32 v; get(&v, sizeof(v)); return v; }
+    float readFloat() { float v; get(&v, sizeof(v)); return v; }
+    double readDouble() { double v; get(&v, sizeof(v)); return v; }
+    void readString(std::string &s);
+
+    // skip n bytes, returning where they start
+    const char *skip(size_t n);
+
+  private:
+    const char *cur;
+    const char *end;
+    const char *fileName;
+
+    void get(void *dst, size_t n);
+  };
+
+  ///////////////////////////////////////////////////////////
+  // Writes an archive: for each object, beginObject() and then
+  // for each of its segments beginRecord() followed by the
+  // record's fields.
+  class Writer {
+  public:
+    Writer(const char *fileName);
+    ~Writer();
+
+    void beginObject(ObjectType type, const std::string &name);
+    void beginRecord();
+
+    void writeUnsigned(Uint32 v) { put(&v, sizeof(v)); }
+    void writeInt(Int32 v) { put(&v, sizeof(v)); }
+    void writeFloat(float v) { put(&v, sizeof(v)); }
+    void writeDouble(double v) { put(&v, sizeof(v)); }
+    void writeString(const std::string &s);
+
+    // write the index and close the file
+    void close();
+
+  private:
+    struct Object {
+      Uint32 type;
+      std::string name;
+      // record start offsets, then the end of the last record
+      std::vector<uint64_t> offsets;
+    };
+
+    FILE *fp;
+    std::string fileName;
+    std::vector<Object> objects;
+    uint64_t pos;
+
+    void put(const void *src, size_t n);
+    void endObject();
+  };
+
+  ///////////////////////////////////////////////////////////
+  // Return the archive in fileName, mapping it the first time
+  // it is asked for. Archives stay mapped until the program
+  // exits, and are shared by all objects using them.
+  static SegmentArchive* open(const char *fileName);
+
+  // return true if fileName starts like a segment archive
+  static bool isArchive(const char *fileName);
+
+  // the index of the object of the given type and name, or -1
+  int findObject(ObjectType type, const std::string &name) const;
+
+  unsigned numRecords(unsigned object) const {
+    return objects[object].numRecords;
+  }
+
+  // the record of the given object for segment recordNo
+  Record record(unsigned object, unsigned recordNo) const;
+
+  const char *fileName() const { return _fileName.c_str(); }
+
+private:
+
+  SegmentArchive(const char *fileName);
+  ~SegmentArchive();
+
+  struct Object {
+    Uint32 type;
+    std::string name;
+    unsigned numRecords;
+    // numRecords+1 (unaligned) uint64_t offsets of the records
+    const char *offsets;
+  };
+
+  std::string _fileName;
+  std::vector<Object> objects;
+
+  const char *mapBase;
+  size_t mapSize;
+
+  static uint64_t offset(const Object &o, unsigned r) {
+    uint64_t off;
+    memcpy(&off, o.offsets + r * sizeof(uint64_t), sizeof(off));
+    return off;
+  }
+};
+
+
+#endif
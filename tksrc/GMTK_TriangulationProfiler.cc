@@ -0,0 +1,405 @@
+/*
+ * GMTK_TriangulationProfiler.cc
+ *   Rank triangulations by measured (rather than estimated) inference cost.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <float.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if HAVE_WORKING_FORK
+#include <sys/wait.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "debug.h"
+#include "error.h"
+#include "general.h"
+#include "range.h"
+
+#include "GMTK_TriangulationProfiler.h"
+#include "GMTK_GMParms.h"
+#include "GMTK_JunctionTree.h"
+#include "GMTK_MaxClique.h"
+
+#if HAVE_HG_H
+#include "hgstamp.h"
+#endif
+VCID(HGID)
+
+
+// first line of a profile cache file
+#define PROFILE_CACHE_MAGIC "GMTK_TRI_PROFILE 2"
+
+// CPU seconds to allow a measurement beyond the requested time before
+// it is killed
+#define PROFILE_RLIMIT_SLOP 5
+
+
+TriangulationProfiler::TriangulationProfiler(FileSource* fs,
+					     const char* devRange,
+					     unsigned seconds,
+					     const char* vpap,
+					     const char* vcap,
+					     const string& context,
+					     const char* cacheFileName)
+  : fs(fs), devRange(devRange), seconds(seconds), vpap(vpap), vcap(vcap),
+    context(context), cacheFileName(cacheFileName)
+{
+  if (cacheFileName != NULL)
+    readCache();
+}
+
+
+/*
+ * A 64 bit hash of the measurement context and the cliques of each
+ * partition, as a hex string: two 32 bit FNV-1a hashes, one over the
+ * description forwards and one over it backwards. The nodes of a clique and the
+ * cliques of a partition are sorted by name, since set<RV*> order
+ * isn't the same from run to run, so the same triangulation gets the
+ * same key in any run.
+ */
+string
+TriangulationProfiler::triangulationKey(GMTemplate& gm_template)
+{
+  string desc = context + "|" + devRange + "|" + vpap + "|" + vcap;
+  Partition* part[3] = { &gm_template.P, &gm_template.C, &gm_template.E };
+  char buff[64];
+  for (unsigned i=0; i < 3; i++) {
+    vector<string> cliques;
+    for (unsigned c=0; c < part[i]->cliques.size(); c++) {
+      set<RV*>& nodes = part[i]->cliques[c].nodes;
+      vector<string> names;
+      for (set<RV*>::iterator it = nodes.begin(); it != nodes.end(); it++) {
+	sprintf(buff,"(%d)",(*it)->frame());
+	names.push_back((*it)->name() + buff);
+      }
+      sort(names.begin(),names.end());
+      string clique;
+      for (unsigned j=0; j < names.size(); j++)
+	clique += names[j] + " ";
+      cliques.push_back(clique);
+    }
+    sort(cliques.begin(),cliques.end());
+    desc += "|";
+    for (unsigned c=0; c < cliques.size(); c++)
+      desc += "[" + cliques[c] + "]";
+  }
+  unsigned hf = 2166136261u, hb = 2166136261u;
+  for (unsigned i=0; i < desc.size(); i++) {
+    hf = (hf ^ (unsigned char)desc[i]) * 16777619u;
+    hb = (hb ^ (unsigned char)desc[desc.size()-1-i]) * 16777619u;
+  }
+  sprintf(buff,"%08x%08x",hf & 0xFFFFFFFFu,hb & 0xFFFFFFFFu);
+  return string(buff);
+}
+
+
+bool
+TriangulationProfiler::better(const Measurement& a, const Measurement& b)
+{
+  if (a.ok != b.ok)
+    return a.ok;
+  if (!a.ok)
+    return false;
+  if (a.secondsPerPartition != b.secondsPerPartition)
+    return a.secondsPerPartition < b.secondsPerPartition;
+  return a.memoryKB < b.memoryKB;
+}
+
+
+TriangulationProfiler::Measurement
+TriangulationProfiler::measure(GMTemplate& gm_template, bool& cached)
+{
+  const string key = triangulationKey(gm_template);
+  map<string,Measurement>::iterator it = cache.find(key);
+  if (it != cache.end()) {
+    cached = true;
+    return (*it).second;
+  }
+  cached = false;
+  Measurement m;
+  m.ok = run(gm_template,m);
+  cache[key] = m;
+  if (cacheFileName != NULL)
+    writeCache();
+  return m;
+}
+
+
+/*
+ *  Signal handler (for the CPU time ITIMER_PROF timer) to set
+ *  JunctionTree's probEvidenceTime expired timer.
+ */
+static void
+profileExpiredSigHandler(int arg)
+{
+  JunctionTree::probEvidenceTimeExpired = true;
+}
+
+
+/*
+ * Current resident memory of this process in KB, or -1 if it can't be
+ * found (no /proc).
+ */
+static long
+residentKB()
+{
+  FILE* f = fopen("/proc/self/statm","r");
+  if (f == NULL)
+    return -1;
+  unsigned long size, resident;
+  const int n = fscanf(f,"%lu %lu",&size,&resident);
+  fclose(f);
+  if (n != 2)
+    return -1;
+  return (long)(resident * (unsigned long)(sysconf(_SC_PAGESIZE) / 1024));
+}
+
+
+/*
+ * Peak resident memory of this process in KB. A fork()ed child starts
+ * with the parent's peak (getrusage()'s ru_maxrss is the larger of the
+ * two), so where possible this uses /proc's VmHWM, which
+ * resetPeakResident() puts back to the current resident memory.
+ */
+static long
+peakResidentKB()
+{
+  FILE* f = fopen("/proc/self/status","r");
+  if (f != NULL) {
+    char line[256];
+    long kb = -1;
+    while (fgets(line,sizeof(line),f))
+      if (sscanf(line,"VmHWM: %ld",&kb) == 1)
+	break;
+    fclose(f);
+    if (kb >= 0)
+      return kb;
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF,&ru);
+  return ru.ru_maxrss;
+}
+
+
+static void
+resetPeakResident()
+{
+  // "5" resets the peak resident memory (Linux >= 4.0); older kernels
+  // set it to the current resident memory at fork() anyway.
+  FILE* f = fopen("/proc/self/clear_refs","w");
+  if (f == NULL)
+    return;
+  fputs("5",f);
+  fclose(f);
+}
+
+
+// what a measuring child process reports to its parent
+struct ProfileResult {
+  unsigned numPartitions;
+  double cpuSeconds;
+  long memoryKB;
+};
+
+
+/*
+ * Time inference with the triangulation in gm_template in a child
+ * process: build the junction tree and run prob(evidence) over the
+ * development segments once, or until 'seconds' of CPU time have
+ * passed (in which case the partitions done so far are counted).
+ * Returns false if the child failed.
+ */
+bool
+TriangulationProfiler::run(GMTemplate& gm_template, Measurement& m)
+{
+#if HAVE_WORKING_FORK
+  int filedes[2];
+  if (pipe(&filedes[0])) {
+    error("ERROR: can't create pipe. errno = %d, %s\n",errno,strerror(errno));
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    error("ERROR: can't fork triangulation profiling process. errno = %d, %s\n",errno,strerror(errno));
+  }
+
+  if (pid == 0) {
+    // this is the child process.
+    close(filedes[0]);
+
+    // the memory measured is what the child uses beyond what it got
+    // from the parent.
+    resetPeakResident();
+    const long startKB = residentKB();
+
+    // limit the amount of time we run.
+    struct rlimit rlim;
+    rlim.rlim_cur = rlim.rlim_max = seconds + PROFILE_RLIMIT_SLOP;
+    if (setrlimit(RLIMIT_CPU,&rlim))
+      warning("WARNING: can't limit profiling process to %u seconds. No hard limit on process time!!!\n",
+	      seconds + PROFILE_RLIMIT_SLOP);
+
+    JunctionTree myjt(gm_template);
+    myjt.setUpDataStructures(vpap.c_str(),vcap.c_str());
+    myjt.prepareForUnrolling();
+
+    Range range(devRange.c_str(),0,fs->numSegments());
+
+    struct rusage rus; /* starting time */
+    struct rusage rue; /* ending time */
+    getrusage(RUSAGE_SELF,&rus);
+
+    // stop after 'seconds' of CPU (not wall clock) time.
+    JunctionTree::probEvidenceTimeExpired = false;
+    signal(SIGPROF,profileExpiredSigHandler);
+    struct itimerval timer;
+    timer.it_interval.tv_sec = timer.it_interval.tv_usec = 0;
+    timer.it_value.tv_sec = seconds;
+    timer.it_value.tv_usec = 0;
+    setitimer(ITIMER_PROF,&timer,NULL);
+
+    ProfileResult res;
+    res.numPartitions = 0;
+    for (Range::iterator it = range.begin(); !it.at_end(); it++) {
+      const unsigned segment = (unsigned)(*it);
+      if (fs->numSegments() < (segment+1))
+	error("ERROR: only %d segments in file, segment must be in range [%d,%d]\n",
+	      fs->numSegments(),0,fs->numSegments()-1);
+      const unsigned numFrames = GM_Parms.setSegment(segment);
+      unsigned numUsableFrames;
+      unsigned numPartitionsDone = 0;
+      myjt.probEvidenceTime(numFrames,numUsableFrames,numPartitionsDone);
+      res.numPartitions += numPartitionsDone;
+      if (JunctionTree::probEvidenceTimeExpired)
+	break;
+    }
+    timer.it_value.tv_sec = 0;
+    setitimer(ITIMER_PROF,&timer,NULL);
+
+    getrusage(RUSAGE_SELF,&rue);
+    double userTime,sysTime;
+    reportTiming(rus,rue,userTime,sysTime,NULL);
+    res.cpuSeconds = userTime + sysTime;
+    const long peakKB = peakResidentKB();
+    if (startKB < 0)
+      res.memoryKB = peakKB; // can only over-estimate
+    else
+      res.memoryKB = (peakKB > startKB ? peakKB - startKB : 0);
+
+    bool ok = (write(filedes[1],&res,sizeof(res)) == (ssize_t)sizeof(res));
+    close(filedes[1]);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  // this is the parent process.
+  close(filedes[1]);
+  ProfileResult res;
+  ssize_t rc;
+  while ((rc = read(filedes[0],&res,sizeof(res))) < 0 && errno == EINTR)
+    ;
+  close(filedes[0]);
+  int status = 0;
+  while (waitpid(pid,&status,0) < 0 && errno == EINTR)
+    ;
+  if (rc != (ssize_t)sizeof(res) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+    infoMsg(IM::Default,"NOTICE: triangulation failed to complete profiling in %u CPU seconds, or process failed (status = 0x%X)\n",
+	    seconds + PROFILE_RLIMIT_SLOP,status);
+    return false;
+  }
+  if (res.numPartitions == 0)
+    return false;
+  m.numPartitions = res.numPartitions;
+  m.secondsPerPartition = res.cpuSeconds / res.numPartitions;
+  m.memoryKB = res.memoryKB;
+  return true;
+#else
+  error("ERROR: triangulation profiling is not supported on this platform\n");
+  return false;
+#endif
+}
+
+
+/*
+ * The cache file is ASCII: a magic line, then one line per measured
+ * triangulation with its key, ok flag, seconds per partition, memory
+ * (KB), and number of partitions. Only successful measurements are
+ * written: a failure may be due to the -profileSeconds limit or to the
+ * machine, so it is only remembered for the current run.
+ */
+void
+TriangulationProfiler::readCache()
+{
+  FILE* f = fopen(cacheFileName,"r");
+  if (f == NULL)
+    return;
+  char line[1024];
+  if (!fgets(line,sizeof(line),f) || strncmp(line,PROFILE_CACHE_MAGIC,strlen(PROFILE_CACHE_MAGIC))) {
+    warning("WARNING: ignoring triangulation profile cache file '%s' with unknown format\n",cacheFileName);
+    fclose(f);
+    return;
+  }
+  unsigned n = 0;
+  while (fgets(line,sizeof(line),f)) {
+    char key[64];
+    int ok;
+    Measurement m;
+    if (sscanf(line,"%63s %d %lf %lu %u",key,&ok,&m.secondsPerPartition,&m.memoryKB,&m.numPartitions) != 5) {
+      warning("WARNING: ignoring bad line in triangulation profile cache file '%s'\n",cacheFileName);
+      continue;
+    }
+    m.ok = (ok != 0);
+    if (!m.ok)
+      continue;
+    cache[string(key)] = m;
+    n++;
+  }
+  fclose(f);
+  infoMsg(IM::Low,"Read %u triangulation measurements from '%s'\n",n,cacheFileName);
+}
+
+
+void
+TriangulationProfiler::writeCache()
+{
+  string tmpName = string(cacheFileName) + ".tmp";
+  FILE* f = fopen(tmpName.c_str(),"w");
+  if (f == NULL) {
+    warning("WARNING: can't write triangulation profile cache file '%s': %s\n",tmpName.c_str(),strerror(errno));
+    return;
+  }
+  fprintf(f,"%s\n",PROFILE_CACHE_MAGIC);
+  for (map<string,Measurement>::iterator it = cache.begin(); it != cache.end(); it++) {
+    const Measurement& m = (*it).second;
+    if (!m.ok)
+      continue;
+    fprintf(f,"%s %d %.9g %lu %u\n",(*it).first.c_str(),(int)m.ok,
+	    m.secondsPerPartition,m.memoryKB,m.numPartitions);
+  }
+  if (fclose(f) || rename(tmpName.c_str(),cacheFileName)) {
+    warning("WARNING: can't write triangulation profile cache file '%s': %s\n",cacheFileName,strerror(errno));
+    unlink(tmpName.c_str());
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * GMTK_TriangulationProfiler.h
+ *   Rank triangulations by measured (rather than estimated) inference cost.
+ *
+ * Copyright (C) 2013 Jeff Bilmes
+ * Licensed under the Open Software License version 3.0
+ * See COPYING or http://opensource.org/licenses/OSL-3.0
+ *
+ *
+ * The clique weights used to score triangulations are computed from
+ * variable cardinalities and determinism, and so they can't see the
+ * effect of pruning or sparse CPTs. A TriangulationProfiler instead
+ * runs prob(evidence) inference with a candidate triangulation on a
+ * (small) development set of segments and measures the CPU time per
+ * partition and the memory used. As in gmtkTime, each measurement is
+ * done in a child process so that a bad candidate can be limited in
+ * time and can't disturb the caller. Measurements are cached by
+ * triangulation, and the successful ones optionally in a file across
+ * runs.
+ *
+ */
+
+#ifndef GMTK_TRIANGULATIONPROFILER_H
+#define GMTK_TRIANGULATIONPROFILER_H
+
+#include <map>
+#include <string>
+
+#include "GMTK_GMTemplate.h"
+#include "GMTK_FileSource.h"
+
+using namespace std;
+
+class TriangulationProfiler {
+
+ public:
+
+  struct Measurement {
+    // false if inference failed or no partition finished in time
+    bool ok;
+    // CPU seconds per partition of inference
+    double secondsPerPartition;
+    // peak resident memory of the inference beyond what the
+    // measuring process started with (in KB)
+    unsigned long memoryKB;
+    // number of partitions the time was measured over
+    unsigned numPartitions;
+
+    Measurement() : ok(false), secondsPerPartition(0.0), memoryKB(0), numPartitions(0) {}
+  };
+
+  // 'devRange' is a range over the segments of 'fs', 'seconds' is the
+  // CPU time limit of each measurement, and 'vpap'/'vcap' are the
+  // junction tree variable assignment priorities to use. 'context'
+  // should describe anything else (structure file, pruning options,
+  // etc.) that a cached measurement depends on. If 'cacheFileName' is
+  // non-NULL, successful measurements are read from and written to
+  // that file.
+  TriangulationProfiler(FileSource* fs,
+			const char* devRange,
+			unsigned seconds,
+			const char* vpap,
+			const char* vcap,
+			const string& context,
+			const char* cacheFileName = NULL);
+
+  // Measure inference with the triangulation currently in
+  // 'gm_template' (which must be triangulated by clique completion).
+  // 'cached' is set to true if the measurement came from the cache.
+  Measurement measure(GMTemplate& gm_template, bool& cached);
+
+  // true if a is a better triangulation than b: lower time, then
+  // lower memory. Failed measurements are worst.
+  static bool better(const Measurement& a, const Measurement& b);
+
+ private:
+
+  FileSource* fs;
+  string devRange;
+  unsigned seconds;
+  string vpap;
+  string vcap;
+  string context;
+  const char* cacheFileName;
+
+  map<string,Measurement> cache;
+
+  string triangulationKey(GMTemplate& gm_template);
+  bool run(GMTemplate& gm_template, Measurement& m);
+  void readCache();
+  void writeCache();
+
+};
+
+#endif
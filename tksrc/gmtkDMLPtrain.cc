@@ -30,6 +30,7 @@
 #include "MMapMatrix.h"
 #include "BatchSource.h"
 #include "AsynchronousBatchSource.h"
+#include "gemm.h"
 
 #include "general.h"
 #include "error.h"
@@ -97,6 +98,7 @@ VCID(HGID)
 #define GMTK_ARG_CPP_CMD_OPTS
 #define GMTK_ARG_ALLOC_DENSE_CPTS
 #define GMTK_ARG_CPT_NORM_THRES
+#define GMTK_ARG_DEEPNN_PRECISION
 
 
 /*************************   CONTINUOUS RANDOM VARIABLE OPTIONS       *******************************************/
@@ -161,6 +163,67 @@ ObservationSource *globalObservationMatrix;
 
 #include <iostream>
 
+/*
+ * Copy the DeepNN's current parameters into a DBN with element
+ * type Real, train it on the instances from trainSched, and copy
+ * the trained weights back into the DeepNN.
+ */
+template <class Real>
+static void
+trainDMLP(DeepNN *dnn, TrainingSchedule *trainSched, int inputSize, vector<int> &hiddenSize, int outputSize,
+	  vector<Layer::ActFunc> &hActFunc, DBNBase::ObjectiveType objType,
+	  vector<DBNBase::HyperParams> &pretrainHyperParams, DBNBase::HyperParams &bpHyperParams)
+{
+  int numLayers = (int)dnn->numLayers();
+
+  // copy existing weights into W & B in case we're resuming training.
+  // The DeepNN matrices are row-major with the bias in the last column.
+  vector< AllocatingMatrixT<Real> > W(numLayers);
+  vector< AllocatingVectorT<Real> > B(numLayers);
+  for (unsigned j=0; j < numLayers; j+=1) {
+    double *params;
+    int rows, cols;
+    dnn->getParams(j, rows, cols, params);
+    W[j].Resize(cols-1, rows); // -1 for bias column
+    B[j].Resize(rows);
+    for (int r=0; r < rows; r+=1) {
+      for (int c=0; c < cols-1; c+=1)
+	W[j].AtMutable(c, r) = (Real) params[r * cols + c];
+      B[j][r] = (Real) params[r * cols + cols - 1];
+    }
+  }
+  DBNT<Real> dbn(numLayers, inputSize, hiddenSize, outputSize, iActFunc, hActFunc, W, B);
+
+  BatchSourceT<Real> *batchSrc = new ScheduleBatchSourceT<Real>(trainSched);
+#if 1
+  BatchSourceT<Real> *asynchBatchSrc = new AsynchronousBatchSourceT<Real>(batchSrc, batchQueueSize);
+#endif
+
+#if 1
+  // We want to minimize the size of the temporary files used to hold
+  // the mapped inputs to the next layer for pre-training. If either
+  // ptNumEpochs or ptNumAnnealEpochs are > 1, the code will just make
+  // the temp files hold 1 epoch and cycle through them to get the desired
+  // number of minibatches. If both are < 1, we need the larger of them to
+  // supply enough minibatches.
+  float ptFraction = max(ptNumEpochs, ptNumAnnealEpochs);
+  dbn.Train(asynchBatchSrc, objType, pretrainHyperParams, bpHyperParams, ptFraction,
+	    bpEpochFraction, bpAnnealEpochFraction, loadTrainingFile, saveTrainingFile);
+#else
+  dbn.Train(batchSrc, objType, pretrainHyperParams, bpHyperParams, 
+	    bpEpochFraction, bpAnnealEpochFraction, loadTrainingFile, saveTrainingFile);
+#endif
+
+  // Now write training results back to master file(s)
+  vector<DoubleMatrix *> layerMatrix = dnn->getMatrices();
+  assert(layerMatrix.size() == numLayers);
+  for (unsigned layer=0; layer < numLayers; layer+=1) {
+    MatrixT<Real> const W = dbn.getWeights(layer);
+    dnn->setParams(layer, W.Start(), W.Ld(), dbn.getBias(layer).Start());
+  }
+}
+
+
 int
 main(int argc,char*argv[])
 {
@@ -185,6 +248,9 @@ main(int argc,char*argv[])
 #include "GMTK_Arguments.h"
 #undef GMTK_ARGUMENTS_CHECK_ARGS
 
+  gmtk_gemm_set_threads(gemmThreads);
+  infoMsg(IM::Moderate, "Internal matrix multiply: %s kernel, up to %u threads\n",
+	  gmtk_gemm_kernel(), gmtk_gemm_threads());
 
   /////////////////////////////////////////////
 
@@ -289,18 +355,6 @@ main(int argc,char*argv[])
     }
   }
 
-  vector<AllocatingMatrix> W(numLayers); // copy existing weights into W & B in case we're resuming training
-  vector<AllocatingVector> B(numLayers);
-  for (unsigned j=0; j < numLayers; j+=1) {
-    double *params;
-    int rows, cols;
-    dnn->getParams(j, rows, cols, params);
-    Matrix P(params, cols, rows, cols, false);
-    W[j].CopyFrom( P.SubMatrix(0, cols-1, 0, rows) ); // -1 for bias column
-    B[j].CopyFrom( P.GetRow(cols - 1) );
-  }
-  DBN dbn(numLayers, inputSize, hiddenSize, outputSize, iActFunc, hActFunc, W, B);
-
   // Setup TrainingSchedule to create training instances from observation files in desired order
   gomFS->setMinPastFrames( radius );
   gomFS->setMinFutureFrames( radius );
@@ -347,11 +401,6 @@ main(int argc,char*argv[])
     error("ERROR: unknown training schedule '%s', must be one of linear, random, shuffle, or permute\n", trainingSchedule);
   }
 
-  BatchSource *batchSrc = new ScheduleBatchSource(trainSched);
-#if 1
-  BatchSource *asynchBatchSrc = new AsynchronousBatchSource(batchSrc, batchQueueSize);
-#endif
-
   // Set hyperparameters (mostly from command line arguments)
   vector<DBN::HyperParams> pretrainHyperParams(numLayers);
   for (int j = 0; j < numLayers; j+=1) {
@@ -426,27 +475,14 @@ main(int argc,char*argv[])
   DBN::ObjectiveType objType = 
     ( dnn->getSquashFn(numLayers-1) == DeepNN::SOFTMAX ) ? DBN::SOFT_MAX : DBN::SQ_ERR;
 
-#if 1
-  // We want to minimize the size of the temporary files used to hold
-  // the mapped inputs to the next layer for pre-training. If either
-  // ptNumEpochs or ptNumAnnealEpochs are > 1, the code will just make
-  // the temp files hold 1 epoch and cycle through them to get the desired
-  // number of minibatches. If both are < 1, we need the larger of them to
-  // supply enough minibatches.
-  float ptFraction = max(ptNumEpochs, ptNumAnnealEpochs);
-  dbn.Train(asynchBatchSrc, objType, pretrainHyperParams, bpHyperParams, ptFraction,
-	    bpEpochFraction, bpAnnealEpochFraction, loadTrainingFile, saveTrainingFile);
-#else
-  dbn.Train(batchSrc, objType, pretrainHyperParams, bpHyperParams, 
-	    bpEpochFraction, bpAnnealEpochFraction, loadTrainingFile, saveTrainingFile);
-#endif
-
-  // Now write training results back to master file(s)
-  vector<DoubleMatrix *> layerMatrix = dnn->getMatrices();
-  assert(layerMatrix.size() == numLayers);
-  for (unsigned layer=0; layer < numLayers; layer+=1) {
-    Matrix const W = dbn.getWeights(layer);
-    dnn->setParams(layer, W.Start(), W.Ld(), dbn.getBias(layer).Start());
+  // Train in the requested precision and write the results back to
+  // the DeepNN's (double) parameter matrices
+  if (DeepNN::singlePrecision) {
+    trainDMLP<float>(dnn, trainSched, inputSize, hiddenSize, outputSize, hActFunc,
+		     objType, pretrainHyperParams, bpHyperParams);
+  } else {
+    trainDMLP<double>(dnn, trainSched, inputSize, hiddenSize, outputSize, hActFunc,
+		      objType, pretrainHyperParams, bpHyperParams);
   }
   
   if (outputTrainableParameters != NULL) {
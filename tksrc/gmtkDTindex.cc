@@ -81,6 +81,7 @@ VCID(HGID)
 #define GMTK_ARG_VERSION
 
 static char *DTFiles           = NULL;
+static char *segmentArchive    = NULL;
 
 
 #define GMTK_ARGUMENTS_DEFINITION
@@ -96,6 +97,7 @@ Arg Arg::Args[] = {
 
   Arg("\n*** Decision tree files ***\n"),
   Arg("decisionTreeFiles", Arg::Opt, DTFiles, "List of decision tree files"),
+  Arg("segmentArchive", Arg::Opt, segmentArchive, "Instead of index files, write all iterable DTs and lattices of the master file to this segment archive"),
 
   // final one to signal the end of the list
   Arg()
@@ -135,6 +137,9 @@ main(int argc,char*argv[])
 #include "GMTK_Arguments.h"
 #undef GMTK_ARGUMENTS_CHECK_ARGS
 
+  if (segmentArchive != NULL && (inputMasterFile == NULL || DTFiles != NULL)) {
+    error("ERROR: -segmentArchive needs -inputMasterFile (which names the archived objects) and can't be used with -decisionTreeFiles\n");
+  }
 
 
   ////////////////////////////////////////////
@@ -143,7 +148,10 @@ main(int argc,char*argv[])
     iDataStreamFile pf(inputMasterFile,false,true,cppCommandOptions);
 
     GM_Parms.read(pf);
-    GM_Parms.writeDecisionTreeIndexFiles();
+    if (segmentArchive != NULL) 
+      GM_Parms.writeSegmentArchive(segmentArchive);
+    else
+      GM_Parms.writeDecisionTreeIndexFiles();
   }
 
   ////////////////////////////////////////////
@@ -45,6 +45,7 @@ VCID(HGID)
 #include "GMTK_ContRV.h"
 #include "GMTK_GMTemplate.h"
 #include "GMTK_GMParms.h"
+#include "GMTK_FNGramCPT.h"
 #if 0
 #  include "GMTK_ObservationMatrix.h"
 #else
@@ -85,6 +86,8 @@ VCID(HGID)
 #define GMTK_ARG_WPAEEI
 #define GMTK_ARG_ALLOC_DENSE_CPTS
 #define GMTK_ARG_CPT_NORM_THRES
+#define GMTK_ARG_FNGRAM_CACHE
+#define GMTK_ARG_DEEPNN_PRECISION
 
 /*************************   INPUT STRUCTURE PARAMETER FILE HANDLING  *******************************************/
 #define GMTK_ARG_INPUT_MODEL_FILE_HANDLING
@@ -456,6 +459,8 @@ main(int argc,char*argv[])
 	      total_data_prob *= myjt.curProbEvidenceIsland();
 	    }
 	  } else {
+	    if (emPruneMasks)
+	      myjt.setPruneMaskSegment(segment);
 	    unsigned numUsableFrames = myjt.unroll(numFrames);
 	    gomFS->justifySegment(numUsableFrames);
 	    total_num_frames += numUsableFrames;
@@ -47,6 +47,7 @@ VCID(HGID)
 #include "GMTK_ContRV.h"
 #include "GMTK_GMTemplate.h"
 #include "GMTK_GMParms.h"
+#include "GMTK_FNGramCPT.h"
 #if 0
 #  include "GMTK_ObservationMatrix.h"
 #else
@@ -87,6 +88,8 @@ VCID(HGID)
 #define GMTK_ARG_WPAEEI
 #define GMTK_ARG_ALLOC_DENSE_CPTS
 #define GMTK_ARG_CPT_NORM_THRES
+#define GMTK_ARG_FNGRAM_CACHE
+#define GMTK_ARG_DEEPNN_PRECISION
 
 /*************************   INPUT STRUCTURE PARAMETER FILE HANDLING  *******************************************/
 #define GMTK_ARG_INPUT_MODEL_FILE_HANDLING
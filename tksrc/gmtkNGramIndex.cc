@@ -19,6 +19,11 @@
  *          1 % number of parents
  *          VOCAB_SIZE VOCAB_SIZE % cards
  *          ./DATA/bigram.arpa.idx [binary] % ARPA lm indexing file
+ * or, with -packed T,
+ *          bigram
+ *          1 % number of parents
+ *          VOCAB_SIZE VOCAB_SIZE % cards
+ *          ./DATA/bigram.arpa.plm [packed] % packed lm file
  *
  *
  * Copyright (C) 2001 Jeff Bilmes
@@ -40,6 +45,7 @@
 
 #include "GMTK_Vocab.h"
 #include "GMTK_NGramCPT.h"
+#include "GMTK_PackedNGramLM.h"
 #include "GMTK_GMParms.h"
 #include "GMTK_ObservationMatrix.h"
 #include "rand.h"
@@ -58,6 +64,8 @@ VCID(HGID)
 static char * lmFile = NULL;
 static char* vocabFile = NULL;
 static bool outBin = false;
+static bool packed = false;
+static unsigned quantBits = 8;
 
 
 #define GMTK_ARG_VERSION
@@ -86,6 +94,10 @@ Arg Arg::Args[] = {
 
 	Arg("outBin", Arg::Opt, outBin, "Use binary for output index file"),
 
+	Arg("packed", Arg::Opt, packed, "Write a packed (mmap-able) lm file (lmFile.plm) rather than an index file"),
+
+	Arg("quantBits", Arg::Opt, quantBits, "Quantize packed lm probabilities and backoff weights to this many bits (0 = don't quantize)"),
+
 	// final one to signal the end of the list
 	Arg()
 
@@ -167,6 +179,18 @@ int main(int argc, char *argv[]) {
 	Vocab vocab(card);
 	vocab.read(vocabFile);
 
+	if ( packed ) {
+		char * packedFile = new char [strlen(lmFile) + 10];
+		strcpy(packedFile, lmFile);
+		strcat(packedFile, ".plm");
+
+		fprintf(stderr, "writing %d-order packed lm file...\n", order);
+		PackedNGramLM::build(lmFile, vocab, quantBits, packedFile);
+
+		delete [] packedFile;
+		return 0;
+	}
+
 	// read in lm
 	NGramCPT ngram;
 	ngram.setNumParents(order - 1);
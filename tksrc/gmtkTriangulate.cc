@@ -26,6 +26,8 @@
 #include <float.h>
 #include <assert.h>
 
+#include <vector>
+
 #include "general.h"
 #include "error.h"
 #include "debug.h"
@@ -35,6 +37,8 @@
 //#include "spi.h"
 #include "version.h"
 
+#include "GMTK_WordOrganization.h"
+
 VCID(HGID)
 
 
@@ -51,6 +55,8 @@ VCID(HGID)
 #  include "GMTK_FileSource.h"
 #  include "GMTK_ASCIIFile.h"
 #  include "GMTK_Stream.h"
+#  include "GMTK_CreateFileSource.h"
+#  include "GMTK_CookedCacheFile.h"
 #endif
 #include "GMTK_MixtureCommon.h"
 #include "GMTK_GaussianComponent.h"
@@ -61,7 +67,15 @@ VCID(HGID)
 #include "GMTK_Signals.h"
 #include "GMTK_BoundaryTriangulate.h"
 #include "GMTK_JunctionTree.h"
+#include "GMTK_TriangulationProfiler.h"
+
 
+/*************************   OBSERVATION INPUT FILE HANDLING  ***************************************************/
+#define GMTK_ARG_OBS_FILES_OPT_ARG
+#define GMTK_ARG_START_END_SKIP
+
+/************************  OBSERVATION MATRIX TRANSFORMATION OPTIONS   ******************************************/
+#define GMTK_ARG_OBS_MATRIX_XFORMATION
 
 /*************************   INPUT TRAINABLE PARAMETER FILE HANDLING  *******************************************/
 #define GMTK_ARG_CPP_CMD_OPTS
@@ -82,6 +96,16 @@ VCID(HGID)
 #define GMTK_ARG_JTW_UB
 #define GMTK_ARG_JT_OPTIONS
 #define GMTK_ARG_CROSSOVER_OPTIONS
+#define GMTK_ARG_PROFILE_TRIANGULATION
+#define GMTK_ARG_CLIQUE_VAR_ITER_ORDERS
+
+/****************************      BEAM PRUNING OPTIONS     ****************************************************/
+#define GMTK_ARG_BEAM_PRUNING_OPTIONS
+#define GMTK_ARG_CBEAM
+#define GMTK_ARG_CKBEAM
+#define GMTK_ARG_CRBEAM
+#define GMTK_ARG_CMBEAM
+#define GMTK_ARG_SBEAM
 
 /*************************   INPUT TRAINABLE PARAMETER FILE HANDLING  *******************************************/
 #define GMTK_ARG_ALLOC_DENSE_CPTS
@@ -121,6 +145,15 @@ void triangulateCrossover(
  vector<MaxClique>&   input_E_triangulation
  );
 
+void profileTriangulate(
+ BoundaryTriangulate&             triangulator,
+ GMTemplate&                      gm_template,
+ BoundaryTriangulate::SavedGraph& orgnl_P_graph,
+ BoundaryTriangulate::SavedGraph& orgnl_C_graph,
+ BoundaryTriangulate::SavedGraph& orgnl_E_graph,
+ bool doP, bool doC, bool doE
+ );
+
 #define MYBS(x) ((x)?"T":"F")
 
 /*
@@ -178,6 +211,13 @@ void createCommandLineOptionString(string& res)
   if (anyTimeTriangulate != NULL) {
     sprintf(buff,"anyTimeTriangulate: %s, ",anyTimeTriangulate);
     res += buff;
+    sprintf(buff,"anyTimeWorkers: %u, ",anyTimeWorkers);
+    res += buff;
+  }
+
+  if (profileHeuristics != NULL) {
+    res += string("profileHeuristics: ") + profileHeuristics + ", ";
+    res += string("profileRange: ") + profileRange + ", ";
   }
 
 }
@@ -250,6 +290,8 @@ main(int argc,char*argv[])
   set_new_handler(memory_error);
   InstallSignalHandlersTime();
 
+  CODE_TO_COMPUTE_ENDIAN;
+
   ////////////////////////////////////////////
   // parse arguments
   bool parse_was_ok = Arg::parse(argc,(char**)argv,
@@ -264,6 +306,12 @@ main(int argc,char*argv[])
 #include "GMTK_Arguments.h"
 #undef GMTK_ARGUMENTS_CHECK_ARGS
 
+  if (profileHeuristics != NULL) {
+    // observations are only needed to time inference
+    gomFS = instantiateFileSource();
+    globalObservationMatrix = gomFS;
+  }
+
   /////////////////////////////////////////////
   if (loadParameters) {
     // read in all the parameters
@@ -313,7 +361,19 @@ main(int argc,char*argv[])
 
   // make sure that all observation variables work
   // with the global observation stream.
-  // fp.checkConsistentWithGlobalObservationStream();
+  if (profileHeuristics != NULL) {
+    fp.checkConsistentWithGlobalObservationStream();
+    GM_Parms.checkConsistentWithGlobalObservationStream();
+    GM_Parms.setStride(gomFS->stride());
+
+    int dlinkPast = Dlinks::globalMinLag();
+    dlinkPast = (dlinkPast < 0) ? -dlinkPast : 0;
+    gomFS->setMinPastFrames( dlinkPast );
+
+    int dlinkFuture = Dlinks::globalMaxLag();
+    dlinkFuture = (dlinkFuture > 0) ? dlinkFuture : 0;
+    gomFS->setMinFutureFrames( dlinkFuture );
+  }
 
   BoundaryTriangulate triangulator(fp,maxNumChunksInBoundary,chunkSkip,traverseFraction);
 
@@ -448,6 +508,7 @@ main(int argc,char*argv[])
       timer->DisableTimer();
   }
   triangulator.useTimer(timer);
+  triangulator.useAnyTimeWorkers(anyTimeWorkers);
 
   if (jut >= 0) {
     // then Just Unroll, Triangulate, and report on quality of triangulation.
@@ -481,7 +542,12 @@ main(int argc,char*argv[])
       triangulator.saveCurrentNeighbors( gm_template.C.nodes, orgnl_C_graph );
       triangulator.saveCurrentNeighbors( gm_template.E.nodes, orgnl_E_graph );
 
-      if (anyTimeTriangulate == NULL) {
+      if (profileHeuristics != NULL) {
+	// pick the triangulation with the fastest measured inference.
+	profileTriangulate(triangulator,gm_template,
+			   orgnl_P_graph,orgnl_C_graph,orgnl_E_graph,
+			   true,true,true);
+      } else if (anyTimeTriangulate == NULL) {
 	// just run simple triangulation.
 	triangulator.triangulate(string(triangulationHeuristic),
 				 jtWeight,
@@ -552,7 +618,12 @@ main(int argc,char*argv[])
         //////////////////////////////////////////////////////////////////////
         // Call the appropriate triangulation interface  
         //////////////////////////////////////////////////////////////////////
-        if (string(triangulationHeuristic) == "crossover") {
+        if (profileHeuristics != NULL) {
+	  profileTriangulate(triangulator,gm_template,
+			     orgnl_P_graph,orgnl_C_graph,orgnl_E_graph,
+			     !noReTriP,!noReTriC,!noReTriE);
+        }
+        else if (string(triangulationHeuristic) == "crossover") {
           triangulateCrossover( triangulator, gm_template, fp, 
             input_crossover_tri_file, output_crossover_tri_file, 
             input_P_triangulation, 
@@ -804,3 +875,124 @@ void triangulateCrossover(
 }
 
 
+
+
+/*
+ * profileTriangulate:
+ *    Triangulate with each of the comma separated heuristics in
+ *    -profileHeuristics, time inference with each resulting
+ *    triangulation on the -profileRange segments, and leave the
+ *    fastest one (that is within -profileMaxMemory) in gm_template.
+ *    The orgnl_*_graph arguments are the untriangulated partitions.
+ *
+ */
+void profileTriangulate(
+ BoundaryTriangulate&             triangulator,
+ GMTemplate&                      gm_template,
+ BoundaryTriangulate::SavedGraph& orgnl_P_graph,
+ BoundaryTriangulate::SavedGraph& orgnl_C_graph,
+ BoundaryTriangulate::SavedGraph& orgnl_E_graph,
+ bool doP, bool doC, bool doE
+ )
+{
+  // anything besides the triangulation that changes inference cost,
+  // with the size and modification time of the files so that a
+  // changed file is measured again
+  string context = CookedCacheFile::fileIdentity(strFileName);
+  for (unsigned i=0; i < MAX_NUM_OBS_FILES && ofs[i] != NULL; i++)
+    context += string("|") + CookedCacheFile::fileIdentity(ofs[i]);
+  if (inputMasterFile != NULL)
+    context += string("|") + CookedCacheFile::fileIdentity(inputMasterFile);
+  if (inputTrainableParameters != NULL)
+    context += string("|") + CookedCacheFile::fileIdentity(inputTrainableParameters);
+  char buff[512];
+  sprintf(buff,"|cbeam=%g,ckbeam=%u,crbeam=%g,cmbeam=%g,sbeam=%g",
+	  MaxClique::cliqueBeam,MaxClique::cliqueBeamMaxNumStates,
+	  MaxClique::cliqueBeamRetainFraction,MaxClique::cliqueBeamMassRetainFraction,
+	  SeparatorClique::separatorBeam);
+  context += buff;
+
+  TriangulationProfiler profiler(gomFS,profileRange,profileSeconds,
+				 varPartitionAssignmentPrior,varCliqueAssignmentPrior,
+				 context,profileCacheFile);
+
+  vector<string> heuristics;
+  vector<TriangulationProfiler::Measurement> measurements;
+  int best = -1;
+  vector<MaxClique> best_cliques[3];
+  string best_method[3];
+  Partition* part[3] = { &gm_template.P, &gm_template.C, &gm_template.E };
+
+  const string heurs(profileHeuristics);
+  string::size_type start = 0;
+  while (start < heurs.size()) {
+    string::size_type end = heurs.find(',',start);
+    if (end == string::npos)
+      end = heurs.size();
+    const string heur = heurs.substr(start,end-start);
+    start = end + 1;
+    if (heur.size() == 0)
+      continue;
+
+    triangulator.restoreNeighbors(orgnl_P_graph);
+    triangulator.restoreNeighbors(orgnl_C_graph);
+    triangulator.restoreNeighbors(orgnl_E_graph);
+    triangulator.triangulate(heur,jtWeight,gm_template,doP,doC,doE);
+
+    bool cached;
+    TriangulationProfiler::Measurement m = profiler.measure(gm_template,cached);
+    if (m.ok && profileMaxMemory > 0 && m.memoryKB > 1024UL*profileMaxMemory) {
+      infoMsg(IM::Default,"Triangulation '%s' uses %lu KB, more than -profileMaxMemory %u MB\n",
+	      heur.c_str(),m.memoryKB,profileMaxMemory);
+      m.ok = false;
+    }
+    if (m.ok)
+      infoMsg(IM::Default,"Triangulation '%s': %e seconds/partition, %lu KB (%u partitions%s)\n",
+	      heur.c_str(),m.secondsPerPartition,m.memoryKB,m.numPartitions,
+	      cached ? ", cached" : "");
+    else
+      infoMsg(IM::Default,"Triangulation '%s': failed%s\n",heur.c_str(),cached ? " (cached)" : "");
+
+    heuristics.push_back(heur);
+    measurements.push_back(m);
+    if (best < 0 || TriangulationProfiler::better(m,measurements[best])) {
+      best = measurements.size() - 1;
+      for (unsigned i=0; i < 3; i++) {
+	best_cliques[i] = part[i]->cliques;
+	best_method[i] = part[i]->triMethod;
+      }
+    }
+  }
+  if (best < 0 || !measurements[best].ok)
+    error("ERROR: none of the -profileHeuristics triangulations '%s' could be profiled\n",profileHeuristics);
+
+  // rank the candidates
+  vector<unsigned> order;
+  for (unsigned i=0; i < measurements.size(); i++) {
+    unsigned j = order.size();
+    order.push_back(i);
+    while (j > 0 && TriangulationProfiler::better(measurements[i],measurements[order[j-1]])) {
+      order[j] = order[j-1];
+      j--;
+    }
+    order[j] = i;
+  }
+  infoMsg(IM::Default,"--- Triangulations ranked by measured inference time ---\n");
+  for (unsigned r=0; r < order.size(); r++) {
+    const TriangulationProfiler::Measurement& m = measurements[order[r]];
+    if (m.ok)
+      infoMsg(IM::Default,"%u: '%s' %e seconds/partition, %lu KB\n",r+1,
+	      heuristics[order[r]].c_str(),m.secondsPerPartition,m.memoryKB);
+    else
+      infoMsg(IM::Default,"%u: '%s' failed\n",r+1,heuristics[order[r]].c_str());
+  }
+
+  triangulator.restoreNeighbors(orgnl_P_graph);
+  triangulator.restoreNeighbors(orgnl_C_graph);
+  triangulator.restoreNeighbors(orgnl_E_graph);
+  for (unsigned i=0; i < 3; i++) {
+    part[i]->cliques = best_cliques[i];
+    part[i]->triMethod = best_method[i];
+  }
+  gm_template.triangulatePartitionsByCliqueCompletion();
+}